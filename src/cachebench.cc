@@ -0,0 +1,77 @@
+#include "cachebench.hh"
+#include "shared.hh"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+static double median_of(std::vector<double> &v)
+{
+  if (v.empty())
+    return 0;
+  std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+int cache_sweep(void *base, uint64_t size, uint64_t max_bytes, int samples, struct cache_sweep_result *r)
+{
+  memset(r, 0, sizeof(*r));
+  uint64_t target = (uint64_t)base;
+  uint64_t set = target + PAGE_SIZE;
+  if (size > PAGE_SIZE && max_bytes > size - PAGE_SIZE)
+    max_bytes = size - PAGE_SIZE;
+
+  std::vector<double> lat(samples);
+  for (uint64_t bytes = PAIRS_LINE_SIZE; bytes <= max_bytes && r->num_points < CACHE_SWEEP_MAX_POINTS; bytes *= 2)
+  {
+    double sum = 0;
+    for (int s = 0; s < samples; s++)
+    {
+      measure_load(target);
+      for (uint64_t off = 0; off < bytes; off += PAIRS_LINE_SIZE)
+        measure_load(set + off);
+      lat[s] = (double)measure_load(target);
+      sum += lat[s];
+    }
+    struct cache_sweep_point *p = &r->point[r->num_points++];
+    p->bytes = bytes;
+    p->mean = samples ? sum / samples : 0;
+    p->median = median_of(lat);
+  }
+  if (r->num_points < 2)
+    return -1;
+
+  r->hit_latency = r->point[0].median;
+  r->miss_latency = r->point[r->num_points - 1].median;
+  if (r->miss_latency <= r->hit_latency)
+    return -1;
+  double split = (r->hit_latency + r->miss_latency) / 2;
+  for (int i = 0; i < r->num_points && r->point[i].median < split; i++)
+    r->cached_bytes = r->point[i].bytes;
+  return 0;
+}
+
+int flush_bench(void *base, struct flush_bench_result *r)
+{
+  memset(r, 0, sizeof(*r));
+  uint64_t addr = (uint64_t)base;
+  std::vector<double> hit(FLUSH_BENCH_SAMPLES), flushed(FLUSH_BENCH_SAMPLES);
+  for (int s = 0; s < FLUSH_BENCH_SAMPLES; s++)
+  {
+    measure_load(addr);
+    r->hit[s] = measure_load(addr);
+    measure_flush(addr);
+    r->flushed[s] = measure_load(addr);
+    hit[s] = (double)r->hit[s];
+    flushed[s] = (double)r->flushed[s];
+    r->hit_mean += hit[s] / FLUSH_BENCH_SAMPLES;
+    r->flushed_mean += flushed[s] / FLUSH_BENCH_SAMPLES;
+  }
+  r->samples = FLUSH_BENCH_SAMPLES;
+  r->hit_median = median_of(hit);
+  r->flushed_median = median_of(flushed);
+  // A flush that leaves the line cached only shows up as hit noise.
+  std::sort(hit.begin(), hit.end());
+  r->flush_works = r->flushed_median > hit[(size_t)(FLUSH_BENCH_HIT_QUANTILE * (FLUSH_BENCH_SAMPLES - 1))];
+  return r->flush_works ? 0 : -1;
+}
@@ -0,0 +1,71 @@
+#ifndef CACHEBENCH_GUARD
+#define CACHEBENCH_GUARD
+
+#include <stdint.h>
+
+#include "params.hh"
+
+// Cache size and flush benchmarks (tme's Experiment-1A and 1B).
+//
+// The cache sweep loads a target line, streams a working set of each size
+// from one line up, and times a reload of the target: while the working set
+// fits in a cache level the reload hits it, and the sizes where the reload
+// slows down are the cache capacities, and the size of an eviction set that
+// works without a flush instruction. The flush benchmark times the same
+// line loaded twice and loaded again after measure_flush, which tells
+// whether DC CIVAC (clflush) actually evicts from user space.
+//
+// Both time with measure_load, so they run on the shared clock service and
+// under MEASURE_SIM.
+
+struct cache_sweep_point
+{
+  uint64_t bytes; // Working set
+  double mean;    // Reload latency, timer units
+  double median;
+};
+
+struct cache_sweep_result
+{
+  int num_points;
+  struct cache_sweep_point point[CACHE_SWEEP_MAX_POINTS];
+  double hit_latency;    // Median reload after the smallest working set
+  double miss_latency;   // ... and after the largest
+  uint64_t cached_bytes; // Largest working set the reload still hit after, 0 if none
+};
+
+/*
+ * cache_sweep
+ *
+ * Inputs: base/size - Buffer; the target is its first line, the working
+ *                     sets follow from the next page
+ *         max_bytes - Largest working set (capped by the buffer)
+ *         samples - Reloads timed per size
+ * Outputs: r - Latency per working-set size and the largest one still cached
+ * Returns: 0 if the reload got slower past some size, -1 otherwise
+ */
+int cache_sweep(void *base, uint64_t size, uint64_t max_bytes, int samples, struct cache_sweep_result *r);
+
+struct flush_bench_result
+{
+  int samples;
+  uint64_t hit[FLUSH_BENCH_SAMPLES];     // Second of two back-to-back loads
+  uint64_t flushed[FLUSH_BENCH_SAMPLES]; // Load right after measure_flush
+  double hit_mean;
+  double flushed_mean;
+  double hit_median;
+  double flushed_median;
+  int flush_works; // Flushed median above the FLUSH_BENCH_HIT_QUANTILE quantile of the hits
+};
+
+/*
+ * flush_bench
+ *
+ * Times FLUSH_BENCH_SAMPLES hit and flushed loads of the first line of base.
+ *
+ * Outputs: r - Per-sample latencies and their summary
+ * Returns: 0 if the flush made the load slower, -1 otherwise
+ */
+int flush_bench(void *base, struct flush_bench_result *r);
+
+#endif
@@ -0,0 +1,267 @@
+#include "channels.hh"
+#include "config.hh"
+#include "output.hh"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Median of CHANNEL_STREAM_REPEATS measurements.
+static double median_throughput(throughput_fn fn, const uint64_t *addrs, int n, struct channel_map *map)
+{
+  double t[CHANNEL_STREAM_REPEATS];
+  for (int r = 0; r < CHANNEL_STREAM_REPEATS; r++)
+    t[r] = fn(addrs, n);
+  map->measurements += CHANNEL_STREAM_REPEATS;
+  std::sort(t, t + CHANNEL_STREAM_REPEATS);
+  return t[CHANNEL_STREAM_REPEATS / 2];
+}
+
+int channel_discover(throughput_fn fn, void *base, uint64_t size, struct channel_map *map)
+{
+  map->measurements = 0;
+  map->num_channels = 1;
+  map->num_ranks = 1;
+  map->rank_split = 0;
+
+  // Line-aligned probes drawn uniformly from the buffer.
+  std::mt19937_64 rng(config.pair_seed);
+  map->num_probes = CHANNEL_PROBES;
+  for (int i = 0; i < map->num_probes; i++)
+    map->probe[i] = (uint64_t)base + rng() % (size / PAIRS_LINE_SIZE) * PAIRS_LINE_SIZE;
+
+  map->num_groups = mapping_timed_banks(map->probe, map->num_probes, map->probe_group, map->rep, CHANNEL_MAX_GROUPS);
+  int n = map->num_groups;
+  for (int g = 0; g < n; g++)
+  {
+    map->channel[g] = 0;
+    map->rank[g] = 0;
+  }
+  if (n < 2)
+  {
+    output_log("[-] channels: %d bank group(s) found, nothing to tell apart\n", n);
+    return -1;
+  }
+
+  for (int g = 0; g < n; g++)
+    map->single[g] = median_throughput(fn, &map->rep[g], 1, map);
+
+  // Pair throughput relative to one stream: ~2 on different channels,
+  // lower when the pair shares a channel, lower again across its ranks.
+  std::vector<double> ratio(n * n, 0.0);
+  for (int a = 0; a < n; a++)
+  {
+    for (int b = a + 1; b < n; b++)
+    {
+      uint64_t pair[2] = {map->rep[a], map->rep[b]};
+      double mean_single = (map->single[a] + map->single[b]) / 2;
+      double r = mean_single > 0 ? median_throughput(fn, pair, 2, map) / mean_single : 0.0;
+      ratio[a * n + b] = ratio[b * n + a] = r;
+    }
+  }
+
+  // Channels: a group joins the first channel it does not run in parallel with.
+  std::vector<int> channel_rep;
+  for (int g = 0; g < n; g++)
+  {
+    int c = 0;
+    while (c < (int)channel_rep.size() && ratio[g * n + channel_rep[c]] >= CHANNEL_PARALLEL_RATIO)
+      c++;
+    if (c == (int)channel_rep.size())
+      channel_rep.push_back(g);
+    map->channel[g] = c;
+  }
+  map->num_channels = (int)channel_rep.size();
+
+  // Ranks: the largest relative gap between pair ratios inside channels.
+  std::vector<double> inside;
+  for (int a = 0; a < n; a++)
+    for (int b = a + 1; b < n; b++)
+      if (map->channel[a] == map->channel[b])
+        inside.push_back(ratio[a * n + b]);
+  std::sort(inside.begin(), inside.end());
+  double best_gap = 0;
+  for (size_t i = 1; i < inside.size(); i++)
+  {
+    double gap = inside[i] > 0 ? (inside[i] - inside[i - 1]) / inside[i] : 0.0;
+    if (gap > best_gap)
+    {
+      best_gap = gap;
+      map->rank_split = (inside[i] + inside[i - 1]) / 2;
+    }
+  }
+  if (best_gap < CHANNEL_MIN_GAP)
+    map->rank_split = 0;
+
+  if (map->rank_split > 0)
+  {
+    for (int c = 0; c < map->num_channels; c++)
+    {
+      std::vector<int> rank_rep;
+      for (int g = 0; g < n; g++)
+      {
+        if (map->channel[g] != c)
+          continue;
+        int r = 0;
+        while (r < (int)rank_rep.size() && ratio[g * n + rank_rep[r]] < map->rank_split)
+          r++;
+        if (r == (int)rank_rep.size())
+          rank_rep.push_back(g);
+        map->rank[g] = r;
+      }
+      map->num_ranks = std::max(map->num_ranks, (int)rank_rep.size());
+    }
+  }
+
+  if (map->num_channels != NUM_CHANNELS || map->num_ranks != NUM_RANKS)
+    output_log("[-] channels: found %d channel(s) x %d rank(s), params.hh says %d x %d\n", map->num_channels,
+               map->num_ranks, NUM_CHANNELS, NUM_RANKS);
+  return 0;
+}
+
+static inline int parity(uint64_t x)
+{
+  return __builtin_parityll(x);
+}
+
+/*
+ * fit_masks
+ *
+ * Chooses up to log2(num_labels) masks of one or two bits such that, within
+ * every class cls, the parity vector of a probe determines its label.
+ * Masks must be constant on every (class, label) and are tried lightest and
+ * lowest first.
+ */
+static int fit_masks(const std::vector<uint64_t> &phys, const std::vector<int> &label, const std::vector<int> &cls,
+                     int num_labels, int num_classes, unsigned max_bit, uint64_t *masks, unsigned *num_masks)
+{
+  unsigned k = 0;
+  while ((1 << k) < num_labels)
+    k++;
+  if ((1 << k) != num_labels || k > MAPPING_MAX_FUNCS)
+    return -1;
+  *num_masks = 0;
+  if (k == 0)
+    return 0;
+
+  std::vector<uint64_t> candidates;
+  for (unsigned i = CHANNEL_FIT_MIN_BIT; i < max_bit; i++)
+    candidates.push_back(1ULL << i);
+  for (unsigned i = CHANNEL_FIT_MIN_BIT; i < max_bit; i++)
+    for (unsigned j = i + 1; j < max_bit; j++)
+      candidates.push_back((1ULL << i) | (1ULL << j));
+
+  // Parity vector of every (class, label) under the masks chosen so far, and
+  // which (class, label) combinations occur at all.
+  int slots = num_classes * num_labels;
+  std::vector<uint64_t> vec(slots, 0);
+  std::vector<int> seen(slots, 0);
+  for (size_t i = 0; i < phys.size(); i++)
+    seen[cls[i] * num_labels + label[i]] = 1;
+
+  auto separated = [&](const std::vector<uint64_t> &v) {
+    int count = 0;
+    for (int c = 0; c < num_classes; c++)
+      for (int a = 0; a < num_labels; a++)
+        for (int b = a + 1; b < num_labels; b++)
+          count += seen[c * num_labels + a] && seen[c * num_labels + b] &&
+                   v[c * num_labels + a] != v[c * num_labels + b];
+    return count;
+  };
+  int target = 0;
+  {
+    std::vector<uint64_t> all(slots);
+    for (int s = 0; s < slots; s++)
+      all[s] = s % num_labels;
+    target = separated(all);
+  }
+
+  for (size_t m = 0; m < candidates.size() && *num_masks < k; m++)
+  {
+    std::vector<int> p(slots, -1);
+    int ok = 1;
+    for (size_t i = 0; i < phys.size() && ok; i++)
+    {
+      int s = cls[i] * num_labels + label[i];
+      int bit = parity(phys[i] & candidates[m]);
+      ok = p[s] < 0 || p[s] == bit;
+      p[s] = bit;
+    }
+    if (!ok)
+      continue;
+
+    std::vector<uint64_t> next(vec);
+    for (int s = 0; s < slots; s++)
+      next[s] |= (uint64_t)(p[s] > 0) << *num_masks;
+    if (separated(next) <= separated(vec))
+      continue;
+    vec = next;
+    masks[(*num_masks)++] = candidates[m];
+  }
+  return separated(vec) == target ? 0 : -1;
+}
+
+int channel_fit_profile(const struct channel_map *map, struct mapping_profile *p)
+{
+  unsigned max_bit = CHANNEL_FIT_MAX_BIT;
+  if (mapping_current_mode() == MAPPING_INFERRED)
+  {
+    // Offsets are only physical below the contiguous run.
+    unsigned run_bits = 0;
+    while ((1ULL << (run_bits + 1)) <= (uint64_t)MAPPING_CONTIG_BYTES)
+      run_bits++;
+    max_bit = std::min(max_bit, run_bits);
+  }
+
+  std::vector<uint64_t> phys;
+  std::vector<int> channel, rank, zero;
+  for (int i = 0; i < map->num_probes; i++)
+  {
+    int g = map->probe_group[i];
+    if (g < 0)
+      continue;
+    phys.push_back(virt_to_phys(map->probe[i]));
+    channel.push_back(map->channel[g]);
+    rank.push_back(map->rank[g]);
+    zero.push_back(0);
+  }
+
+  struct mapping_profile fitted = *p;
+  if (fit_masks(phys, channel, zero, map->num_channels, 1, max_bit, fitted.channel_masks,
+                &fitted.num_channel_funcs))
+  {
+    output_log("[-] channels: no channel functions of <= 2 bits explain %d channels\n", map->num_channels);
+    return -1;
+  }
+  if (fit_masks(phys, rank, channel, map->num_ranks, map->num_channels, max_bit, fitted.rank_masks,
+                &fitted.num_rank_funcs))
+  {
+    output_log("[-] channels: no rank functions of <= 2 bits explain %d ranks\n", map->num_ranks);
+    return -1;
+  }
+  *p = fitted;
+  return 0;
+}
+
+int channel_refine_mapping(throughput_fn fn, void *base, uint64_t size, struct channel_map *map)
+{
+  if (channel_discover(fn, base, size, map))
+    return -1;
+  struct mapping_profile profile;
+  mapping_default_profile(&profile);
+  if (channel_fit_profile(map, &profile))
+    return 0;
+  mapping_init(mapping_current_mode(), base, size, &profile);
+  return 1;
+}
+
+void channel_print(const struct channel_map *map)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Channel-Discovery, %d groups, %d channels, %d ranks, rank split %.3f\n", map->num_groups,
+                map->num_channels, map->num_ranks, map->rank_split);
+  output_printf("Group,Rep-Phys,Single-Throughput,Channel,Rank\n");
+  for (int g = 0; g < map->num_groups; g++)
+    output_printf("%d,0x%llx,%.5f,%d,%d\n", g, (unsigned long long)virt_to_phys(map->rep[g]), map->single[g],
+                  map->channel[g], map->rank[g]);
+}
@@ -0,0 +1,85 @@
+#ifndef CHANNELS_GUARD
+#define CHANNELS_GUARD
+
+#include <stdint.h>
+
+#include "mapping.hh"
+#include "params.hh"
+
+// Channel and rank discovery.
+//
+// Bank clustering by row conflicts cannot tell channels from banks: two
+// addresses in different channels never conflict, just like two banks of one
+// channel. Concurrency can. Two streams of uncached loads to different
+// channels run in parallel (about twice the throughput of one stream), two
+// streams on one channel share its bus, and two ranks of one channel also
+// pay for switching between them. So after clustering probe addresses into
+// banks by timing, the banks are grouped into channels by pair throughput,
+// each channel's banks into ranks by the next gap down, and the
+// channel/rank labels are fitted to XOR address functions for the mapping
+// profile.
+
+// Combined accesses per time unit of one stream per address
+typedef double (*throughput_fn)(const uint64_t *addrs, int num_addrs);
+
+struct channel_map
+{
+  // Probe addresses and their bank group (-1 if unassigned)
+  int num_probes;
+  uint64_t probe[CHANNEL_PROBES];
+  int probe_group[CHANNEL_PROBES];
+
+  // One representative per bank group, and its labels
+  int num_groups;
+  uint64_t rep[CHANNEL_MAX_GROUPS];
+  double single[CHANNEL_MAX_GROUPS]; // Throughput of the group's stream alone
+  int channel[CHANNEL_MAX_GROUPS];
+  int rank[CHANNEL_MAX_GROUPS];      // Within its channel
+
+  int num_channels;
+  int num_ranks;         // Most ranks seen in one channel
+  double rank_split;     // Pair ratio separating same-rank from cross-rank, 0 if none
+  uint64_t measurements; // Throughput measurements taken
+};
+
+/*
+ * channel_discover
+ *
+ * Inputs: fn - Throughput measurement (measure_concurrent_throughput)
+ *         base/size - Buffer to probe; mapping_init must have been called on it
+ * Outputs: map - Bank groups labelled with channel and rank
+ * Returns: 0 on success, -1 if fewer than two bank groups were found
+ */
+int channel_discover(throughput_fn fn, void *base, uint64_t size, struct channel_map *map);
+
+/*
+ * channel_fit_profile
+ *
+ * Finds channel and rank masks of one or two address bits (between
+ * CHANNEL_FIT_MIN_BIT and CHANNEL_FIT_MAX_BIT, or the contiguous run in
+ * inferred mode) whose parities reproduce the discovered labels on every
+ * probe, and stores them in p. Bank masks are left alone.
+ *
+ * Returns: 0 on success, -1 if no consistent set of masks was found (p
+ *          unchanged)
+ */
+int channel_fit_profile(const struct channel_map *map, struct mapping_profile *p);
+
+/*
+ * channel_refine_mapping
+ *
+ * channel_discover on the buffer, then channel_fit_profile over the default
+ * profile, and mapping_init again in the current mode with the fitted masks,
+ * so later bank lookups tell channels and ranks apart from banks.
+ *
+ * Inputs: fn - Throughput measurement (measure_concurrent_throughput)
+ *         base/size - Buffer mapping_init was called on
+ * Outputs: map - Discovered bank groups, channels and ranks
+ * Returns: 1 if the mapping was rebuilt, 0 if the labels fit no masks
+ *          (mapping unchanged), -1 if discovery failed
+ */
+int channel_refine_mapping(throughput_fn fn, void *base, uint64_t size, struct channel_map *map);
+
+void channel_print(const struct channel_map *map);
+
+#endif
@@ -0,0 +1,331 @@
+#include "compare.hh"
+#include "output.hh"
+#include "replay.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+void dist_init(struct latency_dist *d, double bucket_width)
+{
+  d->value.clear();
+  d->weight.clear();
+  d->total = 0;
+  d->bucket_width = bucket_width;
+  d->ticks_per_ns = 0;
+}
+
+void dist_add(struct latency_dist *d, double value, double weight)
+{
+  if (weight <= 0)
+    return;
+  d->value.push_back(value);
+  d->weight.push_back(weight);
+}
+
+void dist_finish(struct latency_dist *d)
+{
+  std::vector<size_t> order(d->value.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return d->value[a] < d->value[b]; });
+
+  std::vector<double> value, weight;
+  for (size_t i : order)
+  {
+    if (!value.empty() && value.back() == d->value[i])
+      weight.back() += d->weight[i];
+    else
+    {
+      value.push_back(d->value[i]);
+      weight.push_back(d->weight[i]);
+    }
+  }
+  d->value.swap(value);
+  d->weight.swap(weight);
+  d->total = 0;
+  for (double w : d->weight)
+    d->total += w;
+}
+
+// Trace samples are in epoch 0 timer units: the rate recorded for epoch 0,
+// else the rate the writer saw when it opened the trace.
+static int load_trace(const char *path, struct latency_dist *d, double *ticks_per_ns)
+{
+  struct trace_reader reader;
+  struct replay_run run;
+  if (trace_reader_open(&reader, path))
+    return -1;
+  int rc = replay_load(&reader, &run);
+  trace_reader_close(&reader);
+  if (rc)
+    return -1;
+  *ticks_per_ns = !run.epoch_rate.empty() && run.epoch_rate[0] > 0 ? run.epoch_rate[0] : run.ticks_per_ns;
+  dist_init(d, 0);
+  for (const struct replay_pair &p : run.pairs)
+    if (p.num_samples)
+      dist_add(d, p.median, 1);
+  dist_finish(d);
+  return 0;
+}
+
+// histogram's table: "[a-b),  count" rows and a final "[a),  count", in
+// epoch 0 ticks at the header's "Epoch 0 ticks per ns".
+static int load_histogram(FILE *f, struct latency_dist *d, double *ticks_per_ns)
+{
+  char line[OUTPUT_LINE_MAX];
+  dist_init(d, 0);
+  while (fgets(line, sizeof(line), f))
+  {
+    unsigned long long lo, hi, count;
+    double rate;
+    if (sscanf(line, "Epoch 0 ticks per ns, %lf", &rate) == 1)
+      *ticks_per_ns = rate;
+    else if (sscanf(line, "[%llu-%llu),%llu", &lo, &hi, &count) == 3)
+    {
+      d->bucket_width = hi - lo;
+      dist_add(d, (lo + hi) / 2.0, count);
+    }
+    else if (sscanf(line, "[%llu),%llu", &lo, &count) == 2)
+      dist_add(d, lo, count);
+  }
+  dist_finish(d);
+  return d->total > 0 ? 0 : -1;
+}
+
+int dist_load(const char *path, struct latency_dist *d)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    perror("fopen");
+    return -1;
+  }
+  char magic[8] = {0};
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  int rc;
+  double ticks_per_ns = 0;
+  if (n == sizeof(magic) && !memcmp(magic, TRACE_MAGIC, sizeof(magic)))
+    rc = load_trace(path, d, &ticks_per_ns);
+  else
+  {
+    rewind(f);
+    rc = load_histogram(f, d, &ticks_per_ns);
+  }
+  fclose(f);
+  if (rc)
+  {
+    output_log("[-] compare: %s is neither a trace nor histogram output\n", path);
+    return rc;
+  }
+  d->ticks_per_ns = ticks_per_ns > 0 ? ticks_per_ns : 0;
+  return 0;
+}
+
+static void scale(struct latency_dist *d)
+{
+  for (double &v : d->value)
+    v /= d->ticks_per_ns;
+  d->bucket_width /= d->ticks_per_ns;
+}
+
+int dist_to_ns(struct latency_dist *a, struct latency_dist *b)
+{
+  // Runs on different clocks (or the same clock at another frequency) only
+  // compare in nanoseconds.
+  if (a->ticks_per_ns > 0 && b->ticks_per_ns > 0)
+  {
+    scale(a);
+    scale(b);
+    return 1;
+  }
+  if (a->ticks_per_ns > 0 || b->ticks_per_ns > 0)
+  {
+    output_log("[-] compare: only one input records its tick rate, cannot convert both to ns\n");
+    return -1;
+  }
+  output_log("[-] compare: neither input records its tick rate, comparing in raw timer units\n");
+  return 0;
+}
+
+double dist_quantile(const struct latency_dist *d, double q)
+{
+  double target = q * d->total;
+  double seen = 0;
+  for (size_t i = 0; i < d->value.size(); i++)
+  {
+    seen += d->weight[i];
+    if (seen >= target)
+      return d->value[i];
+  }
+  return d->value.empty() ? 0 : d->value.back();
+}
+
+// Weighted median of the values in [lo, hi).
+static double range_median(const struct latency_dist *d, double lo, double hi)
+{
+  double total = 0;
+  for (size_t i = 0; i < d->value.size(); i++)
+    if (d->value[i] >= lo && d->value[i] < hi)
+      total += d->weight[i];
+  double seen = 0;
+  for (size_t i = 0; i < d->value.size(); i++)
+  {
+    if (d->value[i] < lo || d->value[i] >= hi)
+      continue;
+    seen += d->weight[i];
+    if (seen >= total / 2)
+      return d->value[i];
+  }
+  return 0;
+}
+
+void dist_split(const struct latency_dist *d, struct dist_modes *m)
+{
+  m->threshold = replay_otsu(d->value.data(), d->weight.data(), d->value.size());
+  if (m->threshold < 0)
+  {
+    m->hit_median = m->conflict_median = dist_quantile(d, 0.5);
+    m->separation = 0;
+    m->conflict_fraction = 0;
+    return;
+  }
+  m->hit_median = range_median(d, -INFINITY, m->threshold);
+  m->conflict_median = range_median(d, m->threshold, INFINITY);
+  m->separation = m->conflict_median - m->hit_median;
+  double above = 0;
+  for (size_t i = 0; i < d->value.size(); i++)
+    if (d->value[i] >= m->threshold)
+      above += d->weight[i];
+  m->conflict_fraction = d->total > 0 ? above / d->total : 0;
+}
+
+/*
+ * walk_cdfs
+ *
+ * Steps through the merged support of a and b, calling fn(x, next_x, Fa, Fb)
+ * with both CDFs at x for every interval [x, next_x).
+ */
+template <typename F>
+static void walk_cdfs(const struct latency_dist *a, const struct latency_dist *b, F fn)
+{
+  size_t i = 0, j = 0;
+  double ca = 0, cb = 0;
+  while (i < a->value.size() || j < b->value.size())
+  {
+    double x;
+    if (j >= b->value.size() || (i < a->value.size() && a->value[i] <= b->value[j]))
+      x = a->value[i];
+    else
+      x = b->value[j];
+    while (i < a->value.size() && a->value[i] == x)
+      ca += a->weight[i++];
+    while (j < b->value.size() && b->value[j] == x)
+      cb += b->weight[j++];
+
+    double next = x;
+    if (i < a->value.size())
+      next = a->value[i];
+    if (j < b->value.size() && (i >= a->value.size() || b->value[j] < next))
+      next = b->value[j];
+    fn(x, next, a->total > 0 ? ca / a->total : 0, b->total > 0 ? cb / b->total : 0);
+  }
+}
+
+double dist_ks(const struct latency_dist *a, const struct latency_dist *b)
+{
+  double ks = 0;
+  walk_cdfs(a, b, [&](double, double, double fa, double fb) { ks = std::max(ks, fabs(fa - fb)); });
+  return ks;
+}
+
+double dist_emd(const struct latency_dist *a, const struct latency_dist *b)
+{
+  double emd = 0;
+  walk_cdfs(a, b, [&](double x, double next, double fa, double fb) { emd += fabs(fa - fb) * (next - x); });
+  return emd;
+}
+
+// Exact medians put into the bucket midpoints of width.
+static void rebucket(const struct latency_dist *src, double width, struct latency_dist *dst)
+{
+  dist_init(dst, width);
+  for (size_t i = 0; i < src->value.size(); i++)
+    dist_add(dst, (floor(src->value[i] / width) + 0.5) * width, src->weight[i]);
+  dist_finish(dst);
+}
+
+static void add_metric(struct compare_result *r, const char *name, double baseline, double current, double shift,
+                       double limit)
+{
+  struct compare_metric m = {name, baseline, current, shift, limit, limit <= 0 || fabs(shift) <= limit};
+  r->metrics.push_back(m);
+  r->pass &= m.pass;
+}
+
+static double relative(double baseline, double current)
+{
+  return baseline != 0 ? (current - baseline) / baseline : 0;
+}
+
+int compare_dists(const struct latency_dist *baseline, const struct latency_dist *current, struct compare_result *r)
+{
+  struct latency_dist a = *baseline, b = *current;
+  if (a.bucket_width == 0 && b.bucket_width > 0)
+    rebucket(baseline, b.bucket_width, &a);
+  else if (b.bucket_width == 0 && a.bucket_width > 0)
+    rebucket(current, a.bucket_width, &b);
+  // Tables from clocks of different rates have different widths in ns.
+  else if (a.bucket_width > b.bucket_width && b.bucket_width > 0)
+    rebucket(current, a.bucket_width, &b);
+  else if (b.bucket_width > a.bucket_width && a.bucket_width > 0)
+    rebucket(baseline, b.bucket_width, &a);
+
+  r->metrics.clear();
+  r->pass = 1;
+  static const double quantiles[] = {0.05, 0.25, 0.5, 0.75, 0.95};
+  static const char *names[] = {"p5", "p25", "p50", "p75", "p95"};
+  for (int i = 0; i < 5; i++)
+  {
+    double qa = dist_quantile(&a, quantiles[i]);
+    double qb = dist_quantile(&b, quantiles[i]);
+    add_metric(r, names[i], qa, qb, relative(qa, qb), quantiles[i] == 0.5 ? COMPARE_MAX_MEDIAN_SHIFT : 0);
+  }
+
+  double median = dist_quantile(&a, 0.5);
+  double ks = dist_ks(&a, &b);
+  add_metric(r, "ks", 0, ks, ks, COMPARE_MAX_KS);
+  double emd = dist_emd(&a, &b);
+  add_metric(r, "emd", 0, emd, median > 0 ? emd / median : 0, COMPARE_MAX_EMD);
+
+  struct dist_modes ma, mb;
+  dist_split(&a, &ma);
+  dist_split(&b, &mb);
+  add_metric(r, "threshold", ma.threshold, mb.threshold, relative(ma.threshold, mb.threshold),
+             COMPARE_MAX_THRESHOLD_SHIFT);
+  add_metric(r, "hit-median", ma.hit_median, mb.hit_median, relative(ma.hit_median, mb.hit_median), 0);
+  add_metric(r, "conflict-median", ma.conflict_median, mb.conflict_median,
+             relative(ma.conflict_median, mb.conflict_median), 0);
+  add_metric(r, "separation", ma.separation, mb.separation, relative(ma.separation, mb.separation),
+             COMPARE_MAX_SEPARATION_SHIFT);
+  add_metric(r, "conflict-fraction", ma.conflict_fraction, mb.conflict_fraction,
+             mb.conflict_fraction - ma.conflict_fraction, COMPARE_MAX_CONFLICT_SHIFT);
+  return r->pass;
+}
+
+void compare_print(const struct compare_result *r)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Comparison\n");
+  output_printf("Metric,Baseline,Current,Shift,Limit,Result\n");
+  for (const struct compare_metric &m : r->metrics)
+  {
+    if (m.limit > 0)
+      output_printf("%s,%.4f,%.4f,%.4f,%.4f,%s\n", m.name.c_str(), m.baseline, m.current, m.shift, m.limit,
+                    m.pass ? "PASS" : "FAIL");
+    else
+      output_printf("%s,%.4f,%.4f,%.4f,,\n", m.name.c_str(), m.baseline, m.current, m.shift);
+  }
+}
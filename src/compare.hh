@@ -0,0 +1,108 @@
+#ifndef COMPARE_GUARD
+#define COMPARE_GUARD
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "params.hh"
+
+// Run-to-run comparison of latency distributions.
+//
+// A distribution is the per-pair median latency of one histogram run, read
+// either from histogram's printed bucket table or from a raw-sample trace,
+// and converted from timer ticks to nanoseconds with the run's own rate.
+// Older outputs without a rate are compared in raw timer units, and only
+// against each other.
+// Two runs are compared by their percentiles, the Kolmogorov-Smirnov and
+// Earth Mover's distances between their CDFs, and the hit/conflict
+// separation: each run is split in two by Otsu's threshold, and the
+// threshold, the median of either side, their gap and the conflict fraction
+// are compared. A metric with a COMPARE_MAX_* limit fails when its shift
+// exceeds it, and the comparison fails when any metric does.
+
+struct latency_dist
+{
+  std::vector<double> value;  // Sorted ascending, distinct (ns after dist_to_ns)
+  std::vector<double> weight; // Pairs at each value
+  double total;
+  double bucket_width;        // Width of the source buckets, 0 for exact medians
+  double ticks_per_ns;        // Rate the values were recorded at, 0 if unknown
+};
+
+void dist_init(struct latency_dist *d, double bucket_width);
+void dist_add(struct latency_dist *d, double value, double weight);
+// Sorts and merges the values added so far.
+void dist_finish(struct latency_dist *d);
+
+/*
+ * dist_load
+ *
+ * Inputs: path - A trace (see trace.hh) or histogram's printed output
+ * Outputs: d - Pair medians in timer ticks: exact from a trace, bucket
+ *              midpoints (bucket start for the open last bucket) from a
+ *              histogram table; with the tick rate if the file records it
+ *              (trace ticks_per_ns, histogram "Epoch 0 ticks per ns")
+ * Returns: 0 on success, -1 if the file is neither
+ */
+int dist_load(const char *path, struct latency_dist *d);
+
+/*
+ * dist_to_ns
+ *
+ * Converts two loaded distributions to ns with their own tick rates.
+ *
+ * Returns: 1 if converted, 0 if neither records a rate (both stay in timer
+ *          ticks), -1 if only one does
+ */
+int dist_to_ns(struct latency_dist *a, struct latency_dist *b);
+
+// Smallest value with at least q of the weight at or below it.
+double dist_quantile(const struct latency_dist *d, double q);
+
+struct dist_modes
+{
+  double threshold;         // Otsu split, -1 if the distribution has one value
+  double hit_median;
+  double conflict_median;
+  double separation;        // conflict_median - hit_median
+  double conflict_fraction; // Weight above the threshold
+};
+
+void dist_split(const struct latency_dist *d, struct dist_modes *m);
+
+// Largest distance between the two CDFs, and the area between them.
+double dist_ks(const struct latency_dist *a, const struct latency_dist *b);
+double dist_emd(const struct latency_dist *a, const struct latency_dist *b);
+
+struct compare_metric
+{
+  std::string name;
+  double baseline;
+  double current;
+  double shift; // Relative or absolute, as the limit is
+  double limit; // 0: reported only
+  int pass;
+};
+
+struct compare_result
+{
+  std::vector<struct compare_metric> metrics;
+  int pass;
+};
+
+/*
+ * compare_dists
+ *
+ * Compares current against baseline. When one side is bucketed and the other
+ * exact, or bucketed finer, it is bucketed like the coarser side first, so
+ * the bucket midpoints do not read as a shift.
+ *
+ * Outputs: r - Every metric with its shift, limit and verdict
+ * Returns: 1 if every limited metric passed, 0 otherwise
+ */
+int compare_dists(const struct latency_dist *baseline, const struct latency_dist *current, struct compare_result *r);
+
+void compare_print(const struct compare_result *r);
+
+#endif
@@ -0,0 +1,51 @@
+#include "../config.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../compare.hh"
+
+// Compares two histogram runs (printed output or traces) for drift.
+//
+// Usage: compare <baseline> <current>
+// Exit status: 0 if every limited metric is within its COMPARE_MAX_* limit,
+// 1 if any is not, 2 if either input cannot be read or only one records its
+// tick rate.
+
+int main(int argc, char **argv) {
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    if (argc < 3) {
+        output_log("[-] usage: %s <baseline> <current>\n", argv[0]);
+        return 2;
+    }
+
+    struct latency_dist baseline, current;
+    if (dist_load(argv[1], &baseline) || dist_load(argv[2], &current))
+        return 2;
+    int in_ns = dist_to_ns(&baseline, &current);
+    if (in_ns < 0)
+        return 2;
+    const char *unit = in_ns ? "ns" : "ticks";
+
+    struct compare_result result;
+    int pass = compare_dists(&baseline, &current, &result);
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Baseline, %s\n", argv[1]);
+    output_printf("Current, %s\n", argv[2]);
+    output_printf("Baseline pairs, %.0f\n", baseline.total);
+    output_printf("Current pairs, %.0f\n", current.total);
+    output_printf("Unit, %s\n", unit);
+    output_printf("Baseline bucket width (%s), %.2f\n", unit, baseline.bucket_width);
+    output_printf("Current bucket width (%s), %.2f\n", unit, current.bucket_width);
+    compare_print(&result);
+    output_printf("Verdict, %s\n", pass ? "PASS" : "FAIL");
+
+    int failed = 0;
+    for (const struct compare_metric &m : result.metrics)
+        failed += !m.pass;
+    output_log("[%c] compare: %d metric(s) out of limits\n", pass ? '+' : '-', failed);
+    output_shutdown();
+    return pass ? 0 : 1;
+}
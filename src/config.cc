@@ -0,0 +1,394 @@
+#include "config.hh"
+#include "output.hh"
+#include "placement.hh"
+#include "util.hh"
+
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+
+struct run_config config;
+
+enum config_type
+{
+  CONFIG_U64,
+  CONFIG_DOUBLE,
+  CONFIG_STRING,
+};
+
+struct config_key
+{
+  const char *name;
+  enum config_type type;
+  size_t offset;
+  double min;
+  double max;
+  const char *help;
+};
+
+#define U64_KEY(field, min, max, help) {#field, CONFIG_U64, offsetof(struct run_config, field), min, max, help}
+
+// Every key, in the order --help and config_print list them
+static const struct config_key keys[] = {
+    U64_KEY(buffer_mb, 1, 1 << 20, "Measurement and hammering buffer, MB"),
+    U64_KEY(hammers_per_iter, 1, 1e12, "Hammering rounds per victim"),
+    U64_KEY(row_size, PAIRS_LINE_SIZE, 1 << 20, "DRAM row size in bytes, a power of two"),
+    U64_KEY(num_banks, 1, 1 << MAPPING_MAX_FUNCS, "Banks, a power of two"),
+    U64_KEY(row_bits, PAGE_OFFSET_BITS, 48, "Lowest address bit of the row index (row shift)"),
+    U64_KEY(xor_bits, 0, 48, "Lowest column bit XOR-ed with a row bit into the bank index"),
+    U64_KEY(conflict_latency, 1, 1e9, "Row-buffer conflict threshold, timer units"),
+    U64_KEY(hit_latency, 0, 1e9, "Row-buffer hit threshold, timer units"),
+    U64_KEY(samples, 1, 1 << 20, "Samples per pair of a fixed-count sweep"),
+    U64_KEY(sample_budget, 0, 1e15, "Samples per adaptive sweep (0: rows * samples)"),
+    U64_KEY(pair_mode, 0, 3, "Pairs: 0 base, 1 uniform, 2 bit flip, 3 window"),
+    U64_KEY(pair_seed, 0, 18446744073709551615.0, "Pair selection seed"),
+    U64_KEY(pair_budget_pairs, 0, 1e15, "Pairs per sweep (0: one per row)"),
+    {"pair_budget_sec", CONFIG_DOUBLE, offsetof(struct run_config, pair_budget_sec), 0, 1e9,
+     "Seconds per sweep (0: no limit)"},
+    U64_KEY(order, 0, 1, "Row order of sweeps: 0 sequential, 1 prefetch-safe permutation"),
+    U64_KEY(order_min_distance, 1, 1 << 30, "Permuted order: rows between rows visited close together"),
+    U64_KEY(mapping_mode, 0, 2, "Mapping: 0 auto, 1 pagemap, 2 inferred"),
+    U64_KEY(placement_policy, 0, PLACE_NUM_POLICIES - 1,
+            "Thread placement: 0 none, 1 same cluster, 2 SMT siblings, 3 split clusters"),
+    U64_KEY(placement_realtime, 0, 1, "Pinned threads as SCHED_FIFO where permitted"),
+    U64_KEY(channel_discovery, 0, 1, "Discover channels and ranks before hammering"),
+    U64_KEY(refresh_size_hammers, 0, 1, "Size hammering rounds to the refresh window"),
+    {"fuzz_budget_sec", CONFIG_DOUBLE, offsetof(struct run_config, fuzz_budget_sec), 0, 1e9,
+     "Seconds per fuzzing campaign (0: no limit)"},
+    U64_KEY(fuzz_trials, 0, 1e15, "Patterns per fuzzing campaign (0: until the budget runs out)"),
+    U64_KEY(fuzz_activations, 1, 1e12, "Aggressor activations per fuzzing trial"),
+    U64_KEY(output_format, 0, 2, "rhbench results: 0 text tables, 1 CSV, 2 JSON lines"),
+    U64_KEY(huge_pages, 0, 1, "Back buffers with huge pages where the system allows"),
+    U64_KEY(prewarm, 0, 1, "Warm the TLB for both addresses before each sample"),
+    U64_KEY(workers, 1, WORKERS_MAX, "Worker processes"),
+    U64_KEY(workers_buffer_mb, 1, 1 << 20, "Buffer of each worker process, MB"),
+    {"trace_path", CONFIG_STRING, offsetof(struct run_config, trace_path), 0, 0,
+     "File histogram records every sample to (empty: none)"},
+};
+
+#define NUM_KEYS (sizeof(keys) / sizeof(keys[0]))
+
+void config_defaults(void)
+{
+  config.buffer_mb = BUFFER_SIZE_MB;
+  config.hammers_per_iter = HAMMERS_PER_ITER;
+  config.row_size = ROW_SIZE;
+  config.num_banks = NUM_BANKS;
+  config.row_bits = ADDR_ROW_BITS;
+  config.xor_bits = ADDR_BIT_XOR_BITS;
+  config.conflict_latency = ROW_BUFFER_CONFLICT_LATENCY;
+  config.hit_latency = ROW_BUFFER_HIT_LATENCY;
+  config.samples = SAMPLES;
+  config.sample_budget = ADAPTIVE_SAMPLE_BUDGET;
+  config.pair_mode = PAIR_MODE;
+  config.pair_seed = PAIR_SEED;
+  config.pair_budget_pairs = PAIR_BUDGET_PAIRS;
+  config.pair_budget_sec = PAIR_BUDGET_SEC;
+  config.order = SWEEP_ORDER;
+  config.order_min_distance = ORDER_MIN_DISTANCE;
+  config.mapping_mode = MAPPING_MODE;
+  config.placement_policy = PLACEMENT_POLICY;
+  config.placement_realtime = PLACEMENT_REALTIME;
+  config.channel_discovery = CHANNEL_DISCOVERY;
+  config.refresh_size_hammers = REFRESH_SIZE_HAMMERS;
+  config.fuzz_budget_sec = FUZZ_BUDGET_SEC;
+  config.fuzz_trials = FUZZ_TRIALS;
+  config.fuzz_activations = FUZZ_TRIAL_ACTIVATIONS;
+  config.output_format = REPORT_FORMAT;
+  config.huge_pages = ALLOC_HUGE_PAGES;
+  config.prewarm = MEASURE_PREWARM;
+  config.workers = WORKERS;
+  config.workers_buffer_mb = WORKERS_BUFFER_MB;
+  const char *trace = TRACE_PATH;
+  snprintf(config.trace_path, sizeof(config.trace_path), "%s", trace ? trace : "");
+}
+
+static const struct config_key *find_key(const char *name, size_t len)
+{
+  for (size_t i = 0; i < NUM_KEYS; i++)
+    if (strlen(keys[i].name) == len && !strncmp(keys[i].name, name, len))
+      return &keys[i];
+  return NULL;
+}
+
+// Sets k from value; returns 0 or -1 with the reason in err.
+static int set_key(const struct config_key *k, const char *value, char *err, size_t err_len)
+{
+  char *field = (char *)&config + k->offset;
+  char *end;
+  errno = 0;
+  switch (k->type)
+  {
+  case CONFIG_U64:
+  {
+    if (*value == '-')
+      break;
+    unsigned long long v = strtoull(value, &end, 0);
+    if (errno || end == value || *end)
+      break;
+    if (v < k->min || v > k->max)
+    {
+      snprintf(err, err_len, "%s = %llu is outside [%.0f, %.0f]", k->name, v, k->min, k->max);
+      return -1;
+    }
+    *(uint64_t *)field = v;
+    return 0;
+  }
+  case CONFIG_DOUBLE:
+  {
+    double v = strtod(value, &end);
+    if (errno || end == value || *end || !isfinite(v))
+      break;
+    if (v < k->min || v > k->max)
+    {
+      snprintf(err, err_len, "%s = %g is outside [%g, %g]", k->name, v, k->min, k->max);
+      return -1;
+    }
+    *(double *)field = v;
+    return 0;
+  }
+  case CONFIG_STRING:
+    if (strlen(value) >= CONFIG_PATH_MAX)
+    {
+      snprintf(err, err_len, "%s is longer than %d bytes", k->name, CONFIG_PATH_MAX - 1);
+      return -1;
+    }
+    strcpy(field, value);
+    return 0;
+  }
+  snprintf(err, err_len, "%s: '%s' is not a valid value", k->name, value);
+  return -1;
+}
+
+int config_set(const char *key, const char *value)
+{
+  char err[OUTPUT_LINE_MAX];
+  const struct config_key *k = find_key(key, strlen(key));
+  if (!k)
+  {
+    output_log("[-] config: unknown key '%s'\n", key);
+    return -1;
+  }
+  if (set_key(k, value, err, sizeof(err)))
+  {
+    output_log("[-] config: %s\n", err);
+    return -1;
+  }
+  return 0;
+}
+
+// s without leading and trailing whitespace (modified in place).
+static char *trim(char *s)
+{
+  while (*s == ' ' || *s == '\t')
+    s++;
+  size_t n = strlen(s);
+  while (n && (s[n - 1] == ' ' || s[n - 1] == '\t' || s[n - 1] == '\n' || s[n - 1] == '\r'))
+    s[--n] = '\0';
+  return s;
+}
+
+int config_load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    output_log("[-] config: cannot read %s\n", path);
+    return -1;
+  }
+  char line[OUTPUT_LINE_MAX], err[OUTPUT_LINE_MAX];
+  int bad = 0;
+  for (int n = 1; fgets(line, sizeof(line), f); n++)
+  {
+    char *hash = strchr(line, '#');
+    if (hash)
+      *hash = '\0';
+    char *s = trim(line);
+    if (!*s)
+      continue;
+    char *eq = strchr(s, '=');
+    if (!eq)
+    {
+      output_log("[-] config: %s:%d: expected key = value\n", path, n);
+      bad++;
+      continue;
+    }
+    *eq = '\0';
+    char *key = trim(s), *value = trim(eq + 1);
+    const struct config_key *k = find_key(key, strlen(key));
+    if (!k)
+    {
+      output_log("[-] config: %s:%d: unknown key '%s'\n", path, n, key);
+      bad++;
+    }
+    else if (set_key(k, value, err, sizeof(err)))
+    {
+      output_log("[-] config: %s:%d: %s\n", path, n, err);
+      bad++;
+    }
+  }
+  fclose(f);
+  return bad;
+}
+
+static int is_pow2(uint64_t v)
+{
+  return v && !(v & (v - 1));
+}
+
+static int log2_of(uint64_t v)
+{
+  int n = 0;
+  while (v >>= 1)
+    n++;
+  return n;
+}
+
+int config_validate(void)
+{
+  int bad = 0;
+  if (!is_pow2(config.row_size))
+  {
+    output_log("[-] config: row_size %llu is not a power of two\n", (unsigned long long)config.row_size);
+    bad++;
+  }
+  if (!is_pow2(config.num_banks))
+  {
+    output_log("[-] config: num_banks %llu is not a power of two\n", (unsigned long long)config.num_banks);
+    bad++;
+  }
+  else if (config.xor_bits + log2_of(config.num_banks) > config.row_bits)
+  {
+    output_log("[-] config: xor_bits %llu + %d bank bits overlap the row index at bit %llu\n",
+               (unsigned long long)config.xor_bits, log2_of(config.num_banks), (unsigned long long)config.row_bits);
+    bad++;
+  }
+  if (config_buffer_bytes() < 2 * config.row_size)
+  {
+    output_log("[-] config: buffer_mb %llu holds fewer than two rows\n", (unsigned long long)config.buffer_mb);
+    bad++;
+  }
+  if (config.hit_latency >= config.conflict_latency)
+  {
+    output_log("[-] config: hit_latency %llu is not below conflict_latency %llu\n",
+               (unsigned long long)config.hit_latency, (unsigned long long)config.conflict_latency);
+    bad++;
+  }
+  return bad;
+}
+
+static void print_help(const char *prog)
+{
+  output_log("usage: %s [--config=FILE] [--key=value ...]\n", prog);
+  output_log("keys (also valid as key = value lines in FILE):\n");
+  for (size_t i = 0; i < NUM_KEYS; i++)
+    output_log("  --%-22s %s\n", keys[i].name, keys[i].help);
+}
+
+// Removes argv[i] (and the n - 1 after it).
+static void drop_args(int *argc, char **argv, int i, int n)
+{
+  for (int j = i; j + n <= *argc; j++)
+    argv[j] = argv[j + n];
+  *argc -= n;
+}
+
+int config_init(int *argc, char **argv)
+{
+  config_defaults();
+  int bad = 0;
+  const char *built_in = CONFIG_PATH;
+  if (built_in && access(built_in, R_OK) == 0)
+    bad += config_load(built_in) != 0;
+
+  // Files first, so flags override them wherever they appear.
+  for (int i = 1; i < *argc;)
+  {
+    const char *path = NULL;
+    int used = 1;
+    if (!strncmp(argv[i], "--config=", 9))
+      path = argv[i] + 9;
+    else if (!strcmp(argv[i], "-c") && i + 1 < *argc)
+    {
+      path = argv[i + 1];
+      used = 2;
+    }
+    if (!path)
+    {
+      i++;
+      continue;
+    }
+    bad += config_load(path) != 0;
+    drop_args(argc, argv, i, used);
+  }
+
+  for (int i = 1; i < *argc;)
+  {
+    if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
+    {
+      print_help(argv[0]);
+      return 1;
+    }
+    if (strncmp(argv[i], "--", 2))
+    {
+      i++;
+      continue;
+    }
+    const char *key = argv[i] + 2;
+    const char *eq = strchr(key, '=');
+    const struct config_key *k = find_key(key, eq ? (size_t)(eq - key) : strlen(key));
+    if (!k)
+    {
+      // Left for the binary's own options
+      i++;
+      continue;
+    }
+    int used = 1;
+    const char *value = eq ? eq + 1 : NULL;
+    if (!value && i + 1 < *argc)
+    {
+      value = argv[i + 1];
+      used = 2;
+    }
+    char err[OUTPUT_LINE_MAX];
+    if (!value)
+    {
+      output_log("[-] config: --%s needs a value\n", k->name);
+      bad++;
+    }
+    else if (set_key(k, value, err, sizeof(err)))
+    {
+      output_log("[-] config: %s\n", err);
+      bad++;
+    }
+    drop_args(argc, argv, i, used);
+  }
+
+  bad += config_validate();
+  if (bad)
+  {
+    output_log("[-] config: %d problem(s), see %s --help\n", bad, argv[0]);
+    return -1;
+  }
+  return 0;
+}
+
+void config_print(void)
+{
+  for (size_t i = 0; i < NUM_KEYS; i++)
+  {
+    const char *field = (const char *)&config + keys[i].offset;
+    switch (keys[i].type)
+    {
+    case CONFIG_U64:
+      output_printf("Config %s, %llu\n", keys[i].name, (unsigned long long)*(const uint64_t *)field);
+      break;
+    case CONFIG_DOUBLE:
+      output_printf("Config %s, %g\n", keys[i].name, *(const double *)field);
+      break;
+    case CONFIG_STRING:
+      output_printf("Config %s, %s\n", keys[i].name, *field ? field : "none");
+      break;
+    }
+  }
+}
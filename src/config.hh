@@ -0,0 +1,100 @@
+#ifndef CONFIG_GUARD
+#define CONFIG_GUARD
+
+#include <stdint.h>
+
+#include "params.hh"
+
+// Runtime configuration.
+//
+// The tunables that change between runs (buffer, geometry, thresholds, pair
+// selection, placement, ...) are read at startup instead of being fixed at
+// build time. Every binary calls config_init first thing; the compiled-in
+// params.hh values are only the defaults. Later sources override earlier
+// ones:
+//   1. params.hh
+//   2. CONFIG_PATH, if set at build time and present on the device
+//   3. --config=<file> (or -c <file>): key=value lines, '#' comments
+//   4. --<key>=<value> on the command line
+// Unknown keys in a file and bad values anywhere are errors, reported all at
+// once, and the binary exits before touching memory; --options that are not
+// keys are left to the binary. --help lists every key.
+//
+// Parameters that size static arrays or select code at compile time
+// (MAPPING_MAX_FUNCS, output rings, DRAMSIM_*) stay in params.hh.
+// Geometry-dependent inner loops are instantiated for common row sizes and
+// bank counts (kernels.hh) and take a generic path only for others.
+
+struct run_config
+{
+  uint64_t buffer_mb;
+  uint64_t hammers_per_iter;
+  uint64_t row_size;
+  uint64_t num_banks;
+  uint64_t row_bits;
+  uint64_t xor_bits;
+  uint64_t conflict_latency;
+  uint64_t hit_latency;
+  uint64_t samples;
+  uint64_t sample_budget;
+  uint64_t pair_mode;
+  uint64_t pair_seed;
+  uint64_t pair_budget_pairs;
+  double pair_budget_sec;
+  uint64_t order;
+  uint64_t order_min_distance;
+  uint64_t mapping_mode;
+  uint64_t placement_policy;
+  uint64_t placement_realtime;
+  uint64_t channel_discovery;
+  uint64_t refresh_size_hammers;
+  double fuzz_budget_sec;
+  uint64_t fuzz_trials;
+  uint64_t fuzz_activations;
+  uint64_t output_format;
+  uint64_t huge_pages;
+  uint64_t prewarm;
+  uint64_t workers;
+  uint64_t workers_buffer_mb;
+  char trace_path[CONFIG_PATH_MAX]; // Empty: no trace
+};
+
+extern struct run_config config;
+
+/*
+ * config_init
+ *
+ * Loads the configuration sources above and validates the result. Options
+ * it recognises are removed from argv, so positional arguments are left for
+ * the binary.
+ *
+ * Inputs: argc/argv - main's arguments
+ * Returns: 0 to run, 1 if --help was printed, -1 on an invalid
+ *          configuration (every problem already logged)
+ */
+int config_init(int *argc, char **argv);
+
+// Sets one key from its text form. Returns 0, or -1 if the key is unknown or
+// the value does not parse or is out of the key's range.
+int config_set(const char *key, const char *value);
+
+// Applies a key=value file. Returns the number of bad lines, or -1 if the
+// file cannot be read.
+int config_load(const char *path);
+
+// Checks the relations between keys. Returns the number of problems.
+int config_validate(void);
+
+// Restores the params.hh defaults.
+void config_defaults(void);
+
+// Buffer size in bytes.
+static inline uint64_t config_buffer_bytes(void)
+{
+  return config.buffer_mb * 1024 * 1024;
+}
+
+// Every key and its value, one "key, value" line each, for the HEADER block.
+void config_print(void);
+
+#endif
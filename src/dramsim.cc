@@ -0,0 +1,548 @@
+#include "dramsim.hh"
+#include "kernels.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct dramsim default_sim;
+
+static const uint64_t default_channel_masks[] = DRAMSIM_CHANNEL_MASKS;
+static const uint64_t default_rank_masks[] = DRAMSIM_RANK_MASKS;
+static const uint64_t default_bank_masks[] = DRAMSIM_BANK_MASKS;
+
+static unsigned copy_masks(uint64_t *dst, const uint64_t *src, size_t n)
+{
+  unsigned count = 0;
+  for (size_t i = 0; i < n && count < DRAMSIM_MAX_FUNCS; i++)
+  {
+    if (src[i])
+      dst[count++] = src[i];
+  }
+  return count;
+}
+
+void dramsim_default_config(struct dramsim_config *cfg, uint64_t mem_size)
+{
+  cfg->mem_size = mem_size;
+  cfg->row_shift = DRAMSIM_ROW_SHIFT;
+  cfg->num_channel_funcs = copy_masks(cfg->channel_masks, default_channel_masks,
+                                      sizeof(default_channel_masks) / sizeof(default_channel_masks[0]));
+  cfg->num_rank_funcs = copy_masks(cfg->rank_masks, default_rank_masks,
+                                   sizeof(default_rank_masks) / sizeof(default_rank_masks[0]));
+  cfg->num_bank_funcs = copy_masks(cfg->bank_masks, default_bank_masks,
+                                   sizeof(default_bank_masks) / sizeof(default_bank_masks[0]));
+
+  cfg->closed_page = DRAMSIM_CLOSED_PAGE;
+  cfg->closed_page_timeout_ns = DRAMSIM_CLOSED_PAGE_TIMEOUT_NS;
+
+  cfg->t_base = DRAMSIM_T_BASE;
+  cfg->t_row_hit = DRAMSIM_T_ROW_HIT;
+  cfg->t_row_empty = DRAMSIM_T_ROW_EMPTY;
+  cfg->t_row_conflict = DRAMSIM_T_ROW_CONFLICT;
+  cfg->t_same_channel = DRAMSIM_T_SAME_CHANNEL;
+  cfg->t_rank_switch = DRAMSIM_T_RANK_SWITCH;
+  cfg->noise_sigma = DRAMSIM_NOISE_SIGMA;
+  cfg->interrupt_prob = DRAMSIM_INTERRUPT_PROB;
+  cfg->interrupt_cost = DRAMSIM_INTERRUPT_COST;
+  cfg->ns_per_tick = DRAMSIM_NS_PER_TICK;
+
+  cfg->flip_threshold = DRAMSIM_FLIP_THRESHOLD;
+  cfg->flip_prob = DRAMSIM_FLIP_PROB;
+  cfg->refresh_window_ns = DRAMSIM_REFRESH_WINDOW_NS;
+  cfg->trr_entries = DRAMSIM_TRR_ENTRIES;
+  cfg->trr_threshold = DRAMSIM_TRR_THRESHOLD;
+  cfg->refresh_interval_ns = DRAMSIM_T_REFI_NS;
+  cfg->t_rfc = DRAMSIM_T_RFC;
+
+  cfg->tlb_l1_entries = DRAMSIM_TLB_L1_ENTRIES;
+  cfg->tlb_l2_entries = DRAMSIM_TLB_L2_ENTRIES;
+  cfg->tlb_ways = DRAMSIM_TLB_WAYS;
+  cfg->tlb_page_shift = PAGE_OFFSET_BITS;
+  cfg->t_tlb_l2 = DRAMSIM_T_TLB_L2;
+  cfg->t_walk = DRAMSIM_T_WALK;
+  cfg->t_cache = DRAMSIM_T_CACHE;
+
+  cfg->prefetch_next_line = DRAMSIM_PREFETCH_NEXT_LINE;
+  cfg->prefetch_buddy = DRAMSIM_PREFETCH_BUDDY;
+  cfg->prefetch_stride = DRAMSIM_PREFETCH_STRIDE;
+  cfg->prefetch_degree = DRAMSIM_PREFETCH_DEGREE;
+  cfg->prefetch_cross_page = DRAMSIM_PREFETCH_CROSS_PAGE;
+
+  cfg->seed = DRAMSIM_SEED;
+}
+
+void dramsim_init(struct dramsim *sim, const struct dramsim_config *cfg)
+{
+  sim->cfg = *cfg;
+  sim->num_banks_total = 1U << (cfg->num_channel_funcs + cfg->num_rank_funcs + cfg->num_bank_funcs);
+  sim->open_row = (int64_t *)malloc(sim->num_banks_total * sizeof(int64_t));
+  sim->last_access_ns = (double *)calloc(sim->num_banks_total, sizeof(double));
+  if (!sim->open_row || !sim->last_access_ns)
+  {
+    perror("malloc");
+    exit(1);
+  }
+  for (unsigned i = 0; i < sim->num_banks_total; i++)
+    sim->open_row[i] = -1;
+
+  sim->now_ns = 0;
+  sim->window_start_ns = 0;
+  sim->refresh_epoch = 0;
+  sim->refreshes = 0;
+  sim->rng = cfg->seed ? cfg->seed : 1;
+  sim->have_spare = 0;
+  sim->spare_normal = 0;
+  sim->activations.clear();
+  sim->flips.clear();
+  sim->trr_rows.clear();
+  sim->trr_used.assign(sim->num_banks_total, 0);
+  sim->measurements = 0;
+  sim->total_activations = 0;
+
+  sim->tlb_tag[0].assign(cfg->tlb_l1_entries, 0);
+  sim->tlb_used[0].assign(cfg->tlb_l1_entries, 0);
+  sim->tlb_tag[1].assign(cfg->tlb_l1_entries ? cfg->tlb_l2_entries : 0, 0);
+  sim->tlb_used[1].assign(cfg->tlb_l1_entries ? cfg->tlb_l2_entries : 0, 0);
+  sim->tlb_clock = 0;
+  sim->tlb_walks = 0;
+
+  sim->cached_lines.clear();
+  sim->stride_table.clear();
+  sim->prefetches = 0;
+}
+
+void dramsim_free(struct dramsim *sim)
+{
+  free(sim->open_row);
+  free(sim->last_access_ns);
+  sim->open_row = NULL;
+  sim->last_access_ns = NULL;
+  sim->activations.clear();
+  sim->flips.clear();
+  sim->trr_rows.clear();
+  sim->trr_used.clear();
+  for (int level = 0; level < 2; level++)
+  {
+    sim->tlb_tag[level].clear();
+    sim->tlb_used[level].clear();
+  }
+  sim->cached_lines.clear();
+  sim->stride_table.clear();
+}
+
+// xorshift64*: fast, and deterministic for a given seed
+static inline uint64_t next_u64(struct dramsim *sim)
+{
+  sim->rng ^= sim->rng >> 12;
+  sim->rng ^= sim->rng << 25;
+  sim->rng ^= sim->rng >> 27;
+  return sim->rng * 2685821657736338717ULL;
+}
+
+static inline double next_uniform(struct dramsim *sim)
+{
+  return (next_u64(sim) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double next_normal(struct dramsim *sim)
+{
+  if (sim->have_spare)
+  {
+    sim->have_spare = 0;
+    return sim->spare_normal;
+  }
+  double u1 = next_uniform(sim), u2 = next_uniform(sim);
+  if (u1 < 1e-300)
+    u1 = 1e-300;
+  double r = sqrt(-2.0 * log(u1));
+  sim->spare_normal = r * sin(2 * M_PI * u2);
+  sim->have_spare = 1;
+  return r * cos(2 * M_PI * u2);
+}
+
+struct dramsim_location dramsim_locate(const struct dramsim *sim, uint64_t addr)
+{
+  struct dramsim_location loc;
+  loc.channel = parity_index(addr, sim->cfg.channel_masks, sim->cfg.num_channel_funcs);
+  loc.rank = parity_index(addr, sim->cfg.rank_masks, sim->cfg.num_rank_funcs);
+  loc.bank = parity_index(addr, sim->cfg.bank_masks, sim->cfg.num_bank_funcs);
+  loc.row = addr >> sim->cfg.row_shift;
+  return loc;
+}
+
+unsigned dramsim_bank_index(const struct dramsim *sim, uint64_t addr)
+{
+  struct dramsim_location loc = dramsim_locate(sim, addr);
+  return (((loc.channel << sim->cfg.num_rank_funcs) | loc.rank) << sim->cfg.num_bank_funcs) | loc.bank;
+}
+
+static inline uint64_t row_key(unsigned bank_index, uint64_t row)
+{
+  return ((uint64_t)bank_index << 40) | row;
+}
+
+static void activate(struct dramsim *sim, unsigned bank_index, uint64_t row)
+{
+  sim->total_activations++;
+  if (!sim->cfg.flip_threshold)
+    return;
+
+  if (sim->now_ns - sim->window_start_ns >= sim->cfg.refresh_window_ns)
+  {
+    sim->activations.clear();
+    sim->trr_rows.clear();
+    sim->trr_used.assign(sim->num_banks_total, 0);
+    sim->window_start_ns = sim->now_ns;
+  }
+
+  uint64_t key = row_key(bank_index, row);
+  uint64_t count = ++sim->activations[key];
+  // TRR refreshes the neighbours of the rows it tracks before they can flip;
+  // rows that find the bank's slots taken go unnoticed.
+  if (sim->cfg.trr_entries && count >= sim->cfg.trr_threshold)
+  {
+    if (sim->trr_rows.count(key))
+      return;
+    if (sim->trr_used[bank_index] < sim->cfg.trr_entries)
+    {
+      sim->trr_rows[key] = count;
+      sim->trr_used[bank_index]++;
+      return;
+    }
+  }
+  if (count < sim->cfg.flip_threshold)
+    return;
+
+  // Past the threshold every activation disturbs both neighbours.
+  for (int d = -1; d <= 1; d += 2)
+  {
+    if (row == 0 && d < 0)
+      continue;
+    if (next_uniform(sim) < sim->cfg.flip_prob)
+      sim->flips[row_key(bank_index, row + d)]++;
+  }
+}
+
+// A REF command is due every refresh_interval_ns: it precharges every bank
+// and the first access after it waits out t_rfc.
+static double refresh_stall(struct dramsim *sim)
+{
+  if (sim->cfg.refresh_interval_ns <= 0)
+    return 0;
+  uint64_t epoch = (uint64_t)(sim->now_ns / sim->cfg.refresh_interval_ns);
+  if (epoch == sim->refresh_epoch)
+    return 0;
+  sim->refresh_epoch = epoch;
+  sim->refreshes++;
+  // TRR frees the slots of rows not activated since the last REF.
+  for (auto it = sim->trr_rows.begin(); it != sim->trr_rows.end();)
+  {
+    uint64_t count = sim->activations[it->first];
+    if (count == it->second)
+    {
+      sim->trr_used[it->first >> 40]--;
+      it = sim->trr_rows.erase(it);
+    }
+    else
+    {
+      it->second = count;
+      ++it;
+    }
+  }
+  for (unsigned i = 0; i < sim->num_banks_total; i++)
+    sim->open_row[i] = -1;
+  return sim->cfg.t_rfc;
+}
+
+/*
+ * tlb_level
+ *
+ * Looks page up in one TLB level and, on a miss, fills it over the least
+ * recently used way of its set. Returns 1 on a hit.
+ */
+static int tlb_level(struct dramsim *sim, int level, uint64_t page)
+{
+  std::vector<uint64_t> &tag = sim->tlb_tag[level];
+  std::vector<uint64_t> &used = sim->tlb_used[level];
+  unsigned ways = sim->cfg.tlb_ways;
+  size_t sets = tag.size() / ways;
+  if (!sets)
+    return 0;
+  size_t first = (page % sets) * ways;
+  size_t victim = first;
+  for (size_t w = first; w < first + ways; w++)
+  {
+    if (tag[w] == page + 1)
+    {
+      used[w] = ++sim->tlb_clock;
+      return 1;
+    }
+    if (used[w] < used[victim])
+      victim = w;
+  }
+  tag[victim] = page + 1;
+  used[victim] = ++sim->tlb_clock;
+  return 0;
+}
+
+// Translation cost of a load of addr in ticks, 0 without the TLB model.
+static double translate(struct dramsim *sim, uint64_t addr)
+{
+  if (!sim->cfg.tlb_l1_entries)
+    return 0;
+  uint64_t page = addr >> sim->cfg.tlb_page_shift;
+  if (tlb_level(sim, 0, page))
+    return 0;
+  if (tlb_level(sim, 1, page))
+    return sim->cfg.t_tlb_l2;
+  sim->tlb_walks++;
+  return sim->cfg.t_walk;
+}
+
+/*
+ * access
+ *
+ * One uncached access to addr: returns its DRAM cost in ticks and updates
+ * the bank's open row.
+ */
+static double access(struct dramsim *sim, uint64_t addr, unsigned *bank_out, struct dramsim_location *loc_out)
+{
+  struct dramsim_location loc = dramsim_locate(sim, addr);
+  unsigned b = (((loc.channel << sim->cfg.num_rank_funcs) | loc.rank) << sim->cfg.num_bank_funcs) | loc.bank;
+  *bank_out = b;
+  *loc_out = loc;
+
+  double stall = refresh_stall(sim);
+  if (sim->cfg.closed_page && sim->now_ns - sim->last_access_ns[b] > sim->cfg.closed_page_timeout_ns)
+    sim->open_row[b] = -1;
+  sim->last_access_ns[b] = sim->now_ns;
+
+  if (sim->open_row[b] == (int64_t)loc.row)
+    return stall + sim->cfg.t_row_hit;
+
+  double cost = sim->open_row[b] < 0 ? sim->cfg.t_row_empty : sim->cfg.t_row_conflict;
+  sim->open_row[b] = (int64_t)loc.row;
+  activate(sim, b, loc.row);
+  return stall + cost;
+}
+
+uint64_t dramsim_measure(struct dramsim *sim, uint64_t addr_A, uint64_t addr_B)
+{
+  unsigned bank_A, bank_B;
+  struct dramsim_location loc_A, loc_B;
+  double lat_A = access(sim, addr_A, &bank_A, &loc_A);
+  double lat_B = access(sim, addr_B, &bank_B, &loc_B);
+
+  double total = sim->cfg.t_base + translate(sim, addr_A) + translate(sim, addr_B);
+  if (bank_A == bank_B)
+    total += lat_A + lat_B;
+  else if (loc_A.channel == loc_B.channel)
+    total += (lat_A > lat_B ? lat_A : lat_B) + sim->cfg.t_same_channel +
+             (loc_A.rank != loc_B.rank ? sim->cfg.t_rank_switch : 0);
+  else
+    total += lat_A > lat_B ? lat_A : lat_B;
+
+  total += sim->cfg.noise_sigma * next_normal(sim);
+  if (next_uniform(sim) < sim->cfg.interrupt_prob)
+    total += sim->cfg.interrupt_cost;
+  if (total < 0)
+    total = 0;
+
+  sim->now_ns += total * sim->cfg.ns_per_tick;
+  sim->measurements++;
+  return (uint64_t)(total + 0.5);
+}
+
+uint64_t dramsim_single(struct dramsim *sim, uint64_t addr)
+{
+  unsigned bank;
+  struct dramsim_location loc;
+  double total = sim->cfg.t_base + translate(sim, addr) + access(sim, addr, &bank, &loc);
+  total += sim->cfg.noise_sigma * next_normal(sim);
+  if (next_uniform(sim) < sim->cfg.interrupt_prob)
+    total += sim->cfg.interrupt_cost;
+  if (total < 0)
+    total = 0;
+
+  sim->now_ns += total * sim->cfg.ns_per_tick;
+  sim->measurements++;
+  return (uint64_t)(total + 0.5);
+}
+
+void dramsim_hammer(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds)
+{
+  unsigned bank;
+  struct dramsim_location loc;
+  for (uint64_t r = 0; r < rounds; r++)
+  {
+    for (size_t i = 0; i < num_addrs; i++)
+    {
+      double lat = access(sim, addrs[i], &bank, &loc);
+      sim->now_ns += lat * sim->cfg.ns_per_tick;
+    }
+  }
+}
+
+double dramsim_concurrent(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds)
+{
+  unsigned num_channels = 1U << sim->cfg.num_channel_funcs;
+  std::vector<double> bank_time(sim->num_banks_total);
+  std::vector<unsigned> channel_accesses(num_channels);
+  std::vector<uint32_t> channel_ranks(num_channels);
+  unsigned banks_per_channel = sim->num_banks_total / num_channels;
+
+  double total = 0;
+  for (uint64_t r = 0; r < rounds; r++)
+  {
+    std::fill(bank_time.begin(), bank_time.end(), 0.0);
+    std::fill(channel_accesses.begin(), channel_accesses.end(), 0);
+    std::fill(channel_ranks.begin(), channel_ranks.end(), 0);
+
+    // One access per stream; a bank serves its streams back to back.
+    for (size_t i = 0; i < num_addrs; i++)
+    {
+      unsigned b;
+      struct dramsim_location loc;
+      double lat = access(sim, addrs[i], &b, &loc);
+      bank_time[b] += lat;
+      channel_accesses[loc.channel]++;
+      channel_ranks[loc.channel] |= 1U << (loc.rank & 31);
+    }
+
+    // Banks of a channel overlap, but share its bus and pay for switching
+    // ranks; channels run fully in parallel.
+    double round = 0;
+    for (unsigned c = 0; c < num_channels; c++)
+    {
+      if (!channel_accesses[c])
+        continue;
+      double busy = 0;
+      for (unsigned b = c * banks_per_channel; b < (c + 1) * banks_per_channel; b++)
+        busy = bank_time[b] > busy ? bank_time[b] : busy;
+      busy += sim->cfg.t_same_channel * (channel_accesses[c] - 1) +
+              sim->cfg.t_rank_switch * (__builtin_popcount(channel_ranks[c]) - 1);
+      round = busy > round ? busy : round;
+    }
+    round += sim->cfg.noise_sigma * next_normal(sim);
+    if (round < 1)
+      round = 1;
+
+    sim->now_ns += round * sim->cfg.ns_per_tick;
+    total += round;
+  }
+  return total > 0 ? (double)(num_addrs * rounds) / total : 0.0;
+}
+
+double dramsim_touch(struct dramsim *sim, uint64_t addr)
+{
+  double cost = translate(sim, addr);
+  sim->now_ns += (sim->cfg.t_cache + cost) * sim->cfg.ns_per_tick;
+  return cost;
+}
+
+double dramsim_chase(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds)
+{
+  double total = 0;
+  for (uint64_t r = 0; r < rounds; r++)
+    for (size_t i = 0; i < num_addrs; i++)
+      total += sim->cfg.t_cache + translate(sim, addrs[i]);
+  total += sim->cfg.noise_sigma * next_normal(sim);
+  if (total < 0)
+    total = 0;
+  sim->now_ns += total * sim->cfg.ns_per_tick;
+  return num_addrs && rounds ? total / (double)(num_addrs * rounds) : 0.0;
+}
+
+// Caches line (an address / PAIRS_LINE_SIZE) as prefetched from from_line,
+// unless it leaves from_line's page or the buffer.
+static void prefetch_line(struct dramsim *sim, uint64_t from_line, int64_t line)
+{
+  const uint64_t lines_per_page = PAGE_SIZE / PAIRS_LINE_SIZE;
+  if (line < 0 || (uint64_t)line * PAIRS_LINE_SIZE >= sim->cfg.mem_size)
+    return;
+  if (!sim->cfg.prefetch_cross_page && (uint64_t)line / lines_per_page != from_line / lines_per_page)
+    return;
+  if (sim->cached_lines.insert((uint64_t)line).second)
+    sim->prefetches++;
+}
+
+// Prefetches triggered by a demand load of line.
+static void train_prefetchers(struct dramsim *sim, uint64_t line, int missed)
+{
+  if (missed && sim->cfg.prefetch_next_line)
+    prefetch_line(sim, line, (int64_t)line + 1);
+  if (missed && sim->cfg.prefetch_buddy)
+    prefetch_line(sim, line, (int64_t)(line ^ 1));
+  if (!sim->cfg.prefetch_stride)
+    return;
+
+  // Across pages, one detector follows the whole load stream.
+  uint64_t page = sim->cfg.prefetch_cross_page ? 0 : line * PAIRS_LINE_SIZE / PAGE_SIZE;
+  auto it = sim->stride_table.find(page);
+  if (it == sim->stride_table.end())
+  {
+    sim->stride_table[page] = {line, 0, 0};
+    return;
+  }
+  struct dramsim::stride_entry &e = it->second;
+  int64_t stride = (int64_t)line - (int64_t)e.last_line;
+  if (stride != 0 && stride == e.stride)
+    e.repeats++;
+  else
+    e.repeats = 0;
+  e.stride = stride;
+  e.last_line = line;
+  if (e.repeats >= 1)
+    for (unsigned k = 1; k <= sim->cfg.prefetch_degree; k++)
+      prefetch_line(sim, line, (int64_t)line + stride * (int64_t)k);
+}
+
+uint64_t dramsim_load(struct dramsim *sim, uint64_t addr)
+{
+  uint64_t line = addr / PAIRS_LINE_SIZE;
+  if (sim->cached_lines.size() >= DRAMSIM_CACHE_LINES)
+    sim->cached_lines.clear();
+  int missed = sim->cached_lines.insert(line).second;
+
+  double total = sim->cfg.t_base + translate(sim, addr);
+  if (missed)
+  {
+    unsigned bank;
+    struct dramsim_location loc;
+    total += access(sim, addr, &bank, &loc);
+  }
+  else
+  {
+    total += sim->cfg.t_cache;
+  }
+  train_prefetchers(sim, line, missed);
+
+  total += sim->cfg.noise_sigma * next_normal(sim);
+  if (total < 0)
+    total = 0;
+  sim->now_ns += total * sim->cfg.ns_per_tick;
+  sim->measurements++;
+  return (uint64_t)(total + 0.5);
+}
+
+void dramsim_flush(struct dramsim *sim, uint64_t addr)
+{
+  sim->cached_lines.erase(addr / PAIRS_LINE_SIZE);
+}
+
+uint32_t dramsim_row_flips(const struct dramsim *sim, uint64_t addr)
+{
+  struct dramsim_location loc = dramsim_locate(sim, addr);
+  unsigned b = dramsim_bank_index(sim, addr);
+  auto it = sim->flips.find(row_key(b, loc.row));
+  return it == sim->flips.end() ? 0 : it->second;
+}
+
+void dramsim_row_write(struct dramsim *sim, uint64_t addr)
+{
+  struct dramsim_location loc = dramsim_locate(sim, addr);
+  sim->flips.erase(row_key(dramsim_bank_index(sim, addr), loc.row));
+}
@@ -0,0 +1,190 @@
+#ifndef DRAMSIM_GUARD
+#define DRAMSIM_GUARD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "params.hh"
+
+// Deterministic software DRAM model.
+//
+// Stands in for the memory system behind measure_bank_latency() when built
+// with -DMEASURE_SIM, so the sweep, mapping and hammering logic can run on a
+// plain Linux host. Addresses are byte offsets into the allocated buffer and
+// are treated as physical addresses.
+//
+// Channel, rank and bank index bits are each the parity of the address under
+// one mask (the usual XOR address functions); the row is addr >> row_shift.
+// Each bank keeps its open row, so a pair costs a row hit, an access to a
+// precharged bank or a row conflict, serialised when both addresses share a
+// bank and overlapped otherwise. Latencies are in counter ticks and get
+// Gaussian noise plus rare large interrupts. A REF every tREFI closes all
+// rows and stalls the next access. Optionally, rows whose neighbours are
+// activated more than flip_threshold times within one refresh window get
+// bit flips unless a TRR tracker with a few slots per bank caught the
+// aggressor first, and a two-level set-associative TLB with LRU replacement
+// adds the cost of translating each timed load. Single loads that are not
+// flushed first (dramsim_load) go through a line cache fed by next-line,
+// buddy-line and stride prefetchers.
+
+struct dramsim_config
+{
+  uint64_t mem_size;
+  unsigned row_shift;
+
+  unsigned num_channel_funcs;
+  unsigned num_rank_funcs;
+  unsigned num_bank_funcs;
+  uint64_t channel_masks[DRAMSIM_MAX_FUNCS];
+  uint64_t rank_masks[DRAMSIM_MAX_FUNCS];
+  uint64_t bank_masks[DRAMSIM_MAX_FUNCS];
+
+  int closed_page;          // Close rows after closed_page_timeout_ns idle
+  double closed_page_timeout_ns;
+
+  double t_base;            // Fixed cost of a pair (flush, barriers, timer reads)
+  double t_row_hit;
+  double t_row_empty;       // Bank precharged, activate only
+  double t_row_conflict;    // Precharge + activate
+  double t_same_channel;    // Extra cost when two banks share a channel
+  double t_rank_switch;     // Extra cost when they are in different ranks of it
+  double noise_sigma;
+  double interrupt_prob;
+  double interrupt_cost;
+  double ns_per_tick;
+
+  uint64_t flip_threshold;  // Neighbour activations per window; 0 disables flips
+  double flip_prob;
+  double refresh_window_ns;
+  unsigned trr_entries;     // Rows tracked per bank and window; 0 disables TRR
+  uint64_t trr_threshold;   // Activations before a row is tracked
+
+  double refresh_interval_ns; // tREFI; 0 disables refresh
+  double t_rfc;               // Stall of the first access after a REF
+
+  unsigned tlb_l1_entries;    // 0 disables the TLB model
+  unsigned tlb_l2_entries;
+  unsigned tlb_ways;
+  unsigned tlb_page_shift;    // Translation granule of the buffer
+  double t_tlb_l2;            // L1 TLB miss that hits the L2 TLB
+  double t_walk;              // Miss in both: page walk
+  double t_cache;             // Load that hits the cache
+
+  int prefetch_next_line;     // A load also fetches the next line
+  int prefetch_buddy;         // ... and the other line of its 128-byte pair
+  int prefetch_stride;        // Per-page stride detector
+  unsigned prefetch_degree;   // Strides fetched ahead once a stride repeats
+  int prefetch_cross_page;    // Prefetches may leave the page of the load
+
+  uint64_t seed;
+};
+
+struct dramsim_location
+{
+  unsigned channel;
+  unsigned rank;
+  unsigned bank;
+  uint64_t row;
+};
+
+struct dramsim
+{
+  struct dramsim_config cfg;
+  unsigned num_banks_total;
+  int64_t *open_row;         // Per (channel, rank, bank); -1 when precharged
+  double *last_access_ns;
+  double now_ns;             // Simulated time
+  double window_start_ns;
+  uint64_t rng;
+  int have_spare;
+  double spare_normal;
+
+  // Activations per (bank, row) in the current refresh window, and flipped
+  // bits per (bank, row) so far.
+  std::unordered_map<uint64_t, uint64_t> activations;
+  std::unordered_map<uint64_t, uint32_t> flips;
+  // Rows TRR tracks in the current refresh window, with their activation
+  // count at the last REF, and slots used per bank
+  std::unordered_map<uint64_t, uint64_t> trr_rows;
+  std::vector<unsigned> trr_used;
+
+  uint64_t refresh_epoch;     // REF commands due so far
+  uint64_t refreshes;
+
+  // Page number + 1 (0: empty) and last use of every TLB way, per level
+  std::vector<uint64_t> tlb_tag[2];
+  std::vector<uint64_t> tlb_used[2];
+  uint64_t tlb_clock;
+  uint64_t tlb_walks;
+
+  // Lines cached by dramsim_load, and the stride detector's state per page
+  // (one entry for all pages with prefetch_cross_page):
+  // last line loaded, last stride and how often it repeated
+  std::unordered_set<uint64_t> cached_lines;
+  struct stride_entry
+  {
+    uint64_t last_line;
+    int64_t stride;
+    unsigned repeats;
+  };
+  std::unordered_map<uint64_t, struct stride_entry> stride_table;
+  uint64_t prefetches;
+
+  uint64_t measurements;
+  uint64_t total_activations;
+};
+
+// Configuration from the DRAMSIM_* parameters.
+void dramsim_default_config(struct dramsim_config *cfg, uint64_t mem_size);
+
+void dramsim_init(struct dramsim *sim, const struct dramsim_config *cfg);
+void dramsim_free(struct dramsim *sim);
+
+struct dramsim_location dramsim_locate(const struct dramsim *sim, uint64_t addr);
+
+// Flat (channel, rank, bank) index; equal for addresses in the same bank.
+unsigned dramsim_bank_index(const struct dramsim *sim, uint64_t addr);
+
+// Latency in ticks of flushing and then loading addr_A and addr_B.
+uint64_t dramsim_measure(struct dramsim *sim, uint64_t addr_A, uint64_t addr_B);
+
+// Latency in ticks of flushing and then loading addr alone.
+uint64_t dramsim_single(struct dramsim *sim, uint64_t addr);
+
+// Uncached loads of each address in turn, rounds times (a hammer kernel).
+void dramsim_hammer(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds);
+
+// Throughput, in accesses per tick, of one stream per address issuing
+// back-to-back uncached loads for rounds rounds: streams on different
+// channels overlap fully, streams on one channel share its bus.
+double dramsim_concurrent(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds);
+
+// Translates addr through the TLB model and loads it from the cache, untimed
+// (a load that warms the translation). Returns the translation cost in ticks.
+double dramsim_touch(struct dramsim *sim, uint64_t addr);
+
+// Mean ticks per load of a pointer chase through addrs, rounds times, with
+// every line cached: only translation costs vary.
+double dramsim_chase(struct dramsim *sim, const uint64_t *addrs, size_t num_addrs, uint64_t rounds);
+
+// Latency in ticks of loading addr without flushing it first: a cache hit if
+// it was loaded or prefetched since its last flush, a DRAM access otherwise.
+// Trains the prefetchers either way.
+uint64_t dramsim_load(struct dramsim *sim, uint64_t addr);
+
+// Evicts the line holding addr from the cache.
+void dramsim_flush(struct dramsim *sim, uint64_t addr);
+
+// Bits flipped so far in the row holding addr.
+uint32_t dramsim_row_flips(const struct dramsim *sim, uint64_t addr);
+
+// Rewrites the row holding addr, clearing its flipped bits.
+void dramsim_row_write(struct dramsim *sim, uint64_t addr);
+
+// Simulator behind measure_bank_latency() in -DMEASURE_SIM builds.
+extern struct dramsim default_sim;
+
+#endif
@@ -0,0 +1,395 @@
+#include "fuzz.hh"
+#include "config.hh"
+#include "mapping.hh"
+#include "output.hh"
+#include "shared.hh"
+#include "telemetry.hh"
+#include "timer.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Rows a pattern spans above its anchor, aggressors and victims
+#define FUZZ_MAX_ROWS (FUZZ_MIN_SPACING + (FUZZ_MAX_PAIRS - 1) * (FUZZ_MIN_SPACING + FUZZ_SPACING_JITTER) + 3)
+
+#define VICTIM_PATTERN 0x55
+#define AGGRESSOR_PATTERN 0xAA
+
+// Highest frequency at which a pair of this amplitude still fits its
+// occurrences into length slots.
+static uint32_t max_frequency(uint32_t length, unsigned amplitude)
+{
+  uint32_t f = 1;
+  while (f * 4 * amplitude <= length)
+    f *= 2;
+  return f;
+}
+
+// Slots p's accesses take: 2 * amplitude per occurrence of each pair.
+static uint32_t slots_needed(const struct fuzz_pattern *p)
+{
+  uint32_t n = 0;
+  for (unsigned i = 0; i < p->num_pairs; i++)
+    n += 2U * p->pair[i].frequency * p->pair[i].amplitude;
+  return n;
+}
+
+// Brings p back into the pattern space after a change: pairs packed from
+// FUZZ_MIN_SPACING at legal spacings, frequencies and phases that fit, and
+// a length with a slot for every access.
+static void normalize(struct fuzz_pattern *p)
+{
+  for (unsigned i = 0; i < p->num_pairs; i++)
+  {
+    struct fuzz_pair *q = &p->pair[i];
+    uint32_t lo = i ? p->pair[i - 1].offset + FUZZ_MIN_SPACING : FUZZ_MIN_SPACING;
+    uint32_t hi = i ? lo + FUZZ_SPACING_JITTER : FUZZ_MIN_SPACING;
+    q->offset = std::max(lo, std::min(q->offset, hi));
+    q->amplitude = std::max<uint16_t>(1, std::min<uint16_t>(q->amplitude, FUZZ_MAX_AMPLITUDE));
+    q->frequency = std::max<uint16_t>(1, std::min<uint32_t>(q->frequency, max_frequency(p->length, q->amplitude)));
+  }
+
+  // Each pair fits on its own, several together may not: grow the pattern,
+  // and past FUZZ_MAX_SLOTS thin out the busiest pair.
+  while (slots_needed(p) > p->length)
+  {
+    if (p->length < FUZZ_MAX_SLOTS)
+    {
+      p->length *= 2;
+      continue;
+    }
+    struct fuzz_pair *busiest = &p->pair[0];
+    for (unsigned i = 1; i < p->num_pairs; i++)
+      if (p->pair[i].frequency * p->pair[i].amplitude > busiest->frequency * busiest->amplitude)
+        busiest = &p->pair[i];
+    if (busiest->frequency > 1)
+      busiest->frequency /= 2;
+    else
+      busiest->amplitude--;
+  }
+  for (unsigned i = 0; i < p->num_pairs; i++)
+    p->pair[i].phase %= p->length / p->pair[i].frequency;
+}
+
+static void random_pair(const struct fuzz_pattern *p, struct fuzz_pair *q, std::mt19937_64 &rng)
+{
+  q->amplitude = 1 + rng() % FUZZ_MAX_AMPLITUDE;
+  unsigned steps = 0;
+  for (uint32_t f = max_frequency(p->length, q->amplitude); f > 1; f /= 2)
+    steps++;
+  q->frequency = 1 << (rng() % (steps + 1));
+  q->phase = rng() % (p->length / q->frequency);
+}
+
+void fuzz_random_pattern(struct fuzz_pattern *p, unsigned num_pairs, std::mt19937_64 &rng)
+{
+  memset(p, 0, sizeof(*p));
+  unsigned sizes = 0;
+  for (uint32_t l = FUZZ_MIN_SLOTS; l < FUZZ_MAX_SLOTS; l *= 2)
+    sizes++;
+  p->length = FUZZ_MIN_SLOTS << (rng() % (sizes + 1));
+  p->num_pairs = std::max(1U, std::min(num_pairs, (unsigned)FUZZ_MAX_PAIRS));
+  uint32_t offset = FUZZ_MIN_SPACING;
+  for (unsigned i = 0; i < p->num_pairs; i++)
+  {
+    if (i)
+      offset += FUZZ_MIN_SPACING + rng() % (FUZZ_SPACING_JITTER + 1);
+    p->pair[i].offset = offset;
+    random_pair(p, &p->pair[i], rng);
+  }
+  normalize(p);
+}
+
+void fuzz_mutate(struct fuzz_pattern *p, std::mt19937_64 &rng)
+{
+  struct fuzz_pair *q = &p->pair[rng() % p->num_pairs];
+  switch (rng() % 6)
+  {
+  case 0:
+    q->frequency = rng() % 2 ? q->frequency * 2 : std::max(1, q->frequency / 2);
+    break;
+  case 1:
+    q->phase = rng() % (p->length / q->frequency);
+    break;
+  case 2:
+    q->amplitude += rng() % 2 ? 1 : -1;
+    break;
+  case 3:
+  {
+    // Moves this pair and every one above it.
+    int shift = rng() % 2 ? 1 : -1;
+    for (struct fuzz_pair *r = q; r < p->pair + p->num_pairs; r++)
+      r->offset += shift;
+    break;
+  }
+  case 4:
+    if (p->num_pairs < FUZZ_MAX_PAIRS)
+    {
+      struct fuzz_pair *r = &p->pair[p->num_pairs++];
+      r->offset = (r - 1)->offset + FUZZ_MIN_SPACING + rng() % (FUZZ_SPACING_JITTER + 1);
+      random_pair(p, r, rng);
+    }
+    break;
+  case 5:
+    if (p->num_pairs > 1)
+    {
+      unsigned i = (unsigned)(q - p->pair);
+      memmove(q, q + 1, (p->num_pairs - i - 1) * sizeof(*q));
+      p->num_pairs--;
+    }
+    break;
+  }
+  normalize(p);
+}
+
+int fuzz_compile(const struct fuzz_pattern *p, struct fuzz_program *prog)
+{
+  int16_t slots[FUZZ_MAX_SLOTS];
+  uint32_t length = std::min<uint32_t>(p->length, FUZZ_MAX_SLOTS);
+  for (uint32_t i = 0; i < length; i++)
+    slots[i] = -1;
+
+  unsigned order[FUZZ_MAX_PAIRS];
+  for (unsigned i = 0; i < p->num_pairs; i++)
+    order[i] = i;
+  std::stable_sort(order, order + p->num_pairs,
+                   [&](unsigned a, unsigned b) { return p->pair[a].frequency > p->pair[b].frequency; });
+
+  // A dropped access would leave a pair hammered on one side, or not at all,
+  // while the trial is scored as if the whole pattern ran.
+  prog->num_slots = 0;
+  if (slots_needed(p) > length)
+    return -1;
+  for (unsigned n = 0; n < p->num_pairs; n++)
+  {
+    const struct fuzz_pair *q = &p->pair[order[n]];
+    uint32_t interval = length / q->frequency;
+    for (uint32_t k = 0; k < q->frequency; k++)
+    {
+      uint32_t pos = (q->phase + k * interval) % length;
+      for (unsigned a = 0; a < 2U * q->amplitude; a++)
+      {
+        while (slots[pos] >= 0)
+          pos = (pos + 1) % length;
+        slots[pos] = (int16_t)(2 * order[n] + a % 2);
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < length; i++)
+    if (slots[i] >= 0)
+      prog->slot[prog->num_slots++] = (uint8_t)slots[i];
+  return prog->num_slots ? 0 : -1;
+}
+
+/*
+ * place
+ *
+ * Finds every row a pattern touches, in the anchor's bank: aggressors
+ * offset - 1 and offset + 1 of each pair, and as victims every other row
+ * from the first aggressor - 1 to the last aggressor + 1.
+ */
+static int place(const struct fuzz_pattern *p, uint64_t anchor, uint64_t *aggressors, uint64_t *victims,
+                 unsigned *num_victims)
+{
+  uint64_t rows[FUZZ_MAX_ROWS + 1];
+  int role[FUZZ_MAX_ROWS + 1]; // Aggressor index, -1 for a victim
+  uint32_t first = p->pair[0].offset - 2, last = p->pair[p->num_pairs - 1].offset + 2;
+  if (first < 1 || last > FUZZ_MAX_ROWS)
+    return -1;
+  for (uint32_t d = first; d <= last; d++)
+    role[d] = -1;
+  for (unsigned i = 0; i < p->num_pairs; i++)
+  {
+    role[p->pair[i].offset - 1] = 2 * i;
+    role[p->pair[i].offset + 1] = 2 * i + 1;
+  }
+
+  *num_victims = 0;
+  for (uint32_t d = first; d <= last; d++)
+  {
+    rows[d] = mapping_row_above(anchor, d);
+    if (!rows[d])
+      return -1;
+    if (role[d] >= 0)
+      aggressors[role[d]] = rows[d];
+    else
+      victims[(*num_victims)++] = rows[d];
+  }
+  return 0;
+}
+
+int fuzz_run(const struct fuzz_pattern *p, void *base, uint64_t size, uint64_t activations, std::mt19937_64 &rng,
+             struct fuzz_trial *t)
+{
+  uint64_t start = monotonic_ns();
+  memset(t, 0, sizeof(*t));
+  t->pattern = *p;
+
+  // Anchors near the start of a contiguous run leave room above for every
+  // row of the pattern when the mapping is inferred.
+  uint64_t row_bytes = 1ULL << config.row_bits;
+  uint64_t run = std::min<uint64_t>(size, MAPPING_CONTIG_BYTES);
+  uint64_t rows_per_run = std::max<uint64_t>(1, run / row_bytes);
+  uint64_t span = p->pair[p->num_pairs - 1].offset + 3;
+  uint64_t aggressors[2 * FUZZ_MAX_PAIRS], victims[FUZZ_MAX_ROWS];
+  unsigned num_victims = 0;
+  int placed = 0;
+  for (int i = 0; i < FUZZ_PLACE_TRIES && !placed; i++)
+  {
+    uint64_t row = span < rows_per_run ? rng() % (rows_per_run - span) : 0;
+    t->anchor = (uint64_t)base + rng() % (size / run) * run + row * row_bytes;
+    placed = !place(p, t->anchor, aggressors, victims, &num_victims);
+  }
+  if (!placed)
+    return -1;
+
+  struct fuzz_program prog;
+  if (fuzz_compile(p, &prog))
+    return -1;
+  std::vector<uint64_t> sequence(prog.num_slots);
+  for (uint32_t i = 0; i < prog.num_slots; i++)
+    sequence[i] = aggressors[prog.slot[i]];
+  t->num_slots = prog.num_slots;
+
+  for (unsigned i = 0; i < 2 * p->num_pairs; i++)
+    row_write(aggressors[i], AGGRESSOR_PATTERN);
+  for (unsigned i = 0; i < num_victims; i++)
+    row_write(victims[i], VICTIM_PATTERN);
+
+  uint64_t rounds = std::max<uint64_t>(1, activations / prog.num_slots);
+  t->activations = rounds * prog.num_slots;
+  t->hammer_ns = hammer_sequence(sequence.data(), sequence.size(), rounds);
+  telemetry_add(telemetry_thread_counters()->hammer_rounds, rounds);
+
+  for (unsigned i = 0; i < num_victims; i++)
+    t->flips += row_flipped(victims[i], VICTIM_PATTERN);
+
+  t->wall_ns = (double)(monotonic_ns() - start);
+  t->acts_per_sec = t->hammer_ns > 0 ? t->activations * 1e9 / t->hammer_ns : 0.0;
+  t->score = t->wall_ns > 0 ? t->flips * 1e9 / t->wall_ns : 0.0;
+  return 0;
+}
+
+// UCB1 over pair counts: untried regions first, then the best mean score
+// (relative to the best trial so far) plus the exploration bonus.
+static unsigned pick_region(const struct fuzz_result *r, double best_score)
+{
+  unsigned pick = 1;
+  double pick_value = -1;
+  for (unsigned n = 1; n <= FUZZ_MAX_PAIRS; n++)
+  {
+    const struct fuzz_region *g = &r->region[n];
+    if (!g->trials)
+      return n;
+    double mean = best_score > 0 ? g->score_sum / g->trials / best_score : 0.0;
+    double value = mean + sqrt(2.0 * log((double)r->trials) / g->trials);
+    if (value > pick_value)
+    {
+      pick = n;
+      pick_value = value;
+    }
+  }
+  return pick;
+}
+
+void fuzz_pattern_string(const struct fuzz_pattern *p, char *buf, size_t len)
+{
+  int n = snprintf(buf, len, "%u", p->length);
+  for (unsigned i = 0; i < p->num_pairs && n >= 0 && (size_t)n < len; i++)
+  {
+    const struct fuzz_pair *q = &p->pair[i];
+    n += snprintf(buf + n, len - n, " %u:%u/%u/%u", q->offset, q->frequency, q->phase, q->amplitude);
+  }
+}
+
+int fuzz_campaign(void *base, uint64_t size, uint64_t seed, double budget_sec, uint64_t max_trials,
+                  uint64_t activations, struct fuzz_result *r)
+{
+  memset(r, 0, sizeof(*r));
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  uint64_t start = monotonic_ns();
+  double best_score = 0;
+  char text[OUTPUT_LINE_MAX / 2];
+
+  while ((!max_trials || r->trials < max_trials) && (budget_sec <= 0 || (monotonic_ns() - start) / 1e9 < budget_sec))
+  {
+    struct fuzz_pattern p;
+    if (r->have_best && r->best.flips && unit(rng) < FUZZ_MUTATE_FRACTION)
+    {
+      p = r->best.pattern;
+      fuzz_mutate(&p, rng);
+    }
+    else
+    {
+      fuzz_random_pattern(&p, pick_region(r, best_score), rng);
+    }
+
+    struct fuzz_trial t;
+    if (fuzz_run(&p, base, size, activations, rng, &t))
+    {
+      r->unplaced++;
+      // Count it anyway, so that a pattern no location fits cannot spin.
+      r->trials++;
+      continue;
+    }
+    t.trial = r->trials++;
+    telemetry_add(telemetry_thread_counters()->rows_done, 1);
+
+    struct fuzz_region *g = &r->region[p.num_pairs];
+    g->trials++;
+    g->score_sum += t.score;
+    g->wall_ns += t.wall_ns;
+    g->flips += t.flips;
+    g->flipping += t.flips > 0;
+    r->flips += t.flips;
+    if (!r->have_best || t.score > r->best.score)
+    {
+      r->best = t;
+      r->have_best = 1;
+    }
+    best_score = std::max(best_score, t.score);
+
+    if (t.flips)
+    {
+      if (r->num_logged < FUZZ_MAX_LOGGED)
+        r->logged[r->num_logged] = t;
+      r->num_logged++;
+      fuzz_pattern_string(&p, text, sizeof(text));
+      output_log("[+] fuzz: trial %llu, %u pairs, %u flips at %.3g activations/s (%.2f flips/s): %s\n",
+                 (unsigned long long)t.trial, p.num_pairs, t.flips, t.acts_per_sec, t.score, text);
+    }
+  }
+  r->wall_ns = (double)(monotonic_ns() - start);
+  return r->flips ? 0 : -1;
+}
+
+void fuzz_print(const struct fuzz_result *r)
+{
+  char text[OUTPUT_LINE_MAX / 2];
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Fuzz-Regions\n");
+  output_printf("Pairs,Trials,Flipping,Flips,Wall-Sec,Mean-Score\n");
+  for (unsigned n = 1; n <= FUZZ_MAX_PAIRS; n++)
+  {
+    const struct fuzz_region *g = &r->region[n];
+    output_printf("%u,%llu,%llu,%llu,%.3f,%.4f\n", n, (unsigned long long)g->trials, (unsigned long long)g->flipping,
+                  (unsigned long long)g->flips, g->wall_ns / 1e9, g->trials ? g->score_sum / g->trials : 0.0);
+  }
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Fuzz-Flips\n");
+  output_printf("Trial,Pairs,Slots,Activations,Acts-Per-Sec,Flips,Score,Anchor,Pattern\n");
+  uint64_t shown = std::min<uint64_t>(r->num_logged, FUZZ_MAX_LOGGED);
+  for (uint64_t i = 0; i < shown; i++)
+  {
+    const struct fuzz_trial *t = &r->logged[i];
+    fuzz_pattern_string(&t->pattern, text, sizeof(text));
+    output_printf("%llu,%u,%u,%llu,%.0f,%u,%.4f,0x%llx,%s\n", (unsigned long long)t->trial, t->pattern.num_pairs,
+                  t->num_slots, (unsigned long long)t->activations, t->acts_per_sec, t->flips, t->score,
+                  (unsigned long long)t->anchor, text);
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef FUZZ_GUARD
+#define FUZZ_GUARD
+
+#include <random>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "params.hh"
+
+// Many-sided hammer pattern fuzzer.
+//
+// Double-sided hammering at a fixed count is what in-DRAM mitigations (TRR)
+// are built for: they track the few most active rows of a bank and refresh
+// their neighbours. Patterns with more aggressors than the tracker has slots,
+// or with frequent decoy pairs that take the slots before the real
+// aggressors are noticed, get past it. Patterns are described in the
+// frequency domain: each aggressor pair (the rows either side of one victim)
+// recurs frequency times per pattern, starting phase slots in, amplitude
+// times back to back. A pattern is compiled once into a compact sequence of
+// aggressor indices, placed on rows of one bank, and run through the hammer
+// kernel (hammer_sequence) for a fixed number of activations.
+//
+// Every trial is scored by bit flips per second of wall time, placement,
+// row fills and flip checks included, and the budget follows the score: the
+// pair count picks a region of the pattern space, chosen by UCB1 on the
+// regions' scores, and once a pattern has flipped bits FUZZ_MUTATE_FRACTION
+// of the trials mutate the best pattern so far (at a new location) instead of
+// drawing a fresh one.
+
+struct fuzz_pair
+{
+  uint32_t offset;    // Victim row from the anchor row; aggressors at +-1
+  uint16_t frequency; // Occurrences per pattern, a power of two
+  uint16_t phase;     // First slot, below length / frequency
+  uint16_t amplitude; // Back-to-back accesses of the pair per occurrence
+};
+
+struct fuzz_pattern
+{
+  uint32_t num_pairs;
+  uint32_t length; // Slots, a power of two, at least 2 * frequency * amplitude summed over the pairs
+  struct fuzz_pair pair[FUZZ_MAX_PAIRS];
+};
+
+// A compiled pattern: the aggressor (2 * pair + side) of every access.
+struct fuzz_program
+{
+  uint32_t num_slots;
+  uint8_t slot[FUZZ_MAX_SLOTS];
+};
+
+struct fuzz_trial
+{
+  uint64_t trial;
+  struct fuzz_pattern pattern;
+  uint64_t anchor;      // Virtual address of the anchor row
+  uint32_t num_slots;   // Compiled length
+  uint64_t activations; // Aggressor accesses hammered
+  double hammer_ns;
+  double wall_ns;
+  uint32_t flips;       // Over every row between and around the aggressors
+  double acts_per_sec;  // Activation rate of the hammer kernel
+  double score;         // Flips per second of wall time
+};
+
+// Trials by number of aggressor pairs.
+struct fuzz_region
+{
+  uint64_t trials;
+  uint64_t flipping;
+  uint64_t flips;
+  double score_sum;
+  double wall_ns;
+};
+
+struct fuzz_result
+{
+  uint64_t trials;
+  uint64_t unplaced; // Patterns no location was found for
+  uint64_t flips;
+  double wall_ns;
+  struct fuzz_region region[FUZZ_MAX_PAIRS + 1];
+  int have_best;
+  struct fuzz_trial best;
+  uint64_t num_logged; // Flipping trials, the first FUZZ_MAX_LOGGED kept
+  struct fuzz_trial logged[FUZZ_MAX_LOGGED];
+};
+
+// Random pattern of num_pairs pairs (1..FUZZ_MAX_PAIRS).
+void fuzz_random_pattern(struct fuzz_pattern *p, unsigned num_pairs, std::mt19937_64 &rng);
+
+// One random change: a pair's frequency, phase, amplitude or spacing, or a
+// pair added or removed.
+void fuzz_mutate(struct fuzz_pattern *p, std::mt19937_64 &rng);
+
+/*
+ * fuzz_compile
+ *
+ * Lays the pattern out over its slots, most frequent pairs first, each
+ * access in the first free slot from where it is due, and drops the slots
+ * left empty. Patterns from fuzz_random_pattern and fuzz_mutate always fit.
+ *
+ * Outputs: prog - The access sequence, 2 * frequency * amplitude accesses
+ *                 per pair
+ * Returns: 0, or -1 if the accesses need more than length slots
+ */
+int fuzz_compile(const struct fuzz_pattern *p, struct fuzz_program *prog);
+
+/*
+ * fuzz_run
+ *
+ * One trial of p at an anchor drawn from the buffer: writes the aggressor
+ * and victim rows, hammers the compiled pattern for activations accesses,
+ * then counts the flipped victim rows' bytes.
+ *
+ * Inputs: base/size - Buffer; mapping_init must have been called for it
+ *         activations - Aggressor accesses
+ * Outputs: t - The trial (t->trial is left to the caller)
+ * Returns: 0, or -1 if no location with every row in one bank was found or
+ *          the pattern does not compile
+ */
+int fuzz_run(const struct fuzz_pattern *p, void *base, uint64_t size, uint64_t activations, std::mt19937_64 &rng,
+             struct fuzz_trial *t);
+
+/*
+ * fuzz_campaign
+ *
+ * Runs trials until budget_sec of wall time or max_trials trials (0: no
+ * limit on either) are used up, logging each that flips bits.
+ *
+ * Outputs: r - Per-region totals, the best trial and the flipping ones
+ * Returns: 0 if any trial flipped bits, -1 otherwise
+ */
+int fuzz_campaign(void *base, uint64_t size, uint64_t seed, double budget_sec, uint64_t max_trials,
+                  uint64_t activations, struct fuzz_result *r);
+
+// Short text form of p: length, then offset:frequency/phase/amplitude per pair.
+void fuzz_pattern_string(const struct fuzz_pattern *p, char *buf, size_t len);
+
+void fuzz_print(const struct fuzz_result *r);
+
+#endif
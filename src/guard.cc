@@ -0,0 +1,133 @@
+#include "guard.hh"
+#include "output.hh"
+#include "params.hh"
+#include "shared.hh"
+#include "telemetry.hh"
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+struct guard_state default_guard = {measure_bank_latency};
+
+/*
+ * current_cpu
+ *
+ * Core the calling thread is running on, or -1 if the platform has no
+ * cheap way to tell. XNU keeps the CPU number in the low bits of
+ * TPIDRRO_EL0 (see _os_cpu_number in libsyscall).
+ */
+static inline int current_cpu(void)
+{
+#if defined(__linux__)
+  return sched_getcpu();
+#elif defined(__APPLE__) && defined(__aarch64__)
+  uint64_t tpidrro;
+  asm volatile("mrs %0, TPIDRRO_EL0" : "=r"(tpidrro));
+  return (int)(tpidrro & 0x7);
+#else
+  return -1;
+#endif
+}
+
+static inline long involuntary_switches(void)
+{
+  struct rusage ru;
+#if defined(RUSAGE_THREAD)
+  getrusage(RUSAGE_THREAD, &ru);
+#else
+  // Process-wide on macOS; that also catches the counter thread being
+  // preempted, which disturbs the sample just as much.
+  getrusage(RUSAGE_SELF, &ru);
+#endif
+  return ru.ru_nivcsw;
+}
+
+void guard_init(struct guard_state *g, measure_fn inner)
+{
+  g->inner = inner;
+  g->ewma = 0;
+  g->ewmad = 0;
+  g->seen = 0;
+  g->attempts = 0;
+  g->accepted = 0;
+  g->rejected_migrated = 0;
+  g->rejected_preempted = 0;
+  g->rejected_gap = 0;
+  g->gave_up = 0;
+}
+
+static void guard_update(struct guard_state *g, uint64_t t)
+{
+  if (g->seen++ == 0)
+  {
+    g->ewma = (double)t;
+    g->ewmad = 0;
+    return;
+  }
+  double dev = (double)t - g->ewma;
+  g->ewma += GUARD_EWMA_ALPHA * dev;
+  g->ewmad += GUARD_EWMA_ALPHA * ((dev < 0 ? -dev : dev) - g->ewmad);
+}
+
+static int is_gap(const struct guard_state *g, uint64_t t)
+{
+  if (g->seen < GUARD_WARMUP_SAMPLES)
+    return 0;
+  // Floor the deviation so a very tight distribution does not reject
+  // ordinary conflicts sitting just above the hits.
+  double spread = g->ewmad > g->ewma / 8 ? g->ewmad : g->ewma / 8;
+  return (double)t > g->ewma + GUARD_GAP_DEVIATIONS * spread;
+}
+
+uint64_t guard_measure(struct guard_state *g, uint64_t addr_A, uint64_t addr_B)
+{
+  struct telemetry_counters *tc = telemetry_thread_counters();
+  uint64_t t = 0;
+
+  for (int attempt = 0; attempt <= GUARD_MAX_RETRIES; attempt++)
+  {
+    g->attempts++;
+    int cpu_before = current_cpu();
+    long nivcsw_before = involuntary_switches();
+
+    t = g->inner(addr_A, addr_B);
+
+    long nivcsw_after = involuntary_switches();
+    int cpu_after = current_cpu();
+
+    if (cpu_before != cpu_after)
+      g->rejected_migrated++;
+    else if (nivcsw_before != nivcsw_after)
+      g->rejected_preempted++;
+    else if (is_gap(g, t))
+      g->rejected_gap++;
+    else
+    {
+      g->accepted++;
+      guard_update(g, t);
+      return t;
+    }
+    telemetry_add(tc->outliers, 1);
+  }
+
+  g->gave_up++;
+  guard_update(g, t);
+  return t;
+}
+
+uint64_t guard_measure_default(uint64_t addr_A, uint64_t addr_B)
+{
+  return guard_measure(&default_guard, addr_A, addr_B);
+}
+
+void guard_report(const struct guard_state *g)
+{
+  uint64_t rejected = g->rejected_migrated + g->rejected_preempted + g->rejected_gap;
+  double rate = g->attempts ? 100.0 * rejected / g->attempts : 0.0;
+  output_log("[+] guard: %llu attempts, %llu rejected (%.2f%%): %llu migrated, %llu preempted, %llu gaps; "
+             "%llu kept after %d retries\n",
+             (unsigned long long)g->attempts, (unsigned long long)rejected, rate,
+             (unsigned long long)g->rejected_migrated, (unsigned long long)g->rejected_preempted,
+             (unsigned long long)g->rejected_gap, (unsigned long long)g->gave_up, GUARD_MAX_RETRIES);
+}
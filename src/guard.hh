@@ -0,0 +1,57 @@
+#ifndef GUARD_GUARD
+#define GUARD_GUARD
+
+#include <stdint.h>
+
+#include "sampler.hh"
+
+// Disturbance detection around timed windows.
+//
+// Every sample taken through guard_measure is checked for
+//   - migration: the core id changed between before and after,
+//   - preemption: the involuntary context switch count moved,
+//   - gaps: the latency is far above the running distribution,
+// and retried (up to GUARD_MAX_RETRIES times) if any check fires.
+
+struct guard_state
+{
+  measure_fn inner;
+
+  // Running distribution of accepted samples: EWMA of the latency and of
+  // its absolute deviation.
+  double ewma;
+  double ewmad;
+  uint64_t seen;
+
+  uint64_t attempts;
+  uint64_t accepted;
+  uint64_t rejected_migrated;
+  uint64_t rejected_preempted;
+  uint64_t rejected_gap;
+  uint64_t gave_up; // Still disturbed after all retries; returned anyway
+};
+
+// Guard used by guard_measure_default()
+extern struct guard_state default_guard;
+
+void guard_init(struct guard_state *g, measure_fn inner);
+
+/*
+ * guard_measure
+ *
+ * Takes one sample of the pair through g->inner, retrying disturbed ones.
+ *
+ * Inputs: g - Guard state and running distribution
+ *         addr_A/addr_B - The pair
+ * Output: The first clean sample, or the last one if every retry was disturbed
+ */
+uint64_t guard_measure(struct guard_state *g, uint64_t addr_A, uint64_t addr_B);
+
+// measure_fn-compatible wrapper: one sample through default_guard, whose inner
+// function is measure_bank_latency() unless a binary installs its own.
+uint64_t guard_measure_default(uint64_t addr_A, uint64_t addr_B);
+
+// Print attempts and reject rates (total and by cause) to the log stream.
+void guard_report(const struct guard_state *g);
+
+#endif
@@ -0,0 +1,69 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../telemetry.hh"
+#include "../guard.hh"
+#include "../mapping.hh"
+#include "../channels.hh"
+#include "../timer.hh"
+#include "../fuzz.hh"
+
+// Many-sided hammer pattern fuzzing: searches aggressor count, frequency,
+// phase and amplitude for patterns that flip bits past the in-DRAM
+// mitigations, spending the time budget where flips per second are highest.
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t mem_size = config_buffer_bytes();
+    allocated_mem = allocate_pages(mem_size);
+    if (mapping_init((enum mapping_mode) config.mapping_mode, allocated_mem, mem_size, NULL) < 0)
+        return -1;
+
+    // Aggressors must share a bank: fit channels and ranks into the mapping
+    // first, as hammering does.
+    if (config.channel_discovery) {
+        struct channel_map *channels = (struct channel_map *) calloc(1, sizeof(struct channel_map));
+        if (channel_refine_mapping(measure_concurrent_throughput, allocated_mem, mem_size, channels) >= 0)
+            channel_print(channels);
+        free(channels);
+    }
+
+    struct fuzz_result *res = (struct fuzz_result *) calloc(1, sizeof(struct fuzz_result));
+    telemetry_start("fuzz", config.fuzz_trials);
+    int found = !fuzz_campaign(allocated_mem, mem_size, config.pair_seed, config.fuzz_budget_sec, config.fuzz_trials,
+                               config.fuzz_activations, res);
+    telemetry_stop();
+    clock_report();
+
+    char best[OUTPUT_LINE_MAX / 2] = "none";
+    if (res->have_best && res->best.flips)
+        fuzz_pattern_string(&res->best.pattern, best, sizeof(best));
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Hammer pattern fuzzer\n");
+    config_print();
+    output_printf("Mapping, %s\n", mapping_mode_name(mapping_current_mode()));
+    output_printf("Trials, %llu\n", (unsigned long long) res->trials);
+    output_printf("Unplaced, %llu\n", (unsigned long long) res->unplaced);
+    output_printf("Wall seconds, %.1f\n", res->wall_ns / 1e9);
+    output_printf("Flips, %llu\n", (unsigned long long) res->flips);
+    output_printf("Flipping trials, %llu\n", (unsigned long long) res->num_logged);
+    output_printf("Best pattern, %s\n", best);
+    output_printf("Best flips per second, %.4f\n", res->have_best ? res->best.score : 0.0);
+    output_printf("Best activations per second, %.0f\n", res->have_best ? res->best.acts_per_sec : 0.0);
+    fuzz_print(res);
+
+    free(res);
+    guard_report(&default_guard);
+    mapping_report();
+    clock_service_stop();
+    output_shutdown();
+    return found ? 0 : 1;
+}
@@ -1,27 +1,38 @@
 #include "../shared.hh"
+#include "../config.hh"
+#include "../kernels.hh"
 #include "../util.hh"
 #include "../params.hh"
+#include "../output.hh"
+#include "../telemetry.hh"
+#include "../guard.hh"
+#include "../mapping.hh"
+#include "../channels.hh"
+#include "../refresh.hh"
+#include "../timer.hh"
+#include "../pairs.hh"
 #include "stdlib.h"
 #include <random>
 
 std::map<uint64_t, uint64_t> physaddr_bankno_map;
 std::map<uint64_t, std::vector<uint64_t>> bank_to_physaddr_map;
 
+// Rounds per victim: one refresh window's worth once tREFI is known.
+uint64_t hammers_per_iter;
+
 
 /**
  * Since we load an entire row into the cache, need to flush every 64 bits
 */
 void clflush_row(uint8_t *row_ptr) {
-    for (uint32_t index = 0; index < ROW_SIZE; index += 64) {
-        clflush((row_ptr + index));
-    }
+    flush_row(row_ptr, config.row_size);
 }
 /**
  * Another method to flush a lot of things in the cacheline.
 */
 void clflush_area(uint8_t *start_ptr, uint64_t size) {
     for (uint32_t index = 0; index < size; index += 64) {
-        clflush((start_ptr + index));
+        arm_v8_cache_flush((uint64_t)(start_ptr + index));
     }
 }
 /**
@@ -37,14 +48,14 @@ void cache_flush_eviction_method(uint64_t cacheline_size, uint64_t start_address
 
 void get_bank_mapping(void * allocated_mem, uint64_t buffer_size_bytes) {
 
-    const long int num_iterations = buffer_size_bytes / ROW_SIZE;
+    const long int num_iterations = buffer_size_bytes / config.row_size;
     uint64_t * base = (uint64_t *)allocated_mem;
 
     // Insert memory addresses into the map
     for (int i = 0; i < num_iterations; i++) { 
         
         // Set all to bank 0 initially
-        uint64_t virt_addr = (uint64_t) base + i*ROW_SIZE;
+        uint64_t virt_addr = (uint64_t) base + i*config.row_size;
         uint64_t phys_addr = virt_to_phys(virt_addr);
         physaddr_bankno_map[phys_addr] = 0;
     }
@@ -62,14 +73,15 @@ void get_bank_mapping(void * allocated_mem, uint64_t buffer_size_bytes) {
             uint64_t vaddr1 = phys_to_virt(paddr1);
             uint64_t vaddr2 = phys_to_virt(paddr2);
 
-            uint64_t time = measure_bank_latency(vaddr1 , vaddr2);
+            uint64_t time = guard_measure_default(vaddr1 , vaddr2);
+            telemetry_add(telemetry_thread_counters()->measurements, 1);
             
             // TODO: Shubh uses <600. Why?
-            if (time >= ROW_BUFFER_CONFLICT_LATENCY ) {
+            if (time >= config.conflict_latency ) {
                 addr_2->second = bank1;
             } else {
                 // Increment the bank number and ensure it stays within the range of 0 to 7
-                addr_2->second = (bank2 + 1) % NUM_BANKS; // Modulus 8 ensures it stays within 0 to 7 range
+                addr_2->second = (bank2 + 1) % config.num_banks; // Modulus keeps it within 0 to num_banks - 1
 
             }
             
@@ -82,7 +94,7 @@ void get_bank_mapping(void * allocated_mem, uint64_t buffer_size_bytes) {
 void create_banktoaddr_map() {
 
     // Initialize Arrays for bank to phys addr map
-    for (uint64_t i= 0; i<NUM_BANKS; i++) {
+    for (uint64_t i= 0; i<config.num_banks; i++) {
         bank_to_physaddr_map[i] = std::vector<uint64_t>();
     }
 
@@ -115,13 +127,14 @@ void verify_same_bank(uint64_t samples, uint64_t bank_no) {
         uint64_t vaddr1 = phys_to_virt(paddr_1);
         uint64_t vaddr2 = phys_to_virt(paddr_2);
 
-        uint64_t time = measure_bank_latency(vaddr1 , vaddr2);
+        uint64_t time = guard_measure_default(vaddr1 , vaddr2);
+        telemetry_add(telemetry_thread_counters()->measurements, 1);
 
-        if (time >= ROW_BUFFER_HIT_LATENCY && time < ROW_BUFFER_CONFLICT_LATENCY) {
-            fprintf(stdout, "A: {%lu}, B: {%lu}, Latency: {%lu}. NOT IN SAME BANK DESPITE BEING SORTED AS SO", paddr_1, paddr_2, time);
+        if (time >= config.hit_latency && time < config.conflict_latency) {
+            output_printf("A: {%lu}, B: {%lu}, Latency: {%lu}. NOT IN SAME BANK DESPITE BEING SORTED AS SO", paddr_1, paddr_2, time);
         }
-        if (time >= ROW_BUFFER_CONFLICT_LATENCY) {
-            fprintf(stdout, "A: {%lu}, B: {%lu}, Latency: {%lu}. IN SAME BANK AND BEING SORTED AS SO", paddr_1, paddr_2, time);
+        if (time >= config.conflict_latency) {
+            output_printf("A: {%lu}, B: {%lu}, Latency: {%lu}. IN SAME BANK AND BEING SORTED AS SO", paddr_1, paddr_2, time);
         }
 
     }
@@ -130,32 +143,12 @@ void verify_same_bank(uint64_t samples, uint64_t bank_no) {
 
 }
 
-uint32_t hammer_addresses(uint64_t vict_virt_addr, uint64_t attacker_virt_addr_1, uint64_t attacker_virt_addr_2) {
-
-    uint8_t *vict_virt_addr_ptr = reinterpret_cast<uint8_t *>(vict_virt_addr);
-    uint8_t *attacker_virt_addr_1_ptr = reinterpret_cast<uint8_t *>(attacker_virt_addr_1);
-    uint8_t *attacker_virt_addr_2_ptr = reinterpret_cast<uint8_t *>(attacker_virt_addr_2);
-    memset(vict_virt_addr_ptr, 0x55, ROW_SIZE);
-    memset(attacker_virt_addr_1_ptr, 0xAA, ROW_SIZE);
-    memset(attacker_virt_addr_2_ptr, 0xAA, ROW_SIZE);
-    
-    clflush_row(vict_virt_addr_ptr);
-    clflush_row(attacker_virt_addr_1_ptr);
-    clflush_row(attacker_virt_addr_2_ptr);
-  
-    int num_reads = HAMMERS_PER_ITER;
-
-    while (num_reads-- > 0 ) {
-        asm volatile(
-            "mov (%0), %%rax\n\t"
-            "mov (%1), %%rax\n\t"
-            "clflush (%0)\n\t"
-            "clflush (%1)\n\t"
-            "mfence\n\t"
-            :
-            : "r" (attacker_virt_addr_1), "r" (attacker_virt_addr_2)
-            : "rax"
-        );
+void hammer_pair(uint64_t attacker_virt_addr_1, uint64_t attacker_virt_addr_2, uint64_t rounds) {
+    while (rounds-- > 0) {
+        *(volatile uint8_t *)attacker_virt_addr_1;
+        *(volatile uint8_t *)attacker_virt_addr_2;
+        arm_v8_cache_flush(attacker_virt_addr_1);
+        arm_v8_cache_flush(attacker_virt_addr_2);
 
         /*
         asm volatile(
@@ -168,124 +161,167 @@ uint32_t hammer_addresses(uint64_t vict_virt_addr, uint64_t attacker_virt_addr_1
           );
         */
     }
-
-    clflush_row(vict_virt_addr_ptr);
-
-    uint32_t number_of_bitflips_in_target = 0;
-    for (uint32_t index = 0; index < ROW_SIZE; index++) {
-        if (vict_virt_addr_ptr[index] != 0x55) {
-            number_of_bitflips_in_target++;
-        }
-    }
-    return number_of_bitflips_in_target; 
 }
 
 /**
- * returns 1 upon success, 0 upon failure.
+ * Detects tREFI from a latency trace and sizes hammers_per_iter to one
+ * refresh window of double-sided rounds. Keeps config.hammers_per_iter if no
+ * refresh period shows up.
 */
-int get_addresses_to_hammer(uint64_t victim_phys_addr, uint64_t *attacker_1, uint64_t *attacker_2, int row_diff) {
-    int tries = 1000;
-    while (tries-- > 0) {
-        uint64_t row_bits = victim_phys_addr >> 16; // Bit 16+ is for row bits
-        uint64_t column_bits = victim_phys_addr & 0x1fff; // 13 col bits
-
-        int bank_xor_bits = (victim_phys_addr >> 13) & 0x7; // Get Bank XOR Bits
-        int bank = bank_xor_bits ^ (victim_phys_addr & 0x7);
-
-            
-        uint64_t new_row_bits1 = (uint64_t) (row_bits + row_diff);
-        int bits_row_bank_xor1 = (new_row_bits1 & 0x7);
-
-        int new_bank_xor_bits1 = bank ^ bits_row_bank_xor1;
+void size_hammers_to_refresh(uint64_t addr_1, uint64_t addr_2) {
+    struct refresh_trace trace;
+    if (refresh_trace_alloc(&trace, REFRESH_TRACE_SAMPLES))
+        return;
+    refresh_record(&trace, addr_1);
+    struct refresh_result res;
+    int found = !refresh_analyze(&trace, timestamp_ticks_per_ns(), &res);
+    refresh_trace_free(&trace);
+    refresh_print(&res);
+    if (!found) {
+        output_log("[-] No refresh period found, keeping %llu hammers per victim\n", (unsigned long long) hammers_per_iter);
+        return;
+    }
 
+    const uint64_t probe_rounds = 100000;
+    uint64_t start = monotonic_ns();
+    hammer_pair(addr_1, addr_2, probe_rounds);
+    double round_ns = (double) (monotonic_ns() - start) / probe_rounds;
+    uint64_t rounds = refresh_hammer_rounds(&res, round_ns);
+    if (rounds > 0)
+        hammers_per_iter = rounds;
+    output_log("[+] tREFI %.0f ns, window %.2f ms, %.1f ns per round: %llu hammers per victim\n", res.period_ns,
+               res.window_ns / 1e6, round_ns, (unsigned long long) hammers_per_iter);
+}
 
-        uint64_t new_row_bits2 = (uint64_t) (row_bits - row_diff);
-        int bits_row_bank_xor2 = (new_row_bits2 & 0x7);
+uint32_t hammer_addresses(uint64_t vict_virt_addr, uint64_t attacker_virt_addr_1, uint64_t attacker_virt_addr_2) {
 
-        int new_bank_xor_bits2 = bank ^ bits_row_bank_xor2;
+    uint8_t *vict_virt_addr_ptr = reinterpret_cast<uint8_t *>(vict_virt_addr);
+    uint8_t *attacker_virt_addr_1_ptr = reinterpret_cast<uint8_t *>(attacker_virt_addr_1);
+    uint8_t *attacker_virt_addr_2_ptr = reinterpret_cast<uint8_t *>(attacker_virt_addr_2);
+    fill_row(vict_virt_addr_ptr, config.row_size, 0x55);
+    fill_row(attacker_virt_addr_1_ptr, config.row_size, 0xAA);
+    fill_row(attacker_virt_addr_2_ptr, config.row_size, 0xAA);
+    
+    clflush_row(vict_virt_addr_ptr);
+    clflush_row(attacker_virt_addr_1_ptr);
+    clflush_row(attacker_virt_addr_2_ptr);
+  
+    hammer_pair(attacker_virt_addr_1, attacker_virt_addr_2, hammers_per_iter);
 
+    clflush_row(vict_virt_addr_ptr);
+    telemetry_add(telemetry_thread_counters()->hammer_rounds, hammers_per_iter);
 
-        *attacker_1 = phys_to_virt(get_dram_address(new_row_bits1, new_bank_xor_bits1, column_bits));
-        *attacker_2 = phys_to_virt(get_dram_address(new_row_bits2, new_bank_xor_bits2, column_bits));
-        if (*attacker_1 != 0 && *attacker_2 != 0) return 1;
-    }
-    return 0;
+    return count_changed(vict_virt_addr_ptr, config.row_size, 0x55);
 }
 
-
 void print_result(uint64_t victim, uint64_t attacker_1, uint64_t attacker_2, uint32_t num_bit_flips) {
     uint64_t x = virt_to_phys(victim);
     uint64_t a = virt_to_phys(attacker_1);
     uint64_t b = virt_to_phys(attacker_2);
-    fprintf(stdout,"victim: %s\t%ld (phys)\n", int_to_binary(x, 33), x);
-    fprintf(stdout,"attacker 1: %s\t%ld (phys)\n", int_to_binary(a, 33), a);
-    fprintf(stdout,"attacker 2: %s\t%ld (phys)\n", int_to_binary(b, 33), b);
-    fprintf(stdout,"Bit flips found: %d\n", num_bit_flips);
+    output_printf("victim: %s\t%ld (phys)\n", int_to_binary(x, 33), x);
+    output_printf("attacker 1: %s\t%ld (phys)\n", int_to_binary(a, 33), a);
+    output_printf("attacker 2: %s\t%ld (phys)\n", int_to_binary(b, 33), b);
+    output_printf("Bit flips found: %d\n", num_bit_flips);
 }
 
 
 
 int main(int argc, char **argv) {
-    setvbuf(stdout, NULL, _IONBF, 0);
-    uint64_t mem_size = (uint64_t) ((uint64_t) BUFFER_SIZE_MB * (1024 * 1024));
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    hammers_per_iter = config.hammers_per_iter;
+    timing_init();
+    uint64_t mem_size = config_buffer_bytes();
     allocated_mem = allocate_pages(mem_size);
-    setup_PPN_VPN_map(allocated_mem, mem_size);
+    if (mapping_init((enum mapping_mode) config.mapping_mode, allocated_mem, mem_size, NULL) < 0)
+        return -1;
+
+    // Tell channels and ranks apart from banks before picking aggressors,
+    // and rebuild the mapping with the fitted channel/rank functions.
+    if (config.channel_discovery) {
+        struct channel_map *channels = (struct channel_map *) calloc(1, sizeof(struct channel_map));
+        if (channel_refine_mapping(measure_concurrent_throughput, allocated_mem, mem_size, channels) >= 0)
+            channel_print(channels);
+        free(channels);
+    }
+
+    if (config.refresh_size_hammers)
+        size_hammers_to_refresh((uint64_t) allocated_mem, (uint64_t) allocated_mem + mem_size / 2);
 
     uint64_t victim; 
     uint64_t* attacker_1 = (uint64_t*) calloc(1, sizeof(uint64_t));
     uint64_t* attacker_2 = (uint64_t*) calloc(1, sizeof(uint64_t));
 
-    const long int num_iterations = mem_size / ROW_SIZE;
-
-    fprintf(stdout, "=========================================================\n");
-    fprintf(stdout, "Row +1, -1\n");
-    fprintf(stdout, "=========================================================\n");
-
-    for (int i = 1; i < num_iterations-1; i++) {
-        victim = (uint64_t)((uint8_t *)allocated_mem + ROW_SIZE * i);
+    const long int num_iterations = mem_size / config.row_size;
+    // Victims in config.order; a permuted order keeps the prefetchers from
+    // running ahead of the refill and flip check of each victim.
+    struct sweep_order order_1, order_2;
+    sweep_order_init(&order_1, (enum order_mode) config.order, num_iterations - 2, config.pair_seed,
+                     config.order_min_distance);
+    sweep_order_init(&order_2, (enum order_mode) config.order, num_iterations - 4, config.pair_seed,
+                     config.order_min_distance);
+    struct telemetry_counters *tc = telemetry_thread_counters();
+    telemetry_start("row+-1", (num_iterations - 2) + (num_iterations - 4));
+
+    output_printf("=========================================================\n");
+    output_printf("Row +1, -1\n");
+    output_printf("=========================================================\n");
+
+    for (long int k = 0; k < num_iterations-2; k++) {
+        uint64_t i = 1 + sweep_order_at(&order_1, k);
+        victim = (uint64_t)((uint8_t *)allocated_mem + config.row_size * i);
+        telemetry_add(tc->rows_done, 1);
         
         // row + 1, row - 1
-        if (get_addresses_to_hammer(virt_to_phys(victim), attacker_1, attacker_2, 1)) {
+        if (mapping_aggressors(victim, 1, attacker_1, attacker_2)) {
             uint32_t num_bit_flips = hammer_addresses(victim, *attacker_1, *attacker_2);
             //print_result(victim, *attacker_1, *attacker_2, num_bit_flips);
             //if (num_bit_flips > 0) break;
             if (num_bit_flips > 0) {
-                fprintf(stdout, "=========================================================\n");
+                output_printf("=========================================================\n");
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips);
-                fprintf(stdout, "Bit Flips Found. Reproducing Bit Flips.\n");
+                output_printf("Bit Flips Found. Reproducing Bit Flips.\n");
                 uint32_t num_bit_flips2 = hammer_addresses(victim, *attacker_1, *attacker_2);
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips2);
-                fprintf(stdout, "Try again? Reproducing Bit Flips.\n");
+                output_printf("Try again? Reproducing Bit Flips.\n");
                 uint32_t num_bit_flips3 = hammer_addresses(victim, *attacker_1, *attacker_2);
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips3);
-                fprintf(stdout, "=========================================================\n");
+                output_printf("=========================================================\n");
             }
         }
     }
 
-    fprintf(stdout, "=========================================================\n");
-    fprintf(stdout, "Row +2, -2\n");
-    fprintf(stdout, "=========================================================\n");
+    telemetry_set_phase("row+-2");
+    output_printf("=========================================================\n");
+    output_printf("Row +2, -2\n");
+    output_printf("=========================================================\n");
 
-    for (int i = 2; i < num_iterations-2; i++) {
-        victim = (uint64_t)((uint8_t *)allocated_mem + ROW_SIZE * i);
+    for (long int k = 0; k < num_iterations-4; k++) {
+        uint64_t i = 2 + sweep_order_at(&order_2, k);
+        victim = (uint64_t)((uint8_t *)allocated_mem + config.row_size * i);
+        telemetry_add(tc->rows_done, 1);
         // row + 2, row - 2
-        if (get_addresses_to_hammer(virt_to_phys(victim), attacker_1, attacker_2, 2)) {
+        if (mapping_aggressors(victim, 2, attacker_1, attacker_2)) {
             uint32_t num_bit_flips = hammer_addresses(victim, *attacker_1, *attacker_2);
             if (num_bit_flips > 0) {
-                fprintf(stdout, "=========================================================\n");
+                output_printf("=========================================================\n");
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips);
-                fprintf(stdout, "Bit Flips Found. Reproducing Bit Flips.\n");
+                output_printf("Bit Flips Found. Reproducing Bit Flips.\n");
                 uint32_t num_bit_flips2 = hammer_addresses(victim, *attacker_1, *attacker_2);
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips2);
-                fprintf(stdout, "Try again? Reproducing Bit Flips.\n");
+                output_printf("Try again? Reproducing Bit Flips.\n");
                 uint32_t num_bit_flips3 = hammer_addresses(victim, *attacker_1, *attacker_2);
                 print_result(victim, *attacker_1, *attacker_2, num_bit_flips3);
-                fprintf(stdout, "=========================================================\n");
+                output_printf("=========================================================\n");
 
             }
             //if (num_bit_flips > 0) break;
         }
     }
 
+    telemetry_stop();
+    guard_report(&default_guard);
+    mapping_report();
 }
\ No newline at end of file
@@ -1,147 +1,83 @@
 #include "../shared.hh"
+#include "../config.hh"
 #include "../util.hh"
 #include "../params.hh"
-
-#ifdef TIMING_PTHREAD
-#include <pthread.h>
-#include <unistd.h>
-#endif
-
-#ifdef TIMING_PTHREAD
-
-int terminate = 0;
-uint64_t clk = 0;
-// Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
-// Uses dedicated thread that increments once per cycle to act as a timing parameter
-// Gururaj said through experience its a good metric to use.
-
-void *thread_function(void *x_void_ptr)
-{
-    // fprintf(stderr, "[+] Counter thread running...\n");
-
-    while (!terminate)
-    {
-        // printf("Counter = %llu\n", counter);
-        clk++;
-    }
-
-    // fprintf(stderr, "[+] Counter thread finished\n");
-    return NULL;
-}
-
-#endif
-
-uint64_t timestamp()
-{
-// Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
-#ifdef TIMING_PTHREAD
-    return clk;
-#else
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)((uint64_t)(ts.tv_sec) * (uint64_t)(1000 * 1000 * 1000)) + (uint64_t)ts.tv_nsec;
-#endif
-}
-
-uint64_t measure_latency_two_access(uint64_t addr_A, uint64_t addr_B)
-{
-
-#ifdef TIMING_PTHREAD
-  printf("pthread timing active \n");
-  pthread_t cthread;
-  // Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
-  fprintf(stderr, "Creating counter thread\n");
-  if (pthread_create(&cthread, NULL, thread_function, NULL))
-  {
-    fprintf(stderr, "[-] Error creating thread\n");
-    perror("pthread");
-    return -1;
-  }
-  fprintf(stderr, "[+] Waiting for thread to start?\n");
-  // sleep(1);
-#endif
-  // run clflush2(addr_A);
-  // run clflush2(addr_B);
-  arm_v8_cache_flush(addr_A);
-  arm_v8_cache_flush(addr_B);
-
-  uint8_t *addr_A_ptr = reinterpret_cast<uint8_t *>(addr_A);
-  uint8_t *addr_B_ptr = reinterpret_cast<uint8_t *>(addr_B);
-
-  // Deleted part where Shubh first LDR's then evicts an address from cache
-  // (*addr_A_ptr);
-  // run clflush2(addr_A);
-  // arm_v8_cache_flush(addr_A);
-
-  // Credit: IAIK - ARMageddon Paper
-  // lfence();
-  arm_v8_memory_barrier();
-  
-  uint64_t t1 = 0;
-  uint64_t t2 = 0;
-  // Two ways of measuring timestamps: timestruct vs kernel of rdtscp
-#ifdef TIMING_PTHREAD
-  t1 = clk;
-#endif
-  // uint64_t start = rdtsc();
-
-  (*addr_A_ptr);
-  (*addr_B_ptr);
-
-  // lfence();
-  arm_v8_memory_barrier();
-#ifdef TIMING_PTHREAD
-  t2 = clk;
-#endif
-  // uint64_t end = rdtsc();
-
-#ifdef TIMING_PTHREAD
-  // Exit counter thread
-  // Code from SPECTRE.
-  terminate = 1;
-  if (pthread_join(cthread, NULL))
-  {
-    fprintf(stderr, "Error joining thread\n");
-    perror("join");
-    exit(1);
-  }
-#endif
-
-  return (uint64_t)t2 - t1;
-  // return (uint64_t) end - start;
-}
-
+#include "../output.hh"
+#include "../guard.hh"
+#include "../timer.hh"
+#include "../sweep.hh"
 
 int main(int argc, char **argv) {
-    setvbuf(stdout, NULL, _IONBF, 0);
-    uint64_t buffer_size_bytes = (uint64_t) BUFFER_SIZE_MB * (1024*1024);
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t buffer_size_bytes = config_buffer_bytes();
     allocated_mem = allocate_pages(buffer_size_bytes);
-    uint64_t* bank_lat_histogram = (uint64_t*) calloc((100+1), sizeof(uint64_t));
-    
-    const long int num_iterations = buffer_size_bytes / ROW_SIZE;
-    char *base = (char *)allocated_mem;
-    for (int i = 1; i < num_iterations; i++) {
-        uint64_t time = 0;
-        for (int j = 0; j < SAMPLES; j++) {
-            time += measure_latency_two_access((uint64_t)base, (uint64_t)(base + i * ROW_SIZE));
-        }
-        double avg_time = (double) ( time / (float) SAMPLES);
-        bank_lat_histogram[(int) (avg_time / 10)]++;
-    }
+
+    const long int num_iterations = buffer_size_bytes / config.row_size;
+    uint64_t max_pairs = config.pair_budget_pairs ? config.pair_budget_pairs : num_iterations - 1;
+    guard_init(&default_guard, config.prewarm ? measure_bank_latency_prewarm : measure_bank_latency);
+    struct latency_sweep sweep;
+    latency_sweep_init(&sweep, allocated_mem, buffer_size_bytes, config.pair_seed, max_pairs,
+                       config.conflict_latency, config.sample_budget);
+    // Every raw sample to config.trace_path, for replay
+    const char *trace_path = config.trace_path;
+    if (*trace_path)
+        latency_sweep_trace(&sweep, trace_path, "histogram");
+    latency_sweep_run(&sweep, "histogram");
+    latency_sweep_close(&sweep);
+    guard_report(&default_guard);
+    clock_report();
+    // compare converts the table to ns with this; the simulator has no clock
+    // service, so fall back to its tick rate like the trace writer does.
+    double epoch0_rate = clock_calibration_of(0).ticks_per_ns;
+    if (epoch0_rate <= 0)
+        epoch0_rate = timestamp_ticks_per_ns();
 
     //Modify Shubh's format
-    puts("HEADER,HEADER");
-    printf("Total Number of pairs, %ld\n", num_iterations);
+    output_printf("HEADER,HEADER\n");
+    output_printf("Total Number of pairs, %ld\n", num_iterations);
+    output_printf("Pair mode, %s\n", pair_mode_name(sweep.pairs.mode));
+    output_printf("Pair seed, %llu\n", (unsigned long long) config.pair_seed);
+    output_printf("Row order, %s\n", order_mode_name((enum order_mode) config.order));
+    output_printf("Order min distance, %llu\n", (unsigned long long) sweep.pairs.order.min_distance);
+    output_printf("Backing, %s\n", allocated_backing);
+    output_printf("TLB prewarm, %s\n", config.prewarm ? "yes" : "no");
+    output_printf("Pairs measured, %llu\n", (unsigned long long) sweep.sampler.pairs_done);
+    output_printf("Total samples, %llu\n", (unsigned long long) sweep.sampler.samples_taken);
+    output_printf("Ambiguous pairs, %llu\n", (unsigned long long) sweep.sampler.pairs_ambiguous);
+    uint64_t tried;
+    uint64_t rejected = latency_sweep_rejected(&sweep, &tried);
+    output_printf("Rejected samples, %llu\n", (unsigned long long) rejected);
+    output_printf("Reject rate, %.4f\n", tried ? (double) rejected / tried : 0.0);
+    output_printf("Clock epochs, %u\n", clock_epoch() + 1);
+    output_printf("Epoch 0 ticks per ns, %.4f\n", epoch0_rate);
+    output_printf("Max clock drift, %.4f\n", clock_max_drift());
+    output_printf("Trace, %s\n", sweep.trace.total_samples ? trace_path : "none");
+    config_print();
   
-    puts("TABLESTART,TABLESTART");
-    printf("UNIT,NS\n");
-    printf("TIMING-METHOD,POSIX\n");
-    printf("Timing-Unit,Number-of-Address-Pairs\n");
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("UNIT,NS\n");
+    output_printf("TIMING-METHOD,POSIX\n");
+    output_printf("Timing-Unit,Number-of-Address-Pairs\n");
     
 
     for (int i=0; i<100 ;i++){
-        printf("[%d-%d),%15llu\n",
-	    i*10, i*10 + 10, bank_lat_histogram[i]);
+        output_printf("[%d-%d),%15llu\n",
+	    i*10, i*10 + 10, (unsigned long long) sweep.histogram[i]);
+    }
+    output_printf("[%d),%15llu \n",100*10, (unsigned long long) sweep.histogram[100]);
+
+    if (sweep.pairs.mode == PAIRS_BITFLIP) {
+        output_printf("TABLESTART,TABLESTART\n");
+        output_printf("Flipped-Bit,Pairs,Conflict-Fraction\n");
+        for (unsigned bit = sweep.pairs.min_bit; bit < sweep.pairs.min_bit + sweep.pairs.num_bits; bit++) {
+            output_printf("%u,%llu,%.4f\n", bit, (unsigned long long) sweep.bit_pairs[bit],
+                sweep.bit_pairs[bit] ? (double) sweep.bit_conflicts[bit] / sweep.bit_pairs[bit] : 0.0);
+        }
     }
-    printf("[%d),%15llu \n",100*10, bank_lat_histogram[100]);
+    clock_service_stop();
+    output_shutdown();
 }
\ No newline at end of file
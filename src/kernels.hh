@@ -0,0 +1,148 @@
+#ifndef KERNELS_GUARD
+#define KERNELS_GUARD
+
+#include <stdint.h>
+#include <string.h>
+
+#include "params.hh"
+#include "util.hh"
+
+// Geometry-dependent inner loops.
+//
+// Row size and bank count are runtime settings (config.hh), but the loops
+// that walk a row or fold an address into a bank index run per hammered
+// victim and per simulated access. Each kernel is written once with its size
+// as a parameter and instantiated with the size as a constant for the common
+// geometries, where the compiler unrolls and vectorises it; a switch picks
+// the instance, and any other size takes the same code with the size left
+// at runtime.
+
+#define KERNEL_ALWAYS_INLINE inline __attribute__((always_inline))
+
+static KERNEL_ALWAYS_INLINE void flush_row_body(uint8_t *row, uint64_t size)
+{
+  for (uint64_t i = 0; i < size; i += PAIRS_LINE_SIZE)
+    arm_v8_cache_flush((uint64_t)(row + i));
+}
+
+// Bytes of row that are not pattern, a word at a time: a byte of x is
+// non-zero iff its high bit survives ((x & 0x7f..) + 0x7f..) | x.
+static KERNEL_ALWAYS_INLINE uint32_t count_changed_body(const uint8_t *row, uint64_t size, uint8_t pattern)
+{
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t low7 = 0x7f * ones, high = 0x80 * ones;
+  uint64_t expect = pattern * ones;
+  uint32_t changed = 0;
+  for (uint64_t i = 0; i < size; i += sizeof(uint64_t))
+  {
+    uint64_t w;
+    memcpy(&w, row + i, sizeof(w));
+    uint64_t x = w ^ expect;
+    changed += __builtin_popcountll((((x & low7) + low7) | x) & high);
+  }
+  return changed;
+}
+
+template <uint64_t RowSize>
+static void flush_row_fixed(uint8_t *row)
+{
+  flush_row_body(row, RowSize);
+}
+
+template <uint64_t RowSize>
+static void fill_row_fixed(uint8_t *row, uint8_t pattern)
+{
+  memset(row, pattern, RowSize);
+}
+
+template <uint64_t RowSize>
+static uint32_t count_changed_fixed(const uint8_t *row, uint8_t pattern)
+{
+  return count_changed_body(row, RowSize, pattern);
+}
+
+// Flushes every line of a row of size bytes.
+static inline void flush_row(uint8_t *row, uint64_t size)
+{
+  switch (size)
+  {
+  case 4096:
+    return flush_row_fixed<4096>(row);
+  case 8192:
+    return flush_row_fixed<8192>(row);
+  case 16384:
+    return flush_row_fixed<16384>(row);
+  default:
+    return flush_row_body(row, size);
+  }
+}
+
+// Sets a row of size bytes to pattern.
+static inline void fill_row(uint8_t *row, uint64_t size, uint8_t pattern)
+{
+  switch (size)
+  {
+  case 4096:
+    return fill_row_fixed<4096>(row, pattern);
+  case 8192:
+    return fill_row_fixed<8192>(row, pattern);
+  case 16384:
+    return fill_row_fixed<16384>(row, pattern);
+  default:
+    memset(row, pattern, size);
+  }
+}
+
+// Bytes of a row of size bytes (a multiple of 8) that differ from pattern.
+static inline uint32_t count_changed(const uint8_t *row, uint64_t size, uint8_t pattern)
+{
+  switch (size)
+  {
+  case 4096:
+    return count_changed_fixed<4096>(row, pattern);
+  case 8192:
+    return count_changed_fixed<8192>(row, pattern);
+  case 16384:
+    return count_changed_fixed<16384>(row, pattern);
+  default:
+    return count_changed_body(row, size, pattern);
+  }
+}
+
+// Index whose bit i is the parity of addr & masks[i], for n masks.
+static KERNEL_ALWAYS_INLINE unsigned parity_index_body(uint64_t addr, const uint64_t *masks, unsigned n)
+{
+  unsigned v = 0;
+  for (unsigned i = 0; i < n; i++)
+    v |= (unsigned)__builtin_parityll(addr & masks[i]) << i;
+  return v;
+}
+
+template <unsigned N>
+static unsigned parity_index_fixed(uint64_t addr, const uint64_t *masks)
+{
+  return parity_index_body(addr, masks, N);
+}
+
+// parity_index_body for up to 16 banks (and the channel and rank functions)
+// unrolled, anything wider through the loop.
+static inline unsigned parity_index(uint64_t addr, const uint64_t *masks, unsigned n)
+{
+  switch (n)
+  {
+  case 0:
+    return 0;
+  case 1:
+    return parity_index_fixed<1>(addr, masks);
+  case 2:
+    return parity_index_fixed<2>(addr, masks);
+  case 3:
+    return parity_index_fixed<3>(addr, masks);
+  case 4:
+    return parity_index_fixed<4>(addr, masks);
+  default:
+    return parity_index_body(addr, masks, n);
+  }
+}
+
+#endif
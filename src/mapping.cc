@@ -0,0 +1,330 @@
+#include "mapping.hh"
+#include "config.hh"
+#include "guard.hh"
+#include "kernels.hh"
+#include "output.hh"
+#include "sampler.hh"
+#include "shared.hh"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#define PAGEMAP_ENTRY (8)
+#define PAGEMAP_PRESENT (1ULL << 63)
+#define PAGEMAP_PFN_MASK ((1ULL << 55) - 1)
+
+static enum mapping_mode mode = MAPPING_INFERRED;
+static struct mapping_profile profile;
+static uint64_t buf_base;
+static uint64_t buf_size;
+static uint64_t page_size;
+
+// Pagemap backend: frame number of each page of the buffer, and back.
+static std::vector<uint64_t> page_pfn;
+static std::unordered_map<uint64_t, uint64_t> pfn_page;
+
+// Inferred backend: same-bank groups found so far. Each keeps up to two
+// members in different rows, so an address that shares a row with one of
+// them (and would time as a row hit either way) can use the other.
+struct bank_group
+{
+  uint64_t member[2];
+  int num_members;
+};
+static std::vector<struct bank_group> groups;
+static std::unordered_map<uint64_t, int> row_group; // Row-size slice of the buffer -> group
+static struct adaptive_sampler conflicts;
+
+void mapping_default_profile(struct mapping_profile *p)
+{
+  p->row_shift = config.row_bits;
+  p->num_channel_funcs = 0;
+  p->num_rank_funcs = 0;
+  p->num_bank_funcs = 0;
+  for (unsigned banks = config.num_banks; banks > 1 && p->num_bank_funcs < MAPPING_MAX_FUNCS; banks >>= 1)
+  {
+    unsigned i = p->num_bank_funcs++;
+    p->bank_masks[i] = (1ULL << (config.xor_bits + i)) | (1ULL << (config.row_bits + i));
+  }
+}
+
+unsigned mapping_profile_bank(const struct mapping_profile *p, uint64_t phys)
+{
+  unsigned channel = parity_index(phys, p->channel_masks, p->num_channel_funcs);
+  unsigned rank = parity_index(phys, p->rank_masks, p->num_rank_funcs);
+  unsigned bank = parity_index(phys, p->bank_masks, p->num_bank_funcs);
+  return (((channel << p->num_rank_funcs) | rank) << p->num_bank_funcs) | bank;
+}
+
+/*
+ * read_pagemap
+ *
+ * Fills page_pfn for the whole buffer in one read. Returns 0 if every page
+ * is present with a non-zero frame number, -1 otherwise (no pagemap, or
+ * frame numbers hidden from unprivileged processes since Linux 4.0).
+ */
+static int read_pagemap(void)
+{
+  int fd = open("/proc/self/pagemap", O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  uint64_t pages = (buf_size + page_size - 1) / page_size;
+  page_pfn.assign(pages, 0);
+  ssize_t want = (ssize_t)(pages * PAGEMAP_ENTRY);
+  ssize_t got = pread(fd, page_pfn.data(), want, (off_t)(buf_base / page_size * PAGEMAP_ENTRY));
+  close(fd);
+  if (got != want)
+    return -1;
+
+  pfn_page.clear();
+  for (uint64_t i = 0; i < pages; i++)
+  {
+    uint64_t entry = page_pfn[i];
+    uint64_t pfn = entry & PAGEMAP_PFN_MASK;
+    if (!(entry & PAGEMAP_PRESENT) || !pfn)
+      return -1;
+    page_pfn[i] = pfn;
+    pfn_page[pfn] = i;
+  }
+  return 0;
+}
+
+int mapping_init(enum mapping_mode requested, void *base, uint64_t size, const struct mapping_profile *p)
+{
+  buf_base = (uint64_t)base;
+  buf_size = size;
+  page_size = (uint64_t)getpagesize();
+  if (p)
+    profile = *p;
+  else
+    mapping_default_profile(&profile);
+
+  groups.clear();
+  row_group.clear();
+  page_pfn.clear();
+  pfn_page.clear();
+  sampler_init(&conflicts, config.conflict_latency, UINT64_MAX);
+
+  if (requested != MAPPING_INFERRED)
+  {
+    if (!read_pagemap())
+    {
+      mode = MAPPING_PAGEMAP;
+      output_log("[+] mapping: pagemap, %llu pages\n", (unsigned long long)page_pfn.size());
+      return mode;
+    }
+    page_pfn.clear();
+    pfn_page.clear();
+    if (requested == MAPPING_PAGEMAP)
+    {
+      output_log("[-] mapping: no frame numbers from /proc/self/pagemap (needs CAP_SYS_ADMIN)\n");
+      return -1;
+    }
+  }
+
+#ifndef MEASURE_SIM
+  // Simulated memory is contiguous; real memory only within its pages.
+  if (allocated_page_size < MAPPING_CONTIG_BYTES)
+  {
+    output_log("[-] mapping: inferred mode needs contiguous runs of %llu bytes, the buffer has %llu-byte %s pages "
+               "(rerun with --huge_pages=1)\n",
+               (unsigned long long)MAPPING_CONTIG_BYTES, (unsigned long long)allocated_page_size, allocated_backing);
+    return -1;
+  }
+#endif
+  mode = MAPPING_INFERRED;
+  output_log("[+] mapping: inferred, contiguous runs of %llu bytes\n", (unsigned long long)MAPPING_CONTIG_BYTES);
+  return mode;
+}
+
+enum mapping_mode mapping_current_mode(void)
+{
+  return mode;
+}
+
+const char *mapping_mode_name(enum mapping_mode m)
+{
+  switch (m)
+  {
+  case MAPPING_AUTO:
+    return "auto";
+  case MAPPING_PAGEMAP:
+    return "pagemap";
+  case MAPPING_INFERRED:
+    return "inferred";
+  default:
+    return "unknown";
+  }
+}
+
+uint64_t virt_to_phys(uint64_t virt_addr)
+{
+  uint64_t offset = virt_addr - buf_base;
+  if (mode == MAPPING_INFERRED)
+    return offset;
+  return page_pfn[offset / page_size] * page_size + offset % page_size;
+}
+
+uint64_t phys_to_virt(uint64_t phys_addr)
+{
+  if (mode == MAPPING_INFERRED)
+    return phys_addr < buf_size ? buf_base + phys_addr : 0;
+  auto it = pfn_page.find(phys_addr / page_size);
+  if (it == pfn_page.end())
+    return 0;
+  return buf_base + it->second * page_size + phys_addr % page_size;
+}
+
+uint64_t mapping_row_of(uint64_t virt_addr)
+{
+  return virt_to_phys(virt_addr) >> profile.row_shift;
+}
+
+// Median-based conflict test; ambiguous pairs get one more try.
+static int timed_conflict(uint64_t addr_A, uint64_t addr_B)
+{
+  struct pair_result res;
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    sampler_measure_pair(&conflicts, guard_measure_default, addr_A, addr_B, &res);
+    if (res.decision != PAIR_AMBIGUOUS)
+      return res.decision == PAIR_CONFLICT;
+  }
+  return 0;
+}
+
+/*
+ * assign_group
+ *
+ * Group of gs whose members time as a row conflict with virt_addr, or a new
+ * group holding it. -1 when none matches and gs already has max_groups.
+ */
+static int assign_group(std::vector<struct bank_group> &gs, uint64_t virt_addr, size_t max_groups)
+{
+  uint64_t row = mapping_row_of(virt_addr);
+  int found = -1;
+  for (size_t g = 0; g < gs.size() && found < 0; g++)
+  {
+    for (int m = 0; m < gs[g].num_members; m++)
+    {
+      if (mapping_row_of(gs[g].member[m]) == row)
+        continue;
+      if (timed_conflict(gs[g].member[m], virt_addr))
+        found = (int)g;
+      break;
+    }
+  }
+
+  if (found < 0)
+  {
+    if (gs.size() >= max_groups)
+      return -1;
+    struct bank_group g = {{virt_addr, 0}, 1};
+    gs.push_back(g);
+    return (int)gs.size() - 1;
+  }
+  if (gs[found].num_members < 2 && mapping_row_of(gs[found].member[0]) != row)
+    gs[found].member[gs[found].num_members++] = virt_addr;
+  return found;
+}
+
+static int inferred_bank_of(uint64_t virt_addr)
+{
+  // Groups are per row-size slice: slices of one row may sit in different banks.
+  uint64_t key = (virt_addr - buf_base) / config.row_size;
+  auto it = row_group.find(key);
+  if (it != row_group.end())
+    return it->second;
+
+  int found = assign_group(groups, virt_addr, MAPPING_MAX_GROUPS);
+  if (found >= 0)
+    row_group[key] = found;
+  return found;
+}
+
+int mapping_timed_banks(const uint64_t *addrs, int n, int *group_of, uint64_t *reps, int max_reps)
+{
+  std::vector<struct bank_group> gs;
+  for (int i = 0; i < n; i++)
+    group_of[i] = assign_group(gs, addrs[i], (size_t)max_reps);
+  for (size_t g = 0; g < gs.size(); g++)
+    reps[g] = gs[g].member[0];
+  return (int)gs.size();
+}
+
+int mapping_bank_of(uint64_t virt_addr)
+{
+  if (mode == MAPPING_INFERRED)
+    return inferred_bank_of(virt_addr);
+  return (int)mapping_profile_bank(&profile, virt_to_phys(virt_addr));
+}
+
+/*
+ * find_in_row
+ *
+ * Candidate addresses in row target keep the victim's offset except for the
+ * bits between the row size and the row shift, which select the bank within a
+ * row on every mapping this code has met. The pagemap backend checks
+ * candidates against the profile, the inferred one by timing a conflict with
+ * the victim, and only inside the victim's contiguous run.
+ */
+static uint64_t find_in_row(uint64_t victim, uint64_t victim_phys, uint64_t target)
+{
+  uint64_t row_bytes = 1ULL << profile.row_shift;
+  uint64_t low = victim_phys & (row_bytes - 1);
+  unsigned bank = 0;
+  if (mode == MAPPING_PAGEMAP)
+    bank = mapping_profile_bank(&profile, victim_phys);
+
+  for (uint64_t slice = 0; slice < row_bytes; slice += config.row_size)
+  {
+    uint64_t phys = (target << profile.row_shift) | (low ^ slice);
+    if (mode == MAPPING_INFERRED)
+    {
+      if (phys / MAPPING_CONTIG_BYTES != victim_phys / MAPPING_CONTIG_BYTES)
+        return 0;
+    }
+    else if (mapping_profile_bank(&profile, phys) != bank)
+    {
+      continue;
+    }
+
+    uint64_t virt = phys_to_virt(phys);
+    if (!virt)
+      continue;
+    if (mode == MAPPING_PAGEMAP || timed_conflict(victim, virt))
+      return virt;
+  }
+  return 0;
+}
+
+uint64_t mapping_row_above(uint64_t virt_addr, uint64_t row_diff)
+{
+  uint64_t phys = virt_to_phys(virt_addr);
+  return find_in_row(virt_addr, phys, (phys >> profile.row_shift) + row_diff);
+}
+
+int mapping_aggressors(uint64_t victim, int row_diff, uint64_t *attacker_1, uint64_t *attacker_2)
+{
+  uint64_t phys = virt_to_phys(victim);
+  uint64_t row = phys >> profile.row_shift;
+  if (row < (uint64_t)row_diff)
+    return 0;
+
+  *attacker_1 = find_in_row(victim, phys, row + row_diff);
+  *attacker_2 = find_in_row(victim, phys, row - row_diff);
+  return *attacker_1 != 0 && *attacker_2 != 0;
+}
+
+void mapping_report(void)
+{
+  size_t banks = (size_t)1 << (profile.num_channel_funcs + profile.num_rank_funcs + profile.num_bank_funcs);
+  if (mode == MAPPING_INFERRED)
+    banks = groups.size();
+  output_log("[+] mapping: %s, %zu bank groups, %llu timing samples over %llu pairs\n", mapping_mode_name(mode), banks,
+             (unsigned long long)conflicts.samples_taken, (unsigned long long)conflicts.pairs_done);
+}
@@ -0,0 +1,112 @@
+#ifndef MAPPING_GUARD
+#define MAPPING_GUARD
+
+#include <stdint.h>
+
+#include "params.hh"
+
+// Virtual address to DRAM (bank, row) mapping for the hammering pipeline.
+//
+// Two backends answer the same questions, which bank group an address is in,
+// its row index, and which addresses are its aggressors:
+//   - pagemap: physical addresses from /proc/self/pagemap, with bank and row
+//     from the address functions of a mapping_profile.
+//   - inferred: no physical addresses (macOS, or Linux without
+//     CAP_SYS_ADMIN). The buffer is assumed physically contiguous in aligned
+//     runs of MAPPING_CONTIG_BYTES, so an address's offset into the buffer
+//     stands in for its physical address: row order is exact inside a run and
+//     meaningless across runs. The buffer must come from allocate_pages with
+//     pages at least that large (config.huge_pages). Same-bank groups and aggressors are found by
+//     timing: a row conflict between two rows means one bank.
+
+enum mapping_mode
+{
+  MAPPING_AUTO = 0,     // Pagemap if it yields frame numbers, else inferred
+  MAPPING_PAGEMAP = 1,
+  MAPPING_INFERRED = 2,
+};
+
+// DRAM address functions: each channel, rank and bank index bit is the
+// parity of the physical address under one mask; the row is addr >> row_shift.
+struct mapping_profile
+{
+  unsigned row_shift;
+  unsigned num_channel_funcs;
+  unsigned num_rank_funcs;
+  unsigned num_bank_funcs;
+  uint64_t channel_masks[MAPPING_MAX_FUNCS];
+  uint64_t rank_masks[MAPPING_MAX_FUNCS];
+  uint64_t bank_masks[MAPPING_MAX_FUNCS];
+};
+
+// Profile from config.row_bits, xor_bits and num_banks: bank bit i is
+// address bit xor_bits + i XOR row bit i; one channel, one rank.
+void mapping_default_profile(struct mapping_profile *p);
+
+// Flat (channel, rank, bank) index of a physical address under p.
+unsigned mapping_profile_bank(const struct mapping_profile *p, uint64_t phys);
+
+/*
+ * mapping_init
+ *
+ * Sets up the backend for a buffer. Pages must already be touched so that
+ * pagemap reports them present.
+ *
+ * Inputs: mode - One of enum mapping_mode
+ *         base/size - The buffer
+ *         profile - Address functions for the pagemap backend, NULL for the
+ *                   default profile
+ * Returns: The mode in use (never MAPPING_AUTO), or -1 if mode cannot be
+ *          honoured (MAPPING_PAGEMAP without frame numbers, or inferred
+ *          with pages smaller than MAPPING_CONTIG_BYTES)
+ */
+int mapping_init(enum mapping_mode mode, void *base, uint64_t size, const struct mapping_profile *profile);
+
+enum mapping_mode mapping_current_mode(void);
+const char *mapping_mode_name(enum mapping_mode mode);
+
+// Physical address of virt; in inferred mode its offset into the buffer.
+uint64_t virt_to_phys(uint64_t virt_addr);
+// Inverse of virt_to_phys, 0 if the address is not in the buffer.
+uint64_t phys_to_virt(uint64_t phys_addr);
+
+// Row index of virt. In inferred mode rows only compare within one run.
+uint64_t mapping_row_of(uint64_t virt_addr);
+
+// Bank group of virt: the flat bank index with pagemap, a group number
+// assigned by timing when inferred. -1 if no group could be assigned.
+int mapping_bank_of(uint64_t virt_addr);
+
+/*
+ * mapping_timed_banks
+ *
+ * Clusters addresses into banks by timing alone, whatever the backend: an
+ * address joins the first group whose member it row-conflicts with. Used
+ * where the profile cannot be trusted to tell banks apart (channel discovery).
+ *
+ * Outputs: group_of - Group of each address, -1 if max_reps groups were full
+ *          reps - First member of each group
+ * Returns: Number of groups
+ */
+int mapping_timed_banks(const uint64_t *addrs, int n, int *group_of, uint64_t *reps, int max_reps);
+
+/*
+ * mapping_aggressors
+ *
+ * Finds the addresses row_diff rows above and below victim in the victim's
+ * bank, at the same column where the mapping allows.
+ *
+ * Outputs: attacker_1/attacker_2 - Virtual addresses of rows +row_diff/-row_diff
+ * Returns: 1 on success, 0 if either row is outside the buffer (or, inferred,
+ *          outside the victim's contiguous run) or no same-bank address was found
+ */
+int mapping_aggressors(uint64_t victim, int row_diff, uint64_t *attacker_1, uint64_t *attacker_2);
+
+// Address row_diff rows above virt_addr in its bank, found as for
+// mapping_aggressors, or 0.
+uint64_t mapping_row_above(uint64_t virt_addr, uint64_t row_diff);
+
+// Timing measurements spent by the inferred backend, groups found.
+void mapping_report(void);
+
+#endif
@@ -0,0 +1,368 @@
+#include "output.hh"
+#include "params.hh"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// One SPSC ring per stream. head is only written by the producer, tail only
+// by whoever currently holds drain_lock (the writer thread, or a signal
+// handler on another thread). Both are kept on their own cache lines so the
+// writer polling tail does not bounce the producer's line. OUT_LOG has many
+// producers; they take turns under produce_lock.
+struct output_ring
+{
+  char *buf;
+  int fd;
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<int> produce_lock;
+};
+
+static struct output_ring rings[OUT_NUM_STREAMS];
+static std::atomic<int> drain_lock(0);
+static std::atomic<int> writer_running(0);
+static std::atomic<int> flush_requested(0);
+static int output_active = 0;
+static pthread_t writer_thread;
+
+static const int flush_signals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    buf += n;
+    len -= n;
+  }
+}
+
+/*
+ * drain_ring
+ *
+ * Writes everything between tail and head to the ring's fd.
+ * Caller must hold drain_lock.
+ */
+static void drain_ring(struct output_ring *r)
+{
+  uint64_t tail = r->tail.load(std::memory_order_relaxed);
+  uint64_t head = r->head.load(std::memory_order_acquire);
+
+  if (r->fd < 0)
+  {
+    // No sink: drop what was queued.
+    r->tail.store(head, std::memory_order_release);
+    return;
+  }
+
+  while (tail != head)
+  {
+    uint64_t offset = tail & (OUTPUT_RING_SIZE - 1);
+    uint64_t chunk = head - tail;
+    if (chunk > OUTPUT_RING_SIZE - offset)
+      chunk = OUTPUT_RING_SIZE - offset;
+
+    write_all(r->fd, r->buf + offset, chunk);
+    tail += chunk;
+    r->tail.store(tail, std::memory_order_release);
+  }
+}
+
+static void lock_drain(void)
+{
+  int expected = 0;
+  while (!drain_lock.compare_exchange_weak(expected, 1, std::memory_order_acquire))
+  {
+    expected = 0;
+    sched_yield();
+  }
+}
+
+static void drain_all(void)
+{
+  lock_drain();
+  for (int s = 0; s < OUT_NUM_STREAMS; s++)
+    drain_ring(&rings[s]);
+  drain_lock.store(0, std::memory_order_release);
+}
+
+static uint64_t pending_bytes(struct output_ring *r)
+{
+  return r->head.load(std::memory_order_acquire) - r->tail.load(std::memory_order_relaxed);
+}
+
+static void *writer_function(void *x_void_ptr)
+{
+  // Signals are handled on the other threads, so a handler can never end up
+  // spinning on a drain_lock held by the thread it interrupted.
+  sigset_t set;
+  sigemptyset(&set);
+  for (size_t i = 0; i < sizeof(flush_signals) / sizeof(flush_signals[0]); i++)
+    sigaddset(&set, flush_signals[i]);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  int idle_polls = 0;
+  while (writer_running.load(std::memory_order_acquire))
+  {
+    int full = 0;
+    for (int s = 0; s < OUT_NUM_STREAMS; s++)
+      full |= pending_bytes(&rings[s]) >= OUTPUT_BLOCK_SIZE;
+
+    if (full || flush_requested.load(std::memory_order_acquire) || ++idle_polls >= OUTPUT_IDLE_POLLS)
+    {
+      drain_all();
+      flush_requested.store(0, std::memory_order_release);
+      idle_polls = 0;
+      continue;
+    }
+    usleep(OUTPUT_POLL_US);
+  }
+
+  drain_all();
+  return NULL;
+}
+
+static void flush_signal_handler(int sig)
+{
+  // Only write(2) and atomics here; both are async-signal-safe.
+  drain_all();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+// fork(): hold drain_lock across it so the child never inherits it taken,
+// with the rings drained so nothing queued before the fork is written twice.
+// Only the forking thread survives in the child, so it gets a writer of its
+// own on the same rings and sinks.
+static void fork_prepare(void)
+{
+  if (!output_active)
+    return;
+  lock_drain();
+  for (int s = 0; s < OUT_NUM_STREAMS; s++)
+    drain_ring(&rings[s]);
+}
+
+static void fork_parent(void)
+{
+  if (output_active)
+    drain_lock.store(0, std::memory_order_release);
+}
+
+static void fork_child(void)
+{
+  if (!output_active)
+    return;
+  drain_lock.store(0, std::memory_order_release);
+  flush_requested.store(0);
+  writer_running.store(1);
+  if (pthread_create(&writer_thread, NULL, writer_function, NULL))
+    output_active = 0;
+}
+
+void output_init(const char *result_path)
+{
+  if (output_active)
+    return;
+
+  int result_fd = STDOUT_FILENO;
+  if (result_path)
+  {
+    result_fd = open(result_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (result_fd < 0)
+    {
+      perror("open");
+      exit(1);
+    }
+  }
+
+  int fds[OUT_NUM_STREAMS] = {result_fd, STDERR_FILENO, -1};
+  for (int s = 0; s < OUT_NUM_STREAMS; s++)
+  {
+    rings[s].buf = (char *)malloc(OUTPUT_RING_SIZE);
+    if (!rings[s].buf)
+    {
+      perror("malloc");
+      exit(1);
+    }
+    rings[s].fd = fds[s];
+    rings[s].head.store(0);
+    rings[s].tail.store(0);
+  }
+
+  // Anything already sitting in stdio buffers goes out first.
+  fflush(stdout);
+  fflush(stderr);
+
+  writer_running.store(1);
+  if (pthread_create(&writer_thread, NULL, writer_function, NULL))
+  {
+    fprintf(stderr, "[-] Error creating output writer thread\n");
+    perror("pthread");
+    exit(1);
+  }
+  output_active = 1;
+
+  for (size_t i = 0; i < sizeof(flush_signals) / sizeof(flush_signals[0]); i++)
+    signal(flush_signals[i], flush_signal_handler);
+  atexit(output_shutdown);
+
+  static int atfork_installed = 0;
+  if (!atfork_installed)
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+  atfork_installed = 1;
+}
+
+int output_open_sink(int stream, const char *path)
+{
+  if (!output_active)
+  {
+    fprintf(stderr, "[-] output_open_sink before output_init\n");
+    return -1;
+  }
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    perror("open");
+    return -1;
+  }
+
+  lock_drain();
+  struct output_ring *r = &rings[stream];
+  drain_ring(r);
+  if (r->fd > STDERR_FILENO)
+    close(r->fd);
+  r->fd = fd;
+  drain_lock.store(0, std::memory_order_release);
+  return 0;
+}
+
+void output_write(int stream, const char *buf, size_t len)
+{
+  if (!output_active)
+  {
+    if (stream == OUT_TRACE)
+      return;
+    fwrite(buf, 1, len, stream == OUT_RESULT ? stdout : stderr);
+    return;
+  }
+
+  struct output_ring *r = &rings[stream];
+  int shared = stream == OUT_LOG;
+  if (shared)
+  {
+    int expected = 0;
+    while (!r->produce_lock.compare_exchange_weak(expected, 1, std::memory_order_acquire))
+    {
+      expected = 0;
+      sched_yield();
+    }
+  }
+  uint64_t head = r->head.load(std::memory_order_relaxed);
+
+  while (len > 0)
+  {
+    uint64_t used = head - r->tail.load(std::memory_order_acquire);
+    if (used == OUTPUT_RING_SIZE)
+    {
+      // Writer is behind; never drop results, wait for it instead.
+      flush_requested.store(1, std::memory_order_release);
+      sched_yield();
+      continue;
+    }
+
+    uint64_t offset = head & (OUTPUT_RING_SIZE - 1);
+    uint64_t chunk = OUTPUT_RING_SIZE - used;
+    if (chunk > OUTPUT_RING_SIZE - offset)
+      chunk = OUTPUT_RING_SIZE - offset;
+    if (chunk > len)
+      chunk = len;
+
+    memcpy(r->buf + offset, buf, chunk);
+    head += chunk;
+    buf += chunk;
+    len -= chunk;
+    r->head.store(head, std::memory_order_release);
+  }
+  if (shared)
+    r->produce_lock.store(0, std::memory_order_release);
+}
+
+static void output_vprintf(int stream, const char *fmt, va_list ap)
+{
+  char line[OUTPUT_LINE_MAX];
+  int n = vsnprintf(line, sizeof(line), fmt, ap);
+  if (n < 0)
+    return;
+  if ((size_t)n >= sizeof(line))
+    n = sizeof(line) - 1;
+  output_write(stream, line, n);
+}
+
+void output_printf(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  output_vprintf(OUT_RESULT, fmt, ap);
+  va_end(ap);
+}
+
+void output_log(const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  output_vprintf(OUT_LOG, fmt, ap);
+  va_end(ap);
+}
+
+void output_flush(void)
+{
+  if (!output_active)
+  {
+    fflush(stdout);
+    fflush(stderr);
+    return;
+  }
+
+  flush_requested.store(1, std::memory_order_release);
+  for (int s = 0; s < OUT_NUM_STREAMS; s++)
+  {
+    while (pending_bytes(&rings[s]) != 0)
+      sched_yield();
+  }
+}
+
+void output_shutdown(void)
+{
+  if (!output_active)
+    return;
+
+  writer_running.store(0, std::memory_order_release);
+  pthread_join(writer_thread, NULL);
+  output_active = 0;
+
+  if (rings[OUT_RESULT].fd != STDOUT_FILENO)
+    close(rings[OUT_RESULT].fd);
+  if (rings[OUT_TRACE].fd >= 0)
+    close(rings[OUT_TRACE].fd);
+  for (int s = 0; s < OUT_NUM_STREAMS; s++)
+  {
+    free(rings[s].buf);
+    rings[s].buf = NULL;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef OUTPUT_GUARD
+#define OUTPUT_GUARD
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Asynchronous output layer.
+//
+// Results and log lines are formatted by the measuring thread into a
+// lock-free single-producer/single-consumer ring, and a background writer
+// thread drains the ring to its sink in large blocks. That keeps write(2)
+// (and the cache traffic of stdio) out of the timed loops.
+//
+// OUT_RESULT and OUT_TRACE have exactly one producer: the thread that runs
+// the sweep. OUT_LOG takes lines from any thread (telemetry reporter, clock
+// calibrator, ...): each write holds a short producer lock, so lines are
+// never interleaved. Log from the timed loops sparingly.
+
+enum output_stream
+{
+  OUT_RESULT = 0, // Measurement results: stdout or a file
+  OUT_LOG = 1,    // Diagnostics: stderr
+  OUT_TRACE = 2,  // Binary sample trace (trace.hh): a file from output_open_sink, else dropped
+  OUT_NUM_STREAMS
+};
+
+/*
+ * output_init
+ *
+ * Starts the writer thread and installs the exit and signal flush hooks.
+ *
+ * Inputs: result_path - File to write results to, or NULL for stdout
+ * Outputs: none
+ */
+void output_init(const char *result_path);
+
+/*
+ * output_open_sink
+ *
+ * Points a stream at a file, truncating it. Meant for OUT_TRACE; call it
+ * after output_init and before anything is written to the stream. Whatever
+ * was queued for the old sink is flushed to it first.
+ *
+ * Inputs: stream - One of enum output_stream
+ *         path - File to write the stream to
+ * Returns: 0 on success, -1 if the file could not be opened
+ */
+int output_open_sink(int stream, const char *path);
+
+// Append raw bytes / a formatted line to a stream.
+void output_write(int stream, const char *buf, size_t len);
+void output_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void output_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Block until everything queued so far has reached the sinks.
+void output_flush(void);
+
+// Flush and stop the writer thread. Also runs from atexit().
+void output_shutdown(void);
+
+#endif
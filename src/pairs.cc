@@ -0,0 +1,208 @@
+#include "pairs.hh"
+#include "params.hh"
+
+#include <algorithm>
+#include <time.h>
+
+static double monotonic_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned log2_floor(uint64_t x)
+{
+  unsigned bits = 0;
+  while (x >>= 1)
+    bits++;
+  return bits;
+}
+
+// Circular distance between rows visited within ORDER_WINDOW steps.
+static uint64_t window_distance(uint64_t mult, uint64_t n)
+{
+  uint64_t best = n, x = 0;
+  for (int k = 1; k <= ORDER_WINDOW && (uint64_t)k < n; k++)
+  {
+    x = (x + mult) % n;
+    best = std::min(best, std::min(x, n - x));
+  }
+  return best;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+  while (b)
+  {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+int sweep_order_init(struct sweep_order *o, enum order_mode mode, uint64_t n, uint64_t seed, uint64_t min_distance)
+{
+  o->n = n ? n : 1;
+  o->mult = 1;
+  o->offset = 0;
+  o->min_distance = 1;
+  if (mode != ORDER_PERMUTED || n < 3)
+    return 0;
+
+  std::mt19937_64 rng(seed);
+  o->offset = rng() % n;
+  uint64_t golden = (uint64_t)((double)n * 0.6180339887498949);
+  uint64_t jitter = n / 64 + 1;
+  o->min_distance = 0;
+  for (int t = 0; t < ORDER_TRIES; t++)
+  {
+    // The first try is the golden multiplier itself, later ones nearby.
+    uint64_t mult = t ? golden - jitter + rng() % (2 * jitter + 1) : golden;
+    mult = std::max<uint64_t>(1, std::min(mult, n - 1));
+    while (gcd(mult, n) != 1)
+      mult = mult % (n - 1) + 1;
+    uint64_t d = window_distance(mult, n);
+    if (d > o->min_distance)
+    {
+      o->mult = mult;
+      o->min_distance = d;
+    }
+    if (o->min_distance >= min_distance)
+      return 0;
+  }
+  return -1;
+}
+
+const char *order_mode_name(enum order_mode mode)
+{
+  switch (mode)
+  {
+  case ORDER_SEQUENTIAL:
+    return "sequential";
+  case ORDER_PERMUTED:
+    return "permuted";
+  }
+  return "unknown";
+}
+
+void pair_sampler_init(struct pair_sampler *ps, enum pair_mode mode, void *base, uint64_t size, uint64_t stride,
+                       uint64_t seed, uint64_t max_pairs, double max_seconds)
+{
+  ps->mode = mode;
+  ps->base = (uint64_t)base;
+  ps->size = size;
+  ps->stride = stride;
+  ps->num_rows = size / stride;
+  ps->rng.seed(seed);
+
+  ps->max_pairs = max_pairs;
+  ps->max_seconds = max_seconds;
+  ps->start_sec = monotonic_sec();
+  ps->emitted = 0;
+
+  ps->cursor = 1;
+  sweep_order_init(&ps->order, ORDER_SEQUENTIAL, ps->num_rows - 1, seed, 0);
+  ps->min_bit = PAIRS_BITFLIP_MIN_BIT;
+  ps->num_bits = log2_floor(size) - PAIRS_BITFLIP_MIN_BIT;
+  ps->last_bit = 0;
+
+  ps->win_rows = PAIRS_WINDOW_ROWS < ps->num_rows ? PAIRS_WINDOW_ROWS : ps->num_rows;
+  ps->win_start = 0;
+  ps->win_i = 0;
+  ps->win_j = 0;
+  if (mode == PAIRS_WINDOW)
+    ps->win_start = ps->rng() % (ps->num_rows - ps->win_rows + 1);
+}
+
+int pair_sampler_next(struct pair_sampler *ps, uint64_t *addr_A, uint64_t *addr_B)
+{
+  if (ps->max_pairs && ps->emitted >= ps->max_pairs)
+    return 0;
+  // Reading the clock every pair would cost more than some measurements.
+  if (ps->max_seconds > 0 && (ps->emitted & 255) == 0 && monotonic_sec() - ps->start_sec >= ps->max_seconds)
+    return 0;
+
+  uint64_t a, b;
+  switch (ps->mode)
+  {
+  case PAIRS_BASE:
+    if (ps->cursor >= ps->num_rows)
+      return 0;
+    a = 0;
+    b = (1 + sweep_order_at(&ps->order, ps->cursor++ - 1)) * ps->stride;
+    break;
+
+  case PAIRS_UNIFORM:
+  {
+    uint64_t i = ps->rng() % ps->num_rows;
+    uint64_t j = ps->rng() % (ps->num_rows - 1);
+    if (j >= i)
+      j++;
+    a = i * ps->stride;
+    b = j * ps->stride;
+    break;
+  }
+
+  case PAIRS_BITFLIP:
+    ps->last_bit = ps->min_bit + (unsigned)(ps->emitted % ps->num_bits);
+    do
+    {
+      a = (ps->rng() % (ps->size / PAIRS_LINE_SIZE)) * PAIRS_LINE_SIZE;
+      b = a ^ (1ULL << ps->last_bit);
+    } while (b >= ps->size);
+    break;
+
+  case PAIRS_WINDOW:
+    if (++ps->win_j >= ps->win_rows)
+    {
+      if (++ps->win_i >= ps->win_rows - 1)
+      {
+        ps->win_start = ps->rng() % (ps->num_rows - ps->win_rows + 1);
+        ps->win_i = 0;
+      }
+      ps->win_j = ps->win_i + 1;
+    }
+    a = (ps->win_start + ps->win_i) * ps->stride;
+    b = (ps->win_start + ps->win_j) * ps->stride;
+    break;
+
+  default:
+    return 0;
+  }
+
+  *addr_A = ps->base + a;
+  *addr_B = ps->base + b;
+  ps->emitted++;
+  return 1;
+}
+
+int pair_sampler_set_order(struct pair_sampler *ps, enum order_mode mode, uint64_t seed, uint64_t min_distance)
+{
+  return sweep_order_init(&ps->order, mode, ps->num_rows - 1, seed, min_distance);
+}
+
+uint64_t pair_sampler_expected(const struct pair_sampler *ps)
+{
+  uint64_t n = ps->mode == PAIRS_BASE ? ps->num_rows - 1 : 0;
+  if (ps->max_pairs && (n == 0 || ps->max_pairs < n))
+    n = ps->max_pairs;
+  return n;
+}
+
+const char *pair_mode_name(enum pair_mode mode)
+{
+  switch (mode)
+  {
+  case PAIRS_BASE:
+    return "base";
+  case PAIRS_UNIFORM:
+    return "uniform";
+  case PAIRS_BITFLIP:
+    return "bitflip";
+  case PAIRS_WINDOW:
+    return "window";
+  }
+  return "unknown";
+}
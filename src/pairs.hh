@@ -0,0 +1,115 @@
+#ifndef PAIRS_GUARD
+#define PAIRS_GUARD
+
+#include <random>
+#include <stdint.h>
+
+// Address pair sampler for latency sweeps.
+//
+// All modes draw from a seeded PRNG so a run can be reproduced exactly, and
+// stop at whichever of the pair or wall-clock budget is hit first.
+
+enum pair_mode
+{
+  PAIRS_BASE = 0,    // Row 0 against every other row (the original sweep)
+  PAIRS_UNIFORM = 1, // Two distinct rows drawn uniformly from the buffer
+  PAIRS_BITFLIP = 2, // Random line and the same line with exactly one address bit flipped,
+                     // cycling through the bits so every bit gets the same number of pairs
+  PAIRS_WINDOW = 3,  // Every pair of rows within a window of PAIRS_WINDOW_ROWS rows,
+                     // then the next window at a random offset
+};
+
+enum order_mode
+{
+  ORDER_SEQUENTIAL = 0, // Rows in address order
+  ORDER_PERMUTED = 1,   // Prefetch-safe permutation (see struct sweep_order)
+};
+
+// Visiting order of n rows, computed on demand: row i of the sweep is
+// (mult * i + offset) mod n, a permutation whenever mult and n are coprime.
+// Consecutive rows are always mult (or n - mult) rows apart, and rows k steps
+// apart k * mult, so the multiplier is picked, near n / phi, to keep every
+// row visited within ORDER_WINDOW steps at least min_distance rows away.
+// With the golden ratio the address deltas alternate between two values in
+// a Fibonacci pattern that never repeats one delta three times, so a stride
+// prefetcher that has just confirmed a delta always mispredicts the next.
+struct sweep_order
+{
+  uint64_t n;
+  uint64_t mult;
+  uint64_t offset;
+  uint64_t min_distance; // Achieved over ORDER_WINDOW steps, rows
+};
+
+/*
+ * sweep_order_init
+ *
+ * Inputs: mode - One of enum order_mode
+ *         n - Rows to visit
+ *         seed - Picks the offset and perturbs the multiplier
+ *         min_distance - Requested distance, rows (ORDER_PERMUTED)
+ * Outputs: o - The order
+ * Returns: 0, or -1 if no multiplier tried reached min_distance (o then
+ *          holds the best one)
+ */
+int sweep_order_init(struct sweep_order *o, enum order_mode mode, uint64_t n, uint64_t seed, uint64_t min_distance);
+
+// Row visited at step i < n.
+static inline uint64_t sweep_order_at(const struct sweep_order *o, uint64_t i)
+{
+  return (uint64_t)(((unsigned __int128)o->mult * i + o->offset) % o->n);
+}
+
+const char *order_mode_name(enum order_mode mode);
+
+struct pair_sampler
+{
+  enum pair_mode mode;
+  uint64_t base;
+  uint64_t size;
+  uint64_t stride;
+  uint64_t num_rows;
+  std::mt19937_64 rng;
+
+  uint64_t max_pairs;  // 0: no pair budget
+  double max_seconds;  // 0: no time budget
+  double start_sec;
+  uint64_t emitted;
+
+  uint64_t cursor;     // PAIRS_BASE: next row
+  struct sweep_order order; // PAIRS_BASE: order of rows 1..num_rows-1
+  unsigned min_bit;    // PAIRS_BITFLIP: lowest and number of flipped bits
+  unsigned num_bits;
+  unsigned last_bit;   // PAIRS_BITFLIP: bit flipped in the last pair
+  uint64_t win_start;  // PAIRS_WINDOW: first row of the window, and the
+  uint64_t win_rows;   // current (i, j) inside it
+  uint64_t win_i;
+  uint64_t win_j;
+};
+
+/*
+ * pair_sampler_init
+ *
+ * Inputs: mode - One of enum pair_mode
+ *         base/size - Buffer the pairs are drawn from
+ *         stride - Row size; PAIRS_BASE/UNIFORM/WINDOW pick row-aligned addresses
+ *         seed - PRNG seed
+ *         max_pairs/max_seconds - Hard budget, 0 for none
+ * Outputs: ps - Initialised sampler
+ */
+void pair_sampler_init(struct pair_sampler *ps, enum pair_mode mode, void *base, uint64_t size, uint64_t stride,
+                       uint64_t seed, uint64_t max_pairs, double max_seconds);
+
+// Visits PAIRS_BASE rows in mode's order instead of address order.
+int pair_sampler_set_order(struct pair_sampler *ps, enum order_mode mode, uint64_t seed, uint64_t min_distance);
+
+// Next pair, or 0 once the mode is exhausted or a budget is hit.
+int pair_sampler_next(struct pair_sampler *ps, uint64_t *addr_A, uint64_t *addr_B);
+
+// Pairs the sampler will produce at most (the pair budget, or the mode's
+// own size for PAIRS_BASE). Used for progress reporting.
+uint64_t pair_sampler_expected(const struct pair_sampler *ps);
+
+const char *pair_mode_name(enum pair_mode mode);
+
+#endif
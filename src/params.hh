@@ -11,6 +11,478 @@
 #define BUFFER_SIZE_MB 2048ULL
 #endif
 
+// Size of each asynchronous output ring in bytes (must be a power of two)
+#ifndef OUTPUT_RING_SIZE
+#define OUTPUT_RING_SIZE (1ULL << 20)
+#endif
+
+// Writer thread drains a ring as soon as this many bytes are pending
+#define OUTPUT_BLOCK_SIZE (64 * 1024)
+
+// Writer thread poll period, and idle polls before draining a partial block
+#define OUTPUT_POLL_US (1000)
+#define OUTPUT_IDLE_POLLS (100)
+
+// Longest single formatted output line
+#define OUTPUT_LINE_MAX (512)
+
+// Seconds between live telemetry reports on stderr
+#ifndef TELEMETRY_INTERVAL_SEC
+#define TELEMETRY_INTERVAL_SEC (10)
+#endif
+
+// Optional CSV file receiving the same telemetry reports (NULL: none)
+#ifndef TELEMETRY_PATH
+#define TELEMETRY_PATH NULL
+#endif
+
+// Maximum number of threads reporting telemetry counters
+#define TELEMETRY_MAX_THREADS (64)
+
+// Adaptive sampling: every pair gets at least MIN and at most MAX samples, and
+// stops once (#above threshold - #below threshold) reaches SIGN_MARGIN.
+// A margin of 4 is the SPRT boundary for p=0.8 vs p=0.2 at 1% error rates.
+#define ADAPTIVE_MIN_SAMPLES (5)
+#define ADAPTIVE_MAX_SAMPLES (64)
+#define ADAPTIVE_SIGN_MARGIN (4)
+
+// Global sample budget per sweep, in samples (0: rows * SAMPLES, the cost
+// of the old fixed-count sweep)
+#ifndef ADAPTIVE_SAMPLE_BUDGET
+#define ADAPTIVE_SAMPLE_BUDGET (0)
+#endif
+
+// Disturbed samples (migrated, preempted or a gap) are retried this often
+#define GUARD_MAX_RETRIES (4)
+
+// Gap detection: samples more than GUARD_GAP_DEVIATIONS mean absolute
+// deviations above the running mean are rejected, once GUARD_WARMUP_SAMPLES
+// samples have built up the running distribution.
+#define GUARD_WARMUP_SAMPLES (64)
+#define GUARD_GAP_DEVIATIONS (8)
+#define GUARD_EWMA_ALPHA (0.01)
+
+// Histogram pair selection (see enum pair_mode in pairs.hh):
+// 0 base row vs every row, 1 uniform random, 2 single address bit flipped,
+// 3 exhaustive within a window
+#ifndef PAIR_MODE
+#define PAIR_MODE (0)
+#endif
+
+#ifndef PAIR_SEED
+#define PAIR_SEED (1)
+#endif
+
+// Hard budget in pairs (0: one pair per row, as in the base sweep) and in
+// seconds (0: none)
+#ifndef PAIR_BUDGET_PAIRS
+#define PAIR_BUDGET_PAIRS (0)
+#endif
+#ifndef PAIR_BUDGET_SEC
+#define PAIR_BUDGET_SEC (0)
+#endif
+
+// Rows per window in window mode, and the bit range and granularity of
+// bit-flip mode
+#define PAIRS_WINDOW_ROWS (64)
+#define PAIRS_BITFLIP_MIN_BIT (6)
+#define PAIRS_LINE_SIZE (64)
+
+// Clock service: recalibrate the timer source every CLOCK_RECAL_SEC seconds
+// over a CLOCK_RECAL_WINDOW_MS window, and warn once the tick rate moves more
+// than CLOCK_DRIFT_WARN (fraction) from the first calibration.
+#ifndef CLOCK_RECAL_SEC
+#define CLOCK_RECAL_SEC (10)
+#endif
+#define CLOCK_RECAL_WINDOW_MS (50)
+#define CLOCK_DRIFT_WARN (0.05)
+
+// Calibrations kept for converting tagged samples (at 10 s per epoch, about
+// 11 hours of history)
+#define CLOCK_MAX_EPOCHS (4096)
+
+// Placement of the measuring and counter threads (see enum placement_policy
+// in placement.hh): 0 none, 1 sibling cores of one cluster, 2 SMT siblings,
+// 3 different clusters
+#ifndef PLACEMENT_POLICY
+#define PLACEMENT_POLICY (1)
+#endif
+
+// Run pinned measuring/counter threads as SCHED_FIFO where permitted (Linux)
+#ifndef PLACEMENT_REALTIME
+#define PLACEMENT_REALTIME (1)
+#endif
+
+#define PLACEMENT_MAX_CPUS (256)
+
+// Virtual-to-DRAM mapping backend (see enum mapping_mode in mapping.hh):
+// 0 pagemap when it yields frame numbers, else inferred; 1 pagemap only;
+// 2 inferred from timing and virtual addresses alone
+#ifndef MAPPING_MODE
+#define MAPPING_MODE (0)
+#endif
+
+// Inferred mode: the buffer is taken to be physically contiguous in aligned
+// runs of this many bytes (a huge page on Linux), so address bits below it
+// are physical and row order is known within a run
+#ifndef MAPPING_CONTIG_BYTES
+#define MAPPING_CONTIG_BYTES (HUGE_PAGE_SIZE)
+#endif
+
+// Inferred mode: most same-bank groups tracked
+#define MAPPING_MAX_GROUPS (256)
+#define MAPPING_MAX_FUNCS (8)
+
+// Channel and rank discovery from concurrent-stream throughput (see
+// channels.hh), run before hammering to fill in the mapping profile
+#ifndef CHANNEL_DISCOVERY
+#define CHANNEL_DISCOVERY (1)
+#endif
+// Addresses spread over the buffer and clustered into bank groups
+#define CHANNEL_PROBES (256)
+#define CHANNEL_MAX_GROUPS (64)
+// Length of one throughput measurement, and measurements per median
+#define CHANNEL_STREAM_US (2000)
+#define CHANNEL_STREAM_REPEATS (3)
+// Rounds per throughput measurement in -DMEASURE_SIM builds
+#define CHANNEL_SIM_ROUNDS (256)
+// Two streams on different channels run at least this many times the
+// throughput of one; below it they share a channel
+#define CHANNEL_PARALLEL_RATIO (1.75)
+// Smallest relative gap between pair throughputs taken as a rank boundary
+#define CHANNEL_MIN_GAP (0.08)
+// Address bits searched for channel and rank functions (masks of one or two bits)
+#define CHANNEL_FIT_MIN_BIT (6)
+#define CHANNEL_FIT_MAX_BIT (40)
+
+// Refresh-interval detection (see refresh.hh): samples in one trace of
+// back-to-back uncached loads
+#ifndef REFRESH_TRACE_SAMPLES
+#define REFRESH_TRACE_SAMPLES (1 << 20)
+#endif
+// A sample is a spike when above the median by this many median absolute
+// deviations (and at least REFRESH_MIN_SPIKE_NS)
+#define REFRESH_SPIKE_MADS (8)
+#define REFRESH_MIN_SPIKE_NS (20.0)
+// Bin width and lag range of the spike-interval autocorrelation
+#define REFRESH_BIN_NS (50.0)
+#define REFRESH_MIN_PERIOD_NS (500.0)
+#define REFRESH_MAX_PERIOD_NS (100000.0)
+// REF commands per retention window (64 ms / 7.8 us on DDR4, 32 ms / 3.9 us
+// on LPDDR4): refresh window = tREFI * this
+#define REFRESH_COMMANDS_PER_WINDOW (8192)
+// Size hammering's rounds per victim to one refresh window when detection
+// succeeds, instead of HAMMERS_PER_ITER
+#ifndef REFRESH_SIZE_HAMMERS
+#define REFRESH_SIZE_HAMMERS (1)
+#endif
+
+// Raw-sample traces (see trace.hh): file histogram records every sample to
+// (NULL: no trace)
+#ifndef TRACE_PATH
+#define TRACE_PATH NULL
+#endif
+// Encoded bytes per sample block; a block is only cut between pairs
+#define TRACE_BLOCK_BYTES (64 * 1024)
+// Largest bank clusters replay prints
+#define REPLAY_MAX_CLUSTERS (64)
+
+// Run-to-run comparison (see compare.hh): largest change that still passes.
+// Shifts of the median, separation and threshold are relative to the
+// baseline; KS is a CDF distance in [0, 1]; EMD is relative to the baseline
+// median; the conflict fraction moves in absolute terms.
+#ifndef COMPARE_MAX_MEDIAN_SHIFT
+#define COMPARE_MAX_MEDIAN_SHIFT (0.05)
+#endif
+#ifndef COMPARE_MAX_KS
+#define COMPARE_MAX_KS (0.10)
+#endif
+#ifndef COMPARE_MAX_EMD
+#define COMPARE_MAX_EMD (0.05)
+#endif
+#ifndef COMPARE_MAX_SEPARATION_SHIFT
+#define COMPARE_MAX_SEPARATION_SHIFT (0.10)
+#endif
+#ifndef COMPARE_MAX_THRESHOLD_SHIFT
+#define COMPARE_MAX_THRESHOLD_SHIFT (0.05)
+#endif
+#ifndef COMPARE_MAX_CONFLICT_SHIFT
+#define COMPARE_MAX_CONFLICT_SHIFT (0.05)
+#endif
+
+// Multi-process measurement (see workers.hh): worker processes, each with a
+// buffer of its own of WORKERS_BUFFER_MB
+#ifndef WORKERS
+#define WORKERS (4)
+#endif
+#ifndef WORKERS_BUFFER_MB
+#define WORKERS_BUFFER_MB (256ULL)
+#endif
+#define WORKERS_MAX (64)
+// Pairs a worker measures between merges into the shared histogram
+#define WORKERS_MERGE_PAIRS (1024)
+// Longest wait for every worker to reach the start barrier
+#define WORKERS_BARRIER_SEC (60)
+
+// Row-buffer policy detection (see rowbuf.hh): anchors, each with a partner
+// of every class, and samples of each pair
+#define ROWBUF_PAIRS (256)
+#ifndef ROWBUF_ROUNDS
+#define ROWBUF_ROUNDS (16)
+#endif
+#ifndef ROWBUF_SEED
+#define ROWBUF_SEED (1)
+#endif
+// Concurrent class measurement: ROWBUF_STREAM_PAIRS pairs in flight at once
+// (two streams each), over ROWBUF_STREAM_SETS sets of anchors
+#define ROWBUF_STREAM_PAIRS (4)
+#define ROWBUF_STREAM_SETS (8)
+// Rows between an anchor and its different-row partner
+#define ROWBUF_ROW_DISTANCE (2)
+// Random draws for a different-bank partner before the anchor is dropped
+#define ROWBUF_BANK_TRIES (16)
+// Idle sweep: waits from 0 and then ROWBUF_MIN_DELAY_NS up to
+// ROWBUF_MAX_DELAY_NS in steps of ROWBUF_DELAY_RATIO, ROWBUF_DELAY_SAMPLES
+// samples each (also the size of a gap bin). Keep the longest wait well
+// below tREFI.
+#define ROWBUF_MIN_DELAY_NS (20.0)
+#ifndef ROWBUF_MAX_DELAY_NS
+#define ROWBUF_MAX_DELAY_NS (1000.0)
+#endif
+#define ROWBUF_DELAY_RATIO (1.25)
+#define ROWBUF_DELAY_SAMPLES (256)
+#define ROWBUF_MAX_BINS (64)
+// Closed page when the longest gap costs this fraction of a row conflict
+// over a row hit
+#define ROWBUF_STEP_FRACTION (0.15)
+// Row state is invisible when a conflict costs less than this fraction over
+// a hit (rows closed right after every access)
+#define ROWBUF_MIN_GAP (0.05)
+
+// Translation isolation (see tlb.hh): back buffers with huge pages where the
+// system allows, and warm the TLB for both addresses of a pair before each
+// sample (measure_bank_latency_prewarm) by loading a cached line
+// TLB_WARM_OFFSET bytes away in the same page
+#ifndef ALLOC_HUGE_PAGES
+#define ALLOC_HUGE_PAGES (0)
+#endif
+#ifndef MEASURE_PREWARM
+#define MEASURE_PREWARM (0)
+#endif
+#define TLB_WARM_OFFSET (256)
+// TLB benchmark: a chase over one line in each of TLB_MIN_PAGES pages,
+// doubling up to TLB_MAX_PAGES (or the buffer), against a chase over as many
+// lines packed into few pages; TLB_CHASE_LOADS timed loads (at least
+// TLB_MIN_ROUNDS passes) per measurement, median of TLB_REPEATS
+#ifndef TLB_BUFFER_MB
+#define TLB_BUFFER_MB (512ULL)
+#endif
+#define TLB_MIN_PAGES (8)
+#define TLB_MAX_PAGES (1 << 17)
+#define TLB_MAX_POINTS (32)
+#define TLB_CHASE_LOADS (1 << 18)
+#define TLB_MIN_ROUNDS (2)
+#define TLB_REPEATS (3)
+// First TLB miss level: translation cost above this fraction of the largest
+// one. Page walks: a second plateau at least TLB_WALK_RATIO times the first.
+#define TLB_STEP_FRACTION (0.1)
+#define TLB_WALK_RATIO (1.5)
+
+// Sweep order (see struct sweep_order in pairs.hh): 0 rows in address order,
+// 1 a permuted order in which any two rows visited within ORDER_WINDOW steps
+// of each other are at least ORDER_MIN_DISTANCE rows apart
+#ifndef SWEEP_ORDER
+#define SWEEP_ORDER (0)
+#endif
+#ifndef ORDER_MIN_DISTANCE
+#define ORDER_MIN_DISTANCE (16)
+#endif
+#define ORDER_WINDOW (16)
+// Multipliers tried for the permutation before taking the best one
+#define ORDER_TRIES (64)
+
+// Prefetcher characterisation (see prefetch.hh): loads that train each
+// pattern are given PREFETCH_SETTLE_NS to complete the prefetches they
+// trigger; every probe is repeated PREFETCH_REPEATS times on fresh pages of
+// a PREFETCH_BUFFER_MB buffer
+#ifndef PREFETCH_BUFFER_MB
+#define PREFETCH_BUFFER_MB (64ULL)
+#endif
+#ifndef PREFETCH_REPEATS
+#define PREFETCH_REPEATS (64)
+#endif
+#define PREFETCH_SETTLE_NS (500.0)
+#define PREFETCH_MAX_PROBES (16)
+// Prefetched when the median trained load is below this fraction of the way
+// from a cache hit to a miss
+#define PREFETCH_HIT_FRACTION (0.5)
+
+// Hammer pattern fuzzer (see fuzz.hh): wall-time budget of a campaign, trials
+// (0: until the budget runs out) and aggressor activations per trial
+#ifndef FUZZ_BUDGET_SEC
+#define FUZZ_BUDGET_SEC (600)
+#endif
+#ifndef FUZZ_TRIALS
+#define FUZZ_TRIALS (0)
+#endif
+#ifndef FUZZ_TRIAL_ACTIVATIONS
+#define FUZZ_TRIAL_ACTIVATIONS (1 << 21)
+#endif
+// Pattern space: aggressor pairs, slots per pattern (powers of two between
+// MIN and MAX), back-to-back repeats of a pair, and rows between neighbouring
+// victims (MIN_SPACING plus up to SPACING_JITTER). The rows of a pattern
+// must fit in one MAPPING_CONTIG_BYTES run for the inferred mapping.
+#define FUZZ_MAX_PAIRS (6)
+#define FUZZ_MIN_SLOTS (32)
+#define FUZZ_MAX_SLOTS (512)
+#define FUZZ_MAX_AMPLITUDE (4)
+#define FUZZ_MIN_SPACING (3)
+#define FUZZ_SPACING_JITTER (1)
+// Locations tried before a pattern is given up as unplaceable
+#define FUZZ_PLACE_TRIES (16)
+// Once a pattern has flipped bits, this fraction of trials mutates the best
+// one instead of drawing a new pattern
+#define FUZZ_MUTATE_FRACTION (0.5)
+// Patterns kept in the flip log and printed at the end
+#define FUZZ_MAX_LOGGED (256)
+
+// Cache benchmarks (see cachebench.hh): reloads timed per working-set size,
+// and the largest working set streamed between them (at most the buffer).
+// Sizes double from one line up to it.
+#ifndef CACHE_SWEEP_SAMPLES
+#define CACHE_SWEEP_SAMPLES (50)
+#endif
+#ifndef CACHE_SWEEP_MAX_BYTES
+#define CACHE_SWEEP_MAX_BYTES (64ULL << 20)
+#endif
+#define CACHE_SWEEP_MAX_POINTS (48)
+// Loads timed with and without a flush before them. The flush counts as
+// working when the flushed median is above this quantile of the hits.
+#ifndef FLUSH_BENCH_SAMPLES
+#define FLUSH_BENCH_SAMPLES (50)
+#endif
+#define FLUSH_BENCH_HIT_QUANTILE (0.9)
+
+// Benchmark driver (rhbench): row pairs timed by the calibrate stage, rows
+// the map stage tallies by bank, and the result format: 0 text tables as the
+// other binaries print them, 1 CSV, 2 JSON lines (see report.hh)
+#ifndef CALIBRATE_PAIRS
+#define CALIBRATE_PAIRS (2000)
+#endif
+#define MAP_TALLY_ROWS (4096)
+#ifndef REPORT_FORMAT
+#define REPORT_FORMAT (2)
+#endif
+#define REPORT_SCHEMA_VERSION (1)
+
+// Runtime configuration (see config.hh): key=value file read at startup
+// before --config and command-line overrides (NULL: none), and the longest
+// path or string value
+#ifndef CONFIG_PATH
+#define CONFIG_PATH NULL
+#endif
+#define CONFIG_PATH_MAX (256)
+
+// Software DRAM simulator used by -DMEASURE_SIM builds (see dramsim.hh).
+// Address functions are parity masks; {0} means no such index bits. The
+// default geometry is one channel, one rank and 8 banks XOR-ed with the low
+// row bits, with rows of ROW_SIZE per bank.
+#define DRAMSIM_MAX_FUNCS (8)
+#ifndef DRAMSIM_CHANNEL_MASKS
+#define DRAMSIM_CHANNEL_MASKS {0}
+#endif
+#ifndef DRAMSIM_RANK_MASKS
+#define DRAMSIM_RANK_MASKS {0}
+#endif
+#ifndef DRAMSIM_BANK_MASKS
+#define DRAMSIM_BANK_MASKS {0x12000, 0x24000, 0x48000}
+#endif
+#ifndef DRAMSIM_ROW_SHIFT
+#define DRAMSIM_ROW_SHIFT (16)
+#endif
+
+// 0: open-page policy. 1: rows close after DRAMSIM_CLOSED_PAGE_TIMEOUT_NS idle.
+#ifndef DRAMSIM_CLOSED_PAGE
+#define DRAMSIM_CLOSED_PAGE (0)
+#endif
+#define DRAMSIM_CLOSED_PAGE_TIMEOUT_NS (200.0)
+
+// Simulated costs in counter ticks, chosen so that ROW_BUFFER_HIT_LATENCY
+// and ROW_BUFFER_CONFLICT_LATENCY separate the cases
+#define DRAMSIM_T_BASE (100.0)
+#define DRAMSIM_T_ROW_HIT (60.0)
+#define DRAMSIM_T_ROW_EMPTY (90.0)
+#define DRAMSIM_T_ROW_CONFLICT (160.0)
+#define DRAMSIM_T_SAME_CHANNEL (20.0)
+#define DRAMSIM_T_RANK_SWITCH (15.0)
+#define DRAMSIM_NOISE_SIGMA (12.0)
+#define DRAMSIM_INTERRUPT_PROB (0.001)
+#define DRAMSIM_INTERRUPT_COST (3000.0)
+#define DRAMSIM_NS_PER_TICK (1.0)
+
+// Injected bit flips: past DRAMSIM_FLIP_THRESHOLD activations of a row within
+// one refresh window, each activation flips a bit in each neighbour with
+// probability DRAMSIM_FLIP_PROB (threshold 0 disables flips)
+#ifndef DRAMSIM_FLIP_THRESHOLD
+#define DRAMSIM_FLIP_THRESHOLD (20000)
+#endif
+#define DRAMSIM_FLIP_PROB (1e-4)
+#define DRAMSIM_REFRESH_WINDOW_NS (64e6)
+
+// In-DRAM mitigation (TRR): each bank tracks up to DRAMSIM_TRR_ENTRIES rows
+// per refresh window, admitting a row once it reaches DRAMSIM_TRR_THRESHOLD
+// activations while a slot is free, and freeing it at the first REF the row
+// has not been activated since; the neighbours of tracked rows are refreshed
+// in time and never flip (0 entries disables the mitigation)
+#ifndef DRAMSIM_TRR_ENTRIES
+#define DRAMSIM_TRR_ENTRIES (0)
+#endif
+#define DRAMSIM_TRR_THRESHOLD (5000)
+
+// Periodic refresh: one REF every DRAMSIM_T_REFI_NS (0 disables), stalling
+// the next access by DRAMSIM_T_RFC ticks
+#ifndef DRAMSIM_T_REFI_NS
+#define DRAMSIM_T_REFI_NS (3900.0)
+#endif
+#define DRAMSIM_T_RFC (350.0)
+
+// TLB in front of the timed loads: L1 and L2 entries (L1 0 disables the
+// model), ways per set, and the cost of an L2 hit and of a page walk. A load
+// that hits the cache costs DRAMSIM_T_CACHE. Pages are PAGE_SIZE, or
+// HUGE_PAGE_SIZE with ALLOC_HUGE_PAGES.
+#ifndef DRAMSIM_TLB_L1_ENTRIES
+#define DRAMSIM_TLB_L1_ENTRIES (0)
+#endif
+#define DRAMSIM_TLB_L2_ENTRIES (1024)
+#define DRAMSIM_TLB_WAYS (4)
+#define DRAMSIM_T_TLB_L2 (8.0)
+#define DRAMSIM_T_WALK (40.0)
+#define DRAMSIM_T_CACHE (20.0)
+
+// Prefetchers in front of single loads (dramsim_load): next line, the other
+// line of an aligned 128-byte pair, and a per-page stride detector that
+// prefetches DRAMSIM_PREFETCH_DEGREE strides ahead once it has seen the same
+// stride twice. All stay within a page unless DRAMSIM_PREFETCH_CROSS_PAGE,
+// which also makes the stride detector follow one stream across pages.
+// Lines loaded or prefetched stay cached until flushed (at most
+// DRAMSIM_CACHE_LINES, then the cache is emptied).
+#ifndef DRAMSIM_PREFETCH_NEXT_LINE
+#define DRAMSIM_PREFETCH_NEXT_LINE (0)
+#endif
+#ifndef DRAMSIM_PREFETCH_BUDDY
+#define DRAMSIM_PREFETCH_BUDDY (0)
+#endif
+#ifndef DRAMSIM_PREFETCH_STRIDE
+#define DRAMSIM_PREFETCH_STRIDE (0)
+#endif
+#define DRAMSIM_PREFETCH_DEGREE (1)
+#define DRAMSIM_PREFETCH_CROSS_PAGE (0)
+#define DRAMSIM_CACHE_LINES (1 << 16)
+
+#ifndef DRAMSIM_SEED
+#define DRAMSIM_SEED (1)
+#endif
+
 // IRRELEVANT PARAMETERS FROM x86 EXPERIMENTS:
 
 // Size of hugepages in system
@@ -0,0 +1,345 @@
+#include "placement.hh"
+#include "config.hh"
+#include "output.hh"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#include <sys/sysctl.h>
+#endif
+
+static int planned_measure_cpu = -1;
+static int planned_counter_cpu = -1;
+static int planned_realtime = 0;
+
+#if defined(__linux__)
+// CPUs the process may run on, captured before the measuring thread pins
+// itself so helper threads are not confined to its CPU.
+static cpu_set_t allowed_cpus;
+static int allowed_known = 0;
+#endif
+
+#if defined(__linux__)
+static int read_sysfs_int(int cpu, const char *name, int fallback)
+{
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return fallback;
+  int value = fallback;
+  if (fscanf(f, "%d", &value) != 1)
+    value = fallback;
+  fclose(f);
+  return value;
+}
+#endif
+
+#if defined(__APPLE__)
+static int read_sysctl_int(const char *name, int fallback)
+{
+  int value = 0;
+  size_t len = sizeof(value);
+  if (sysctlbyname(name, &value, &len, NULL, 0))
+    return fallback;
+  return value;
+}
+#endif
+
+int topology_discover(struct topology *topo)
+{
+  int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu > PLACEMENT_MAX_CPUS)
+    ncpu = PLACEMENT_MAX_CPUS;
+  topo->num_cpus = ncpu;
+  topo->num_clusters = 0;
+
+#if defined(__linux__)
+  for (int cpu = 0; cpu < ncpu; cpu++)
+  {
+    struct cpu_info *c = &topo->cpus[cpu];
+    int package = read_sysfs_int(cpu, "physical_package_id", 0);
+    c->cpu = cpu;
+    // Make core ids unique across packages.
+    c->core = package * PLACEMENT_MAX_CPUS + read_sysfs_int(cpu, "core_id", cpu);
+    // Older kernels have no cluster_id; treat each package as one cluster.
+    c->cluster = read_sysfs_int(cpu, "cluster_id", -1);
+    if (c->cluster < 0)
+      c->cluster = package;
+    else
+      c->cluster += package * PLACEMENT_MAX_CPUS;
+    c->perf_level = 0;
+  }
+#elif defined(__APPLE__)
+  // XNU numbers the fastest perf level first; cores of one level are split
+  // into clusters of cpusperl2.
+  int levels = read_sysctl_int("hw.nperflevels", 1);
+  int cpu = 0, cluster = 0;
+  for (int level = 0; level < levels && cpu < ncpu; level++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "hw.perflevel%d.logicalcpu", level);
+    int count = read_sysctl_int(name, levels == 1 ? ncpu : 0);
+    snprintf(name, sizeof(name), "hw.perflevel%d.cpusperl2", level);
+    int per_cluster = read_sysctl_int(name, count);
+    if (per_cluster <= 0)
+      per_cluster = count;
+    for (int i = 0; i < count && cpu < ncpu; i++, cpu++)
+    {
+      topo->cpus[cpu].cpu = cpu;
+      topo->cpus[cpu].core = cpu;
+      topo->cpus[cpu].cluster = cluster + i / per_cluster;
+      topo->cpus[cpu].perf_level = level;
+    }
+    cluster += (count + per_cluster - 1) / per_cluster;
+  }
+  for (; cpu < ncpu; cpu++)
+  {
+    topo->cpus[cpu].cpu = cpu;
+    topo->cpus[cpu].core = cpu;
+    topo->cpus[cpu].cluster = cluster;
+    topo->cpus[cpu].perf_level = levels;
+  }
+#else
+  for (int cpu = 0; cpu < ncpu; cpu++)
+  {
+    topo->cpus[cpu].cpu = cpu;
+    topo->cpus[cpu].core = cpu;
+    topo->cpus[cpu].cluster = 0;
+    topo->cpus[cpu].perf_level = 0;
+  }
+#endif
+
+  // Count distinct clusters.
+  for (int i = 0; i < ncpu; i++)
+  {
+    int seen = 0;
+    for (int j = 0; j < i && !seen; j++)
+      seen = topo->cpus[j].cluster == topo->cpus[i].cluster;
+    topo->num_clusters += !seen;
+  }
+  return 0;
+}
+
+void topology_print(const struct topology *topo)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Topology, %d cpus, %d clusters\n", topo->num_cpus, topo->num_clusters);
+  output_printf("CPU,Core,Cluster,Perf-Level\n");
+  for (int i = 0; i < topo->num_cpus; i++)
+  {
+    const struct cpu_info *c = &topo->cpus[i];
+    output_printf("%d,%d,%d,%d\n", c->cpu, c->core, c->cluster, c->perf_level);
+  }
+}
+
+int placement_plan(const struct topology *topo, enum placement_policy policy, int *measure_cpu, int *counter_cpu)
+{
+  *measure_cpu = -1;
+  *counter_cpu = -1;
+  if (policy == PLACE_NONE)
+    return 0;
+
+  // Prefer the fastest cores: scan in order, lowest perf level first.
+  for (int level = 0; level <= PLACEMENT_MAX_CPUS; level++)
+  {
+    for (int i = 0; i < topo->num_cpus; i++)
+    {
+      const struct cpu_info *a = &topo->cpus[i];
+      if (a->perf_level != level)
+        continue;
+      for (int j = 0; j < topo->num_cpus; j++)
+      {
+        const struct cpu_info *b = &topo->cpus[j];
+        if (i == j || b->perf_level != level)
+          continue;
+
+        int ok = 0;
+        switch (policy)
+        {
+        case PLACE_SAME_CLUSTER:
+          ok = a->cluster == b->cluster && a->core != b->core;
+          break;
+        case PLACE_SMT_SIBLINGS:
+          ok = a->core == b->core;
+          break;
+        case PLACE_SPLIT_CLUSTERS:
+          ok = a->cluster != b->cluster;
+          break;
+        default:
+          break;
+        }
+        if (ok)
+        {
+          *measure_cpu = a->cpu;
+          *counter_cpu = b->cpu;
+          return 0;
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+int placement_apply_self(int cpu, int realtime)
+{
+  int ret = 0;
+
+#if defined(__linux__)
+  if (cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+    {
+      output_log("[-] Could not pin thread to cpu %d\n", cpu);
+      ret = -1;
+    }
+  }
+  if (realtime)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+      output_log("[-] SCHED_FIFO unavailable (needs CAP_SYS_NICE), staying SCHED_OTHER\n");
+  }
+#elif defined(__APPLE__)
+  (void)cpu;
+  (void)realtime;
+  if (pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0))
+    output_log("[-] Could not set QoS class\n");
+#else
+  (void)cpu;
+  (void)realtime;
+#endif
+
+  return ret;
+}
+
+void placement_helper_attr(pthread_attr_t *attr)
+{
+  pthread_attr_init(attr);
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(attr, SCHED_OTHER);
+  pthread_attr_setschedparam(attr, &param);
+
+#if defined(__linux__)
+  if (!allowed_known)
+    return;
+  cpu_set_t set = allowed_cpus;
+  if (planned_measure_cpu >= 0)
+    CPU_CLR(planned_measure_cpu, &set);
+  if (planned_counter_cpu >= 0)
+    CPU_CLR(planned_counter_cpu, &set);
+  // On a machine too small to spare both, share the counter's CPU, and
+  // failing that any of them.
+  if (CPU_COUNT(&set) == 0)
+  {
+    set = allowed_cpus;
+    if (planned_measure_cpu >= 0)
+      CPU_CLR(planned_measure_cpu, &set);
+  }
+  if (CPU_COUNT(&set) == 0)
+    set = allowed_cpus;
+  pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+#elif defined(__APPLE__)
+  pthread_attr_set_qos_class_np(attr, QOS_CLASS_UTILITY, 0);
+#endif
+}
+
+int placement_plan_workers(const struct topology *topo, enum placement_policy policy, int num_workers,
+                           int *measure_cpus, int *counter_cpus)
+{
+  struct topology left = *topo;
+  int planned = 0;
+  for (int w = 0; w < num_workers; w++)
+  {
+    if (placement_plan(&left, policy, &measure_cpus[w], &counter_cpus[w]) || measure_cpus[w] < 0)
+      continue;
+    planned++;
+
+    // Take both CPUs out of what the next workers can use.
+    int n = 0;
+    for (int i = 0; i < left.num_cpus; i++)
+      if (left.cpus[i].cpu != measure_cpus[w] && left.cpus[i].cpu != counter_cpus[w])
+        left.cpus[n++] = left.cpus[i];
+    left.num_cpus = n;
+  }
+  return planned;
+}
+
+void placement_init(enum placement_policy policy)
+{
+  placement_init_worker(policy, 0, 1);
+}
+
+void placement_init_worker(enum placement_policy policy, int worker, int num_workers)
+{
+  struct topology topo;
+  topology_discover(&topo);
+
+  int measure_cpus[PLACEMENT_MAX_CPUS], counter_cpus[PLACEMENT_MAX_CPUS];
+  if (num_workers > PLACEMENT_MAX_CPUS)
+    num_workers = PLACEMENT_MAX_CPUS;
+  placement_plan_workers(&topo, policy, num_workers, measure_cpus, counter_cpus);
+  planned_measure_cpu = worker < num_workers ? measure_cpus[worker] : -1;
+  planned_counter_cpu = worker < num_workers ? counter_cpus[worker] : -1;
+  if (policy != PLACE_NONE && planned_measure_cpu < 0)
+    output_log("[-] placement: policy %s not possible on %d cpus / %d clusters for worker %d of %d, leaving "
+               "threads unpinned\n",
+               placement_policy_name(policy), topo.num_cpus, topo.num_clusters, worker, num_workers);
+
+  // A SCHED_FIFO spinner sharing a core with anything else starves it, so
+  // only go real-time when both threads have a core of their own.
+  planned_realtime = config.placement_realtime && planned_measure_cpu >= 0 && planned_counter_cpu >= 0 &&
+                     topo.cpus[planned_measure_cpu].core != topo.cpus[planned_counter_cpu].core;
+
+#if defined(__linux__)
+  if (!allowed_known && !pthread_getaffinity_np(pthread_self(), sizeof(allowed_cpus), &allowed_cpus))
+    allowed_known = 1;
+#endif
+  placement_apply_self(planned_measure_cpu, planned_realtime);
+  output_log("[+] placement: %s, measure cpu %d, counter cpu %d%s\n", placement_policy_name(policy),
+             planned_measure_cpu, planned_counter_cpu, planned_realtime ? ", SCHED_FIFO" : "");
+}
+
+int placement_counter_cpu(void)
+{
+  return planned_counter_cpu;
+}
+
+int placement_measure_cpu(void)
+{
+  return planned_measure_cpu;
+}
+
+int placement_realtime(void)
+{
+  return planned_realtime;
+}
+
+const char *placement_policy_name(enum placement_policy policy)
+{
+  switch (policy)
+  {
+  case PLACE_NONE:
+    return "none";
+  case PLACE_SAME_CLUSTER:
+    return "same-cluster";
+  case PLACE_SMT_SIBLINGS:
+    return "smt-siblings";
+  case PLACE_SPLIT_CLUSTERS:
+    return "split-clusters";
+  default:
+    return "unknown";
+  }
+}
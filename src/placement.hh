@@ -0,0 +1,112 @@
+#ifndef PLACEMENT_GUARD
+#define PLACEMENT_GUARD
+
+#include "params.hh"
+
+#include <pthread.h>
+
+// CPU topology discovery and thread placement.
+//
+// Linux: topology from /sys/devices/system/cpu, pinning with
+// pthread_setaffinity_np and optionally SCHED_FIFO.
+// macOS: topology from the hw.perflevel* sysctls. Threads cannot be pinned,
+// so placement falls back to the QoS class, which keeps USER_INTERACTIVE
+// threads on the performance cluster.
+
+struct cpu_info
+{
+  int cpu;        // Logical CPU id
+  int core;       // Physical core id (SMT siblings share it)
+  int cluster;    // Cluster / L2 domain
+  int perf_level; // 0 = fastest core type
+};
+
+struct topology
+{
+  int num_cpus;
+  int num_clusters;
+  struct cpu_info cpus[PLACEMENT_MAX_CPUS];
+};
+
+enum placement_policy
+{
+  PLACE_NONE = 0,           // Leave both threads to the scheduler
+  PLACE_SAME_CLUSTER = 1,   // Counter and measuring thread on sibling cores of the same cluster
+  PLACE_SMT_SIBLINGS = 2,   // Counter and measuring thread on the two hardware threads of one core
+  PLACE_SPLIT_CLUSTERS = 3, // Counter and measuring thread in different clusters
+  PLACE_NUM_POLICIES
+};
+
+int topology_discover(struct topology *topo);
+void topology_print(const struct topology *topo);
+
+/*
+ * placement_plan
+ *
+ * Picks CPUs for the measuring and the counter thread under a policy.
+ *
+ * Inputs: topo - Discovered topology
+ *         policy - One of enum placement_policy
+ * Outputs: measure_cpu/counter_cpu - Chosen CPUs, -1 for "not pinned"
+ * Returns: 0 if the policy could be satisfied, -1 otherwise (both set to -1)
+ */
+int placement_plan(const struct topology *topo, enum placement_policy policy, int *measure_cpu, int *counter_cpu);
+
+/*
+ * placement_plan_workers
+ *
+ * Plans num_workers measuring/counter pairs under policy on disjoint CPUs:
+ * each pair is placement_plan() on the CPUs the earlier pairs left free.
+ *
+ * Outputs: measure_cpus/counter_cpus - One entry per worker, -1 where the
+ *          remaining CPUs could not satisfy the policy
+ * Returns: Number of workers that got CPUs
+ */
+int placement_plan_workers(const struct topology *topo, enum placement_policy policy, int num_workers,
+                           int *measure_cpus, int *counter_cpus);
+
+/*
+ * placement_apply_self
+ *
+ * Pins the calling thread to cpu (if >= 0 and supported) and raises its
+ * scheduling class: SCHED_FIFO on Linux when realtime is set, the
+ * USER_INTERACTIVE QoS class on macOS.
+ *
+ * Output: 0 on success, -1 if pinning failed
+ */
+int placement_apply_self(int cpu, int realtime);
+
+/*
+ * placement_helper_attr
+ *
+ * Initializes attributes for a background thread (clock calibrator,
+ * telemetry reporter, load streams). Threads otherwise inherit the creating
+ * thread's pin and SCHED_FIFO and would compete with the measuring thread
+ * for its CPU. Helpers get SCHED_OTHER and, on Linux, the CPUs the process
+ * was allowed before placement minus the measuring and counter CPUs; on
+ * macOS the UTILITY QoS class. Destroy attr after pthread_create.
+ *
+ * Outputs: attr - Initialized attributes
+ */
+void placement_helper_attr(pthread_attr_t *attr);
+
+/*
+ * placement_init
+ *
+ * Discovers the topology, plans under policy, pins the calling (measuring)
+ * thread and remembers the counter thread's CPU for the clock service.
+ */
+void placement_init(enum placement_policy policy);
+
+// placement_init for worker process `worker` of num_workers, on its own CPUs
+// from placement_plan_workers.
+void placement_init_worker(enum placement_policy policy, int worker, int num_workers);
+
+// CPU chosen for the counter thread by placement_init, or -1.
+int placement_counter_cpu(void);
+int placement_measure_cpu(void);
+int placement_realtime(void);
+
+const char *placement_policy_name(enum placement_policy policy);
+
+#endif
@@ -0,0 +1,140 @@
+#include "prefetch.hh"
+#include "output.hh"
+#include "shared.hh"
+
+#include <algorithm>
+#include <random>
+#include <string.h>
+#include <vector>
+
+// Probes: training loads from offset in steps of stride, then the target.
+// next-line and buddy start on an odd line, so that the next line and the
+// other line of its 128-byte pair differ.
+static const struct prefetch_probe probes[] = {
+    {"next-line", 33 * PAIRS_LINE_SIZE, PAIRS_LINE_SIZE, 1},
+    {"buddy", 33 * PAIRS_LINE_SIZE, -PAIRS_LINE_SIZE, 1},
+    {"stream", 0, PAIRS_LINE_SIZE, 4},
+    {"stream-descending", PAGE_SIZE - PAIRS_LINE_SIZE, -PAIRS_LINE_SIZE, 4},
+    {"stride-128", 0, 128, 4},
+    {"stride-256", 0, 256, 4},
+    {"stride-512", 0, 512, 4},
+    {"stride-1024", 0, 1024, 3},
+    {"cross-page", PAGE_SIZE - 4 * PAIRS_LINE_SIZE, PAIRS_LINE_SIZE, 4},
+};
+
+#define NUM_PROBES ((int)(sizeof(probes) / sizeof(probes[0])))
+
+static double median_of(std::vector<double> &v)
+{
+  if (v.empty())
+    return 0;
+  std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+// Flushes the page at page and the first line of the next one.
+static void flush_page(uint64_t page)
+{
+  for (uint64_t off = 0; off <= PAGE_SIZE; off += PAIRS_LINE_SIZE)
+    measure_flush(page + off);
+}
+
+// One run of p on page: the target's latency, with or without training.
+// Without, a single load half a page from the target opens the same DRAM
+// row, so that only the prefetch tells the two runs apart.
+static double run_probe(const struct prefetch_probe *p, uint64_t page, int train)
+{
+  flush_page(page);
+  uint64_t target = page + p->offset + p->loads * p->stride;
+  if (train)
+    for (int i = 0; i < p->loads; i++)
+      measure_load(page + p->offset + i * p->stride);
+  else
+    measure_load(page + ((target - page) ^ (PAGE_SIZE / 2)));
+  measure_idle_ns(PREFETCH_SETTLE_NS);
+  return (double)measure_load(target);
+}
+
+int prefetch_characterize(void *base, uint64_t size, uint64_t seed, struct prefetch_result *r)
+{
+  memset(r, 0, sizeof(*r));
+  uint64_t pages = size / PAGE_SIZE;
+  if (pages < 2)
+    return -1;
+  std::mt19937_64 rng(seed);
+  uint64_t b = (uint64_t)base;
+  auto random_page = [&]() { return b + rng() % (pages - 1) * PAGE_SIZE; };
+
+  // Trained and untrained runs alternate, so drift hits both alike.
+  std::vector<double> trained[NUM_PROBES], untrained[NUM_PROBES], hits, misses;
+  for (int rep = 0; rep < PREFETCH_REPEATS; rep++)
+  {
+    for (int i = 0; i < NUM_PROBES; i++)
+    {
+      trained[i].push_back(run_probe(&probes[i], random_page(), 1));
+      double miss = run_probe(&probes[i], random_page(), 0);
+      untrained[i].push_back(miss);
+      misses.push_back(miss);
+    }
+    uint64_t line = random_page() + rng() % (PAGE_SIZE / PAIRS_LINE_SIZE) * PAIRS_LINE_SIZE;
+    measure_flush(line);
+    measure_load(line);
+    hits.push_back((double)measure_load(line));
+  }
+
+  r->hit_latency = median_of(hits);
+  r->miss_latency = median_of(misses);
+  double cut = r->hit_latency + PREFETCH_HIT_FRACTION * (r->miss_latency - r->hit_latency);
+  r->num_probes = NUM_PROBES;
+  for (int i = 0; i < NUM_PROBES; i++)
+  {
+    struct prefetch_probe *p = &r->probe[i];
+    *p = probes[i];
+    p->trained = median_of(trained[i]);
+    p->untrained = median_of(untrained[i]);
+    p->prefetched = r->miss_latency > r->hit_latency && p->trained < cut;
+  }
+  if (r->miss_latency <= r->hit_latency)
+    return -1;
+
+  for (int i = 0; i < NUM_PROBES; i++)
+  {
+    const struct prefetch_probe *p = &r->probe[i];
+    if (!p->prefetched)
+      continue;
+    if (!strcmp(p->name, "next-line"))
+      r->next_line = 1;
+    else if (!strcmp(p->name, "buddy"))
+      r->buddy = 1;
+    else if (!strcmp(p->name, "stream-descending"))
+      r->descending = 1;
+    else if (!strcmp(p->name, "cross-page"))
+      r->cross_page = 1;
+    else
+    {
+      r->stream |= p->stride == PAIRS_LINE_SIZE;
+      r->max_stride = std::max(r->max_stride, p->stride);
+    }
+  }
+  return 0;
+}
+
+void prefetch_print(const struct prefetch_result *r)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Prefetch-Probes\n");
+  output_printf("Probe,Offset,Stride,Loads,Trained,Untrained,Prefetched\n");
+  for (int i = 0; i < r->num_probes; i++)
+  {
+    const struct prefetch_probe *p = &r->probe[i];
+    output_printf("%s,%llu,%lld,%d,%.0f,%.0f,%s\n", p->name, (unsigned long long)p->offset, (long long)p->stride,
+                  p->loads, p->trained, p->untrained, p->prefetched ? "yes" : "no");
+  }
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Prefetchers\n");
+  output_printf("Hit-Latency,Miss-Latency,Next-Line,Buddy,Stream,Descending,Max-Stride,Cross-Page\n");
+  output_printf("%.0f,%.0f,%s,%s,%s,%s,%lld,%s\n", r->hit_latency, r->miss_latency, r->next_line ? "yes" : "no",
+                r->buddy ? "yes" : "no", r->stream ? "yes" : "no", r->descending ? "yes" : "no",
+                (long long)r->max_stride, r->cross_page ? "yes" : "no");
+}
@@ -0,0 +1,66 @@
+#ifndef PREFETCH_GUARD
+#define PREFETCH_GUARD
+
+#include <stdint.h>
+
+#include "params.hh"
+
+// Hardware prefetcher characterisation.
+//
+// A sweep that walks memory at a constant stride lets the prefetchers fetch
+// the next address before it is timed, and the "DRAM access" becomes a cache
+// hit: the fast tail of a histogram. To see which prefetchers are active,
+// each probe flushes a few lines of a fresh page, loads all but the last in
+// a fixed pattern (next line, the other line of a 128-byte pair, ascending
+// and descending streams, larger strides, a stream running into the next
+// page), waits PREFETCH_SETTLE_NS and times a load of the last one, which
+// the pattern predicts but nothing has touched. The same load after a single
+// load half a page away, which opens the DRAM row but predicts nothing, is
+// the miss reference; a line loaded twice is the hit reference. A probe counts as prefetched when its median is nearer the
+// hit than the miss (PREFETCH_HIT_FRACTION).
+//
+// The permuted sweep order (SWEEP_ORDER, pairs.hh) keeps sweeps clear of
+// every pattern probed here.
+
+struct prefetch_probe
+{
+  const char *name;
+  uint64_t offset;    // First training load, from the start of the page
+  int64_t stride;     // Between loads, bytes
+  int loads;          // Training loads; the target is loads strides on
+  double trained;     // Median latency of the target, timer units
+  double untrained;
+  int prefetched;
+};
+
+struct prefetch_result
+{
+  int num_probes;
+  struct prefetch_probe probe[PREFETCH_MAX_PROBES];
+  double hit_latency;
+  double miss_latency;
+
+  // Summary
+  int next_line;
+  int buddy;
+  int stream;
+  int descending;
+  int64_t max_stride; // Largest stride prefetched, bytes; 0 if none
+  int cross_page;
+};
+
+/*
+ * prefetch_characterize
+ *
+ * Runs every probe PREFETCH_REPEATS times, each on a page drawn from the
+ * buffer (seeded by seed), with measure_load and measure_flush.
+ *
+ * Inputs: base/size - Buffer, at least a few pages
+ * Outputs: r - Probe latencies and the detected prefetchers
+ * Returns: 0 if hits and misses could be told apart, -1 otherwise
+ */
+int prefetch_characterize(void *base, uint64_t size, uint64_t seed, struct prefetch_result *r);
+
+void prefetch_print(const struct prefetch_result *r);
+
+#endif
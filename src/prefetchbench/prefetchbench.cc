@@ -0,0 +1,51 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../timer.hh"
+#include "../pairs.hh"
+#include "../prefetch.hh"
+
+// Prefetcher characterisation: which of next-line, buddy-line, stream,
+// stride and cross-page prefetching turn a timed load into a cache hit, and
+// how far apart the permuted sweep order keeps the rows it visits.
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t buffer_size_bytes = PREFETCH_BUFFER_MB * (1024 * 1024);
+    allocated_mem = allocate_pages(buffer_size_bytes);
+
+    struct prefetch_result res;
+    int found = !prefetch_characterize(allocated_mem, buffer_size_bytes, config.pair_seed, &res);
+    clock_report();
+
+    // The order histogram and hammering would use on their buffer.
+    struct sweep_order order;
+    uint64_t rows = config_buffer_bytes() / config.row_size;
+    sweep_order_init(&order, ORDER_PERMUTED, rows - 1, config.pair_seed, config.order_min_distance);
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Prefetch benchmark\n");
+    output_printf("Repeats, %d\n", PREFETCH_REPEATS);
+    output_printf("Settle NS, %.0f\n", PREFETCH_SETTLE_NS);
+    output_printf("Ticks per ns, %.4f\n", timestamp_ticks_per_ns());
+    output_printf("Hits told from misses, %s\n", found ? "yes" : "no");
+    output_printf("Sequential sweep stride bytes, %llu\n", (unsigned long long) config.row_size);
+    output_printf("Permuted order rows, %llu\n", (unsigned long long) order.n);
+    output_printf("Permuted order multiplier, %llu\n", (unsigned long long) order.mult);
+    output_printf("Permuted order min distance rows, %llu (window %d)\n", (unsigned long long) order.min_distance,
+                  ORDER_WINDOW);
+    int prefetching = res.next_line || res.buddy || res.stream || res.descending || res.max_stride || res.cross_page;
+    output_printf("Recommended order, %s\n", prefetching ? "permuted (--order=1)" : "sequential");
+    prefetch_print(&res);
+
+    clock_service_stop();
+    output_shutdown();
+    return found ? 0 : 1;
+}
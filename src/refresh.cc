@@ -0,0 +1,217 @@
+#include "refresh.hh"
+#include "output.hh"
+#include "shared.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+int refresh_trace_alloc(struct refresh_trace *t, size_t capacity)
+{
+  t->capacity = capacity;
+  t->count = 0;
+  t->start = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+  t->latency = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+  if (!t->start || !t->latency)
+  {
+    refresh_trace_free(t);
+    return -1;
+  }
+  // Fault every page in now rather than in the middle of the trace.
+  memset(t->start, 0, capacity * sizeof(uint64_t));
+  memset(t->latency, 0, capacity * sizeof(uint32_t));
+  return 0;
+}
+
+void refresh_trace_free(struct refresh_trace *t)
+{
+  free(t->start);
+  free(t->latency);
+  t->start = NULL;
+  t->latency = NULL;
+  t->capacity = t->count = 0;
+}
+
+void refresh_record(struct refresh_trace *t, uint64_t addr)
+{
+  for (size_t i = 0; i < t->capacity; i++)
+  {
+    uint64_t lat = measure_access(addr, &t->start[i]);
+    t->latency[i] = lat > UINT32_MAX ? UINT32_MAX : (uint32_t)lat;
+  }
+  t->count = t->capacity;
+}
+
+static double median_of(std::vector<double> v)
+{
+  if (v.empty())
+    return 0;
+  std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+/*
+ * fit_period
+ *
+ * Least-squares fit of spike time against refresh number over the spikes
+ * up to horizon, keeping only those within tolerance of the grid implied by
+ * the current estimate. Returns the number of spikes on the grid and
+ * updates period/phase.
+ */
+static size_t fit_period(const std::vector<double> &spikes, double horizon, double *period, double *phase,
+                         size_t *slots)
+{
+  double tol = std::max(2 * REFRESH_BIN_NS, *period * 0.1);
+  double sn = 0, st = 0, snn = 0, snt = 0;
+  size_t used = 0;
+  int64_t last_n = INT64_MIN;
+  *slots = 0;
+  for (double t : spikes)
+  {
+    if (t > horizon)
+      break;
+    double n = floor((t - *phase) / *period + 0.5);
+    if (fabs(t - *phase - n * *period) > tol)
+      continue;
+    sn += n;
+    st += t;
+    snn += n * n;
+    snt += n * t;
+    used++;
+    if ((int64_t)n != last_n)
+      (*slots)++;
+    last_n = (int64_t)n;
+  }
+  double den = used * snn - sn * sn;
+  if (used < 2 || den <= 0)
+    return used;
+  *period = (used * snt - sn * st) / den;
+  *phase = (st - *period * sn) / used;
+  return used;
+}
+
+int refresh_analyze(const struct refresh_trace *t, double ticks_per_ns, struct refresh_result *r)
+{
+  memset(r, 0, sizeof(*r));
+  r->samples = t->count;
+  if (t->count < 2 || ticks_per_ns <= 0)
+    return -1;
+
+  std::vector<double> lat(t->count);
+  for (size_t i = 0; i < t->count; i++)
+    lat[i] = t->latency[i] / ticks_per_ns;
+  r->duration_ns = (t->start[t->count - 1] - t->start[0]) / ticks_per_ns;
+  r->median_ns = median_of(lat);
+
+  std::vector<double> dev(t->count);
+  for (size_t i = 0; i < t->count; i++)
+    dev[i] = fabs(lat[i] - r->median_ns);
+  double mad = median_of(dev);
+  double threshold = r->median_ns + std::max(REFRESH_SPIKE_MADS * mad, REFRESH_MIN_SPIKE_NS);
+
+  std::vector<double> spikes;
+  std::vector<double> spike_lat;
+  for (size_t i = 0; i < t->count; i++)
+  {
+    if (lat[i] > threshold)
+    {
+      spikes.push_back((t->start[i] - t->start[0]) / ticks_per_ns);
+      spike_lat.push_back(lat[i]);
+    }
+  }
+  r->spikes = spikes.size();
+  if (spikes.size() < 4)
+    return -1;
+
+  // Autocorrelation of the spike train: distances between every pair of
+  // spikes up to the longest period considered.
+  size_t bins = (size_t)(REFRESH_MAX_PERIOD_NS / REFRESH_BIN_NS) + 2;
+  std::vector<double> hist(bins, 0.0);
+  for (size_t i = 0; i < spikes.size(); i++)
+  {
+    for (size_t j = i + 1; j < spikes.size(); j++)
+    {
+      double d = spikes[j] - spikes[i];
+      if (d >= REFRESH_MAX_PERIOD_NS)
+        break;
+      hist[(size_t)(d / REFRESH_BIN_NS)]++;
+    }
+  }
+
+  // Strongest lag (smoothed over neighbouring bins), then the smallest
+  // submultiple that is nearly as strong, so 2*tREFI is not mistaken for it.
+  auto smoothed = [&](size_t b) { return hist[b] + (b > 0 ? hist[b - 1] : 0) + (b + 1 < bins ? hist[b + 1] : 0); };
+  size_t first = (size_t)(REFRESH_MIN_PERIOD_NS / REFRESH_BIN_NS);
+  size_t best = 0;
+  for (size_t b = first; b + 1 < bins; b++)
+    if (!best || smoothed(b) > smoothed(best))
+      best = b;
+  if (!best || smoothed(best) < 4)
+    return -1;
+  for (int d = 4; d >= 2; d--)
+  {
+    size_t b = (size_t)((best + 0.5) / d);
+    if (b >= first && smoothed(b) >= 0.5 * smoothed(best))
+    {
+      best = b;
+      break;
+    }
+  }
+
+  // Phase: the most populated bin of the first spikes folded onto one
+  // period, so a stray interrupt cannot anchor the grid. Then refine over a
+  // horizon growing fourfold, so the small error of the lag estimate never
+  // accumulates far enough to push spikes off the grid.
+  double period = (best + 0.5) * REFRESH_BIN_NS;
+  double horizon = 64 * period;
+  std::vector<size_t> folded(best + 1, 0);
+  for (size_t i = 0; i < spikes.size() && spikes[i] <= horizon; i++)
+    folded[std::min(best, (size_t)(fmod(spikes[i], period) / REFRESH_BIN_NS))]++;
+  double phase = (std::max_element(folded.begin(), folded.end()) - folded.begin() + 0.5) * REFRESH_BIN_NS;
+
+  size_t used = 0, slots = 0;
+  for (;;)
+  {
+    for (int iter = 0; iter < 3; iter++)
+      used = fit_period(spikes, horizon, &period, &phase, &slots);
+    if (horizon >= r->duration_ns)
+      break;
+    horizon *= 4;
+  }
+
+  r->matched = (double)used / spikes.size();
+  r->coverage = std::min(1.0, slots / (r->duration_ns / period));
+  if (used < 4 || r->coverage < 0.1)
+    return -1;
+
+  // Spike cost from the spikes on the grid only, not interrupts.
+  std::vector<double> on_grid;
+  double tol = std::max(2 * REFRESH_BIN_NS, period * 0.1);
+  for (size_t i = 0; i < spikes.size(); i++)
+  {
+    double n = floor((spikes[i] - phase) / period + 0.5);
+    if (fabs(spikes[i] - phase - n * period) <= tol)
+      on_grid.push_back(spike_lat[i]);
+  }
+  r->period_ns = period;
+  r->spike_cost_ns = median_of(on_grid) - r->median_ns;
+  r->window_ns = period * REFRESH_COMMANDS_PER_WINDOW;
+  return 0;
+}
+
+uint64_t refresh_hammer_rounds(const struct refresh_result *r, double round_ns)
+{
+  if (r->window_ns <= 0 || round_ns <= 0)
+    return 0;
+  return (uint64_t)(r->window_ns / round_ns);
+}
+
+void refresh_print(const struct refresh_result *r)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Refresh-Detection\n");
+  output_printf("Samples,Duration-NS,Median-NS,Spikes,tREFI-NS,Matched,Coverage,Spike-Cost-NS,Window-NS\n");
+  output_printf("%zu,%.0f,%.1f,%zu,%.1f,%.3f,%.3f,%.1f,%.0f\n", r->samples, r->duration_ns, r->median_ns, r->spikes,
+                r->period_ns, r->matched, r->coverage, r->spike_cost_ns, r->window_ns);
+}
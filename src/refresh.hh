@@ -0,0 +1,62 @@
+#ifndef REFRESH_GUARD
+#define REFRESH_GUARD
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "params.hh"
+
+// Refresh-interval (tREFI) detection.
+//
+// A REF command stalls whatever access lands on it, so a long trace of
+// back-to-back uncached loads of one line shows a latency spike every tREFI
+// on top of interrupts and noise. The spikes are found against the median,
+// their spacing is autocorrelated (a histogram of the distances between
+// every pair of spikes up to REFRESH_MAX_PERIOD_NS), the strongest
+// fundamental lag is taken as tREFI, and a least-squares fit of spike time
+// against refresh number over the whole trace refines it.
+
+// Preallocated so that recording never faults or allocates.
+struct refresh_trace
+{
+  size_t capacity;
+  size_t count;
+  uint64_t *start;   // Timestamp before each load, timer units
+  uint32_t *latency; // Load latency, timer units
+};
+
+struct refresh_result
+{
+  size_t samples;
+  double duration_ns;
+  double median_ns;     // Typical uncached load
+  size_t spikes;
+  double period_ns;     // Estimated tREFI, 0 if none was found
+  double matched;       // Fraction of spikes on the fitted refresh grid
+  double coverage;      // Fraction of refresh slots in the trace that showed a spike
+  double spike_cost_ns; // Median extra latency of a refresh spike
+  double window_ns;     // period_ns * REFRESH_COMMANDS_PER_WINDOW
+};
+
+int refresh_trace_alloc(struct refresh_trace *t, size_t capacity);
+void refresh_trace_free(struct refresh_trace *t);
+
+// Fills the whole trace with timed loads of addr, back to back.
+void refresh_record(struct refresh_trace *t, uint64_t addr);
+
+/*
+ * refresh_analyze
+ *
+ * Inputs: t - Recorded trace
+ *         ticks_per_ns - Timer rate for converting the trace
+ * Outputs: r - Spike statistics and the tREFI estimate
+ * Returns: 0 if a refresh period was found, -1 otherwise
+ */
+int refresh_analyze(const struct refresh_trace *t, double ticks_per_ns, struct refresh_result *r);
+
+// Hammer rounds of round_ns each that fit in one refresh window.
+uint64_t refresh_hammer_rounds(const struct refresh_result *r, double round_ns);
+
+void refresh_print(const struct refresh_result *r);
+
+#endif
@@ -0,0 +1,47 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../timer.hh"
+#include "../refresh.hh"
+
+// Refresh-interval detection: one long trace of back-to-back uncached loads
+// of a single line, analysed for periodic refresh stalls.
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    allocated_mem = allocate_pages(HUGE_PAGE_SIZE);
+
+    struct refresh_trace trace;
+    if (refresh_trace_alloc(&trace, REFRESH_TRACE_SAMPLES))
+    {
+        output_log("[-] Could not allocate a trace of %d samples\n", REFRESH_TRACE_SAMPLES);
+        return -1;
+    }
+    refresh_record(&trace, (uint64_t)allocated_mem);
+
+    struct refresh_result res;
+    int found = !refresh_analyze(&trace, timestamp_ticks_per_ns(), &res);
+    clock_report();
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Refresh interval detection\n");
+    output_printf("Trace samples, %zu\n", trace.count);
+    output_printf("Ticks per ns, %.4f\n", timestamp_ticks_per_ns());
+    output_printf("Refresh found, %s\n", found ? "yes" : "no");
+    // A double-sided round is two flushed loads.
+    output_printf("Hammer rounds per window, %llu\n",
+                  (unsigned long long)refresh_hammer_rounds(&res, 2 * res.median_ns));
+    refresh_print(&res);
+
+    refresh_trace_free(&trace);
+    clock_service_stop();
+    output_shutdown();
+    return found ? 0 : 1;
+}
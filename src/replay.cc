@@ -0,0 +1,230 @@
+#include "replay.hh"
+#include "config.hh"
+#include "output.hh"
+#include "params.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <unordered_map>
+
+static uint64_t meta_u64(const struct trace_reader *r, const char *key, uint64_t def)
+{
+  std::string v = trace_meta_get(r, key, "");
+  return v.empty() ? def : strtoull(v.c_str(), NULL, 0);
+}
+
+// Same rescaling as clock_normalize(), with the rates the trace recorded.
+static uint64_t normalize(const struct replay_run *run, uint64_t ticks, uint32_t epoch)
+{
+  if (epoch == 0 || epoch >= run->epoch_rate.size() || run->epoch_rate[epoch] <= 0 || run->epoch_rate[0] <= 0)
+    return ticks;
+  return (uint64_t)((double)ticks * run->epoch_rate[0] / run->epoch_rate[epoch] + 0.5);
+}
+
+int replay_load(struct trace_reader *r, struct replay_run *run)
+{
+  run->pairs.clear();
+  run->samples.clear();
+  run->epoch_rate.clear();
+  run->num_samples = 0;
+  run->threshold = meta_u64(r, "threshold", config.conflict_latency);
+  run->ticks_per_ns = atof(trace_meta_get(r, "ticks_per_ns", "0").c_str());
+  run->min_samples = (int)meta_u64(r, "adaptive_min_samples", ADAPTIVE_MIN_SAMPLES);
+  run->max_samples = (int)meta_u64(r, "adaptive_max_samples", ADAPTIVE_MAX_SAMPLES);
+  run->sign_margin = (int)meta_u64(r, "adaptive_sign_margin", ADAPTIVE_SIGN_MARGIN);
+
+  // Pass 1: pairs, epoch rates and samples per pair.
+  struct trace_record rec;
+  int rc;
+  trace_rewind(r);
+  while ((rc = trace_next(r, &rec)) > 0)
+  {
+    if (rec.type == TRACE_BLOCK_EPOCHS)
+    {
+      if (rec.epoch >= run->epoch_rate.size())
+        run->epoch_rate.resize(rec.epoch + 1, 0.0);
+      run->epoch_rate[rec.epoch] = rec.ticks_per_ns;
+      continue;
+    }
+    if (rec.pair_id >= run->pairs.size())
+      run->pairs.resize(rec.pair_id + 1, {0, 0, 0, 0, 0, 0});
+    struct replay_pair *p = &run->pairs[rec.pair_id];
+    if (rec.type == TRACE_BLOCK_PAIRS)
+    {
+      p->offset_A = rec.offset_A;
+      p->offset_B = rec.offset_B;
+      p->defined = 1;
+    }
+    else
+    {
+      p->num_samples++;
+      run->num_samples++;
+    }
+  }
+  if (rc < 0)
+  {
+    output_log("[-] replay: corrupt block before offset %zu\n", r->next_block);
+    return -1;
+  }
+  run->truncated = r->truncated;
+  if (run->truncated)
+    output_log("[-] replay: trace ends in a partial block, replaying what came before it\n");
+
+  uint64_t first = 0;
+  for (struct replay_pair &p : run->pairs)
+  {
+    p.first = first;
+    first += p.num_samples;
+    p.num_samples = 0;
+  }
+
+  // Pass 2: samples, in recording order within each pair.
+  run->samples.resize(run->num_samples);
+  trace_rewind(r);
+  while (trace_next(r, &rec) > 0)
+  {
+    if (rec.type != TRACE_BLOCK_SAMPLES)
+      continue;
+    struct replay_pair *p = &run->pairs[rec.pair_id];
+    uint64_t t = normalize(run, rec.latency, rec.epoch);
+    run->samples[p->first + p->num_samples++] = t > UINT32_MAX ? UINT32_MAX : (uint32_t)t;
+  }
+
+  std::vector<uint32_t> tmp;
+  for (struct replay_pair &p : run->pairs)
+  {
+    if (!p.num_samples)
+      continue;
+    tmp.assign(run->samples.begin() + p.first, run->samples.begin() + p.first + p.num_samples);
+    std::nth_element(tmp.begin(), tmp.begin() + tmp.size() / 2, tmp.end());
+    p.median = tmp[tmp.size() / 2];
+  }
+  return 0;
+}
+
+enum pair_decision replay_decide(const struct replay_run *run, const struct replay_pair *p, uint64_t threshold)
+{
+  int walk = 0;
+  for (uint32_t n = 0; n < p->num_samples; n++)
+  {
+    walk += run->samples[p->first + n] >= threshold ? 1 : -1;
+    if (n + 1 >= (uint32_t)run->min_samples && abs(walk) >= run->sign_margin)
+      break;
+  }
+  if (abs(walk) >= run->sign_margin)
+    return walk > 0 ? PAIR_CONFLICT : PAIR_HIT;
+  return PAIR_AMBIGUOUS;
+}
+
+double replay_otsu(const double *values, const double *weights, size_t n)
+{
+  double total_w = 0, total = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    total_w += weights[i];
+    total += weights[i] * values[i];
+  }
+  double w_below = 0, below = 0, best = -1, split = -1;
+  for (size_t i = 1; i < n; i++)
+  {
+    w_below += weights[i - 1];
+    below += weights[i - 1] * values[i - 1];
+    if (values[i] == values[i - 1] || w_below <= 0 || w_below >= total_w)
+      continue;
+    double w0 = w_below / total_w;
+    double w1 = 1 - w0;
+    double mu0 = below / w_below;
+    double mu1 = (total - below) / (total_w - w_below);
+    double between = w0 * w1 * (mu0 - mu1) * (mu0 - mu1);
+    if (between > best)
+    {
+      best = between;
+      split = (values[i - 1] + values[i]) / 2;
+    }
+  }
+  return split;
+}
+
+uint64_t replay_threshold(const struct replay_run *run)
+{
+  std::vector<double> m;
+  for (const struct replay_pair &p : run->pairs)
+    if (p.num_samples)
+      m.push_back(p.median);
+  std::sort(m.begin(), m.end());
+  std::vector<double> w(m.size(), 1.0);
+  double split = replay_otsu(m.data(), w.data(), m.size());
+  return split < 0 ? run->threshold : (uint64_t)ceil(split);
+}
+
+void replay_histogram(const struct replay_run *run, uint64_t bucket_width, uint64_t *hist, int buckets)
+{
+  for (int i = 0; i < buckets; i++)
+    hist[i] = 0;
+  for (const struct replay_pair &p : run->pairs)
+  {
+    if (!p.num_samples)
+      continue;
+    uint64_t b = p.median / bucket_width;
+    hist[b < (uint64_t)buckets - 1 ? b : buckets - 1]++;
+  }
+}
+
+static uint64_t find(std::vector<uint64_t> &parent, uint64_t x)
+{
+  while (parent[x] != x)
+  {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+std::vector<uint64_t> replay_clusters(const struct replay_run *run, uint64_t threshold)
+{
+  std::unordered_map<uint64_t, uint64_t> node;
+  std::vector<uint64_t> parent;
+  auto id = [&](uint64_t off) {
+    auto it = node.find(off);
+    if (it != node.end())
+      return it->second;
+    node[off] = parent.size();
+    parent.push_back(parent.size());
+    return parent.size() - 1;
+  };
+
+  for (const struct replay_pair &p : run->pairs)
+  {
+    if (!p.defined || !p.num_samples || replay_decide(run, &p, threshold) != PAIR_CONFLICT)
+      continue;
+    uint64_t a = find(parent, id(p.offset_A));
+    uint64_t b = find(parent, id(p.offset_B));
+    if (a != b)
+      parent[a] = b;
+  }
+
+  std::unordered_map<uint64_t, uint64_t> size;
+  for (uint64_t x = 0; x < parent.size(); x++)
+    size[find(parent, x)]++;
+  std::vector<uint64_t> sizes;
+  for (auto &s : size)
+    sizes.push_back(s.second);
+  std::sort(sizes.begin(), sizes.end(), std::greater<uint64_t>());
+  return sizes;
+}
+
+void replay_bitflip(const struct replay_run *run, uint64_t threshold, uint64_t *bit_pairs, uint64_t *bit_conflicts)
+{
+  for (int b = 0; b < 64; b++)
+    bit_pairs[b] = bit_conflicts[b] = 0;
+  for (const struct replay_pair &p : run->pairs)
+  {
+    uint64_t diff = p.offset_A ^ p.offset_B;
+    if (!p.defined || !p.num_samples || __builtin_popcountll(diff) != 1)
+      continue;
+    int b = __builtin_ctzll(diff);
+    bit_pairs[b]++;
+    bit_conflicts[b] += replay_decide(run, &p, threshold) == PAIR_CONFLICT;
+  }
+}
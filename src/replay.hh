@@ -0,0 +1,83 @@
+#ifndef REPLAY_GUARD
+#define REPLAY_GUARD
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sampler.hh"
+#include "trace.hh"
+
+// Offline analysis of raw-sample traces.
+//
+// A trace is loaded once into per-pair sample runs, rescaled to epoch 0 the
+// way the live sampler rescales them, after which histograms, the sampler's
+// decisions under any threshold, a threshold derived from the data and bank
+// clusters can all be recomputed in seconds.
+
+struct replay_pair
+{
+  uint64_t offset_A;
+  uint64_t offset_B;
+  uint64_t first;       // Index of the pair's first sample in replay_run::samples
+  uint32_t num_samples;
+  uint64_t median;
+  int defined;          // Declared by a pairs block
+};
+
+struct replay_run
+{
+  std::vector<struct replay_pair> pairs; // Indexed by pair id
+  std::vector<uint32_t> samples;         // Epoch 0 timer units, grouped by pair
+  std::vector<double> epoch_rate;        // ticks per ns of each epoch, 0 if unknown
+  uint64_t num_samples;
+  int truncated;
+
+  // From the metadata, falling back to this build's params.hh
+  uint64_t threshold; // Live sampler threshold
+  double ticks_per_ns;
+  int min_samples;
+  int max_samples;
+  int sign_margin;
+};
+
+/*
+ * replay_load
+ *
+ * Inputs: r - Open trace reader
+ * Outputs: run - Per-pair samples, medians and run parameters
+ * Returns: 0 on success, -1 on a corrupt trace
+ */
+int replay_load(struct trace_reader *r, struct replay_run *run);
+
+// The live sampler's decision for p, re-run on its recorded samples.
+enum pair_decision replay_decide(const struct replay_run *run, const struct replay_pair *p, uint64_t threshold);
+
+/*
+ * replay_otsu
+ *
+ * Two-class split of a weighted sample maximising the between-class variance
+ * (Otsu's method).
+ *
+ * Inputs: values - Sorted ascending
+ *         weights - Weight of each value
+ * Returns: Midpoint between the last value of the lower class and the first
+ *          of the upper one, or -1 if there are fewer than two distinct values
+ */
+double replay_otsu(const double *values, const double *weights, size_t n);
+
+// Hit/conflict threshold from the pair medians alone: the split of the sorted
+// medians maximising the between-class variance (Otsu).
+uint64_t replay_threshold(const struct replay_run *run);
+
+// Pair medians in buckets of bucket_width; the last bucket takes everything above.
+void replay_histogram(const struct replay_run *run, uint64_t bucket_width, uint64_t *hist, int buckets);
+
+// Sizes of the groups of addresses joined by conflicting pairs, largest first,
+// leaving out addresses that never conflicted.
+std::vector<uint64_t> replay_clusters(const struct replay_run *run, uint64_t threshold);
+
+// Pairs and conflicts for every pair whose offsets differ in exactly one bit.
+void replay_bitflip(const struct replay_run *run, uint64_t threshold, uint64_t *bit_pairs, uint64_t *bit_conflicts);
+
+#endif
@@ -0,0 +1,118 @@
+#include "../config.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../timer.hh"
+#include "../trace.hh"
+#include "../replay.hh"
+
+// Rebuilds histogram's tables from a raw-sample trace, plus a threshold
+// derived from the data and the bank clusters the conflicts imply.
+//
+// Usage: replay <trace> [threshold]
+// The threshold (epoch 0 timer units) defaults to the one recorded live.
+
+static void print_decisions(const char *name, const struct replay_run *run, uint64_t threshold) {
+    uint64_t count[3] = {0, 0, 0};
+    for (const struct replay_pair &p : run->pairs) {
+        if (p.num_samples)
+            count[replay_decide(run, &p, threshold)]++;
+    }
+    output_printf("%s,%llu,%.1f,%llu,%llu,%llu\n", name, (unsigned long long) threshold,
+                  run->ticks_per_ns > 0 ? threshold / run->ticks_per_ns : 0.0,
+                  (unsigned long long) count[PAIR_HIT], (unsigned long long) count[PAIR_CONFLICT],
+                  (unsigned long long) count[PAIR_AMBIGUOUS]);
+}
+
+int main(int argc, char **argv) {
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    if (argc < 2) {
+        output_log("[-] usage: %s <trace> [threshold]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t start = monotonic_ns();
+    struct trace_reader reader;
+    if (trace_reader_open(&reader, argv[1]))
+        return 1;
+    struct replay_run run;
+    if (replay_load(&reader, &run)) {
+        trace_reader_close(&reader);
+        return 1;
+    }
+    output_log("[+] replay: loaded %zu pairs, %llu samples in %.2f s\n", run.pairs.size(),
+               (unsigned long long) run.num_samples, (monotonic_ns() - start) / 1e9);
+
+    uint64_t derived = replay_threshold(&run);
+    uint64_t threshold = argc > 2 ? strtoull(argv[2], NULL, 0) : run.threshold;
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Trace, %s\n", argv[1]);
+    output_printf("Trace bytes, %zu\n", reader.size);
+    // Every metadata line, as "key, value"
+    for (size_t i = 0; i < reader.meta_bytes;) {
+        size_t eol = i;
+        while (eol < reader.meta_bytes && reader.meta[eol] != '\n')
+            eol++;
+        std::string line(reader.meta + i, eol - i);
+        size_t eq = line.find('=');
+        if (eq != std::string::npos)
+            output_printf("%s, %s\n", line.substr(0, eq).c_str(), line.substr(eq + 1).c_str());
+        i = eol + 1;
+    }
+    output_printf("Pairs measured, %zu\n", run.pairs.size());
+    output_printf("Total samples, %llu\n", (unsigned long long) run.num_samples);
+    output_printf("Bytes per sample, %.2f\n", run.num_samples ? (double) reader.size / run.num_samples : 0.0);
+    output_printf("Clock epochs, %zu\n", run.epoch_rate.size());
+    output_printf("Truncated, %d\n", run.truncated);
+    output_printf("Derived threshold, %llu\n", (unsigned long long) derived);
+    output_printf("Replay threshold, %llu\n", (unsigned long long) threshold);
+
+    // Same buckets as histogram
+    uint64_t hist[101];
+    replay_histogram(&run, 10, hist, 101);
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("UNIT,NS\n");
+    output_printf("TIMING-METHOD,%s\n", trace_meta_get(&reader, "timer", "unknown").c_str());
+    output_printf("Timing-Unit,Number-of-Address-Pairs\n");
+    for (int i = 0; i < 100; i++)
+        output_printf("[%d-%d),%15llu\n", i * 10, i * 10 + 10, (unsigned long long) hist[i]);
+    output_printf("[%d),%15llu \n", 100 * 10, (unsigned long long) hist[100]);
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Decisions\n");
+    output_printf("Threshold-Source,Threshold,Threshold-NS,Hit,Conflict,Ambiguous\n");
+    print_decisions("recorded", &run, run.threshold);
+    print_decisions("derived", &run, derived);
+    if (argc > 2)
+        print_decisions("argument", &run, threshold);
+
+    std::vector<uint64_t> clusters = replay_clusters(&run, threshold);
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Bank-Clusters, %zu\n", clusters.size());
+    output_printf("Cluster,Addresses\n");
+    for (size_t c = 0; c < clusters.size() && c < REPLAY_MAX_CLUSTERS; c++)
+        output_printf("%zu,%llu\n", c, (unsigned long long) clusters[c]);
+
+    uint64_t bit_pairs[64], bit_conflicts[64];
+    replay_bitflip(&run, threshold, bit_pairs, bit_conflicts);
+    int any = 0;
+    for (int b = 0; b < 64; b++)
+        any |= bit_pairs[b] != 0;
+    if (any) {
+        output_printf("TABLESTART,TABLESTART\n");
+        output_printf("Flipped-Bit,Pairs,Conflict-Fraction\n");
+        for (int b = 0; b < 64; b++) {
+            if (bit_pairs[b])
+                output_printf("%d,%llu,%.4f\n", b, (unsigned long long) bit_pairs[b],
+                              (double) bit_conflicts[b] / bit_pairs[b]);
+        }
+    }
+
+    trace_reader_close(&reader);
+    output_log("[+] replay: done in %.2f s\n", (monotonic_ns() - start) / 1e9);
+    output_shutdown();
+    return 0;
+}
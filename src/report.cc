@@ -0,0 +1,241 @@
+#include "report.hh"
+#include "output.hh"
+#include "params.hh"
+#include "timer.hh"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static enum report_format format = REPORT_TEXT;
+static std::string stage;
+static uint64_t stage_start_ns = 0;
+static std::string table;
+static std::vector<std::string> columns;
+static uint64_t row_index = 0;
+
+static void emit(const std::string &line)
+{
+  output_write(OUT_RESULT, line.data(), line.size());
+}
+
+// Cells are printed with the padding of the text layout; the other formats drop it.
+static std::string trim(const char *s, size_t len)
+{
+  while (len && (*s == ' ' || *s == '\t'))
+  {
+    s++;
+    len--;
+  }
+  while (len && (s[len - 1] == ' ' || s[len - 1] == '\t' || s[len - 1] == '\n'))
+    len--;
+  return std::string(s, len);
+}
+
+static std::vector<std::string> split(const char *s)
+{
+  std::vector<std::string> cells;
+  const char *start = s;
+  for (const char *p = s;; p++)
+  {
+    if (*p == ',' || *p == '\0')
+    {
+      cells.push_back(trim(start, p - start));
+      if (*p == '\0')
+        break;
+      start = p + 1;
+    }
+  }
+  return cells;
+}
+
+static std::string csv_field(const std::string &s)
+{
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+  std::string out = "\"";
+  for (char c : s)
+  {
+    if (c == '"')
+      out += '"';
+    out += c;
+  }
+  return out + "\"";
+}
+
+// Plain decimal numbers only: hex addresses, inf and nan stay strings.
+static int is_number(const std::string &s)
+{
+  if (s.empty() || s.find_first_not_of("0123456789+-.eE") != std::string::npos)
+    return 0;
+  char *end;
+  strtod(s.c_str(), &end);
+  return *end == '\0';
+}
+
+static std::string json_string(const std::string &s)
+{
+  std::string out = "\"";
+  for (unsigned char c : s)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += (char)c;
+    }
+    else if (c < 0x20)
+    {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    }
+    else
+    {
+      out += (char)c;
+    }
+  }
+  return out + "\"";
+}
+
+static std::string json_value(const std::string &s)
+{
+  return is_number(s) ? s : json_string(s);
+}
+
+// Opening fields every JSON record shares.
+static std::string json_record(const char *type)
+{
+  char head[64];
+  snprintf(head, sizeof(head), "{\"schema\":%d,\"type\":\"%s\",\"stage\":", REPORT_SCHEMA_VERSION, type);
+  return head + json_string(stage);
+}
+
+static std::string csv_record(const std::string &tbl, const std::string &row, const std::string &key,
+                              const std::string &value)
+{
+  return std::to_string(REPORT_SCHEMA_VERSION) + "," + csv_field(stage) + "," + csv_field(tbl) + "," + row + "," +
+         csv_field(key) + "," + csv_field(value) + "\n";
+}
+
+void report_init(enum report_format f)
+{
+  format = f;
+  if (format == REPORT_CSV)
+    emit("schema,stage,table,row,key,value\n");
+}
+
+void report_begin(const char *name)
+{
+  stage = name;
+  stage_start_ns = monotonic_ns();
+  table.clear();
+  columns.clear();
+
+  switch (format)
+  {
+  case REPORT_TEXT:
+    emit("HEADER,HEADER\nStage, " + stage + "\n");
+    break;
+  case REPORT_CSV:
+    emit(csv_record("", "", "begin", ""));
+    break;
+  case REPORT_JSON:
+    emit(json_record("begin") + "}\n");
+    break;
+  }
+}
+
+void report_end(int status)
+{
+  double seconds = (monotonic_ns() - stage_start_ns) / 1e9;
+  char text[32];
+  snprintf(text, sizeof(text), "%.3f", seconds);
+
+  switch (format)
+  {
+  case REPORT_TEXT:
+    break;
+  case REPORT_CSV:
+    emit(csv_record("", "", "status", std::to_string(status)));
+    emit(csv_record("", "", "seconds", text));
+    break;
+  case REPORT_JSON:
+    emit(json_record("end") + ",\"status\":" + std::to_string(status) + ",\"seconds\":" + text + "}\n");
+    break;
+  }
+  table.clear();
+  columns.clear();
+}
+
+void report_value(const char *key, const char *fmt, ...)
+{
+  char text[OUTPUT_LINE_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(text, sizeof(text), fmt, ap);
+  va_end(ap);
+
+  switch (format)
+  {
+  case REPORT_TEXT:
+    emit(std::string(key) + ", " + text + "\n");
+    break;
+  case REPORT_CSV:
+    emit(csv_record("", "", key, trim(text, strlen(text))));
+    break;
+  case REPORT_JSON:
+    emit(json_record("value") + ",\"key\":" + json_string(key) + ",\"value\":" +
+         json_value(trim(text, strlen(text))) + "}\n");
+    break;
+  }
+}
+
+void report_table(const char *name, const char *cols)
+{
+  table = name;
+  columns = split(cols);
+  row_index = 0;
+  if (format == REPORT_TEXT)
+    emit("TABLESTART,TABLESTART\n" + table + "\n" + cols + "\n");
+}
+
+void report_row(const char *fmt, ...)
+{
+  char text[OUTPUT_LINE_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(text, sizeof(text), fmt, ap);
+  va_end(ap);
+
+  if (format == REPORT_TEXT)
+  {
+    emit(std::string(text) + "\n");
+    row_index++;
+    return;
+  }
+
+  // Cells past the last column keep their position as the key.
+  std::vector<std::string> cells = split(text);
+  std::string row = std::to_string(row_index++);
+  if (format == REPORT_CSV)
+  {
+    std::string lines;
+    for (size_t c = 0; c < cells.size(); c++)
+      lines += csv_record(table, row, c < columns.size() ? columns[c] : std::to_string(c), cells[c]);
+    emit(lines);
+  }
+  else
+  {
+    std::string line = json_record("row") + ",\"table\":" + json_string(table) + ",\"row\":" + row + ",\"cells\":{";
+    for (size_t c = 0; c < cells.size(); c++)
+    {
+      if (c)
+        line += ",";
+      line += json_string(c < columns.size() ? columns[c] : std::to_string(c)) + ":" + json_value(cells[c]);
+    }
+    emit(line + "}}\n");
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef REPORT_GUARD
+#define REPORT_GUARD
+
+#include <stdint.h>
+
+// Machine-readable results.
+//
+// The binaries print their results as "HEADER,HEADER" blocks of "Key, value"
+// lines and "TABLESTART,TABLESTART" tables, which suits a terminal and
+// compare's parser but nothing else. A report is the same content as
+// records: a stage (one step of a run) holds keyed values and named tables
+// of rows, and each record is written to OUT_RESULT in one of three formats:
+//
+//   REPORT_TEXT  The HEADER/TABLESTART layout: "key, value" lines, and per
+//                table its name, the column line and the rows.
+//   REPORT_CSV   One cell per line under a fixed header,
+//                  schema,stage,table,row,key,value
+//                with table and row empty for stage values. Begin and end
+//                of a stage are the values "begin" and "status"/"seconds".
+//   REPORT_JSON  One object per line (JSON lines), each with "schema" and
+//                "stage" and a "type" of
+//                  begin  -
+//                  value  "key", "value"
+//                  row    "table", "row" (from 0), "cells": {column: value}
+//                  end    "status" (0 ok), "seconds"
+//                Values that read as numbers are written as numbers, the
+//                rest as strings.
+//
+// The schema field is REPORT_SCHEMA_VERSION; it changes only when a record
+// type, key or column is renamed or removed, not when one is added. Table
+// rows are comma-separated cells, so cells cannot contain commas; values can.
+
+enum report_format
+{
+  REPORT_TEXT = 0,
+  REPORT_CSV = 1,
+  REPORT_JSON = 2,
+};
+
+// Selects the format and writes the CSV header. Call once, after output_init.
+void report_init(enum report_format format);
+
+void report_begin(const char *stage);
+// Closes the stage begun last, with its exit status and elapsed time.
+void report_end(int status);
+
+void report_value(const char *key, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Starts a table of the current stage. columns: comma-separated names.
+void report_table(const char *name, const char *columns);
+// One row of the table started last: comma-separated cells, one per column.
+void report_row(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
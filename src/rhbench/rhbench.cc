@@ -0,0 +1,489 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../telemetry.hh"
+#include "../sampler.hh"
+#include "../guard.hh"
+#include "../pairs.hh"
+#include "../mapping.hh"
+#include "../channels.hh"
+#include "../timer.hh"
+#include "../trace.hh"
+#include "../replay.hh"
+#include "../compare.hh"
+#include "../cachebench.hh"
+#include "../fuzz.hh"
+#include "../report.hh"
+#include "../sweep.hh"
+
+#include <algorithm>
+#include <string>
+#include <string.h>
+#include <vector>
+
+// Benchmark driver: runs the measurement stages named on the command line,
+// in order, in one process.
+//
+// Usage: rhbench [--key=value ...] <stage> [<stage> ...]
+//
+// The stages share one buffer (allocated once, before the first stage that
+// needs it), one clock service and one calibration state: the threshold the
+// calibrate stage finds is the one histogram, map and hammer use, instead of
+// each binary allocating, starting its counter thread and reading
+// CONFLICT_LATENCY again. Results are reported per stage as JSON lines, CSV
+// or the text tables of the other binaries (--output_format, see report.hh).
+// A stage that finds nothing reports a non-zero status and the next one still
+// runs; the exit status is that of the first stage that failed.
+
+struct session
+{
+    void *mem;
+    uint64_t mem_size;
+    int timing; // Clock service started
+    int mapped; // mapping_init (and channel discovery) done
+
+    // Calibration state
+    const char *threshold_source; // "config" until a stage calibrates it
+    uint64_t threshold;           // Hit/conflict boundary, epoch 0 timer units
+    double hit_median;
+    double conflict_median;
+};
+
+typedef int (*stage_fn)(struct session *s);
+
+struct stage
+{
+    const char *name;
+    int needs_buffer; // Buffer and clock service
+    stage_fn run;
+    const char *help;
+};
+
+static double ticks_to_ns(double ticks)
+{
+    double rate = timestamp_ticks_per_ns();
+    return rate > 0 ? ticks / rate : 0.0;
+}
+
+/*
+ * session_map
+ *
+ * Sets up the mapping for the session's buffer once, fitting channels and
+ * ranks into it first when channel discovery is on, as hammering does.
+ */
+static int session_map(struct session *s, struct channel_map *channels, int *fitted)
+{
+    *fitted = 0;
+    if (s->mapped)
+        return 0;
+    if (mapping_init((enum mapping_mode) config.mapping_mode, s->mem, s->mem_size, NULL) < 0)
+        return -1;
+    if (config.channel_discovery)
+        *fitted = channel_refine_mapping(measure_concurrent_throughput, s->mem, s->mem_size, channels) > 0;
+    s->mapped = 1;
+    return 0;
+}
+
+static void report_histogram(const uint64_t *hist)
+{
+    report_table("latency_histogram", "bucket,pairs,bucket_start");
+    for (int i = 0; i < 100; i++)
+        report_row("[%d-%d),%15llu,%d", i * 10, i * 10 + 10, (unsigned long long) hist[i], i * 10);
+    report_row("[%d),%15llu,%d", 100 * 10, (unsigned long long) hist[100], 100 * 10);
+}
+
+// Median of config.samples guarded samples of every pair, split by Otsu's
+// threshold into hits and conflicts.
+static int run_calibrate(struct session *s)
+{
+    struct pair_sampler pairs;
+    pair_sampler_init(&pairs, PAIRS_UNIFORM, s->mem, s->mem_size, config.row_size, config.pair_seed,
+                      CALIBRATE_PAIRS, config.pair_budget_sec);
+    struct telemetry_counters *tc = telemetry_thread_counters();
+    telemetry_start("calibrate", CALIBRATE_PAIRS);
+
+    struct latency_dist dist;
+    dist_init(&dist, 0);
+    std::vector<uint64_t> lat(config.samples);
+    uint64_t addr_A, addr_B;
+    while (pair_sampler_next(&pairs, &addr_A, &addr_B)) {
+        for (uint64_t i = 0; i < config.samples; i++)
+            lat[i] = clock_normalize(guard_measure_default(addr_A, addr_B), clock_epoch());
+        std::nth_element(lat.begin(), lat.begin() + lat.size() / 2, lat.end());
+        dist_add(&dist, (double) lat[lat.size() / 2], 1);
+        telemetry_add(tc->measurements, config.samples);
+        telemetry_add(tc->rows_done, 1);
+    }
+    telemetry_stop();
+    dist_finish(&dist);
+
+    struct dist_modes m;
+    dist_split(&dist, &m);
+    uint64_t configured = config.conflict_latency;
+    int found = m.threshold >= 0 && m.conflict_fraction > 0;
+    if (found) {
+        // Every later stage, and the library code it calls, reads it from config.
+        s->threshold_source = "calibrate";
+        s->threshold = (uint64_t) (m.threshold + 0.5);
+        s->hit_median = m.hit_median;
+        s->conflict_median = m.conflict_median;
+        config.conflict_latency = s->threshold;
+    }
+
+    report_value("pairs", "%.0f", dist.total);
+    report_value("samples_per_pair", "%llu", (unsigned long long) config.samples);
+    report_value("ticks_per_ns", "%.4f", timestamp_ticks_per_ns());
+    report_value("clock_epochs", "%u", clock_epoch() + 1);
+    report_value("configured_threshold", "%llu", (unsigned long long) configured);
+    report_value("bimodal", "%s", found ? "yes" : "no");
+    report_value("threshold", "%llu", (unsigned long long) s->threshold);
+    report_value("threshold_ns", "%.1f", ticks_to_ns(s->threshold));
+    report_value("hit_median", "%.1f", m.hit_median);
+    report_value("conflict_median", "%.1f", m.conflict_median);
+    report_value("separation", "%.1f", m.separation);
+    report_value("conflict_fraction", "%.4f", m.conflict_fraction);
+    report_table("latency_quantiles", "quantile,latency,latency_ns");
+    static const double quantiles[] = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+    for (double q : quantiles) {
+        double v = dist_quantile(&dist, q);
+        report_row("%.2f,%.1f,%.1f", q, v, ticks_to_ns(v));
+    }
+    return found ? 0 : 1;
+}
+
+// histogram's sweep, under the session threshold.
+static int run_histogram(struct session *s)
+{
+    const uint64_t num_rows = s->mem_size / config.row_size;
+    uint64_t max_pairs = config.pair_budget_pairs ? config.pair_budget_pairs : num_rows - 1;
+    struct latency_sweep sweep;
+    latency_sweep_init(&sweep, s->mem, s->mem_size, config.pair_seed, max_pairs, s->threshold, config.sample_budget);
+    const char *trace_path = config.trace_path;
+    if (*trace_path)
+        latency_sweep_trace(&sweep, trace_path, "rhbench");
+    latency_sweep_run(&sweep, "histogram");
+    latency_sweep_close(&sweep);
+
+    uint64_t tried;
+    uint64_t rejected = latency_sweep_rejected(&sweep, &tried);
+    report_value("rows", "%llu", (unsigned long long) num_rows);
+    report_value("pair_mode", "%s", pair_mode_name(sweep.pairs.mode));
+    report_value("pair_seed", "%llu", (unsigned long long) config.pair_seed);
+    report_value("row_order", "%s", order_mode_name((enum order_mode) config.order));
+    report_value("order_min_distance", "%llu", (unsigned long long) sweep.pairs.order.min_distance);
+    report_value("threshold", "%llu", (unsigned long long) sweep.sampler.threshold);
+    report_value("threshold_source", "%s", s->threshold_source);
+    report_value("pairs_measured", "%llu", (unsigned long long) sweep.sampler.pairs_done);
+    report_value("conflict_pairs", "%llu", (unsigned long long) sweep.conflicts);
+    report_value("ambiguous_pairs", "%llu", (unsigned long long) sweep.sampler.pairs_ambiguous);
+    report_value("total_samples", "%llu", (unsigned long long) sweep.sampler.samples_taken);
+    report_value("rejected_samples", "%llu", (unsigned long long) rejected);
+    report_value("reject_rate", "%.4f", tried ? (double) rejected / tried : 0.0);
+    report_value("clock_epochs", "%u", clock_epoch() + 1);
+    report_value("max_clock_drift", "%.4f", clock_max_drift());
+    report_value("trace", "%s", sweep.trace.total_samples ? trace_path : "none");
+    report_histogram(sweep.histogram);
+    if (sweep.pairs.mode == PAIRS_BITFLIP) {
+        report_table("bitflip", "bit,pairs,conflict_fraction");
+        for (unsigned bit = sweep.pairs.min_bit; bit < sweep.pairs.min_bit + sweep.pairs.num_bits; bit++)
+            report_row("%u,%llu,%.4f", bit, (unsigned long long) sweep.bit_pairs[bit],
+                       sweep.bit_pairs[bit] ? (double) sweep.bit_conflicts[bit] / sweep.bit_pairs[bit] : 0.0);
+    }
+    return sweep.sampler.pairs_done ? 0 : 1;
+}
+
+// tme's Experiment-1A, on the session buffer.
+static int run_cache_sweep(struct session *s)
+{
+    struct cache_sweep_result r;
+    int rc = cache_sweep(s->mem, s->mem_size, CACHE_SWEEP_MAX_BYTES, CACHE_SWEEP_SAMPLES, &r);
+    report_value("samples", "%d", CACHE_SWEEP_SAMPLES);
+    report_value("hit_latency", "%.1f", r.hit_latency);
+    report_value("miss_latency", "%.1f", r.miss_latency);
+    report_value("cached_bytes", "%llu", (unsigned long long) r.cached_bytes);
+    report_table("reload_latency", "working_set_bytes,mean,median,median_ns");
+    for (int i = 0; i < r.num_points; i++)
+        report_row("%llu,%.2f,%.1f,%.1f", (unsigned long long) r.point[i].bytes, r.point[i].mean, r.point[i].median,
+                   ticks_to_ns(r.point[i].median));
+    return rc ? 1 : 0;
+}
+
+// tme's Experiment-1B.
+static int run_flush_bench(struct session *s)
+{
+    struct flush_bench_result r;
+    flush_bench(s->mem, &r);
+    report_value("samples", "%d", r.samples);
+    report_value("hit_mean", "%.2f", r.hit_mean);
+    report_value("flushed_mean", "%.2f", r.flushed_mean);
+    report_value("hit_median", "%.1f", r.hit_median);
+    report_value("flushed_median", "%.1f", r.flushed_median);
+    report_value("flush_evicts", "%s", r.flush_works ? "yes" : "no");
+    report_table("flush_samples", "sample,hit,flushed");
+    for (int i = 0; i < r.samples; i++)
+        report_row("%d,%llu,%llu", i, (unsigned long long) r.hit[i], (unsigned long long) r.flushed[i]);
+    // A flush that does not evict is a result, not a failure.
+    return 0;
+}
+
+static int run_map(struct session *s)
+{
+    int was_mapped = s->mapped, fitted = 0;
+    struct channel_map *channels = (struct channel_map *) calloc(1, sizeof(struct channel_map));
+    if (session_map(s, channels, &fitted)) {
+        free(channels);
+        report_value("mapping", "failed");
+        return 1;
+    }
+    report_value("mapping", "%s", mapping_mode_name(mapping_current_mode()));
+    report_value("threshold", "%llu", (unsigned long long) config.conflict_latency);
+    report_value("threshold_source", "%s", s->threshold_source);
+    if (!was_mapped && channels->num_groups) {
+        report_value("bank_groups_probed", "%d", channels->num_groups);
+        report_value("channels", "%d", channels->num_channels);
+        report_value("ranks", "%d", channels->num_ranks);
+        report_value("rank_split", "%.4f", channels->rank_split);
+        report_value("channel_masks_fitted", "%s", fitted ? "yes" : "no");
+    }
+    free(channels);
+
+    // Bank of the first rows of the buffer
+    uint64_t rows = std::min<uint64_t>(s->mem_size / config.row_size, MAP_TALLY_ROWS);
+    std::vector<uint64_t> tally;
+    uint64_t unassigned = 0;
+    for (uint64_t r = 0; r < rows; r++) {
+        int bank = mapping_bank_of((uint64_t) s->mem + r * config.row_size);
+        if (bank < 0) {
+            unassigned++;
+            continue;
+        }
+        if ((size_t) bank >= tally.size())
+            tally.resize(bank + 1);
+        tally[bank]++;
+    }
+    report_value("rows_tallied", "%llu", (unsigned long long) rows);
+    report_value("rows_unassigned", "%llu", (unsigned long long) unassigned);
+    report_table("rows_per_bank", "bank,rows");
+    for (size_t b = 0; b < tally.size(); b++) {
+        if (tally[b])
+            report_row("%zu,%llu", b, (unsigned long long) tally[b]);
+    }
+    mapping_report();
+    return 0;
+}
+
+// hammerfuzz's campaign, on the session mapping.
+static int run_hammer(struct session *s)
+{
+    int fitted;
+    struct channel_map *channels = (struct channel_map *) calloc(1, sizeof(struct channel_map));
+    int rc = session_map(s, channels, &fitted);
+    free(channels);
+    if (rc) {
+        report_value("mapping", "failed");
+        return 1;
+    }
+
+    struct fuzz_result *res = (struct fuzz_result *) calloc(1, sizeof(struct fuzz_result));
+    telemetry_start("fuzz", config.fuzz_trials);
+    int found = !fuzz_campaign(s->mem, s->mem_size, config.pair_seed, config.fuzz_budget_sec, config.fuzz_trials,
+                               config.fuzz_activations, res);
+    telemetry_stop();
+
+    char text[OUTPUT_LINE_MAX / 2] = "none";
+    if (res->have_best && res->best.flips)
+        fuzz_pattern_string(&res->best.pattern, text, sizeof(text));
+    report_value("mapping", "%s", mapping_mode_name(mapping_current_mode()));
+    report_value("threshold", "%llu", (unsigned long long) config.conflict_latency);
+    report_value("trials", "%llu", (unsigned long long) res->trials);
+    report_value("unplaced", "%llu", (unsigned long long) res->unplaced);
+    report_value("wall_seconds", "%.1f", res->wall_ns / 1e9);
+    report_value("flips", "%llu", (unsigned long long) res->flips);
+    report_value("flipping_trials", "%llu", (unsigned long long) res->num_logged);
+    report_value("best_pattern", "%s", text);
+    report_value("best_flips_per_second", "%.4f", res->have_best ? res->best.score : 0.0);
+    report_value("best_activations_per_second", "%.0f", res->have_best ? res->best.acts_per_sec : 0.0);
+
+    report_table("fuzz_regions", "pairs,trials,flipping,flips,wall_seconds,mean_score");
+    for (unsigned n = 1; n <= FUZZ_MAX_PAIRS; n++) {
+        const struct fuzz_region *g = &res->region[n];
+        report_row("%u,%llu,%llu,%llu,%.3f,%.4f", n, (unsigned long long) g->trials, (unsigned long long) g->flipping,
+                   (unsigned long long) g->flips, g->wall_ns / 1e9, g->trials ? g->score_sum / g->trials : 0.0);
+    }
+    report_table("fuzz_flips", "trial,pairs,slots,activations,activations_per_second,flips,score,anchor,pattern");
+    uint64_t shown = std::min<uint64_t>(res->num_logged, FUZZ_MAX_LOGGED);
+    for (uint64_t i = 0; i < shown; i++) {
+        const struct fuzz_trial *t = &res->logged[i];
+        fuzz_pattern_string(&t->pattern, text, sizeof(text));
+        report_row("%llu,%u,%u,%llu,%.0f,%u,%.4f,0x%llx,%s", (unsigned long long) t->trial, t->pattern.num_pairs,
+                   t->num_slots, (unsigned long long) t->activations, t->acts_per_sec, t->flips, t->score,
+                   (unsigned long long) t->anchor, text);
+    }
+    free(res);
+    return found ? 0 : 1;
+}
+
+// replay's analysis of the trace at --trace_path, e.g. the one an earlier
+// histogram stage of the session just wrote.
+static int run_replay(struct session *s)
+{
+    const char *path = config.trace_path;
+    report_value("trace", "%s", *path ? path : "none");
+    if (!*path) {
+        output_log("[-] replay: no --trace_path\n");
+        return 1;
+    }
+    struct trace_reader reader;
+    if (trace_reader_open(&reader, path))
+        return 1;
+    struct replay_run run;
+    if (replay_load(&reader, &run)) {
+        trace_reader_close(&reader);
+        return 1;
+    }
+
+    uint64_t derived = replay_threshold(&run);
+    report_value("trace_bytes", "%zu", reader.size);
+    report_value("recorded_by", "%s", trace_meta_get(&reader, "binary", "unknown").c_str());
+    report_value("pairs_measured", "%zu", run.pairs.size());
+    report_value("total_samples", "%llu", (unsigned long long) run.num_samples);
+    report_value("clock_epochs", "%zu", run.epoch_rate.size());
+    report_value("truncated", "%d", run.truncated);
+    report_value("recorded_threshold", "%llu", (unsigned long long) run.threshold);
+    report_value("derived_threshold", "%llu", (unsigned long long) derived);
+
+    uint64_t hist[101];
+    replay_histogram(&run, 10, hist, 101);
+    report_histogram(hist);
+
+    report_table("decisions", "threshold_source,threshold,threshold_ns,hit,conflict,ambiguous");
+    const char *sources[2] = {"recorded", "derived"};
+    uint64_t thresholds[2] = {run.threshold, derived};
+    for (int i = 0; i < 2; i++) {
+        uint64_t count[3] = {0, 0, 0};
+        for (const struct replay_pair &p : run.pairs) {
+            if (p.num_samples)
+                count[replay_decide(&run, &p, thresholds[i])]++;
+        }
+        report_row("%s,%llu,%.1f,%llu,%llu,%llu", sources[i], (unsigned long long) thresholds[i],
+                   run.ticks_per_ns > 0 ? thresholds[i] / run.ticks_per_ns : 0.0, (unsigned long long) count[PAIR_HIT],
+                   (unsigned long long) count[PAIR_CONFLICT], (unsigned long long) count[PAIR_AMBIGUOUS]);
+    }
+
+    std::vector<uint64_t> clusters = replay_clusters(&run, run.threshold);
+    report_table("bank_clusters", "cluster,addresses");
+    for (size_t c = 0; c < clusters.size() && c < REPLAY_MAX_CLUSTERS; c++)
+        report_row("%zu,%llu", c, (unsigned long long) clusters[c]);
+    trace_reader_close(&reader);
+    (void) s;
+    return 0;
+}
+
+static const struct stage stages[] = {
+    {"calibrate", 1, run_calibrate, "Hit/conflict threshold for the stages after it"},
+    {"histogram", 1, run_histogram, "Pair latency histogram (as histogram)"},
+    {"cache-sweep", 1, run_cache_sweep, "Reload latency by working-set size (tme, Experiment-1A)"},
+    {"flush-bench", 1, run_flush_bench, "Whether a flush evicts from user space (tme, Experiment-1B)"},
+    {"map", 1, run_map, "Mapping backend, channels and rows per bank"},
+    {"hammer", 1, run_hammer, "Hammer pattern fuzzing campaign (as hammerfuzz)"},
+    {"replay", 0, run_replay, "Tables of the trace at --trace_path (as replay)"},
+};
+
+#define NUM_STAGES (sizeof(stages) / sizeof(stages[0]))
+
+static const struct stage *find_stage(const char *name)
+{
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        if (!strcmp(stages[i].name, name))
+            return &stages[i];
+    }
+    return NULL;
+}
+
+static void usage(const char *argv0)
+{
+    output_log("usage: %s [--key=value ...] <stage> [<stage> ...]\n", argv0);
+    for (size_t i = 0; i < NUM_STAGES; i++)
+        output_log("  %-12s %s\n", stages[i].name, stages[i].help);
+}
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Every stage name is checked before any memory is touched.
+    std::vector<const struct stage *> run;
+    int needs_buffer = 0;
+    for (int i = 1; i < argc; i++) {
+        const struct stage *st = find_stage(argv[i]);
+        if (!st) {
+            output_log("[-] Unknown stage %s\n", argv[i]);
+            usage(argv[0]);
+            return 2;
+        }
+        run.push_back(st);
+        needs_buffer |= st->needs_buffer;
+    }
+
+    struct session s;
+    memset(&s, 0, sizeof(s));
+    s.threshold_source = "config";
+    s.threshold = config.conflict_latency;
+    if (needs_buffer) {
+        timing_init();
+        s.timing = 1;
+        s.mem_size = config_buffer_bytes();
+        s.mem = allocated_mem = allocate_pages(s.mem_size);
+        guard_init(&default_guard, config.prewarm ? measure_bank_latency_prewarm : measure_bank_latency);
+    }
+
+    report_init((enum report_format) config.output_format);
+    report_begin("session");
+    std::string names;
+    for (const struct stage *st : run)
+        names += std::string(names.empty() ? "" : " ") + st->name;
+    report_value("stages", "%s", names.c_str());
+    report_value("schema", "%d", REPORT_SCHEMA_VERSION);
+    report_value("buffer_bytes", "%llu", (unsigned long long) s.mem_size);
+    report_value("backing", "%s", s.mem ? allocated_backing : "none");
+#ifdef MEASURE_SIM
+    report_value("timer", "dramsim");
+#elif defined(TIMING_PTHREAD)
+    report_value("timer", "%s", timer_name(TIMER_COUNTER_THREAD));
+#else
+    report_value("timer", "%s", timer_name(TIMER_CLOCK_GETTIME));
+#endif
+    report_value("ticks_per_ns", "%.4f", s.timing ? timestamp_ticks_per_ns() : 0.0);
+    report_value("row_size", "%llu", (unsigned long long) config.row_size);
+    report_value("threshold", "%llu", (unsigned long long) s.threshold);
+    report_end(0);
+
+    int status = 0;
+    for (const struct stage *st : run) {
+        uint64_t start = monotonic_ns();
+        report_begin(st->name);
+        int stage_rc = st->run(&s);
+        report_end(stage_rc);
+        output_log("[%c] %s: status %d in %.2f s\n", stage_rc ? '-' : '+', st->name, stage_rc,
+                   (monotonic_ns() - start) / 1e9);
+        if (stage_rc && !status)
+            status = stage_rc;
+    }
+
+    if (s.timing) {
+        guard_report(&default_guard);
+        clock_report();
+        clock_service_stop();
+    }
+    output_shutdown();
+    return status;
+}
@@ -0,0 +1,290 @@
+#include "rowbuf.hh"
+#include "config.hh"
+#include "output.hh"
+#include "shared.hh"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/*
+ * same_row_partner
+ *
+ * Another column of addr's row: addr with one column bit (between a line
+ * and the row size) flipped, highest first, that the mapping keeps in addr's
+ * row and bank. 0 if none does.
+ */
+static uint64_t same_row_partner(uint64_t addr, uint64_t base, uint64_t size, int bank)
+{
+  for (uint64_t bit = config.row_size / 2; bit >= PAIRS_LINE_SIZE; bit >>= 1)
+  {
+    uint64_t c = addr ^ bit;
+    if (c < base || c >= base + size)
+      continue;
+    if (mapping_row_of(c) == mapping_row_of(addr) && mapping_bank_of(c) == bank)
+      return c;
+  }
+  return 0;
+}
+
+int rowbuf_build(void *base, uint64_t size, uint64_t seed, struct rowbuf_result *r)
+{
+  std::mt19937_64 rng(seed);
+  uint64_t b = (uint64_t)base;
+  uint64_t lines = size / PAIRS_LINE_SIZE;
+  r->num_pairs = 0;
+  for (int i = 0; i < ROWBUF_PAIRS; i++)
+  {
+    uint64_t a = b + rng() % lines * PAIRS_LINE_SIZE;
+    int bank = mapping_bank_of(a);
+    if (bank < 0)
+      continue;
+
+    uint64_t same = same_row_partner(a, b, size, bank);
+    uint64_t up = 0, down = 0;
+    mapping_aggressors(a, ROWBUF_ROW_DISTANCE, &up, &down);
+    uint64_t other = 0;
+    for (int t = 0; t < ROWBUF_BANK_TRIES && !other; t++)
+    {
+      uint64_t c = b + rng() % lines * PAIRS_LINE_SIZE;
+      int cb = mapping_bank_of(c);
+      if (cb >= 0 && cb != bank)
+        other = c;
+    }
+    if (!same || !(up || down) || !other)
+      continue;
+
+    int n = r->num_pairs++;
+    r->anchor[n] = a;
+    r->partner[ROWBUF_SAME_ROW][n] = same;
+    r->partner[ROWBUF_DIFF_ROW][n] = up ? up : down;
+    r->partner[ROWBUF_DIFF_BANK][n] = other;
+  }
+  output_log("[%c] rowbuf: %d of %d anchors with a partner of every class\n", r->num_pairs ? '+' : '-', r->num_pairs,
+             ROWBUF_PAIRS);
+  return r->num_pairs;
+}
+
+// Value at quantile q of v (reordered).
+static double quantile_of(std::vector<double> &v, double q)
+{
+  if (v.empty())
+    return 0;
+  size_t k = std::min(v.size() - 1, (size_t)(q * v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+// Times every class, interleaved pair by pair.
+static void measure_classes(measure_fn fn, struct rowbuf_result *r)
+{
+  std::vector<double> lat[ROWBUF_CLASSES];
+  for (int c = 0; c < ROWBUF_CLASSES; c++)
+    lat[c].reserve((size_t)r->num_pairs * ROWBUF_ROUNDS);
+  for (int round = 0; round < ROWBUF_ROUNDS; round++)
+    for (int p = 0; p < r->num_pairs; p++)
+      for (int c = 0; c < ROWBUF_CLASSES; c++)
+        lat[c].push_back((double)fn(r->anchor[p], r->partner[c][p]));
+
+  for (int c = 0; c < ROWBUF_CLASSES; c++)
+  {
+    struct rowbuf_class_stats *s = &r->cls[c];
+    s->pairs = r->num_pairs;
+    s->samples = lat[c].size();
+    s->p25 = quantile_of(lat[c], 0.25);
+    s->median = quantile_of(lat[c], 0.5);
+    s->p75 = quantile_of(lat[c], 0.75);
+  }
+}
+
+// Throughput of every class with ROWBUF_STREAM_PAIRS pairs in flight, over
+// ROWBUF_STREAM_SETS sets of anchors, the classes interleaved set by set.
+static void measure_classes_concurrent(struct rowbuf_result *r)
+{
+  int per_set = std::min(ROWBUF_STREAM_PAIRS, r->num_pairs);
+  std::vector<double> rate[ROWBUF_CLASSES];
+  std::vector<uint64_t> addrs(2 * per_set);
+  for (int set = 0; set < ROWBUF_STREAM_SETS; set++)
+    for (int c = 0; c < ROWBUF_CLASSES; c++)
+    {
+      for (int i = 0; i < per_set; i++)
+      {
+        int p = (set * per_set + i) % r->num_pairs;
+        addrs[2 * i] = r->anchor[p];
+        addrs[2 * i + 1] = r->partner[c][p];
+      }
+      rate[c].push_back(measure_concurrent_throughput(addrs.data(), (int)addrs.size()));
+    }
+
+  for (int c = 0; c < ROWBUF_CLASSES; c++)
+    r->cls[c].throughput = quantile_of(rate[c], 0.5);
+}
+
+struct idle_sample
+{
+  double gap_ns;
+  double latency;
+};
+
+/*
+ * best_split
+ *
+ * Gap that best separates fast from slow second loads in samples (sorted by
+ * gap): the split with the fewest slow samples before it and fast ones after.
+ */
+static double best_split(const std::vector<struct idle_sample> &samples, double level)
+{
+  // Errors of splitting before sample 0: every fast sample is on the wrong side.
+  long errors = 0;
+  for (const struct idle_sample &s : samples)
+    errors += s.latency <= level;
+  long best_errors = errors;
+  size_t best = 0;
+  for (size_t k = 0; k < samples.size(); k++)
+  {
+    errors += samples[k].latency > level ? 1 : -1;
+    if (errors < best_errors)
+    {
+      best_errors = errors;
+      best = k + 1;
+    }
+  }
+  if (best == 0)
+    return 0;
+  if (best == samples.size())
+    return samples.back().gap_ns;
+  return (samples[best - 1].gap_ns + samples[best].gap_ns) / 2;
+}
+
+int rowbuf_measure(measure_fn fn, struct rowbuf_result *r)
+{
+  r->policy = ROWBUF_UNKNOWN;
+  r->timeout_ns = 0;
+  r->num_bins = 0;
+  if (r->num_pairs == 0)
+    return -1;
+  measure_classes(fn, r);
+  measure_classes_concurrent(r);
+
+  // Idle sweep. Anchors rotate so that no row is reopened right away.
+  double ticks_per_ns = timestamp_ticks_per_ns();
+  std::vector<double> delays(1, 0.0);
+  for (double d = ROWBUF_MIN_DELAY_NS; d <= ROWBUF_MAX_DELAY_NS && (int)delays.size() < ROWBUF_MAX_BINS;
+       d *= ROWBUF_DELAY_RATIO)
+    delays.push_back(d);
+
+  std::vector<struct idle_sample> samples;
+  samples.reserve(delays.size() * ROWBUF_DELAY_SAMPLES);
+  std::vector<double> conflict;
+  int p = 0;
+  for (double d : delays)
+  {
+    for (int i = 0; i < ROWBUF_DELAY_SAMPLES; i++, p = (p + 1) % r->num_pairs)
+    {
+      uint64_t t_open, t_load;
+      measure_access(r->anchor[p], &t_open);
+      measure_idle_ns(d);
+      double lat = (double)measure_access(r->partner[ROWBUF_SAME_ROW][p], &t_load);
+      samples.push_back({(t_load - t_open) / ticks_per_ns, lat});
+    }
+  }
+  // Reference: a load into another row of the bank just opened.
+  for (int i = 0; i < ROWBUF_DELAY_SAMPLES; i++, p = (p + 1) % r->num_pairs)
+  {
+    uint64_t t;
+    measure_access(r->anchor[p], &t);
+    conflict.push_back((double)measure_access(r->partner[ROWBUF_DIFF_ROW][p], &t));
+  }
+
+  std::sort(samples.begin(), samples.end(),
+            [](const struct idle_sample &a, const struct idle_sample &b) { return a.gap_ns < b.gap_ns; });
+  for (size_t first = 0; first + ROWBUF_DELAY_SAMPLES <= samples.size(); first += ROWBUF_DELAY_SAMPLES)
+  {
+    std::vector<double> gap, lat;
+    for (size_t i = first; i < first + ROWBUF_DELAY_SAMPLES; i++)
+    {
+      gap.push_back(samples[i].gap_ns);
+      lat.push_back(samples[i].latency);
+    }
+    r->bin[r->num_bins].gap_ns = quantile_of(gap, 0.5);
+    r->bin[r->num_bins].latency = quantile_of(lat, 0.5);
+    r->num_bins++;
+  }
+  if (r->num_bins < 2)
+    return -1;
+
+  r->hit_latency = r->bin[0].latency;
+  r->far_latency = r->bin[r->num_bins - 1].latency;
+  r->conflict_latency = quantile_of(conflict, 0.5);
+  double scale = r->conflict_latency - r->hit_latency;
+  r->pair_conflicts = r->cls[ROWBUF_DIFF_ROW].median - r->cls[ROWBUF_SAME_ROW].median >
+                      ROWBUF_MIN_GAP * r->cls[ROWBUF_SAME_ROW].median;
+
+  if (scale < ROWBUF_MIN_GAP * r->hit_latency)
+  {
+    // Not even the shortest gap finds the row open.
+    r->policy = ROWBUF_CLOSED_PAGE;
+    r->timeout_ns = 0;
+  }
+  else if (r->far_latency - r->hit_latency < ROWBUF_STEP_FRACTION * scale)
+    r->policy = ROWBUF_OPEN_PAGE;
+  else
+  {
+    r->policy = ROWBUF_CLOSED_PAGE;
+    r->timeout_ns = best_split(samples, (r->hit_latency + r->far_latency) / 2);
+  }
+  return 0;
+}
+
+const char *rowbuf_class_name(enum rowbuf_class c)
+{
+  switch (c)
+  {
+  case ROWBUF_SAME_ROW:
+    return "same-row";
+  case ROWBUF_DIFF_ROW:
+    return "diff-row";
+  case ROWBUF_DIFF_BANK:
+    return "diff-bank";
+  default:
+    return "unknown";
+  }
+}
+
+const char *rowbuf_policy_name(enum rowbuf_policy p)
+{
+  switch (p)
+  {
+  case ROWBUF_OPEN_PAGE:
+    return "open-page";
+  case ROWBUF_CLOSED_PAGE:
+    return "closed-page";
+  default:
+    return "unknown";
+  }
+}
+
+void rowbuf_print(const struct rowbuf_result *r)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Row-Buffer-Classes\n");
+  output_printf("Class,Pairs,Samples,P25,Median,P75,Throughput\n");
+  for (int c = 0; c < ROWBUF_CLASSES; c++)
+  {
+    const struct rowbuf_class_stats *s = &r->cls[c];
+    output_printf("%s,%d,%llu,%.0f,%.0f,%.0f,%.4f\n", rowbuf_class_name((enum rowbuf_class)c), s->pairs,
+                  (unsigned long long)s->samples, s->p25, s->median, s->p75, s->throughput);
+  }
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Row-Buffer-Idle-Sweep\n");
+  output_printf("Gap-NS,Latency\n");
+  for (int i = 0; i < r->num_bins; i++)
+    output_printf("%.1f,%.0f\n", r->bin[i].gap_ns, r->bin[i].latency);
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Row-Buffer-Policy\n");
+  output_printf("Policy,Timeout-NS,Hit-Latency,Far-Latency,Conflict-Latency,Pair-Conflicts\n");
+  output_printf("%s,%.1f,%.0f,%.0f,%.0f,%s\n", rowbuf_policy_name(r->policy), r->timeout_ns, r->hit_latency,
+                r->far_latency, r->conflict_latency, r->pair_conflicts ? "yes" : "no");
+}
@@ -0,0 +1,119 @@
+#ifndef ROWBUF_GUARD
+#define ROWBUF_GUARD
+
+#include <stdint.h>
+
+#include "mapping.hh"
+#include "params.hh"
+#include "sampler.hh"
+
+// Row-buffer policy detection.
+//
+// Histogram pairs mix every relation between two addresses. Here the mapping
+// backend builds three classes of pairs from the same anchors instead:
+//   - same row, same bank: another column of the anchor's row,
+//   - different row, same bank: the anchor's column a few rows away,
+//   - different bank,
+// and each class is timed with measure_bank_latency over ROWBUF_PAIRS pairs,
+// ROWBUF_ROUNDS times each, the classes interleaved pair by pair so drift
+// hits all of them alike. Each class is also measured with many pairs in
+// flight: measure_concurrent_throughput streams ROWBUF_STREAM_PAIRS pairs at
+// once, so row hits overlap, same-bank row conflicts queue on the bank and
+// different banks work in parallel.
+//
+// The pairs give the costs, but not the policy: a pair's two loads follow
+// each other too closely for any page timeout to expire between them. So a
+// second measurement opens a row with one load, waits, and times a load of
+// another column of that row. While the row stays open the second load is a
+// row hit; once the controller has closed it, it costs an activation. The
+// gap between the two loads is taken from their timestamps, so it includes
+// the first load itself, and the samples are binned by it: a latency step
+// at some gap is a closed-page policy with that timeout, no step up to
+// ROWBUF_MAX_DELAY_NS is an open-page policy. The sweep stays well below the
+// refresh interval, since a REF closes every row whatever the policy.
+
+enum rowbuf_class
+{
+  ROWBUF_SAME_ROW = 0,  // Same bank, same row
+  ROWBUF_DIFF_ROW = 1,  // Same bank, different row
+  ROWBUF_DIFF_BANK = 2,
+  ROWBUF_CLASSES = 3,
+};
+
+enum rowbuf_policy
+{
+  ROWBUF_UNKNOWN = 0,
+  ROWBUF_OPEN_PAGE = 1,
+  ROWBUF_CLOSED_PAGE = 2,
+};
+
+struct rowbuf_class_stats
+{
+  int pairs;
+  uint64_t samples;
+  double median; // Timer units
+  double p25;
+  double p75;
+  double throughput; // Accesses per ns with pairs in flight (per tick with MEASURE_SIM)
+};
+
+// One bin of the idle sweep: ROWBUF_DELAY_SAMPLES samples of similar gap.
+struct rowbuf_bin
+{
+  double gap_ns;  // Median gap between the opening load and the timed one
+  double latency; // Median latency of the timed load, timer units
+};
+
+struct rowbuf_result
+{
+  // Address sets: anchor and partner of each class
+  int num_pairs;
+  uint64_t anchor[ROWBUF_PAIRS];
+  uint64_t partner[ROWBUF_CLASSES][ROWBUF_PAIRS];
+
+  struct rowbuf_class_stats cls[ROWBUF_CLASSES];
+
+  int num_bins;
+  struct rowbuf_bin bin[ROWBUF_MAX_BINS];
+  double hit_latency;      // Second load into a just-opened row
+  double conflict_latency; // Load into another row of a just-opened bank
+  double far_latency;      // Second load at the longest gap
+
+  enum rowbuf_policy policy;
+  double timeout_ns; // Closed page: gap at which rows close, 0 if below the shortest gap
+  int pair_conflicts; // Alternating two rows of one bank costs more than one row
+};
+
+/*
+ * rowbuf_build
+ *
+ * Picks ROWBUF_PAIRS anchors in the buffer (seeded by seed) and, through the
+ * mapping backend, a partner of each class for each. Anchors without all
+ * three partners are dropped.
+ *
+ * Inputs: base/size - Buffer; mapping_init must have been called on it
+ * Outputs: r->anchor, r->partner, r->num_pairs
+ * Returns: Number of complete anchors
+ */
+int rowbuf_build(void *base, uint64_t size, uint64_t seed, struct rowbuf_result *r);
+
+/*
+ * rowbuf_measure
+ *
+ * Times every class, one pair at a time with fn and many at once with
+ * measure_concurrent_throughput, then runs the idle sweep with
+ * measure_access and decides the policy.
+ *
+ * Inputs: fn - Pair measurement (guard_measure_default or measure_bank_latency)
+ *         r - Address sets from rowbuf_build
+ * Outputs: r - Class statistics, sweep bins and the policy
+ * Returns: 0 if a policy was decided, -1 otherwise
+ */
+int rowbuf_measure(measure_fn fn, struct rowbuf_result *r);
+
+const char *rowbuf_class_name(enum rowbuf_class c);
+const char *rowbuf_policy_name(enum rowbuf_policy p);
+
+void rowbuf_print(const struct rowbuf_result *r);
+
+#endif
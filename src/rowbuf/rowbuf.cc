@@ -0,0 +1,54 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../guard.hh"
+#include "../timer.hh"
+#include "../mapping.hh"
+#include "../rowbuf.hh"
+
+// Row-buffer policy: times same-row, different-row and different-bank pairs
+// built from the mapping, then sweeps the idle time between two loads of one
+// row to tell an open-page controller from a closed-page one and its timeout.
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t buffer_size_bytes = config_buffer_bytes();
+    allocated_mem = allocate_pages(buffer_size_bytes);
+    if (mapping_init((enum mapping_mode) config.mapping_mode, allocated_mem, buffer_size_bytes, NULL) < 0)
+        return -1;
+    guard_init(&default_guard, config.prewarm ? measure_bank_latency_prewarm : measure_bank_latency);
+
+    struct rowbuf_result *res = (struct rowbuf_result *) calloc(1, sizeof(struct rowbuf_result));
+    rowbuf_build(allocated_mem, buffer_size_bytes, ROWBUF_SEED, res);
+    int found = !rowbuf_measure(guard_measure_default, res);
+    mapping_report();
+    guard_report(&default_guard);
+    clock_report();
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Row-buffer policy\n");
+    output_printf("Mapping, %s\n", mapping_mode_name(mapping_current_mode()));
+    output_printf("Row size, %llu\n", (unsigned long long) config.row_size);
+    output_printf("Anchors, %d\n", res->num_pairs);
+    output_printf("Rounds, %d\n", ROWBUF_ROUNDS);
+    output_printf("Ticks per ns, %.4f\n", timestamp_ticks_per_ns());
+    output_printf("Policy, %s\n", rowbuf_policy_name(res->policy));
+    if (res->policy == ROWBUF_CLOSED_PAGE)
+        output_printf("Timeout NS, %.1f\n", res->timeout_ns);
+    // Double-sided hammering alternates two rows of one bank; it only
+    // activates on every load if those pairs cost more than one row.
+    output_printf("Hammer pairs activate, %s\n", res->pair_conflicts ? "yes" : "no");
+    rowbuf_print(res);
+
+    free(res);
+    clock_service_stop();
+    output_shutdown();
+    return found ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#include "sampler.hh"
+#include "params.hh"
+#include "timer.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+void sampler_init(struct adaptive_sampler *s, uint64_t threshold, uint64_t budget)
+{
+  s->threshold = threshold;
+  s->budget_left = budget;
+  s->samples_taken = 0;
+  s->pairs_done = 0;
+  s->pairs_ambiguous = 0;
+  s->trace = NULL;
+}
+
+void sampler_trace(struct adaptive_sampler *s, struct trace_writer *trace)
+{
+  s->trace = trace;
+}
+
+int sampler_measure_pair(struct adaptive_sampler *s, measure_fn measure, uint64_t addr_A, uint64_t addr_B,
+                         struct pair_result *out)
+{
+  if (s->budget_left < ADAPTIVE_MIN_SAMPLES)
+    return 0;
+
+  uint64_t samples[ADAPTIVE_MAX_SAMPLES];
+  uint32_t n = 0;
+  int walk = 0; // (#samples >= threshold) - (#samples < threshold)
+  double mean = 0, m2 = 0;
+  if (s->trace)
+    trace_pair(s->trace, (uint32_t)s->pairs_done, addr_A, addr_B);
+
+  while (n < ADAPTIVE_MAX_SAMPLES && s->budget_left > 0)
+  {
+    // Rescale to epoch 0 ticks so the fixed threshold means the same thing
+    // at the end of a long sweep as at the start.
+    uint64_t raw = measure(addr_A, addr_B);
+    uint32_t epoch = clock_epoch();
+    uint64_t t = clock_normalize(raw, epoch);
+    if (s->trace)
+      trace_sample(s->trace, (uint32_t)s->pairs_done, raw, epoch);
+    samples[n++] = t;
+    out->epoch = epoch;
+    s->budget_left--;
+
+    walk += t >= s->threshold ? 1 : -1;
+
+    // Welford's online mean/variance
+    double delta = (double)t - mean;
+    mean += delta / n;
+    m2 += delta * ((double)t - mean);
+
+    if (n >= ADAPTIVE_MIN_SAMPLES && abs(walk) >= ADAPTIVE_SIGN_MARGIN)
+      break;
+  }
+
+  std::nth_element(samples, samples + n / 2, samples + n);
+  out->median = samples[n / 2];
+  out->mean = mean;
+  out->stddev = n > 1 ? sqrt(m2 / (n - 1)) : 0.0;
+  out->num_samples = n;
+
+  if (abs(walk) >= ADAPTIVE_SIGN_MARGIN)
+    out->decision = walk > 0 ? PAIR_CONFLICT : PAIR_HIT;
+  else
+    out->decision = PAIR_AMBIGUOUS;
+
+  s->samples_taken += n;
+  s->pairs_done++;
+  if (out->decision == PAIR_AMBIGUOUS)
+    s->pairs_ambiguous++;
+  return 1;
+}
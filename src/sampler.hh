@@ -0,0 +1,68 @@
+#ifndef SAMPLER_GUARD
+#define SAMPLER_GUARD
+
+#include <stdint.h>
+
+// Adaptive sequential sampler.
+//
+// Instead of averaging a fixed number of samples per address pair, keep
+// sampling a pair only until its median is confidently on one side of the
+// hit/conflict threshold. The stopping rule is a sign test run as an SPRT:
+// every sample above the threshold is a step up, every sample below a step
+// down, and we stop once the walk is ADAPTIVE_SIGN_MARGIN steps from zero.
+// A single interrupted sample can only move the walk by one step, so it no
+// longer corrupts the pair's bucket the way it corrupted the average.
+
+struct trace_writer;
+
+typedef uint64_t (*measure_fn)(uint64_t addr_A, uint64_t addr_B);
+
+enum pair_decision
+{
+  PAIR_HIT = 0,       // Median confidently below the threshold
+  PAIR_CONFLICT = 1,  // Median confidently at or above the threshold
+  PAIR_AMBIGUOUS = 2, // Ran out of per-pair or global samples first
+};
+
+// Statistics are over samples rescaled to clock epoch 0 (see timer.hh).
+struct pair_result
+{
+  uint64_t median;
+  double mean;
+  double stddev;
+  uint32_t num_samples;
+  uint32_t epoch; // Clock epoch of the last sample
+  enum pair_decision decision;
+};
+
+struct adaptive_sampler
+{
+  uint64_t threshold;   // Hit/conflict boundary, in timer units
+  uint64_t budget_left; // Samples left for the whole run
+  uint64_t samples_taken;
+  uint64_t pairs_done;
+  uint64_t pairs_ambiguous;
+  struct trace_writer *trace; // Receives every raw sample if set; pair ids are pairs_done
+};
+
+void sampler_init(struct adaptive_sampler *s, uint64_t threshold, uint64_t budget);
+
+// Records every pair and raw sample from now on to an open trace (NULL stops).
+void sampler_trace(struct adaptive_sampler *s, struct trace_writer *trace);
+
+/*
+ * sampler_measure_pair
+ *
+ * Samples one address pair until the stopping rule fires, the pair reaches
+ * ADAPTIVE_MAX_SAMPLES, or the global budget runs out.
+ *
+ * Inputs: s - Sampler state (threshold and remaining budget)
+ *         measure - Function returning one latency sample for a pair
+ *         addr_A/addr_B - The pair
+ * Outputs: out - Median, mean, deviation and decision for the pair
+ * Returns: 1 if the pair was measured, 0 if the global budget is exhausted
+ */
+int sampler_measure_pair(struct adaptive_sampler *s, measure_fn measure, uint64_t addr_A, uint64_t addr_B,
+                         struct pair_result *out);
+
+#endif
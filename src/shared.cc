@@ -1,4 +1,5 @@
 #include "shared.hh"
+#include "config.hh"
 #include "params.hh"
 #include "util.hh"
 
@@ -6,61 +7,128 @@
 // Seconds to Nanoseconds
 #define SEC_TO_NS(sec) ((sec) * NS_PER_SEC)
 
-#ifdef TIMING_PTHREAD
+#include "timer.hh"
+#include "placement.hh"
+#include "dramsim.hh"
+#include "kernels.hh"
+#include "output.hh"
+
+#include <atomic>
 #include <pthread.h>
-#include <unistd.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#if defined(__APPLE__)
+#include <mach/vm_statistics.h>
 #endif
 
-#ifdef TIMING_PTHREAD
-// Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
-// Uses dedicated thread that increments once per cycle to act as a timing parameter
-// Gururaj said through experience its a good metric to use.
+// Base pointer to a large memory pool
+void *allocated_mem;
 
-int counter_thread_ended = 0;
-uint64_t counter = 0;
+// Page size backing allocated_mem, and how it was obtained
+uint64_t allocated_page_size = PAGE_SIZE;
+const char *allocated_backing = "base";
 
-void *counter_function(void *x_void_ptr)
+#ifndef MEASURE_SIM
+/*
+ * map_huge
+ *
+ * Anonymous mapping of memory_size backed by huge pages: hugetlbfs pages
+ * where the kernel has them reserved, else a huge-page-aligned mapping
+ * advised for transparent huge pages (Linux), or 2 MB superpages (macOS, where
+ * the kernel supports them). NULL if none of these is available.
+ */
+static void *map_huge(uint64_t memory_size)
 {
-  fprintf(stderr, "[+] Counter thread running...\n");
-
-  while (!counter_thread_ended)
+#if defined(MAP_HUGETLB)
+  uint64_t rounded = (memory_size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  void *block = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+  if (block != MAP_FAILED)
   {
-    // printf("Counter = %llu\n", counter);
-    counter++;
+    allocated_page_size = HUGE_PAGE_SIZE;
+    allocated_backing = "hugetlb";
+    return block;
   }
-
-  fprintf(stderr, "[+] Counter thread finished\n");
+#endif
+#if defined(MADV_HUGEPAGE)
+  // Over-allocate by one huge page and trim to an aligned range.
+  uint8_t *raw = (uint8_t *)mmap(NULL, memory_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,
+                                 -1, 0);
+  if (raw != MAP_FAILED)
+  {
+    uint8_t *aligned = (uint8_t *)(((uint64_t)raw + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    if (aligned > raw)
+      munmap(raw, aligned - raw);
+    munmap(aligned + memory_size, raw + HUGE_PAGE_SIZE - aligned);
+    if (!madvise(aligned, memory_size, MADV_HUGEPAGE))
+    {
+      allocated_page_size = HUGE_PAGE_SIZE;
+      allocated_backing = "thp";
+      return aligned;
+    }
+    munmap(aligned, memory_size);
+  }
+#elif defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+  void *block = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+  if (block != MAP_FAILED)
+  {
+    allocated_page_size = HUGE_PAGE_SIZE;
+    allocated_backing = "superpage";
+    return block;
+  }
+#endif
   return NULL;
 }
-
 #endif
 
-// Base pointer to a large memory pool
-void *allocated_mem;
-
 /*
  * allocate_pages
  *
- * Allocates a memory block of size BUFFER_SIZE_MB
+ * Allocates a memory block of memory_size bytes (config_buffer_bytes()
+ * for the measurement buffer)
  *
  * Make sure to write something to each page in the block to ensure
  * that the memory has actually been allocated!
  *
+ * With config.huge_pages the block is backed by huge pages where the system
+ * allows (see allocated_backing), and by base pages otherwise.
+ *
+ * With MEASURE_SIM the buffer only provides addresses for the simulator,
+ * so it is reserved but never touched; config.huge_pages sets the
+ * simulator's translation granule instead.
+ *
  * Inputs: none
  * Outputs: A pointer to the beginning of the allocated memory block
  */
 void *allocate_pages(uint64_t memory_size)
 {
-  void *memory_block = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+#ifdef MEASURE_SIM
+  void *memory_block = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
   assert(memory_block != (void *)-1);
+  allocated_page_size = config.huge_pages ? HUGE_PAGE_SIZE : PAGE_SIZE;
+  allocated_backing = config.huge_pages ? "simulated-huge" : "base";
+  default_sim.cfg.tlb_page_shift = __builtin_ctzll(allocated_page_size);
+#else
+  void *memory_block = config.huge_pages ? map_huge(memory_size) : NULL;
+  if (!memory_block)
+  {
+    if (config.huge_pages)
+      output_log("[-] allocate_pages: no huge pages, using base pages\n");
+    allocated_page_size = PAGE_SIZE;
+    allocated_backing = "base";
+    memory_block = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    assert(memory_block != (void *)-1);
+  }
 
   for (uint64_t i = 0; i < memory_size; i += PAGE_SIZE)
   {
     uint64_t *addr = (uint64_t *)((uint8_t *)(memory_block) + i);
     //*addr = i;
-    // Memset Zero out all alloc'd memory
-    memset(&addr, 0, sizeof(addr));
+    // Memset Zero out all alloc'd memory (the page itself, not the pointer,
+    // or nothing is faulted in and pagemap reports every page absent)
+    memset(addr, 0, sizeof(*addr));
   }
+#endif
 
   return memory_block;
 }
@@ -69,7 +137,7 @@ uint64_t get_timestamp()
 {
 // Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
 #ifdef TIMING_PTHREAD
-  return counter;
+  return timer_counter;
 #else
   struct timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -77,6 +145,77 @@ uint64_t get_timestamp()
 #endif
 }
 
+/*
+ * timestamp_ticks_per_ns
+ *
+ * Rate of get_timestamp() (and of the latencies measure_* return) under the
+ * current clock epoch; the simulator's tick rate with MEASURE_SIM.
+ */
+double timestamp_ticks_per_ns(void)
+{
+#ifdef MEASURE_SIM
+  return 1.0 / default_sim.cfg.ns_per_tick;
+#else
+  return clock_calibration_of(clock_epoch()).ticks_per_ns;
+#endif
+}
+
+const char *timer_backend(void)
+{
+#if defined(MEASURE_SIM)
+  return "dramsim";
+#elif defined(TIMING_PTHREAD)
+  return timer_name(TIMER_COUNTER_THREAD);
+#else
+  return timer_name(TIMER_CLOCK_GETTIME);
+#endif
+}
+
+/*
+ * timing_init
+ *
+ * Pins the calling (measuring) thread under config.placement_policy, then starts
+ * the clock service for the source get_timestamp() reads: the counter
+ * thread with TIMING_PTHREAD, CLOCK_MONOTONIC otherwise. The counter
+ * thread then runs for the whole process instead of being created and
+ * joined around every measurement.
+ *
+ * Inputs: none
+ * Outputs: none
+ */
+void timing_init(void)
+{
+  timing_init_worker(0, 1);
+}
+
+/*
+ * timing_init_worker
+ *
+ * timing_init for one of num_workers measuring processes (see workers.hh):
+ * the same, on CPUs no other worker is given. Call it in the worker after
+ * fork(), since threads do not survive it.
+ */
+void timing_init_worker(int worker, int num_workers)
+{
+#ifdef MEASURE_SIM
+  // Simulated memory: no timer source, no placement; just the model.
+  (void)worker;
+  (void)num_workers;
+  struct dramsim_config cfg;
+  dramsim_default_config(&cfg, config_buffer_bytes());
+  dramsim_init(&default_sim, &cfg);
+#else
+  placement_init_worker((enum placement_policy)config.placement_policy, worker, num_workers);
+#ifdef TIMING_PTHREAD
+  if (clock_service_start(TIMER_COUNTER_THREAD))
+    exit(1);
+#else
+  if (clock_service_start(TIMER_CLOCK_GETTIME))
+    exit(1);
+#endif
+#endif
+}
+
 /*
  * measure_bank_latency
  *
@@ -90,20 +229,9 @@ uint64_t get_timestamp()
  */
 uint64_t measure_bank_latency(uint64_t addr_A, uint64_t addr_B)
 {
-
-#ifdef TIMING_PTHREAD
-  pthread_t counter_thread;
-  // Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
-  fprintf(stderr, "Creating counter thread\n");
-  if (pthread_create(&counter_thread, NULL, counter_function, NULL))
-  {
-    fprintf(stderr, "[-] Error creating thread\n");
-    perror("pthread");
-    return -1;
-  }
-  fprintf(stderr, "[+] Waiting for thread to start?\n");
-  // sleep(1);
-#endif
+#ifdef MEASURE_SIM
+  return dramsim_measure(&default_sim, addr_A - (uint64_t)allocated_mem, addr_B - (uint64_t)allocated_mem);
+#else
   // run clflush2(addr_A);
   // run clflush2(addr_B);
   arm_v8_cache_flush(addr_A);
@@ -125,8 +253,8 @@ uint64_t measure_bank_latency(uint64_t addr_A, uint64_t addr_B)
   uint64_t t1 = get_timestamp();
   // uint64_t start = rdtsc();
 
-  (*addr_A_ptr);
-  (*addr_B_ptr);
+  *(volatile uint8_t *)addr_A_ptr;
+  *(volatile uint8_t *)addr_B_ptr;
 
   // lfence();
   arm_v8_memory_barrier();
@@ -134,19 +262,295 @@ uint64_t measure_bank_latency(uint64_t addr_A, uint64_t addr_B)
   uint64_t t2 = get_timestamp();
   // uint64_t end = rdtsc();
 
-#ifdef TIMING_PTHREAD
-  // Exit counter thread
-  // Code from SPECTRE.
-  counter_thread_ended = 1;
-  if (pthread_join(counter_thread, NULL))
+  return (uint64_t)t2 - t1;
+  // return (uint64_t) end - start;
+#endif
+}
+
+/*
+ * measure_bank_latency_prewarm
+ *
+ * measure_bank_latency with the translations of both addresses warmed
+ * first, so that the timed loads never miss the TLB: loads a line
+ * TLB_WARM_OFFSET bytes from each address, in the same page, which stays
+ * cached across samples and so leaves the row buffers alone.
+ */
+uint64_t measure_bank_latency_prewarm(uint64_t addr_A, uint64_t addr_B)
+{
+#ifdef MEASURE_SIM
+  dramsim_touch(&default_sim, addr_A - (uint64_t)allocated_mem);
+  dramsim_touch(&default_sim, addr_B - (uint64_t)allocated_mem);
+#else
+  *(volatile uint8_t *)(addr_A ^ TLB_WARM_OFFSET);
+  *(volatile uint8_t *)(addr_B ^ TLB_WARM_OFFSET);
+#endif
+  return measure_bank_latency(addr_A, addr_B);
+}
+
+/*
+ * measure_chase
+ *
+ * Pointer chase through addrs in order: writes the chain into the lines,
+ * walks it once untimed to cache them, then times rounds passes.
+ *
+ * Inputs: addrs - Line-aligned (virtual) addresses, in chase order
+ *         num_addrs - Length of the chain
+ *         rounds - Timed passes over it
+ * Returns: Mean latency of one load in timer units
+ */
+double measure_chase(const uint64_t *addrs, int num_addrs, uint64_t rounds)
+{
+#ifdef MEASURE_SIM
+  uint64_t n = (uint64_t)num_addrs;
+  std::vector<uint64_t> offsets(n);
+  for (uint64_t i = 0; i < n; i++)
+    offsets[i] = addrs[i] - (uint64_t)allocated_mem;
+  dramsim_chase(&default_sim, offsets.data(), n, 1);
+  return dramsim_chase(&default_sim, offsets.data(), n, rounds);
+#else
+  for (int i = 0; i < num_addrs; i++)
+    *(uint64_t *)addrs[i] = addrs[(i + 1) % num_addrs];
+  uint64_t p = addrs[0];
+  for (int i = 0; i < num_addrs; i++)
+    p = *(volatile uint64_t *)p;
+
+  arm_v8_memory_barrier();
+  uint64_t t1 = get_timestamp();
+  for (uint64_t i = 0; i < rounds * num_addrs; i++)
+    p = *(volatile uint64_t *)p;
+  arm_v8_memory_barrier();
+  uint64_t t2 = get_timestamp();
+  return rounds && num_addrs ? (double)(t2 - t1) / (double)(rounds * num_addrs) : 0.0;
+#endif
+}
+
+/*
+ * measure_access
+ *
+ * Flushes addr and times one load of it.
+ *
+ * Inputs: addr - (virtual) address to load
+ * Outputs: start - Timestamp taken just before the load
+ * Returns: Latency in timer units
+ */
+uint64_t measure_access(uint64_t addr, uint64_t *start)
+{
+#ifdef MEASURE_SIM
+  *start = (uint64_t)(default_sim.now_ns / default_sim.cfg.ns_per_tick);
+  return dramsim_single(&default_sim, addr - (uint64_t)allocated_mem);
+#else
+  arm_v8_cache_flush(addr);
+  arm_v8_memory_barrier();
+  uint64_t t1 = get_timestamp();
+  *(volatile uint8_t *)addr;
+  arm_v8_memory_barrier();
+  uint64_t t2 = get_timestamp();
+  *start = t1;
+  return t2 - t1;
+#endif
+}
+
+/*
+ * measure_load
+ *
+ * Times one load of addr as the cache finds it: no flush first, so a line
+ * loaded or prefetched since its last measure_flush is a hit.
+ *
+ * Inputs: addr - (virtual) address to load
+ * Returns: Latency in timer units
+ */
+uint64_t measure_load(uint64_t addr)
+{
+#ifdef MEASURE_SIM
+  return dramsim_load(&default_sim, addr - (uint64_t)allocated_mem);
+#else
+  arm_v8_memory_barrier();
+  uint64_t t1 = get_timestamp();
+  *(volatile uint8_t *)addr;
+  arm_v8_memory_barrier();
+  uint64_t t2 = get_timestamp();
+  return t2 - t1;
+#endif
+}
+
+// Evicts the line holding addr from every cache level.
+void measure_flush(uint64_t addr)
+{
+#ifdef MEASURE_SIM
+  dramsim_flush(&default_sim, addr - (uint64_t)allocated_mem);
+#else
+  arm_v8_cache_flush(addr);
+#endif
+}
+
+/*
+ * measure_idle_ns
+ *
+ * Leaves the memory system alone for ns: spins on the timer without loads
+ * or stores, so nothing reaches DRAM in between. Advances the simulator's
+ * clock with MEASURE_SIM.
+ */
+void measure_idle_ns(double ns)
+{
+#ifdef MEASURE_SIM
+  default_sim.now_ns += ns;
+#else
+  uint64_t end = get_timestamp() + (uint64_t)(ns * timestamp_ticks_per_ns());
+  while (get_timestamp() < end)
+    ;
+#endif
+}
+
+#ifndef MEASURE_SIM
+struct stream_arg
+{
+  uint64_t addr;
+  std::atomic<int> *ready;
+  std::atomic<int> *go;
+  uint64_t accesses;
+};
+
+// One stream: flush and reload the same line until told to stop.
+static void *stream_function(void *x_void_ptr)
+{
+  struct stream_arg *arg = (struct stream_arg *)x_void_ptr;
+  uint64_t n = 0;
+  arg->ready->fetch_add(1);
+  while (arg->go->load(std::memory_order_acquire) == 0)
+    ;
+  while (arg->go->load(std::memory_order_relaxed) == 1)
   {
-    fprintf(stderr, "Error joining thread\n");
-    return -1;
+    arm_v8_cache_flush(arg->addr);
+    *(volatile uint8_t *)arg->addr;
+    n++;
   }
+  arg->accesses = n;
+  return NULL;
+}
 #endif
 
-  return (uint64_t)t2 - t1;
-  // return (uint64_t) end - start;
+/*
+ * measure_concurrent_throughput
+ *
+ * Runs one thread per address, each repeatedly flushing and loading its
+ * line, for CHANNEL_STREAM_US, and returns the combined rate. Streams on
+ * different channels overlap; streams on one channel queue on its bus.
+ *
+ * Inputs: addrs - One address per stream
+ *         num_addrs - Number of streams
+ * Output: Accesses per nanosecond (per tick with MEASURE_SIM), 0 if not
+ *         every stream could be started
+ */
+double measure_concurrent_throughput(const uint64_t *addrs, int num_addrs)
+{
+#ifdef MEASURE_SIM
+  std::vector<uint64_t> offsets(num_addrs);
+  for (int i = 0; i < num_addrs; i++)
+    offsets[i] = addrs[i] - (uint64_t)allocated_mem;
+  return dramsim_concurrent(&default_sim, offsets.data(), num_addrs, CHANNEL_SIM_ROUNDS);
+#else
+  std::atomic<int> ready(0), go(0);
+  std::vector<struct stream_arg> args(num_addrs);
+  std::vector<pthread_t> threads(num_addrs);
+  // Streams must not inherit the measuring thread's pin and SCHED_FIFO: they
+  // would all queue on its CPU, and a real-time waiter never lets them run.
+  pthread_attr_t attr;
+  placement_helper_attr(&attr);
+  int started = 0;
+  for (int i = 0; i < num_addrs; i++)
+  {
+    args[i].addr = addrs[i];
+    args[i].ready = &ready;
+    args[i].go = &go;
+    args[i].accesses = 0;
+    int rc = pthread_create(&threads[i], &attr, stream_function, &args[i]);
+    if (rc)
+    {
+      output_log("[-] Error creating stream thread %d of %d: %s\n", i, num_addrs, strerror(rc));
+      break;
+    }
+    started++;
+  }
+  pthread_attr_destroy(&attr);
+  // Time from the moment every stream is spinning, not from thread creation.
+  while (ready.load() < started)
+    sched_yield();
+
+  uint64_t start = monotonic_ns();
+  go.store(1, std::memory_order_release);
+  if (started == num_addrs)
+    usleep(CHANNEL_STREAM_US);
+  go.store(2, std::memory_order_relaxed);
+  uint64_t elapsed = monotonic_ns() - start;
+
+  uint64_t total = 0;
+  for (int i = 0; i < started; i++)
+  {
+    pthread_join(threads[i], NULL);
+    total += args[i].accesses;
+  }
+  if (started < num_addrs)
+    return 0.0;
+  return elapsed ? (double)total / elapsed : 0.0;
+#endif
+}
+
+/*
+ * hammer_sequence
+ *
+ * The hammer kernel: loads and flushes each address in turn, rounds times.
+ *
+ * Inputs: addrs - Aggressor (virtual) addresses, in access order
+ *         num_addrs - Length of the sequence
+ *         rounds - Passes over it
+ * Returns: Elapsed time in ns (simulated with MEASURE_SIM)
+ */
+double hammer_sequence(const uint64_t *addrs, size_t num_addrs, uint64_t rounds)
+{
+#ifdef MEASURE_SIM
+  std::vector<uint64_t> offsets(num_addrs);
+  for (size_t i = 0; i < num_addrs; i++)
+    offsets[i] = addrs[i] - (uint64_t)allocated_mem;
+  double start = default_sim.now_ns;
+  dramsim_hammer(&default_sim, offsets.data(), num_addrs, rounds);
+  return default_sim.now_ns - start;
+#else
+  uint64_t start = monotonic_ns();
+  while (rounds-- > 0)
+  {
+    for (size_t i = 0; i < num_addrs; i++)
+    {
+      *(volatile uint8_t *)addrs[i];
+      arm_v8_cache_flush(addrs[i]);
+    }
+  }
+  return (double)(monotonic_ns() - start);
+#endif
+}
+
+// Fills the row at addr with pattern and writes it back to DRAM.
+void row_write(uint64_t addr, uint8_t pattern)
+{
+#ifdef MEASURE_SIM
+  (void)pattern;
+  dramsim_row_write(&default_sim, addr - (uint64_t)allocated_mem);
+#else
+  fill_row((uint8_t *)addr, config.row_size, pattern);
+  flush_row((uint8_t *)addr, config.row_size);
+#endif
+}
+
+// Bytes of the row at addr that no longer hold pattern (flipped bits in the
+// row with MEASURE_SIM).
+uint32_t row_flipped(uint64_t addr, uint8_t pattern)
+{
+#ifdef MEASURE_SIM
+  (void)pattern;
+  return dramsim_row_flips(&default_sim, addr - (uint64_t)allocated_mem);
+#else
+  flush_row((uint8_t *)addr, config.row_size);
+  return count_changed((uint8_t *)addr, config.row_size, pattern);
+#endif
 }
 
 char *int_to_binary(uint64_t num, int num_bits)
@@ -22,14 +22,31 @@
 
 // Base pointer to a large memory pool
 extern void *allocated_mem;
+// Page size backing it, and how it was obtained ("base", "hugetlb", ...)
+extern uint64_t allocated_page_size;
+extern const char *allocated_backing;
 
 // Student Provided Functions
-// uint64_t virt_to_phys(uint64_t virt_addr);
-// uint64_t phys_to_virt(uint64_t phys_addr);
+// virt_to_phys/phys_to_virt and the PPN/VPN map now live in mapping.hh,
+// with a pagemap-free backend for macOS.
 // uint8_t phys_to_bankid(uint64_t phys_ptr, uint8_t candidate);
-// void setup_PPN_VPN_map(void * mem_map, uint64_t memory_size);
 uint64_t measure_bank_latency(uint64_t addr_A, uint64_t addr_B);
+uint64_t measure_bank_latency_prewarm(uint64_t addr_A, uint64_t addr_B);
+uint64_t measure_access(uint64_t addr, uint64_t *start);
+uint64_t measure_load(uint64_t addr);
+void measure_flush(uint64_t addr);
+void measure_idle_ns(double ns);
+double measure_chase(const uint64_t *addrs, int num_addrs, uint64_t rounds);
+double measure_concurrent_throughput(const uint64_t *addrs, int num_addrs);
+double hammer_sequence(const uint64_t *addrs, size_t num_addrs, uint64_t rounds);
+void row_write(uint64_t addr, uint8_t pattern);
+uint32_t row_flipped(uint64_t addr, uint8_t pattern);
 uint64_t get_timestamp(void);
+double timestamp_ticks_per_ns(void);
+// Source get_timestamp() reads in this build ("dramsim" with MEASURE_SIM).
+const char *timer_backend(void);
+void timing_init(void);
+void timing_init_worker(int worker, int num_workers);
 // uint64_t measure_bank_latency_2(uint64_t addr_A, uint64_t addr_B);
 // uint64_t get_dr//am_address(uint64_t row, int bank, uint64_t col);
 char *int_to_binary(uint64_t num, int num_bits);
@@ -0,0 +1,1011 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../kernels.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../sampler.hh"
+#include "../guard.hh"
+#include "../pairs.hh"
+#include "../timer.hh"
+#include "../dramsim.hh"
+#include "../mapping.hh"
+#include "../channels.hh"
+#include "../refresh.hh"
+#include "../trace.hh"
+#include "../replay.hh"
+#include "../compare.hh"
+#include "../workers.hh"
+#include "../rowbuf.hh"
+#include "../tlb.hh"
+#include "../prefetch.hh"
+#include "../fuzz.hh"
+#include "../cachebench.hh"
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <random>
+#include <vector>
+
+// Host-side check of the sweep machinery against the software DRAM model.
+// Built with -DMEASURE_SIM, so measure_bank_latency() is answered by
+// default_sim and every classification can be compared with the ground
+// truth the simulator knows.
+
+// Pairs per check
+#define CHECK_PAIRS (20000)
+// Minimum fraction of pairs classified like the ground truth
+#define MIN_ACCURACY (0.99)
+// Hammer rounds for the flip check, on top of DRAMSIM_FLIP_THRESHOLD
+#define HAMMER_ROUNDS (200000)
+// Victims for the pagemap-free mapping check
+#define MAPPING_VICTIMS (256)
+// Trace length for the refresh check
+#define REFRESH_CHECK_SAMPLES (1 << 18)
+// Slower row conflicts for the comparison check's drifted run
+#define COMPARE_CHECK_SLOWDOWN (1.2)
+// Worker processes for the multi-process check
+#define CHECK_WORKERS (4)
+// Page timeout of the closed-page run of the row-buffer check; longer than
+// one simulated load, or no gap could find a row open
+#define ROWBUF_CHECK_TIMEOUT_NS (600.0)
+// TLB of the translation checks: L1 entries (the L2 is DRAMSIM_TLB_L2_ENTRIES)
+#define TLB_CHECK_L1_ENTRIES (32)
+// Pairs, and samples of each, for the prewarm check
+#define TLB_CHECK_PAIRS (4096)
+#define TLB_CHECK_SAMPLES (4)
+// Raw-sample trace written and replayed by the trace check
+// Row-start loads replayed through the stride prefetcher per sweep order
+#define ORDER_CHECK_STEPS (16384)
+// Reloads per working-set size for the cache sweep check
+#define CACHE_CHECK_SAMPLES (4)
+
+// TRR slots per bank, fuzzing trials and activations per trial
+#define FUZZ_CHECK_TRR_ENTRIES (4)
+#define FUZZ_CHECK_TRIALS (48)
+#define FUZZ_CHECK_ACTIVATIONS (1 << 19)
+// Random and mutated patterns compiled by the fuzz-compile check
+#define FUZZ_CHECK_PATTERNS (1024)
+
+#define TRACE_CHECK_PATH "simcheck.trace"
+// Configuration file written and loaded by the config check
+#define CONFIG_CHECK_PATH "simcheck.conf"
+
+static int failures = 0;
+
+static void check(const char *name, int ok, const char *detail)
+{
+    output_printf("%s,%s,%s\n", name, ok ? "PASS" : "FAIL", detail);
+    failures += !ok;
+}
+
+// A pair conflicts when both addresses sit in different rows of one bank.
+static int truth_conflict(uint64_t addr_A, uint64_t addr_B)
+{
+    uint64_t a = addr_A - (uint64_t)allocated_mem;
+    uint64_t b = addr_B - (uint64_t)allocated_mem;
+    return dramsim_bank_index(&default_sim, a) == dramsim_bank_index(&default_sim, b) &&
+           dramsim_locate(&default_sim, a).row != dramsim_locate(&default_sim, b).row;
+}
+
+/*
+ * run_sweep
+ *
+ * Measures CHECK_PAIRS pairs of one mode through the guard and the adaptive
+ * sampler, exactly as histogram does, and scores each decision against the
+ * simulator. Bit-flip mode also records the conflict rate per flipped bit.
+ */
+static double run_sweep(enum pair_mode mode, uint64_t size, uint64_t threshold, double *rate,
+                        uint64_t *bit_pairs, uint64_t *bit_conflicts)
+{
+    struct pair_sampler pairs;
+    pair_sampler_init(&pairs, mode, allocated_mem, size, config.row_size, PAIR_SEED, CHECK_PAIRS, 0);
+    struct adaptive_sampler sampler;
+    sampler_init(&sampler, threshold, (uint64_t)CHECK_PAIRS * ADAPTIVE_MAX_SAMPLES);
+
+    uint64_t correct = 0;
+    uint64_t start = monotonic_ns();
+    uint64_t addr_A, addr_B;
+    while (pair_sampler_next(&pairs, &addr_A, &addr_B))
+    {
+        struct pair_result res;
+        if (!sampler_measure_pair(&sampler, guard_measure_default, addr_A, addr_B, &res))
+            break;
+        int conflict = res.decision == PAIR_CONFLICT;
+        correct += conflict == truth_conflict(addr_A, addr_B);
+        if (bit_pairs)
+        {
+            bit_pairs[pairs.last_bit]++;
+            bit_conflicts[pairs.last_bit] += conflict;
+        }
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+
+    *rate = elapsed ? sampler.samples_taken * 1e9 / elapsed : 0.0;
+    output_printf("%s,%llu,%llu,%llu,%.0f,%.4f\n", pair_mode_name(mode), (unsigned long long)sampler.pairs_done,
+                  (unsigned long long)sampler.samples_taken, (unsigned long long)sampler.pairs_ambiguous, *rate,
+                  sampler.pairs_done ? (double)correct / sampler.pairs_done : 0.0);
+    return sampler.pairs_done ? (double)correct / sampler.pairs_done : 0.0;
+}
+
+// Some address in the given row that shares a bank with addr, or 0.
+static uint64_t same_bank_in_row(uint64_t addr, uint64_t row)
+{
+    unsigned bank = dramsim_bank_index(&default_sim, addr);
+    uint64_t row_bytes = 1ULL << default_sim.cfg.row_shift;
+    for (uint64_t off = 0; off < row_bytes; off += config.row_size)
+    {
+        uint64_t cand = row * row_bytes + off;
+        if (cand < default_sim.cfg.mem_size && dramsim_bank_index(&default_sim, cand) == bank)
+            return cand;
+    }
+    return 0;
+}
+
+static void run_flip_check(void)
+{
+    // Double-sided: aggressors at rows r-1 and r+1 of one bank, victim r.
+    uint64_t row = 100;
+    uint64_t above = (row - 1) << default_sim.cfg.row_shift;
+    uint64_t below = same_bank_in_row(above, row + 1);
+    uint64_t victim = same_bank_in_row(above, row);
+    uint64_t far = same_bank_in_row(above, row + 50);
+    char detail[128];
+    if (!below || !victim || !far)
+    {
+        check("flip-setup", 0, "no same-bank rows");
+        return;
+    }
+
+    // Under the threshold nothing may flip.
+    uint64_t aggressors[2] = {above, below};
+    dramsim_hammer(&default_sim, aggressors, 2, DRAMSIM_FLIP_THRESHOLD / 2);
+    snprintf(detail, sizeof(detail), "victim flips %u", dramsim_row_flips(&default_sim, victim));
+    check("flip-below-threshold", dramsim_row_flips(&default_sim, victim) == 0, detail);
+
+    dramsim_hammer(&default_sim, aggressors, 2, HAMMER_ROUNDS);
+    uint32_t victim_flips = dramsim_row_flips(&default_sim, victim);
+    uint32_t far_flips = dramsim_row_flips(&default_sim, far);
+    snprintf(detail, sizeof(detail), "victim flips %u, far row flips %u", victim_flips, far_flips);
+    check("flip-victim-only", victim_flips > 0 && far_flips == 0, detail);
+}
+
+/*
+ * run_mapping_check
+ *
+ * Inferred (pagemap-free) mapping against the simulator, whose physical
+ * addresses are exactly the buffer offsets the inferred mode assumes: bank
+ * groups must match the simulated banks one to one, and aggressors must be
+ * the neighbouring rows of the victim's bank.
+ */
+static void run_mapping_check(uint64_t size)
+{
+    char detail[128];
+    if (mapping_init(MAPPING_INFERRED, allocated_mem, size, NULL) != MAPPING_INFERRED)
+    {
+        check("mapping-init", 0, "inferred mode unavailable");
+        return;
+    }
+
+    std::map<int, unsigned> group_bank;
+    std::map<unsigned, int> bank_group;
+    int mismatched = 0, found = 0, wrong = 0;
+    uint64_t step = size / MAPPING_VICTIMS / config.row_size * config.row_size + 3 * config.row_size;
+    for (int i = 0; i < MAPPING_VICTIMS; i++)
+    {
+        uint64_t off = (i * step) % size;
+        uint64_t victim = (uint64_t)allocated_mem + off;
+        int group = mapping_bank_of(victim);
+        unsigned bank = dramsim_bank_index(&default_sim, off);
+        if (!group_bank.count(group))
+            group_bank[group] = bank;
+        if (!bank_group.count(bank))
+            bank_group[bank] = group;
+        mismatched += group < 0 || group_bank[group] != bank || bank_group[bank] != group;
+
+        uint64_t a1, a2;
+        if (!mapping_aggressors(victim, 1, &a1, &a2))
+            continue;
+        found++;
+        uint64_t o1 = a1 - (uint64_t)allocated_mem, o2 = a2 - (uint64_t)allocated_mem;
+        uint64_t row = dramsim_locate(&default_sim, off).row;
+        wrong += dramsim_bank_index(&default_sim, o1) != bank || dramsim_bank_index(&default_sim, o2) != bank ||
+                 dramsim_locate(&default_sim, o1).row != row + 1 || dramsim_locate(&default_sim, o2).row != row - 1;
+    }
+    mapping_report();
+
+    snprintf(detail, sizeof(detail), "%zu groups for %u banks, %d victims misgrouped", group_bank.size(),
+             default_sim.num_banks_total, mismatched);
+    check("inferred-bank-groups", mismatched == 0 && group_bank.size() == default_sim.num_banks_total, detail);
+    snprintf(detail, sizeof(detail), "%d of %d victims with aggressors, %d wrong", found, MAPPING_VICTIMS, wrong);
+    check("inferred-aggressors", found > MAPPING_VICTIMS / 2 && wrong == 0, detail);
+}
+
+/*
+ * run_channel_check
+ *
+ * Swaps in a two-channel, two-rank geometry and checks that channel
+ * discovery finds it and fits the simulator's own channel and rank functions.
+ */
+static void run_channel_check(uint64_t size)
+{
+    char detail[160];
+    struct dramsim_config saved = default_sim.cfg;
+    struct dramsim_config cfg = saved;
+    cfg.num_channel_funcs = 1;
+    cfg.channel_masks[0] = (1ULL << 8) | (1ULL << 19);
+    cfg.num_rank_funcs = 1;
+    cfg.rank_masks[0] = 1ULL << 20;
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &cfg);
+    mapping_init(MAPPING_INFERRED, allocated_mem, size, NULL);
+
+    struct channel_map *map = (struct channel_map *)calloc(1, sizeof(struct channel_map));
+    int ok = !channel_discover(measure_concurrent_throughput, allocated_mem, size, map);
+    channel_print(map);
+    snprintf(detail, sizeof(detail), "%d groups, %d channels, %d ranks, %llu throughput measurements",
+             map->num_groups, map->num_channels, map->num_ranks, (unsigned long long)map->measurements);
+    check("channel-discovery", ok && map->num_groups == (int)default_sim.num_banks_total && map->num_channels == 2 &&
+          map->num_ranks == 2, detail);
+
+    struct mapping_profile profile;
+    mapping_default_profile(&profile);
+    int fitted = ok && !channel_fit_profile(map, &profile);
+    snprintf(detail, sizeof(detail), "channel mask 0x%llx, rank mask 0x%llx",
+             fitted && profile.num_channel_funcs ? (unsigned long long)profile.channel_masks[0] : 0ULL,
+             fitted && profile.num_rank_funcs ? (unsigned long long)profile.rank_masks[0] : 0ULL);
+    check("channel-profile", fitted && profile.num_channel_funcs == 1 && profile.num_rank_funcs == 1 &&
+          profile.channel_masks[0] == cfg.channel_masks[0] && profile.rank_masks[0] == cfg.rank_masks[0], detail);
+
+    free(map);
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+// tREFI recovered from a latency trace to within 1%.
+static void run_refresh_check(void)
+{
+    char detail[160];
+    struct refresh_trace trace;
+    if (refresh_trace_alloc(&trace, REFRESH_CHECK_SAMPLES))
+    {
+        check("refresh-trace", 0, "allocation failed");
+        return;
+    }
+    refresh_record(&trace, (uint64_t)allocated_mem);
+    struct refresh_result res;
+    int found = !refresh_analyze(&trace, timestamp_ticks_per_ns(), &res);
+    refresh_trace_free(&trace);
+    refresh_print(&res);
+
+    double expected = default_sim.cfg.refresh_interval_ns;
+    snprintf(detail, sizeof(detail), "tREFI %.1f ns (simulated %.1f), spike cost %.0f, coverage %.3f", res.period_ns,
+             expected, res.spike_cost_ns, res.coverage);
+    check("refresh-period", found && fabs(res.period_ns - expected) < expected * 0.01, detail);
+}
+
+/*
+ * run_trace_check
+ *
+ * Records a uniform sweep to a trace, replays it, and checks that the replay
+ * sees every pair and sample, reaches the live decision for every pair, and
+ * derives a threshold between the different-bank and same-bank latencies.
+ */
+static void run_trace_check(uint64_t size, uint64_t threshold, double other_bank, double same_bank)
+{
+    char detail[160];
+    struct trace_writer trace;
+    trace_writer_init(&trace, (uint64_t)allocated_mem);
+    trace_meta(&trace, "binary", "simcheck");
+    trace_meta(&trace, "threshold", "%llu", (unsigned long long)threshold);
+    if (trace_writer_open(&trace, TRACE_CHECK_PATH))
+    {
+        check("trace-write", 0, "cannot open " TRACE_CHECK_PATH);
+        return;
+    }
+
+    struct pair_sampler pairs;
+    pair_sampler_init(&pairs, PAIRS_UNIFORM, allocated_mem, size, config.row_size, PAIR_SEED + 1, CHECK_PAIRS, 0);
+    struct adaptive_sampler sampler;
+    sampler_init(&sampler, threshold, (uint64_t)CHECK_PAIRS * ADAPTIVE_MAX_SAMPLES);
+    sampler_trace(&sampler, &trace);
+    std::vector<enum pair_decision> live;
+    uint64_t addr_A, addr_B;
+    struct pair_result res;
+    while (pair_sampler_next(&pairs, &addr_A, &addr_B) &&
+           sampler_measure_pair(&sampler, guard_measure_default, addr_A, addr_B, &res))
+        live.push_back(res.decision);
+    trace_writer_close(&trace);
+
+    struct trace_reader reader;
+    struct replay_run run;
+    if (trace_reader_open(&reader, TRACE_CHECK_PATH) || replay_load(&reader, &run))
+    {
+        check("trace-replay", 0, "trace does not load");
+        unlink(TRACE_CHECK_PATH);
+        return;
+    }
+    uint64_t mismatched = 0;
+    for (size_t i = 0; i < run.pairs.size() && i < live.size(); i++)
+        mismatched += replay_decide(&run, &run.pairs[i], threshold) != live[i];
+    uint64_t derived = replay_threshold(&run);
+    snprintf(detail, sizeof(detail), "%zu/%zu pairs, %llu/%llu samples, %llu decisions differ, %.2f bytes/sample",
+             run.pairs.size(), live.size(), (unsigned long long)run.num_samples,
+             (unsigned long long)sampler.samples_taken, (unsigned long long)mismatched,
+             (double)reader.size / run.num_samples);
+    check("trace-replay", run.pairs.size() == live.size() && run.num_samples == sampler.samples_taken &&
+                              mismatched == 0 && !run.truncated, detail);
+    snprintf(detail, sizeof(detail), "derived %llu, between %.0f and %.0f", (unsigned long long)derived, other_bank,
+             same_bank);
+    check("trace-threshold", derived > other_bank && derived < same_bank, detail);
+    trace_reader_close(&reader);
+    unlink(TRACE_CHECK_PATH);
+}
+
+// Pair medians of a uniform sweep of CHECK_PAIRS / 4 pairs.
+static void sweep_dist(uint64_t size, uint64_t threshold, uint64_t seed, struct latency_dist *d)
+{
+    struct pair_sampler pairs;
+    pair_sampler_init(&pairs, PAIRS_UNIFORM, allocated_mem, size, config.row_size, seed, CHECK_PAIRS / 4, 0);
+    struct adaptive_sampler sampler;
+    sampler_init(&sampler, threshold, (uint64_t)CHECK_PAIRS * ADAPTIVE_MAX_SAMPLES);
+    dist_init(d, 0);
+    uint64_t addr_A, addr_B;
+    struct pair_result res;
+    while (pair_sampler_next(&pairs, &addr_A, &addr_B) &&
+           sampler_measure_pair(&sampler, guard_measure_default, addr_A, addr_B, &res))
+        dist_add(d, res.median, 1);
+    dist_finish(d);
+}
+
+/*
+ * run_compare_check
+ *
+ * Two sweeps of the same model with different pair seeds must compare as
+ * equal; a sweep after slowing row conflicts by COMPARE_CHECK_SLOWDOWN must
+ * not.
+ */
+static void run_compare_check(uint64_t size, uint64_t threshold)
+{
+    char detail[160];
+    struct latency_dist baseline, repeat, drifted;
+    sweep_dist(size, threshold, PAIR_SEED + 2, &baseline);
+    sweep_dist(size, threshold, PAIR_SEED + 3, &repeat);
+    double t_row_conflict = default_sim.cfg.t_row_conflict;
+    default_sim.cfg.t_row_conflict *= COMPARE_CHECK_SLOWDOWN;
+    sweep_dist(size, threshold, PAIR_SEED + 4, &drifted);
+    default_sim.cfg.t_row_conflict = t_row_conflict;
+
+    struct compare_result same, moved;
+    int same_pass = compare_dists(&baseline, &repeat, &same);
+    int moved_pass = compare_dists(&baseline, &drifted, &moved);
+    compare_print(&moved);
+    snprintf(detail, sizeof(detail), "ks %.4f, emd %.2f", dist_ks(&baseline, &repeat),
+             dist_emd(&baseline, &repeat));
+    check("compare-repeat", same_pass, detail);
+    snprintf(detail, sizeof(detail), "ks %.4f, emd %.2f", dist_ks(&baseline, &drifted),
+             dist_emd(&baseline, &drifted));
+    check("compare-drift", !moved_pass, detail);
+}
+
+// Worker body for run_workers_check: a uniform sweep on the inherited model,
+// scored against its ground truth.
+static int check_worker(int worker, struct worker_shared *sh, void *arg)
+{
+    uint64_t threshold = *(uint64_t *)arg;
+    struct pair_sampler pairs;
+    pair_sampler_init(&pairs, PAIRS_UNIFORM, allocated_mem, config_buffer_bytes(), config.row_size,
+                      PAIR_SEED + 10 + worker, CHECK_PAIRS / 8, 0);
+    struct adaptive_sampler sampler;
+    sampler_init(&sampler, threshold, (uint64_t)CHECK_PAIRS * ADAPTIVE_MAX_SAMPLES);
+    struct worker_local local;
+    memset(&local, 0, sizeof(local));
+    if (worker_barrier(sh, worker))
+        return 1;
+
+    uint64_t addr_A, addr_B;
+    struct pair_result res;
+    while (pair_sampler_next(&pairs, &addr_A, &addr_B) &&
+           sampler_measure_pair(&sampler, guard_measure_default, addr_A, addr_B, &res))
+    {
+        local.correct += (res.decision == PAIR_CONFLICT) == truth_conflict(addr_A, addr_B);
+        worker_count(sh, worker, &local, &res);
+    }
+    worker_merge(sh, worker, &local);
+    return 0;
+}
+
+/*
+ * run_workers_check
+ *
+ * CHECK_WORKERS forked workers sweep through the start barrier and merge
+ * into shared memory: every worker must finish, the merged totals must equal
+ * the sum of the per-worker ones, and every worker must classify as well as
+ * a single-process sweep.
+ */
+static void run_workers_check(uint64_t threshold)
+{
+    char detail[160];
+    struct worker_shared *sh = workers_create(CHECK_WORKERS);
+    if (!sh)
+    {
+        check("workers-run", 0, "no shared region");
+        return;
+    }
+    int failed = workers_run(sh, check_worker, &threshold);
+
+    uint64_t pairs = 0, samples = 0, merged = 0;
+    double worst = 1.0;
+    for (int w = 0; w < CHECK_WORKERS; w++)
+    {
+        pairs += sh->slot[w].pairs;
+        samples += sh->slot[w].samples;
+        worst = std::min(worst, sh->slot[w].pairs ? (double)sh->slot[w].correct / sh->slot[w].pairs : 0.0);
+    }
+    for (int b = 0; b < WORKER_BUCKETS; b++)
+        merged += sh->histogram[b];
+    snprintf(detail, sizeof(detail), "%d failed, %llu pairs merged, %llu in slots, %llu in histogram", failed,
+             (unsigned long long)sh->pairs.load(), (unsigned long long)pairs, (unsigned long long)merged);
+    check("workers-merge", failed == 0 && pairs == sh->pairs && samples == sh->samples && merged == pairs &&
+                               pairs == (uint64_t)CHECK_WORKERS * (CHECK_PAIRS / 8), detail);
+    snprintf(detail, sizeof(detail), "worst worker %.4f", worst);
+    check("workers-accuracy", worst >= MIN_ACCURACY, detail);
+    workers_destroy(sh);
+}
+
+/*
+ * run_rowbuf_check
+ *
+ * Builds the row-buffer address sets, checks every partner against the
+ * simulator's ground truth, and checks that the policy is detected as open
+ * page, that row conflicts sustain less throughput than row hits with pairs
+ * in flight, and then, after switching the simulator to closed page, as closed
+ * page with its timeout to within 10%.
+ */
+static void run_rowbuf_check(uint64_t size)
+{
+    char detail[160];
+    mapping_init(MAPPING_INFERRED, allocated_mem, size, NULL);
+    struct rowbuf_result *res = (struct rowbuf_result *)calloc(1, sizeof(struct rowbuf_result));
+    rowbuf_build(allocated_mem, size, ROWBUF_SEED, res);
+
+    int wrong = 0;
+    for (int i = 0; i < res->num_pairs; i++)
+    {
+        uint64_t a = res->anchor[i] - (uint64_t)allocated_mem;
+        unsigned bank = dramsim_bank_index(&default_sim, a);
+        uint64_t row = dramsim_locate(&default_sim, a).row;
+        for (int c = 0; c < ROWBUF_CLASSES; c++)
+        {
+            uint64_t p = res->partner[c][i] - (uint64_t)allocated_mem;
+            int same_bank = dramsim_bank_index(&default_sim, p) == bank;
+            int same_row = dramsim_locate(&default_sim, p).row == row;
+            if (c == ROWBUF_SAME_ROW)
+                wrong += !same_bank || !same_row;
+            else if (c == ROWBUF_DIFF_ROW)
+                wrong += !same_bank || same_row;
+            else
+                wrong += same_bank;
+        }
+    }
+    snprintf(detail, sizeof(detail), "%d anchors, %d partners in the wrong class", res->num_pairs, wrong);
+    check("rowbuf-classes", res->num_pairs > ROWBUF_PAIRS / 2 && wrong == 0, detail);
+
+    int ok = !rowbuf_measure(measure_bank_latency, res);
+    rowbuf_print(res);
+    snprintf(detail, sizeof(detail), "%s, same-row %.0f, diff-row %.0f, diff-bank %.0f",
+             rowbuf_policy_name(res->policy), res->cls[ROWBUF_SAME_ROW].median, res->cls[ROWBUF_DIFF_ROW].median,
+             res->cls[ROWBUF_DIFF_BANK].median);
+    check("rowbuf-open-page", ok && res->policy == ROWBUF_OPEN_PAGE && res->pair_conflicts, detail);
+    // With pairs in flight, row conflicts queue on their bank.
+    const struct rowbuf_class_stats *cls = res->cls;
+    snprintf(detail, sizeof(detail), "accesses per tick: same-row %.4f, diff-row %.4f, diff-bank %.4f",
+             cls[ROWBUF_SAME_ROW].throughput, cls[ROWBUF_DIFF_ROW].throughput, cls[ROWBUF_DIFF_BANK].throughput);
+    check("rowbuf-concurrent", cls[ROWBUF_DIFF_ROW].throughput < cls[ROWBUF_SAME_ROW].throughput, detail);
+
+    struct dramsim_config saved = default_sim.cfg;
+    default_sim.cfg.closed_page = 1;
+    default_sim.cfg.closed_page_timeout_ns = ROWBUF_CHECK_TIMEOUT_NS;
+    ok = !rowbuf_measure(measure_bank_latency, res);
+    default_sim.cfg = saved;
+    rowbuf_print(res);
+    snprintf(detail, sizeof(detail), "%s, timeout %.1f ns (simulated %.1f)", rowbuf_policy_name(res->policy),
+             res->timeout_ns, ROWBUF_CHECK_TIMEOUT_NS);
+    check("rowbuf-closed-page", ok && res->policy == ROWBUF_CLOSED_PAGE &&
+          fabs(res->timeout_ns - ROWBUF_CHECK_TIMEOUT_NS) < ROWBUF_CHECK_TIMEOUT_NS * 0.1, detail);
+    free(res);
+}
+
+// Fraction of TLB_CHECK_SAMPLES samples per pair on the wrong side of threshold.
+static double misclassified_samples(measure_fn fn, uint64_t size, uint64_t threshold)
+{
+    std::mt19937_64 rng(PAIR_SEED);
+    uint64_t lines = size / PAIRS_LINE_SIZE, wrong = 0;
+    for (int i = 0; i < TLB_CHECK_PAIRS; i++)
+    {
+        uint64_t a = (uint64_t)allocated_mem + rng() % lines * PAIRS_LINE_SIZE;
+        uint64_t b = (uint64_t)allocated_mem + rng() % lines * PAIRS_LINE_SIZE;
+        int truth = truth_conflict(a, b);
+        for (int j = 0; j < TLB_CHECK_SAMPLES; j++)
+            wrong += (fn(a, b) >= threshold) != truth;
+    }
+    return (double)wrong / (TLB_CHECK_PAIRS * TLB_CHECK_SAMPLES);
+}
+
+/*
+ * run_tlb_check
+ *
+ * Turns on the simulator's TLB and checks that the TLB benchmark recovers
+ * both TLB sizes and miss costs, and that warming the translations keeps
+ * page walks from pushing pair samples over the threshold.
+ */
+static void run_tlb_check(uint64_t size, uint64_t threshold)
+{
+    char detail[160];
+    struct dramsim_config saved = default_sim.cfg;
+    struct dramsim_config cfg = saved;
+    // Without refresh stalls, which would blur the comparison.
+    cfg.refresh_interval_ns = 0;
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &cfg);
+    double base_wrong = misclassified_samples(measure_bank_latency, size, threshold);
+    cfg.tlb_l1_entries = TLB_CHECK_L1_ENTRIES;
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &cfg);
+
+    struct tlb_result res;
+    int found = !tlb_sweep(allocated_mem, size, PAIR_SEED, &res);
+    tlb_print(&res);
+    double l2_hit = cfg.t_tlb_l2 * cfg.ns_per_tick, walk = cfg.t_walk * cfg.ns_per_tick;
+    snprintf(detail, sizeof(detail), "L1 %llu pages, L2 %llu pages, L2 hit %.1f ns (%.1f), walk %.1f ns (%.1f)",
+             (unsigned long long)res.l1_pages, (unsigned long long)res.l2_pages, res.l2_hit_ns, l2_hit, res.walk_ns,
+             walk);
+    check("tlb-levels", found && res.l1_pages == cfg.tlb_l1_entries && res.l2_pages == cfg.tlb_l2_entries &&
+          fabs(res.l2_hit_ns - l2_hit) < l2_hit * 0.1 && fabs(res.walk_ns - walk) < walk * 0.1, detail);
+
+    double cold_wrong = misclassified_samples(measure_bank_latency, size, threshold);
+    double warm_wrong = misclassified_samples(measure_bank_latency_prewarm, size, threshold);
+    snprintf(detail, sizeof(detail), "misclassified samples: %.4f cold, %.4f prewarmed, %.4f without a TLB",
+             cold_wrong, warm_wrong, base_wrong);
+    check("tlb-prewarm", warm_wrong <= base_wrong + 0.005 && cold_wrong > 2 * warm_wrong + 0.01, detail);
+
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+/*
+ * run_prefetch_check
+ *
+ * Turns on one simulated prefetcher at a time and checks that the prefetch
+ * benchmark names exactly that one.
+ */
+static void run_prefetch_check(void)
+{
+    char detail[160];
+    struct dramsim_config saved = default_sim.cfg;
+    const struct
+    {
+        const char *name;
+        int next_line, buddy, stride, cross_page;
+        // Expected: next-line, buddy, stream, descending, max stride, cross-page
+        int e_next_line, e_buddy, e_stream, e_descending;
+        int64_t e_max_stride;
+        int e_cross_page;
+    } cases[] = {
+        {"prefetch-none", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        // Next-line prefetches only on misses, so a stream's last line misses.
+        {"prefetch-next-line", 1, 0, 0, 0, 1, 0, 0, 0, 0, 0},
+        {"prefetch-buddy", 0, 1, 0, 0, 0, 1, 0, 0, 0, 0},
+        {"prefetch-stride", 0, 0, 1, 0, 0, 0, 1, 1, 1024, 0},
+        {"prefetch-cross-page", 0, 0, 1, 1, 0, 0, 1, 1, 1024, 1},
+    };
+    for (const auto &c : cases)
+    {
+        struct dramsim_config cfg = saved;
+        cfg.refresh_interval_ns = 0;
+        cfg.prefetch_next_line = c.next_line;
+        cfg.prefetch_buddy = c.buddy;
+        cfg.prefetch_stride = c.stride;
+        cfg.prefetch_cross_page = c.cross_page;
+        dramsim_free(&default_sim);
+        dramsim_init(&default_sim, &cfg);
+
+        struct prefetch_result res;
+        int found = !prefetch_characterize(allocated_mem, cfg.mem_size, PAIR_SEED, &res);
+        snprintf(detail, sizeof(detail), "next-line %d, buddy %d, stream %d, descending %d, max stride %lld, cross-page %d",
+                 res.next_line, res.buddy, res.stream, res.descending, (long long)res.max_stride, res.cross_page);
+        check(c.name, found && res.next_line == c.e_next_line && res.buddy == c.e_buddy && res.stream == c.e_stream &&
+              res.descending == c.e_descending && res.max_stride == c.e_max_stride &&
+              res.cross_page == c.e_cross_page, detail);
+    }
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+// Fraction of the first ORDER_CHECK_STEPS steps of o after which the stride
+// prefetcher has brought in the next row. A sweep flushes what it measures,
+// so only what the last load prefetched is kept.
+static double order_prefetched(const struct sweep_order *o)
+{
+    uint64_t steps = std::min<uint64_t>(o->n - 1, ORDER_CHECK_STEPS), hits = 0;
+    for (uint64_t i = 0; i < steps; i++)
+    {
+        default_sim.cached_lines.clear();
+        dramsim_load(&default_sim, (1 + sweep_order_at(o, i)) * config.row_size);
+        hits += default_sim.cached_lines.count((1 + sweep_order_at(o, i + 1)) * config.row_size / PAIRS_LINE_SIZE);
+    }
+    return steps ? (double)hits / steps : 0.0;
+}
+
+/*
+ * run_order_check
+ *
+ * Checks that the permuted sweep order visits every row exactly once, keeps
+ * the requested distance, never repeats a row delta three times, and leaves
+ * a stride prefetcher that follows the sequential sweep nothing to predict.
+ */
+static void run_order_check(uint64_t size)
+{
+    char detail[160];
+    uint64_t n = size / config.row_size - 1;
+    struct sweep_order o;
+    int reached = !sweep_order_init(&o, ORDER_PERMUTED, n, PAIR_SEED, ORDER_MIN_DISTANCE);
+
+    std::vector<char> seen(n, 0);
+    uint64_t missing = n, repeats = 0;
+    int64_t d1 = 0, d2 = 0;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        uint64_t row = sweep_order_at(&o, i);
+        missing -= !seen[row];
+        seen[row] = 1;
+        if (i)
+        {
+            int64_t d = (int64_t)row - (int64_t)sweep_order_at(&o, i - 1);
+            repeats += i >= 3 && d == d1 && d1 == d2;
+            d2 = d1;
+            d1 = d;
+        }
+    }
+    // Rows k < ORDER_WINDOW steps apart, directly.
+    uint64_t closest = n;
+    for (uint64_t i = 0; i + ORDER_WINDOW < n && i < ORDER_CHECK_STEPS; i++)
+        for (int k = 1; k <= ORDER_WINDOW; k++)
+        {
+            uint64_t a = sweep_order_at(&o, i), b = sweep_order_at(&o, i + k);
+            closest = std::min(closest, a > b ? a - b : b - a);
+        }
+    snprintf(detail, sizeof(detail), "%llu rows, mult %llu, %llu missed, closest %llu (%llu), %llu triple deltas",
+             (unsigned long long)n, (unsigned long long)o.mult, (unsigned long long)missing,
+             (unsigned long long)closest, (unsigned long long)o.min_distance, (unsigned long long)repeats);
+    check("order-permutation", reached && !missing && !repeats && closest >= ORDER_MIN_DISTANCE, detail);
+
+    struct dramsim_config saved = default_sim.cfg;
+    struct dramsim_config cfg = saved;
+    cfg.refresh_interval_ns = 0;
+    cfg.prefetch_stride = 1;
+    cfg.prefetch_cross_page = 1;
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &cfg);
+    struct sweep_order seq;
+    sweep_order_init(&seq, ORDER_SEQUENTIAL, n, PAIR_SEED, 0);
+    double seq_hits = order_prefetched(&seq);
+    double perm_hits = order_prefetched(&o);
+    snprintf(detail, sizeof(detail), "prefetched rows: %.4f sequential, %.4f permuted", seq_hits, perm_hits);
+    check("order-prefetch", seq_hits > 0.9 && perm_hits == 0, detail);
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+/*
+ * run_cachebench_check
+ *
+ * The simulator's cache holds DRAMSIM_CACHE_LINES lines and empties when
+ * full, so the cache sweep must find the reload hitting up to half of it
+ * (the working set and the target share it) and missing past it, and a
+ * flushed line must load slower than a cached one.
+ */
+static void run_cachebench_check(uint64_t size)
+{
+    char detail[160];
+    struct dramsim_config saved = default_sim.cfg;
+    struct dramsim_config cfg = saved;
+    cfg.refresh_interval_ns = 0;
+    cfg.prefetch_next_line = cfg.prefetch_buddy = cfg.prefetch_stride = cfg.prefetch_cross_page = 0;
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &cfg);
+
+    uint64_t capacity = (uint64_t)DRAMSIM_CACHE_LINES * PAIRS_LINE_SIZE;
+    struct cache_sweep_result sweep;
+    int found = !cache_sweep(allocated_mem, size, 4 * capacity, CACHE_CHECK_SAMPLES, &sweep);
+    snprintf(detail, sizeof(detail), "%llu bytes cached of %llu, reload %.0f hit %.0f miss",
+             (unsigned long long)sweep.cached_bytes, (unsigned long long)capacity, sweep.hit_latency,
+             sweep.miss_latency);
+    check("cache-sweep", found && sweep.cached_bytes == capacity / 2, detail);
+
+    struct flush_bench_result flush;
+    found = !flush_bench(allocated_mem, &flush);
+    snprintf(detail, sizeof(detail), "median %.0f hit, %.0f flushed", flush.hit_median, flush.flushed_median);
+    check("flush-bench", found && flush.flush_works, detail);
+
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+/*
+ * run_fuzz_check
+ *
+ * Turns on the simulator's TRR tracker and checks that double-sided
+ * hammering, which flips bits without it, no longer does, and that the
+ * fuzzer finds patterns with more aggressors than the tracker has slots and
+ * spends most of its trials on them. Before that, every random and mutated
+ * pattern must compile to exactly its 2 * frequency * amplitude accesses
+ * per pair.
+ */
+static void run_fuzz_check(uint64_t size)
+{
+    char detail[160];
+    struct dramsim_config saved = default_sim.cfg;
+    struct dramsim_config cfg = saved;
+    std::mt19937_64 rng(PAIR_SEED);
+    struct fuzz_pattern p;
+
+    int short_patterns = 0;
+    uint32_t max_slots = 0;
+    struct fuzz_program prog;
+    for (int i = 0; i < FUZZ_CHECK_PATTERNS; i++)
+    {
+        fuzz_random_pattern(&p, 1 + i % FUZZ_MAX_PAIRS, rng);
+        for (int m = 0; m < i % 8; m++)
+            fuzz_mutate(&p, rng);
+        uint32_t needed = 0;
+        for (unsigned n = 0; n < p.num_pairs; n++)
+            needed += 2U * p.pair[n].frequency * p.pair[n].amplitude;
+        short_patterns += fuzz_compile(&p, &prog) || prog.num_slots != needed || needed > p.length;
+        max_slots = std::max(max_slots, prog.num_slots);
+    }
+    snprintf(detail, sizeof(detail), "%d of %d patterns compiled short, longest %u slots", short_patterns,
+             FUZZ_CHECK_PATTERNS, max_slots);
+    check("fuzz-compile", short_patterns == 0, detail);
+
+    fuzz_random_pattern(&p, 1, rng);
+    p.length = FUZZ_MIN_SLOTS;
+    p.pair[0].frequency = 1;
+    p.pair[0].phase = 0;
+    p.pair[0].amplitude = 1;
+
+    uint32_t flips[2] = {0, 0};
+    int placed = 1;
+    for (int trr = 0; trr < 2; trr++)
+    {
+        cfg.trr_entries = trr ? FUZZ_CHECK_TRR_ENTRIES : 0;
+        dramsim_free(&default_sim);
+        dramsim_init(&default_sim, &cfg);
+        struct fuzz_trial t;
+        placed &= !fuzz_run(&p, allocated_mem, size, FUZZ_CHECK_ACTIVATIONS, rng, &t);
+        flips[trr] = t.flips;
+    }
+    snprintf(detail, sizeof(detail), "double-sided flips: %u without TRR, %u with %d slots", flips[0], flips[1],
+             FUZZ_CHECK_TRR_ENTRIES);
+    check("fuzz-double-sided", placed && flips[0] > 0 && flips[1] == 0, detail);
+
+    struct fuzz_result *res = (struct fuzz_result *)calloc(1, sizeof(struct fuzz_result));
+    int found = !fuzz_campaign(allocated_mem, size, PAIR_SEED, 0, FUZZ_CHECK_TRIALS, FUZZ_CHECK_ACTIVATIONS, res);
+    fuzz_print(res);
+    // Patterns of up to half as many pairs as slots are all caught.
+    uint64_t caught_flipping = 0, productive = 0;
+    for (unsigned n = 1; n <= FUZZ_MAX_PAIRS; n++)
+    {
+        if (2 * n <= FUZZ_CHECK_TRR_ENTRIES)
+            caught_flipping += res->region[n].flipping;
+        else
+            productive += res->region[n].trials;
+    }
+    char best[OUTPUT_LINE_MAX / 2] = "none";
+    if (res->have_best)
+        fuzz_pattern_string(&res->best.pattern, best, sizeof(best));
+    snprintf(detail, sizeof(detail), "%llu flips, best %u pairs (%s), %llu caught flipping, %llu of %llu trials past TRR",
+             (unsigned long long)res->flips, res->best.pattern.num_pairs, best, (unsigned long long)caught_flipping,
+             (unsigned long long)productive, (unsigned long long)res->trials);
+    check("fuzz-campaign", found && 2 * res->best.pattern.num_pairs > FUZZ_CHECK_TRR_ENTRIES && !caught_flipping &&
+          2 * productive > res->trials, detail);
+    free(res);
+
+    dramsim_free(&default_sim);
+    dramsim_init(&default_sim, &saved);
+}
+
+/*
+ * run_config_check
+ *
+ * Loads a configuration file and command line the way a binary would, and
+ * checks that bad keys, values and geometries are refused. The run's own
+ * configuration is restored afterwards.
+ */
+static void run_config_check(void)
+{
+    char detail[256];
+    struct run_config saved = config;
+
+    FILE *f = fopen(CONFIG_CHECK_PATH, "w");
+    if (!f)
+    {
+        check("config-file", 0, "cannot write " CONFIG_CHECK_PATH);
+        return;
+    }
+    fprintf(f, "# geometry\nrow_size = 16384\n  conflict_latency=500   # trailing comment\n\ntrace_path = a b\n");
+    fclose(f);
+    char arg0[] = "simcheck", arg1[] = "--config=" CONFIG_CHECK_PATH, arg2[] = "--samples=7", arg3[] = "positional",
+         arg4[] = "--num_banks", arg5[] = "4";
+    char *argv[] = {arg0, arg1, arg2, arg3, arg4, arg5, NULL};
+    int argc = 6;
+    int rc = config_init(&argc, argv);
+    snprintf(detail, sizeof(detail), "rc %d, row %llu, conflict %llu, samples %llu, banks %llu, trace '%.64s', %d args left",
+             rc, (unsigned long long)config.row_size, (unsigned long long)config.conflict_latency,
+             (unsigned long long)config.samples, (unsigned long long)config.num_banks, config.trace_path, argc);
+    check("config-file", rc == 0 && config.row_size == 16384 && config.conflict_latency == 500 && config.samples == 7 &&
+          config.num_banks == 4 && !strcmp(config.trace_path, "a b") && argc == 2 && !strcmp(argv[1], "positional"),
+          detail);
+
+    // Refused: unknown keys, unparsable and out-of-range values, and
+    // geometries that parse but do not fit together.
+    f = fopen(CONFIG_CHECK_PATH, "w");
+    if (f)
+    {
+        fprintf(f, "rows = 4\nsamples = ten\nworkers = 1000\nno equals sign\n");
+        fclose(f);
+    }
+    int bad_lines = config_load(CONFIG_CHECK_PATH);
+    int bad_set = (config_set("pair_mode", "-1") != 0) + (config_set("pair_budget_sec", "1e400") != 0);
+    config_defaults();
+    config_set("row_size", "12288");
+    int bad_row = config_validate();
+    config_defaults();
+    config_set("hit_latency", "600");
+    config_set("conflict_latency", "500");
+    config_set("num_banks", "64");
+    int bad_relations = config_validate();
+    snprintf(detail, sizeof(detail), "%d bad lines, %d bad values, %d row-size and %d relation problems", bad_lines,
+             bad_set, bad_row, bad_relations);
+    check("config-validate", bad_lines == 4 && bad_set == 2 && bad_row == 1 && bad_relations == 2, detail);
+
+    remove(CONFIG_CHECK_PATH);
+    config = saved;
+}
+
+/*
+ * run_kernel_check
+ *
+ * The row and bank-index kernels: every instantiated size against the
+ * generic path and a plain byte or bit loop.
+ */
+static void run_kernel_check(void)
+{
+    char detail[160];
+    std::mt19937_64 rng(PAIR_SEED);
+    const uint64_t sizes[] = {4096, 8192, 16384, 24576};
+    int row_errors = 0;
+    std::vector<uint8_t> row(24576);
+    for (uint64_t size : sizes)
+    {
+        fill_row(row.data(), size, 0x55);
+        for (int i = 0; i < 64; i++)
+            row[rng() % size] ^= (uint8_t)(1 << (rng() % 8));
+        uint32_t expect = 0;
+        for (uint64_t i = 0; i < size; i++)
+            expect += row[i] != 0x55;
+        row_errors += count_changed(row.data(), size, 0x55) != expect;
+    }
+
+    int parity_errors = 0;
+    uint64_t masks[MAPPING_MAX_FUNCS];
+    for (int i = 0; i < MAPPING_MAX_FUNCS; i++)
+        masks[i] = rng();
+    for (int t = 0; t < 10000; t++)
+    {
+        uint64_t addr = rng();
+        unsigned n = t % (MAPPING_MAX_FUNCS + 1);
+        unsigned expect = 0;
+        for (unsigned i = 0; i < n; i++)
+            expect |= (unsigned)(__builtin_popcountll(addr & masks[i]) & 1) << i;
+        parity_errors += parity_index(addr, masks, n) != expect;
+    }
+    snprintf(detail, sizeof(detail), "%d row sizes and %d bank indices wrong", row_errors, parity_errors);
+    check("kernels", row_errors == 0 && parity_errors == 0, detail);
+}
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t buffer_size_bytes = config_buffer_bytes();
+    allocated_mem = allocate_pages(buffer_size_bytes);
+    guard_init(&default_guard, measure_bank_latency);
+
+    // Halfway between a different-bank pair and a same-bank conflict.
+    const struct dramsim_config *cfg = &default_sim.cfg;
+    double other_bank = cfg->t_base + cfg->t_row_conflict + cfg->t_same_channel;
+    double same_bank = cfg->t_base + 2 * cfg->t_row_conflict;
+    uint64_t threshold = (uint64_t)((other_bank + same_bank) / 2);
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Simulator check\n");
+    output_printf("Seed, %llu\n", (unsigned long long)cfg->seed);
+    output_printf("Banks, %u\n", default_sim.num_banks_total);
+    output_printf("Threshold, %llu\n", (unsigned long long)threshold);
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Sweeps\n");
+    output_printf("Mode,Pairs,Samples,Ambiguous,Samples-Per-Sec,Accuracy\n");
+    double rate;
+    double acc_base = run_sweep(PAIRS_BASE, buffer_size_bytes, threshold, &rate, NULL, NULL);
+    double acc_uniform = run_sweep(PAIRS_UNIFORM, buffer_size_bytes, threshold, &rate, NULL, NULL);
+    uint64_t bit_pairs[64] = {0};
+    uint64_t bit_conflicts[64] = {0};
+    double acc_bitflip = run_sweep(PAIRS_BITFLIP, buffer_size_bytes, threshold, &rate, bit_pairs, bit_conflicts);
+
+    // Flipping a bit keeps the bank and changes the row exactly when the bit
+    // is a row bit that no bank function uses: those should always conflict.
+    uint64_t used = 0;
+    for (unsigned i = 0; i < cfg->num_channel_funcs; i++)
+        used |= cfg->channel_masks[i];
+    for (unsigned i = 0; i < cfg->num_rank_funcs; i++)
+        used |= cfg->rank_masks[i];
+    for (unsigned i = 0; i < cfg->num_bank_funcs; i++)
+        used |= cfg->bank_masks[i];
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Bit-Flip-Mapping\n");
+    output_printf("Bit,Pairs,Conflict-Fraction,Expected\n");
+    int bits_wrong = 0;
+    for (int b = 0; b < 64; b++)
+    {
+        if (!bit_pairs[b])
+            continue;
+        double fraction = (double)bit_conflicts[b] / bit_pairs[b];
+        int expected = b >= (int)cfg->row_shift && !(used >> b & 1);
+        bits_wrong += (fraction > 0.5) != expected;
+        output_printf("%d,%llu,%.4f,%d\n", b, (unsigned long long)bit_pairs[b], fraction, expected);
+    }
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Checks\n");
+    output_printf("Check,Result,Detail\n");
+    char detail[128];
+    snprintf(detail, sizeof(detail), "%.4f", acc_base);
+    check("base-accuracy", acc_base >= MIN_ACCURACY, detail);
+    snprintf(detail, sizeof(detail), "%.4f", acc_uniform);
+    check("uniform-accuracy", acc_uniform >= MIN_ACCURACY, detail);
+    snprintf(detail, sizeof(detail), "%.4f", acc_bitflip);
+    check("bitflip-accuracy", acc_bitflip >= MIN_ACCURACY, detail);
+    snprintf(detail, sizeof(detail), "%d bits misclassified", bits_wrong);
+    check("bitflip-mapping", bits_wrong == 0, detail);
+    run_trace_check(buffer_size_bytes, threshold, other_bank, same_bank);
+    run_compare_check(buffer_size_bytes, threshold);
+    run_workers_check(threshold);
+    run_mapping_check(buffer_size_bytes);
+    run_rowbuf_check(buffer_size_bytes);
+    run_tlb_check(buffer_size_bytes, threshold);
+    run_prefetch_check();
+    run_order_check(buffer_size_bytes);
+    run_cachebench_check(buffer_size_bytes);
+    if (DRAMSIM_FLIP_THRESHOLD)
+        run_fuzz_check(buffer_size_bytes);
+    run_channel_check(buffer_size_bytes);
+    run_config_check();
+    run_kernel_check();
+    if (DRAMSIM_T_REFI_NS > 0)
+        run_refresh_check();
+    if (DRAMSIM_FLIP_THRESHOLD)
+        run_flip_check();
+
+    guard_report(&default_guard);
+    output_log("[%c] simcheck: %d check(s) failed\n", failures ? '-' : '+', failures);
+    output_shutdown();
+    dramsim_free(&default_sim);
+    return failures ? 1 : 0;
+}
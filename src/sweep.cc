@@ -0,0 +1,89 @@
+#include "sweep.hh"
+#include "config.hh"
+#include "guard.hh"
+#include "output.hh"
+#include "telemetry.hh"
+
+#include <string.h>
+
+void latency_sweep_init(struct latency_sweep *sw, void *base, uint64_t size, uint64_t seed, uint64_t max_pairs,
+                        uint64_t threshold, uint64_t sample_budget)
+{
+  memset(sw->histogram, 0, sizeof(sw->histogram));
+  memset(sw->bit_pairs, 0, sizeof(sw->bit_pairs));
+  memset(sw->bit_conflicts, 0, sizeof(sw->bit_conflicts));
+  sw->conflicts = 0;
+
+  pair_sampler_init(&sw->pairs, (enum pair_mode)config.pair_mode, base, size, config.row_size, seed, max_pairs,
+                    config.pair_budget_sec);
+  // A constant stride lets the prefetchers turn measured loads into hits.
+  if (pair_sampler_set_order(&sw->pairs, (enum order_mode)config.order, seed, config.order_min_distance))
+    output_log("[-] Permuted order keeps rows only %llu apart\n", (unsigned long long)sw->pairs.order.min_distance);
+
+  // Sample each pair only until its median is clearly a hit or a conflict,
+  // within the same total budget the fixed config.samples-per-pair sweep used.
+  uint64_t budget = sample_budget ? sample_budget : pair_sampler_expected(&sw->pairs) * config.samples;
+  sampler_init(&sw->sampler, threshold, budget);
+  trace_writer_init(&sw->trace, (uint64_t)base);
+  sw->tc = telemetry_thread_counters();
+  sw->guard_attempts = default_guard.attempts;
+  sw->guard_accepted = default_guard.accepted;
+}
+
+int latency_sweep_trace(struct latency_sweep *sw, const char *path, const char *binary)
+{
+  trace_meta(&sw->trace, "binary", "%s", binary);
+  trace_meta(&sw->trace, "pair_mode", "%s", pair_mode_name(sw->pairs.mode));
+  trace_meta(&sw->trace, "threshold", "%llu", (unsigned long long)sw->sampler.threshold);
+  if (trace_writer_open(&sw->trace, path))
+  {
+    output_log("[-] Could not open trace %s, not recording samples\n", path);
+    return -1;
+  }
+  sampler_trace(&sw->sampler, &sw->trace);
+  return 0;
+}
+
+int latency_sweep_next(struct latency_sweep *sw, struct pair_result *res)
+{
+  uint64_t addr_A, addr_B;
+  if (!pair_sampler_next(&sw->pairs, &addr_A, &addr_B))
+    return 0;
+  if (!sampler_measure_pair(&sw->sampler, guard_measure_default, addr_A, addr_B, res))
+  {
+    output_log("[-] Sample budget exhausted after %llu pairs\n", (unsigned long long)sw->sampler.pairs_done);
+    return 0;
+  }
+  sw->histogram[sweep_bucket(res->median)]++;
+  sw->conflicts += res->decision == PAIR_CONFLICT;
+  if (sw->pairs.mode == PAIRS_BITFLIP)
+  {
+    sw->bit_pairs[sw->pairs.last_bit]++;
+    sw->bit_conflicts[sw->pairs.last_bit] += res->decision == PAIR_CONFLICT;
+  }
+  telemetry_add(sw->tc->measurements, res->num_samples);
+  telemetry_add(sw->tc->rows_done, 1);
+  return 1;
+}
+
+void latency_sweep_run(struct latency_sweep *sw, const char *phase)
+{
+  telemetry_start(phase, pair_sampler_expected(&sw->pairs));
+  struct pair_result res;
+  while (latency_sweep_next(sw, &res))
+    ;
+  telemetry_stop();
+}
+
+void latency_sweep_close(struct latency_sweep *sw)
+{
+  trace_writer_close(&sw->trace);
+}
+
+uint64_t latency_sweep_rejected(const struct latency_sweep *sw, uint64_t *tried)
+{
+  uint64_t attempts = default_guard.attempts - sw->guard_attempts;
+  if (tried)
+    *tried = attempts;
+  return attempts - (default_guard.accepted - sw->guard_accepted);
+}
@@ -0,0 +1,93 @@
+#ifndef SWEEP_GUARD
+#define SWEEP_GUARD
+
+#include <stdint.h>
+
+#include "pairs.hh"
+#include "params.hh"
+#include "sampler.hh"
+#include "trace.hh"
+
+// The pair latency sweep behind histogram, workers and rhbench's histogram
+// stage.
+//
+// Pairs come from a pair sampler in config.pair_mode, visited in
+// config.order. Each is measured through default_guard by the adaptive
+// sampler until its median is clearly a hit or a conflict, and the median is
+// tallied into SWEEP_BUCKETS buckets of SWEEP_BUCKET_WIDTH timer units (the
+// last one open) and, in bit-flip mode, under the flipped bit. Every raw
+// sample can also go to a trace for replay.
+
+#define SWEEP_BUCKETS (101)
+#define SWEEP_BUCKET_WIDTH (10)
+
+struct telemetry_counters;
+
+struct latency_sweep
+{
+  struct pair_sampler pairs;
+  struct adaptive_sampler sampler;
+  struct trace_writer trace;
+  struct telemetry_counters *tc;
+
+  uint64_t histogram[SWEEP_BUCKETS];
+  uint64_t conflicts;
+  uint64_t bit_pairs[64]; // PAIRS_BITFLIP: pairs and conflicts per flipped bit
+  uint64_t bit_conflicts[64];
+  uint64_t guard_attempts; // default_guard's counters at init
+  uint64_t guard_accepted;
+};
+
+static inline int sweep_bucket(uint64_t median)
+{
+  uint64_t bucket = median / SWEEP_BUCKET_WIDTH;
+  return bucket < SWEEP_BUCKETS - 1 ? (int)bucket : SWEEP_BUCKETS - 1;
+}
+
+/*
+ * latency_sweep_init
+ *
+ * Inputs: base/size - Buffer the pairs are drawn from
+ *         seed - Pair sampler and row order seed
+ *         max_pairs - Pair budget (config.pair_budget_sec applies as well)
+ *         threshold - Hit/conflict boundary, epoch 0 timer units
+ *         sample_budget - Samples for the whole sweep, 0 for config.samples
+ *                         per expected pair
+ * Outputs: sw - Sweep ready to run, not tracing
+ */
+void latency_sweep_init(struct latency_sweep *sw, void *base, uint64_t size, uint64_t seed, uint64_t max_pairs,
+                        uint64_t threshold, uint64_t sample_budget);
+
+/*
+ * latency_sweep_trace
+ *
+ * Records every pair and raw sample to path, with binary, the pair mode and
+ * the threshold in its metadata.
+ *
+ * Returns: 0 if recording, -1 if path could not be opened (the sweep runs
+ *          without a trace)
+ */
+int latency_sweep_trace(struct latency_sweep *sw, const char *path, const char *binary);
+
+/*
+ * latency_sweep_next
+ *
+ * Measures the next pair and tallies it.
+ *
+ * Outputs: res - The pair's median, samples and decision
+ * Returns: 1 if a pair was measured, 0 once the pairs or the sample budget
+ *          are exhausted
+ */
+int latency_sweep_next(struct latency_sweep *sw, struct pair_result *res);
+
+// Runs the sweep to the end, reporting progress as telemetry phase.
+void latency_sweep_run(struct latency_sweep *sw, const char *phase);
+
+// Closes the trace, if any.
+void latency_sweep_close(struct latency_sweep *sw);
+
+// Samples default_guard retried since latency_sweep_init; tried gets the
+// attempts over the same span.
+uint64_t latency_sweep_rejected(const struct latency_sweep *sw, uint64_t *tried);
+
+#endif
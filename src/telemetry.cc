@@ -0,0 +1,172 @@
+#include "telemetry.hh"
+#include "output.hh"
+#include "params.hh"
+#include "placement.hh"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct telemetry_counters slots[TELEMETRY_MAX_THREADS];
+static std::atomic<int> num_slots(0);
+static thread_local struct telemetry_counters *thread_slot = NULL;
+
+static std::atomic<const char *> current_phase("");
+static std::atomic<int> reporter_running(0);
+static pthread_t reporter_thread;
+static uint64_t total_rows = 0;
+static FILE *telemetry_file = NULL;
+
+struct telemetry_snapshot
+{
+  double time_sec;
+  uint64_t rows_done;
+  uint64_t measurements;
+  uint64_t hammer_rounds;
+  uint64_t outliers;
+};
+
+static double monotonic_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+struct telemetry_counters *telemetry_thread_counters(void)
+{
+  if (!thread_slot)
+  {
+    int slot = num_slots.fetch_add(1);
+    if (slot >= TELEMETRY_MAX_THREADS)
+    {
+      // Shared slot: counts may be lost but reports stay roughly right.
+      output_log("[-] telemetry: more than %d threads, sharing last slot\n", TELEMETRY_MAX_THREADS);
+      slot = TELEMETRY_MAX_THREADS - 1;
+    }
+    thread_slot = &slots[slot];
+  }
+  return thread_slot;
+}
+
+static void take_snapshot(struct telemetry_snapshot *snap)
+{
+  int used = num_slots.load();
+  if (used > TELEMETRY_MAX_THREADS)
+    used = TELEMETRY_MAX_THREADS;
+
+  snap->time_sec = monotonic_sec();
+  snap->rows_done = snap->measurements = snap->hammer_rounds = snap->outliers = 0;
+  for (int i = 0; i < used; i++)
+  {
+    snap->rows_done += slots[i].rows_done.load(std::memory_order_relaxed);
+    snap->measurements += slots[i].measurements.load(std::memory_order_relaxed);
+    snap->hammer_rounds += slots[i].hammer_rounds.load(std::memory_order_relaxed);
+    snap->outliers += slots[i].outliers.load(std::memory_order_relaxed);
+  }
+}
+
+static void report(const struct telemetry_snapshot *start, const struct telemetry_snapshot *prev,
+                   const struct telemetry_snapshot *now)
+{
+  double dt = now->time_sec - prev->time_sec;
+  if (dt <= 0)
+    dt = 1e-9;
+  double elapsed = now->time_sec - start->time_sec;
+
+  double meas_rate = (now->measurements - prev->measurements) / dt;
+  double hammer_rate = (now->hammer_rounds - prev->hammer_rounds) / dt;
+  uint64_t window_meas = now->measurements - prev->measurements;
+  double outlier_rate = window_meas ? (double)(now->outliers - prev->outliers) / window_meas : 0.0;
+
+  // ETA from the average row rate over the whole run, which is steadier
+  // than the last window for sweeps with uneven rows.
+  double row_rate = elapsed > 0 ? now->rows_done / elapsed : 0.0;
+  double eta = -1;
+  if (row_rate > 0 && total_rows >= now->rows_done)
+    eta = (total_rows - now->rows_done) / row_rate;
+
+  const char *phase = current_phase.load();
+  int stalled = now->rows_done == prev->rows_done && now->measurements == prev->measurements &&
+                now->hammer_rounds == prev->hammer_rounds;
+
+  output_log("[telemetry] %8.0fs %-12s rows %llu/%llu  meas/s %.0f  hammer/s %.0f  outliers %.2f%%  eta %.0fs%s\n",
+             elapsed, phase, (unsigned long long)now->rows_done, (unsigned long long)total_rows, meas_rate,
+             hammer_rate, outlier_rate * 100.0, eta, stalled ? "  STALLED" : "");
+
+  if (telemetry_file)
+  {
+    fprintf(telemetry_file, "%.3f,%s,%llu,%llu,%.1f,%.1f,%.6f,%.1f\n", elapsed, phase,
+            (unsigned long long)now->rows_done, (unsigned long long)total_rows, meas_rate, hammer_rate,
+            outlier_rate, eta);
+    fflush(telemetry_file);
+  }
+}
+
+static void *reporter_function(void *x_void_ptr)
+{
+  struct telemetry_snapshot start, prev, now;
+  take_snapshot(&start);
+  prev = start;
+
+  while (reporter_running.load())
+  {
+    // Sleep in short steps so telemetry_stop() does not wait a full interval.
+    double deadline = prev.time_sec + TELEMETRY_INTERVAL_SEC;
+    while (reporter_running.load() && monotonic_sec() < deadline)
+      usleep(100 * 1000);
+
+    take_snapshot(&now);
+    report(&start, &prev, &now);
+    prev = now;
+  }
+  return NULL;
+}
+
+void telemetry_start(const char *phase, uint64_t rows_total)
+{
+  current_phase.store(phase);
+  total_rows = rows_total;
+
+  const char *path = TELEMETRY_PATH;
+  if (path && path[0])
+  {
+    telemetry_file = fopen(path, "w");
+    if (!telemetry_file)
+      output_log("[-] telemetry: could not open %s: %s\n", path, strerror(errno));
+    else
+      fprintf(telemetry_file, "elapsed_s,phase,rows_done,rows_total,meas_per_s,hammer_rounds_per_s,outlier_rate,eta_s\n");
+  }
+
+  reporter_running.store(1);
+  pthread_attr_t attr;
+  placement_helper_attr(&attr);
+  int rc = pthread_create(&reporter_thread, &attr, reporter_function, NULL);
+  pthread_attr_destroy(&attr);
+  if (rc)
+  {
+    output_log("[-] Error creating telemetry thread: %s\n", strerror(rc));
+    reporter_running.store(0);
+  }
+}
+
+void telemetry_set_phase(const char *phase)
+{
+  current_phase.store(phase);
+}
+
+void telemetry_stop(void)
+{
+  if (!reporter_running.exchange(0))
+    return;
+  pthread_join(reporter_thread, NULL);
+  if (telemetry_file)
+  {
+    fclose(telemetry_file);
+    telemetry_file = NULL;
+  }
+}
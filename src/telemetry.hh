@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_GUARD
+#define TELEMETRY_GUARD
+
+#include <atomic>
+#include <stdint.h>
+
+// Live progress telemetry.
+//
+// Hot loops bump per-thread counters with relaxed loads/stores (each slot has
+// a single writer, so no locked read-modify-write is needed). A reporter
+// thread sums all slots every TELEMETRY_INTERVAL_SEC seconds and prints rows
+// done, measurement and hammer rates, the current outlier rate and an ETA to
+// the log stream (see output.hh), and optionally as CSV to TELEMETRY_PATH.
+
+struct telemetry_counters
+{
+  alignas(64) std::atomic<uint64_t> rows_done;
+  std::atomic<uint64_t> measurements;
+  std::atomic<uint64_t> hammer_rounds;
+  std::atomic<uint64_t> outliers;
+};
+
+// Counters owned by the calling thread (registered on first use).
+struct telemetry_counters *telemetry_thread_counters(void);
+
+static inline void telemetry_add(std::atomic<uint64_t> &counter, uint64_t n)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+ * telemetry_start
+ *
+ * Starts the reporter thread.
+ *
+ * Inputs: phase - Short name of the current sweep, printed with each report
+ *         rows_total - Rows the whole run will cover, used for the ETA
+ * Outputs: none
+ */
+void telemetry_start(const char *phase, uint64_t rows_total);
+
+// Rename the current sweep (e.g. between hammering distances).
+void telemetry_set_phase(const char *phase);
+
+// Print a final report and stop the reporter thread.
+void telemetry_stop(void);
+
+#endif
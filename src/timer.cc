@@ -0,0 +1,256 @@
+#include "timer.hh"
+#include "output.hh"
+#include "params.hh"
+#include "placement.hh"
+#include "util.hh"
+
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+// Code from SPECTRE: https://github.com/cryptax/spectre-armv7/blob/bc9bd14988d1119242c95042024ff0f20afd2e03/source.c#L165
+// Uses dedicated thread that increments once per cycle to act as a timing parameter
+volatile uint64_t timer_counter = 0;
+
+static std::atomic<int> counter_running(0);
+static pthread_t counter_thread;
+
+static void *counter_function(void *x_void_ptr)
+{
+  int cpu = (int)(intptr_t)x_void_ptr;
+  placement_apply_self(cpu, cpu >= 0 && cpu == placement_counter_cpu() && placement_realtime());
+
+  while (counter_running.load(std::memory_order_relaxed))
+  {
+    timer_counter++;
+  }
+  return NULL;
+}
+
+int counter_thread_start(int cpu)
+{
+  if (counter_running.exchange(1))
+    return 0;
+
+  uint64_t before = timer_counter;
+  int rc = pthread_create(&counter_thread, NULL, counter_function, (void *)(intptr_t)cpu);
+  if (rc)
+  {
+    output_log("[-] Error creating counter thread: %s\n", strerror(rc));
+    counter_running.store(0);
+    return -1;
+  }
+
+  // Don't hand out timestamps before the thread is actually spinning.
+  while (timer_counter == before)
+    sched_yield();
+  return 0;
+}
+
+void counter_thread_stop(void)
+{
+  if (!counter_running.exchange(0))
+    return;
+  int rc = pthread_join(counter_thread, NULL);
+  if (rc)
+    output_log("[-] Error joining counter thread: %s\n", strerror(rc));
+}
+
+uint64_t monotonic_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int timer_available(enum timer_source src)
+{
+  switch (src)
+  {
+  case TIMER_COUNTER_THREAD:
+  case TIMER_CLOCK_GETTIME:
+    return 1;
+  case TIMER_CNTVCT:
+#if defined(__aarch64__)
+    return 1;
+#else
+    return 0;
+#endif
+  case TIMER_TSC:
+#if defined(__x86_64__)
+    return 1;
+#else
+    return 0;
+#endif
+  default:
+    return 0;
+  }
+}
+
+const char *timer_name(enum timer_source src)
+{
+  switch (src)
+  {
+  case TIMER_COUNTER_THREAD:
+    return "counter-thread";
+  case TIMER_CNTVCT:
+    return "cntvct_el0";
+  case TIMER_CLOCK_GETTIME:
+    return "clock_gettime";
+  case TIMER_TSC:
+    return "tsc";
+  default:
+    return "unknown";
+  }
+}
+
+uint64_t timer_read(enum timer_source src)
+{
+  switch (src)
+  {
+  case TIMER_COUNTER_THREAD:
+    return timer_counter;
+  case TIMER_CNTVCT:
+  case TIMER_TSC:
+    return rdtsc();
+  case TIMER_CLOCK_GETTIME:
+    return monotonic_ns();
+  default:
+    return 0;
+  }
+}
+
+static enum timer_source clock_src = TIMER_CLOCK_GETTIME;
+// Epoch 0 is the reference every later epoch is normalized to, so it is kept
+// out of the ring the calibrator recycles.
+static struct clock_calibration epoch0;
+static struct clock_calibration calibrations[CLOCK_MAX_EPOCHS];
+static std::atomic<uint32_t> current_epoch(0);
+static std::atomic<int> clock_running(0);
+static pthread_t calibrator_thread;
+static double max_drift = 0;
+
+static const struct clock_calibration &calibration_at(uint32_t epoch)
+{
+  return epoch ? calibrations[epoch % CLOCK_MAX_EPOCHS] : epoch0;
+}
+
+static struct clock_calibration calibrate(enum timer_source src)
+{
+  uint64_t m1 = monotonic_ns();
+  uint64_t t1 = timer_read(src);
+  usleep(CLOCK_RECAL_WINDOW_MS * 1000);
+  uint64_t t2 = timer_read(src);
+  uint64_t m2 = monotonic_ns();
+
+  struct clock_calibration cal;
+  cal.taken_ns = m2;
+  cal.ticks_per_ns = (double)(t2 - t1) / (double)(m2 - m1);
+  return cal;
+}
+
+static void *calibrator_function(void *x_void_ptr)
+{
+  uint64_t next_ns = monotonic_ns() + (uint64_t)CLOCK_RECAL_SEC * 1000000000ULL;
+  while (clock_running.load())
+  {
+    if (monotonic_ns() < next_ns)
+    {
+      usleep(100 * 1000);
+      continue;
+    }
+
+    struct clock_calibration cal = calibrate(clock_src);
+    uint32_t epoch = current_epoch.load(std::memory_order_relaxed) + 1;
+    // Publish the calibration before the epoch id that points at it.
+    calibrations[epoch % CLOCK_MAX_EPOCHS] = cal;
+    current_epoch.store(epoch, std::memory_order_release);
+
+    double drift = cal.ticks_per_ns / epoch0.ticks_per_ns - 1.0;
+    if (drift < 0)
+      drift = -drift;
+    if (drift > max_drift)
+      max_drift = drift;
+    if (drift > CLOCK_DRIFT_WARN)
+      output_log("[-] clock: epoch %u tick rate %.4f/ns is %.1f%% off epoch 0 (%.4f/ns)\n", epoch, cal.ticks_per_ns,
+                 drift * 100.0, epoch0.ticks_per_ns);
+
+    next_ns = cal.taken_ns + (uint64_t)CLOCK_RECAL_SEC * 1000000000ULL;
+  }
+  return NULL;
+}
+
+int clock_service_start(enum timer_source src)
+{
+  if (clock_running.load())
+    return 0;
+
+  clock_src = src;
+  if (src == TIMER_COUNTER_THREAD && counter_thread_start(placement_counter_cpu()))
+    return -1;
+
+  epoch0 = calibrate(src);
+  current_epoch.store(0);
+  max_drift = 0;
+
+  clock_running.store(1);
+  pthread_attr_t attr;
+  placement_helper_attr(&attr);
+  int rc = pthread_create(&calibrator_thread, &attr, calibrator_function, NULL);
+  pthread_attr_destroy(&attr);
+  if (rc)
+  {
+    output_log("[-] Error creating clock calibration thread: %s\n", strerror(rc));
+    clock_running.store(0);
+    return -1;
+  }
+  return 0;
+}
+
+void clock_service_stop(void)
+{
+  if (!clock_running.exchange(0))
+    return;
+  pthread_join(calibrator_thread, NULL);
+  if (clock_src == TIMER_COUNTER_THREAD)
+    counter_thread_stop();
+}
+
+uint32_t clock_epoch(void)
+{
+  return current_epoch.load(std::memory_order_acquire);
+}
+
+struct clock_calibration clock_calibration_of(uint32_t epoch)
+{
+  return calibration_at(epoch);
+}
+
+double clock_to_ns(uint64_t ticks, uint32_t epoch)
+{
+  double rate = calibration_at(epoch).ticks_per_ns;
+  return rate > 0 ? (double)ticks / rate : (double)ticks;
+}
+
+uint64_t clock_normalize(uint64_t ticks, uint32_t epoch)
+{
+  if (epoch == 0)
+    return ticks;
+  double rate = calibration_at(epoch).ticks_per_ns;
+  if (rate <= 0)
+    return ticks;
+  return (uint64_t)((double)ticks * epoch0.ticks_per_ns / rate + 0.5);
+}
+
+double clock_max_drift(void)
+{
+  return max_drift;
+}
+
+void clock_report(void)
+{
+  output_log("[+] clock: %s, %u recalibrations, epoch 0 %.4f ticks/ns, max drift %.2f%%\n", timer_name(clock_src),
+             clock_epoch(), epoch0.ticks_per_ns, max_drift * 100.0);
+}
@@ -0,0 +1,89 @@
+#ifndef TIMER_GUARD
+#define TIMER_GUARD
+
+#include <stdint.h>
+
+// Timer sources available to the measurements.
+//
+// The counter thread is the Branch Different style timer: a dedicated thread
+// spinning on an increment, read from the measuring thread. It is started
+// once per process instead of once per measurement.
+
+enum timer_source
+{
+  TIMER_COUNTER_THREAD = 0, // Dedicated incrementing thread
+  TIMER_CNTVCT = 1,         // cntvct_el0 via rdtsc() (arm64 only)
+  TIMER_CLOCK_GETTIME = 2,  // clock_gettime(CLOCK_MONOTONIC), in ns
+  TIMER_TSC = 3,            // x86 time stamp counter via rdtsc() (x86-64 only)
+  TIMER_NUM_SOURCES
+};
+
+// Incremented by the counter thread while it runs.
+extern volatile uint64_t timer_counter;
+
+/*
+ * counter_thread_start
+ *
+ * Starts the counter thread if it is not already running and waits for its
+ * first increments.
+ *
+ * Inputs: cpu - Core to pin the thread to, or -1 to leave placement to the
+ *               scheduler (see placement.hh)
+ * Output: 0 on success, -1 if the thread could not be created
+ */
+int counter_thread_start(int cpu);
+void counter_thread_stop(void);
+
+int timer_available(enum timer_source src);
+const char *timer_name(enum timer_source src);
+
+// Current value of a source, in its own units.
+uint64_t timer_read(enum timer_source src);
+
+uint64_t monotonic_ns(void);
+
+// Clock service.
+//
+// Counter-thread ticks are only as steady as the core spinning on them: DVFS,
+// throttling and core type all change the tick rate. The clock service
+// recalibrates the measurement source against CLOCK_MONOTONIC every
+// CLOCK_RECAL_SEC seconds from a background thread. Each calibration opens a
+// new epoch; a sample tagged with the epoch it was taken in can be converted
+// to nanoseconds, or to epoch 0 ticks so it stays comparable with thresholds
+// calibrated at the start of the run.
+
+struct clock_calibration
+{
+  uint64_t taken_ns;   // CLOCK_MONOTONIC time the calibration finished
+  double ticks_per_ns;
+};
+
+/*
+ * clock_service_start
+ *
+ * Starts the source (the counter thread, for TIMER_COUNTER_THREAD, on the
+ * CPU chosen by placement_init), calibrates epoch 0 and starts the
+ * recalibration thread.
+ *
+ * Inputs: src - Source get_timestamp() reads
+ * Output: 0 on success, -1 on failure
+ */
+int clock_service_start(enum timer_source src);
+void clock_service_stop(void);
+
+// Epoch of the most recent calibration. Tag samples with it.
+uint32_t clock_epoch(void);
+struct clock_calibration clock_calibration_of(uint32_t epoch);
+
+double clock_to_ns(uint64_t ticks, uint32_t epoch);
+
+// Ticks from an epoch rescaled to epoch 0's tick rate.
+uint64_t clock_normalize(uint64_t ticks, uint32_t epoch);
+
+// Largest relative rate change from epoch 0 seen so far (0.05 == 5%).
+double clock_max_drift(void);
+
+// Print the epoch count and drift to the log stream.
+void clock_report(void);
+
+#endif
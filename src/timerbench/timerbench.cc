@@ -0,0 +1,284 @@
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../timer.hh"
+#include "../placement.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <pthread.h>
+#include <vector>
+
+// Back-to-back reads used for overhead and resolution
+#define READ_ITERS (1000000)
+// Timed fixed workloads used for the jitter distribution
+#define JITTER_SAMPLES (10000)
+#define JITTER_WORK (1000)
+// Rate measurement window, and number of windows for drift
+#define RATE_WINDOW_MS (100)
+#define DRIFT_WINDOWS (20)
+// Cores tried for counter thread placement
+#define MAX_CPUS (16)
+
+static std::atomic<int> load_running(0);
+
+static void *load_function(void *x_void_ptr)
+{
+    volatile uint64_t spin = 0;
+    while (load_running.load(std::memory_order_relaxed))
+        spin++;
+    return NULL;
+}
+
+/*
+ * measure_rate
+ *
+ * Ticks of a source per nanosecond of CLOCK_MONOTONIC over one window.
+ */
+static double measure_rate(enum timer_source src, uint64_t window_ms)
+{
+    uint64_t m1 = monotonic_ns();
+    uint64_t t1 = timer_read(src);
+    usleep(window_ms * 1000);
+    uint64_t t2 = timer_read(src);
+    uint64_t m2 = monotonic_ns();
+    return (double)(t2 - t1) / (double)(m2 - m1);
+}
+
+static void run_read_costs(enum timer_source src, double rate)
+{
+    // Read overhead: many back-to-back reads against the monotonic clock.
+    uint64_t sink = 0;
+    uint64_t m1 = monotonic_ns();
+    for (int i = 0; i < READ_ITERS; i++)
+        sink += timer_read(src);
+    uint64_t m2 = monotonic_ns();
+    double overhead_ns = (double)(m2 - m1) / READ_ITERS;
+
+    // Effective resolution: smallest non-zero step seen between two reads,
+    // and how often two reads return the same value.
+    uint64_t min_step = UINT64_MAX;
+    uint64_t repeats = 0;
+    uint64_t prev = timer_read(src);
+    for (int i = 0; i < READ_ITERS; i++)
+    {
+        uint64_t now = timer_read(src);
+        if (now == prev)
+            repeats++;
+        else if (now - prev < min_step)
+            min_step = now - prev;
+        prev = now;
+    }
+
+    output_printf("%s,%.4f,%.2f,%llu,%.2f,%.4f\n", timer_name(src), rate, overhead_ns,
+                  (unsigned long long)min_step, min_step / rate, (double)repeats / READ_ITERS);
+    (void)sink;
+}
+
+static void run_jitter(enum timer_source src, double rate)
+{
+    std::vector<uint64_t> samples(JITTER_SAMPLES);
+    volatile uint64_t work = 0;
+    for (int i = 0; i < JITTER_SAMPLES; i++)
+    {
+        arm_v8_memory_barrier();
+        uint64_t t1 = timer_read(src);
+        for (int j = 0; j < JITTER_WORK; j++)
+            work = work * 3 + 1;
+        arm_v8_memory_barrier();
+        uint64_t t2 = timer_read(src);
+        samples[i] = t2 - t1;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0, m2 = 0;
+    for (int i = 0; i < JITTER_SAMPLES; i++)
+    {
+        double delta = samples[i] - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (samples[i] - mean);
+    }
+    double stddev = sqrt(m2 / (JITTER_SAMPLES - 1));
+
+    output_printf("%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f\n", timer_name(src),
+                  samples[0] / rate, samples[JITTER_SAMPLES / 100] / rate, samples[JITTER_SAMPLES / 2] / rate,
+                  samples[JITTER_SAMPLES * 99 / 100] / rate, samples[JITTER_SAMPLES - 1] / rate, stddev / rate,
+                  mean > 0 ? stddev / mean : 0.0);
+}
+
+static void run_drift(enum timer_source src)
+{
+    double rates[DRIFT_WINDOWS];
+    uint64_t m_start = monotonic_ns();
+    uint64_t t_start = timer_read(src);
+    for (int w = 0; w < DRIFT_WINDOWS; w++)
+        rates[w] = measure_rate(src, RATE_WINDOW_MS);
+    uint64_t t_end = timer_read(src);
+    uint64_t m_end = monotonic_ns();
+
+    double lo = rates[0], hi = rates[0], sum = 0;
+    for (int w = 0; w < DRIFT_WINDOWS; w++)
+    {
+        lo = std::min(lo, rates[w]);
+        hi = std::max(hi, rates[w]);
+        sum += rates[w];
+    }
+    double mean = sum / DRIFT_WINDOWS;
+
+    // Error accumulated over the whole run if every tick were converted with
+    // the rate calibrated in the first window.
+    double predicted_ns = (t_end - t_start) / rates[0];
+    double offset_ns = predicted_ns - (double)(m_end - m_start);
+
+    output_printf("%s,%.4f,%.4f,%.4f,%.0f,%.0f\n", timer_name(src), lo, mean, hi,
+                  mean > 0 ? (hi - lo) / mean * 1e6 : 0.0, offset_ns);
+}
+
+// Coefficient of variation of a short fixed workload timed with the counter.
+static double counter_jitter_cv(void)
+{
+    const int samples = JITTER_SAMPLES / 10;
+    volatile uint64_t work = 0;
+    double mean = 0, m2 = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        arm_v8_memory_barrier();
+        uint64_t t1 = timer_counter;
+        for (int j = 0; j < JITTER_WORK; j++)
+            work = work * 3 + 1;
+        arm_v8_memory_barrier();
+        double t = (double)(timer_counter - t1);
+        double delta = t - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (t - mean);
+    }
+    return mean > 0 ? sqrt(m2 / (samples - 1)) / mean : 0.0;
+}
+
+// Pins this thread as it goes, so it runs last.
+static void run_policies(const struct topology *topo)
+{
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Counter-Thread-Placement-Policy\n");
+    output_printf("Policy,Measure-CPU,Counter-CPU,Ticks-Per-NS,Jitter-CV\n");
+
+    for (int p = 0; p < PLACE_NUM_POLICIES; p++)
+    {
+        int measure_cpu, counter_cpu;
+        if (placement_plan(topo, (enum placement_policy)p, &measure_cpu, &counter_cpu))
+        {
+            output_printf("%s,n/a,n/a,,\n", placement_policy_name((enum placement_policy)p));
+            continue;
+        }
+        placement_apply_self(measure_cpu, 0);
+        if (counter_thread_start(counter_cpu))
+            continue;
+        usleep(10 * 1000);
+        double rate = measure_rate(TIMER_COUNTER_THREAD, RATE_WINDOW_MS);
+        double cv = counter_jitter_cv();
+        counter_thread_stop();
+        output_printf("%s,%d,%d,%.4f,%.4f\n", placement_policy_name((enum placement_policy)p), measure_cpu,
+                      counter_cpu, rate, cv);
+    }
+}
+
+static void run_counter_placement(void)
+{
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int loads[3] = {0, ncpu / 2, ncpu > 1 ? ncpu - 1 : 0};
+#if defined(__linux__)
+    int max_cpu = std::min(ncpu, MAX_CPUS);
+#else
+    int max_cpu = 0; // no thread pinning on macOS
+#endif
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Counter-Thread-Tick-Rate\n");
+    output_printf("CPU,Load-Threads,Ticks-Per-NS\n");
+
+    for (int l = 0; l < 3; l++)
+    {
+        if (l > 0 && loads[l] == loads[l - 1])
+            continue;
+        std::vector<pthread_t> load_threads(loads[l]);
+        load_running.store(1);
+        for (int i = 0; i < loads[l]; i++)
+            pthread_create(&load_threads[i], NULL, load_function, NULL);
+
+        for (int cpu = -1; cpu < max_cpu; cpu++)
+        {
+            if (counter_thread_start(cpu))
+                continue;
+            usleep(10 * 1000);
+            double rate = measure_rate(TIMER_COUNTER_THREAD, RATE_WINDOW_MS);
+            counter_thread_stop();
+            if (cpu < 0)
+                output_printf("any,%d,%.4f\n", loads[l], rate);
+            else
+                output_printf("%d,%d,%.4f\n", cpu, loads[l], rate);
+        }
+
+        load_running.store(0);
+        for (int i = 0; i < loads[l]; i++)
+            pthread_join(load_threads[i], NULL);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    if (counter_thread_start(-1))
+        return -1;
+
+    double rates[TIMER_NUM_SOURCES];
+    for (int s = 0; s < TIMER_NUM_SOURCES; s++)
+    {
+        if (timer_available((enum timer_source)s))
+            rates[s] = measure_rate((enum timer_source)s, RATE_WINDOW_MS);
+    }
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Timer characterization\n");
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Read-Cost\n");
+    output_printf("Source,Ticks-Per-NS,Read-Overhead-NS,Min-Step-Ticks,Resolution-NS,Repeat-Fraction\n");
+    for (int s = 0; s < TIMER_NUM_SOURCES; s++)
+    {
+        if (timer_available((enum timer_source)s))
+            run_read_costs((enum timer_source)s, rates[s]);
+    }
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Jitter, %d samples of a fixed workload\n", JITTER_SAMPLES);
+    output_printf("Source,Min-NS,P1-NS,P50-NS,P99-NS,Max-NS,Stddev-NS,CV\n");
+    for (int s = 0; s < TIMER_NUM_SOURCES; s++)
+    {
+        if (timer_available((enum timer_source)s))
+            run_jitter((enum timer_source)s, rates[s]);
+    }
+
+    output_printf("TABLESTART,TABLESTART\n");
+    output_printf("Drift, %d windows of %d ms against CLOCK_MONOTONIC\n", DRIFT_WINDOWS, RATE_WINDOW_MS);
+    output_printf("Source,Min-Ticks-Per-NS,Mean-Ticks-Per-NS,Max-Ticks-Per-NS,Spread-PPM,Accumulated-Offset-NS\n");
+    for (int s = 0; s < TIMER_NUM_SOURCES; s++)
+    {
+        if (timer_available((enum timer_source)s))
+            run_drift((enum timer_source)s);
+    }
+
+    counter_thread_stop();
+    run_counter_placement();
+
+    struct topology topo;
+    topology_discover(&topo);
+    topology_print(&topo);
+    run_policies(&topo);
+    output_shutdown();
+    return 0;
+}
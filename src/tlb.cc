@@ -0,0 +1,154 @@
+#include "tlb.hh"
+#include "output.hh"
+#include "shared.hh"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define LINES_PER_PAGE (PAGE_SIZE / PAIRS_LINE_SIZE)
+
+// Median of TLB_REPEATS chases through addrs.
+static double median_chase(const std::vector<uint64_t> &addrs)
+{
+  uint64_t rounds = std::max((uint64_t)TLB_MIN_ROUNDS, (uint64_t)TLB_CHASE_LOADS / addrs.size());
+  double t[TLB_REPEATS];
+  for (int i = 0; i < TLB_REPEATS; i++)
+    t[i] = measure_chase(addrs.data(), (int)addrs.size(), rounds);
+  std::sort(t, t + TLB_REPEATS);
+  return t[TLB_REPEATS / 2];
+}
+
+int tlb_sweep(void *base, uint64_t size, uint64_t seed, struct tlb_result *r)
+{
+  std::mt19937_64 rng(seed);
+  uint64_t b = (uint64_t)base;
+  double ticks_per_ns = timestamp_ticks_per_ns();
+  r->num_points = 0;
+  for (uint64_t pages = TLB_MIN_PAGES; pages <= TLB_MAX_PAGES && pages * PAGE_SIZE <= size &&
+                                       r->num_points < TLB_MAX_POINTS;
+       pages *= 2)
+  {
+    // Sparse: one line per page, pages in random order.
+    std::vector<uint64_t> sparse(pages);
+    for (uint64_t i = 0; i < pages; i++)
+      sparse[i] = b + i * PAGE_SIZE + (i % LINES_PER_PAGE) * PAIRS_LINE_SIZE;
+    std::shuffle(sparse.begin(), sparse.end(), rng);
+
+    // Dense: the same number of lines, a page at a time in random order,
+    // shuffled within each page, so it misses the TLB once per page.
+    uint64_t dense_pages = (pages + LINES_PER_PAGE - 1) / LINES_PER_PAGE;
+    std::vector<uint64_t> page_order(dense_pages);
+    for (uint64_t i = 0; i < dense_pages; i++)
+      page_order[i] = i;
+    std::shuffle(page_order.begin(), page_order.end(), rng);
+    std::vector<uint64_t> dense;
+    for (uint64_t p : page_order)
+    {
+      size_t first = dense.size();
+      for (uint64_t l = 0; l < LINES_PER_PAGE && dense.size() < pages; l++)
+        dense.push_back(b + p * PAGE_SIZE + l * PAIRS_LINE_SIZE);
+      std::shuffle(dense.begin() + first, dense.end(), rng);
+    }
+
+    struct tlb_point *pt = &r->point[r->num_points++];
+    pt->pages = pages;
+    pt->dense = median_chase(dense);
+    pt->sparse = median_chase(sparse);
+    pt->cost_ns = (pt->sparse - pt->dense) / ticks_per_ns;
+  }
+  return tlb_analyze(r);
+}
+
+static double mean_cost(const struct tlb_result *r, int first, int last)
+{
+  double sum = 0;
+  for (int i = first; i < last; i++)
+    sum += r->point[i].cost_ns;
+  return last > first ? sum / (last - first) : 0;
+}
+
+// Squared deviation of the costs in [first, last) from their mean.
+static double spread(const struct tlb_result *r, int first, int last)
+{
+  double mean = mean_cost(r, first, last), sum = 0;
+  for (int i = first; i < last; i++)
+    sum += (r->point[i].cost_ns - mean) * (r->point[i].cost_ns - mean);
+  return sum;
+}
+
+int tlb_analyze(struct tlb_result *r)
+{
+  r->l1_pages = 0;
+  r->l2_pages = 0;
+  r->l2_hit_ns = 0;
+  r->walk_ns = 0;
+  int n = r->num_points;
+  double top = 0;
+  for (int i = 0; i < n; i++)
+    top = std::max(top, r->point[i].cost_ns);
+  if (n < 2 || top <= 0)
+    return -1;
+
+  // First step: the L1 TLB overflows.
+  int first = 0;
+  while (first < n && r->point[first].cost_ns <= TLB_STEP_FRACTION * top)
+    first++;
+  r->l1_pages = first > 0 ? r->point[first - 1].pages : 0;
+
+  // Second step: the split of the rest into the two flattest plateaus, if
+  // the upper one is clearly a different level.
+  int split = -1;
+  double best = spread(r, first, n);
+  for (int j = first + 1; j < n; j++)
+  {
+    double s = spread(r, first, j) + spread(r, j, n);
+    if (s < best && mean_cost(r, j, n) >= TLB_WALK_RATIO * mean_cost(r, first, j))
+    {
+      best = s;
+      split = j;
+    }
+  }
+  if (split < 0)
+  {
+    // One level only: every miss walks (or the L2 TLB outlasts the buffer).
+    r->walk_ns = mean_cost(r, first, n);
+    return 0;
+  }
+  r->l2_pages = r->point[split - 1].pages;
+  r->l2_hit_ns = mean_cost(r, first, split);
+  r->walk_ns = mean_cost(r, split, n);
+  return 0;
+}
+
+double tlb_cost_ns(const struct tlb_result *r, uint64_t bytes)
+{
+  uint64_t pages = (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+  if (pages <= r->l1_pages)
+    return 0;
+  if (r->l2_pages && pages <= r->l2_pages)
+    return r->l2_hit_ns;
+  return r->walk_ns;
+}
+
+void tlb_print(const struct tlb_result *r)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Translation-Cost\n");
+  output_printf("Pages,Working-Set-Bytes,Dense,Sparse,Translation-NS,Level\n");
+  for (int i = 0; i < r->num_points; i++)
+  {
+    const struct tlb_point *p = &r->point[i];
+    const char *level = p->pages <= r->l1_pages                    ? "l1-tlb"
+                        : r->l2_pages && p->pages <= r->l2_pages ? "l2-tlb"
+                                                                 : "walk";
+    output_printf("%llu,%llu,%.2f,%.2f,%.2f,%s\n", (unsigned long long)p->pages,
+                  (unsigned long long)(p->pages * PAGE_SIZE), p->dense, p->sparse, p->cost_ns, level);
+  }
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("TLB-Levels\n");
+  output_printf("L1-Pages,L2-Pages,L2-Hit-NS,Walk-NS\n");
+  output_printf("%llu,%llu,%.2f,%.2f\n", (unsigned long long)r->l1_pages, (unsigned long long)r->l2_pages, r->l2_hit_ns,
+                r->walk_ns);
+}
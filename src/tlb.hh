@@ -0,0 +1,73 @@
+#ifndef TLB_GUARD
+#define TLB_GUARD
+
+#include <stdint.h>
+
+#include "params.hh"
+
+// Translation cost by working-set size.
+//
+// A pair whose two loads land in pages the TLB has never seen pays for
+// translating them on top of the DRAM access, and over a buffer of base
+// pages that is most pairs. To price it, two pointer chases of the same
+// number of cached lines are timed at each size: one with every line in its
+// own page (PAGE_SIZE apart, the line offset rotated so the lines spread
+// over the cache sets), one with the lines packed into as few pages as
+// possible. Both touch the same amount of cache, so the difference is what
+// translation costs per load. As the number of pages grows the cost steps
+// up twice: when they outgrow the L1 TLB (an L2 TLB hit) and when they
+// outgrow the L2 TLB (a page walk). The two plateaus are found by splitting
+// the curve, and tlb_cost_ns prices a working set from them.
+//
+// With config.huge_pages the chases still stride by PAGE_SIZE, so the curve
+// shows what huge pages leave of the cost.
+
+struct tlb_point
+{
+  uint64_t pages;     // Lines in the chase, one per page for the sparse one
+  double dense;       // Timer units per load, lines packed
+  double sparse;      // Timer units per load, one line per page
+  double cost_ns;     // Translation per load: (sparse - dense) in ns
+};
+
+struct tlb_result
+{
+  int num_points;
+  struct tlb_point point[TLB_MAX_POINTS];
+
+  uint64_t l1_pages;  // Largest page count with no translation cost
+  uint64_t l2_pages;  // Largest page count served by the L2 TLB, 0 if no walk level was found
+  double l2_hit_ns;   // Per load, L1 TLB miss that hits the L2 TLB
+  double walk_ns;     // Per load, page walk
+};
+
+/*
+ * tlb_sweep
+ *
+ * Times the dense and sparse chases from TLB_MIN_PAGES pages, doubling up to
+ * TLB_MAX_PAGES or what the buffer holds, and finds the TLB levels.
+ *
+ * Inputs: base/size - Buffer for the chains (overwritten)
+ *         seed - Chase order
+ * Outputs: r - Cost curve and levels
+ * Returns: 0 if a translation cost was found, -1 otherwise
+ */
+int tlb_sweep(void *base, uint64_t size, uint64_t seed, struct tlb_result *r);
+
+/*
+ * tlb_analyze
+ *
+ * Finds the L1 and L2 TLB reach and the cost of each miss level in
+ * r->point, as filled in by tlb_sweep.
+ *
+ * Returns: 0 if a translation cost was found, -1 otherwise
+ */
+int tlb_analyze(struct tlb_result *r);
+
+// Translation cost per load, in ns, of a working set of bytes spread over
+// pages of PAGE_SIZE.
+double tlb_cost_ns(const struct tlb_result *r, uint64_t bytes);
+
+void tlb_print(const struct tlb_result *r);
+
+#endif
@@ -0,0 +1,42 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../timer.hh"
+#include "../tlb.hh"
+
+// Translation cost by working-set size: pointer chases over one line per
+// page against the same lines packed into few pages, so the TLB-miss and
+// page-walk share of a pair latency can be told apart and subtracted.
+
+int main(int argc, char **argv)
+{
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    timing_init();
+    uint64_t buffer_size_bytes = TLB_BUFFER_MB * (1024 * 1024);
+    allocated_mem = allocate_pages(buffer_size_bytes);
+
+    struct tlb_result res;
+    int found = !tlb_sweep(allocated_mem, buffer_size_bytes, config.pair_seed, &res);
+    clock_report();
+
+    // A histogram pair is two loads anywhere in its buffer.
+    uint64_t histogram_bytes = config_buffer_bytes();
+    output_printf("HEADER,HEADER\n");
+    output_printf("TLB benchmark\n");
+    output_printf("Backing, %s\n", allocated_backing);
+    output_printf("Backing page size, %llu\n", (unsigned long long) allocated_page_size);
+    output_printf("Chase stride, %d\n", PAGE_SIZE);
+    output_printf("Ticks per ns, %.4f\n", timestamp_ticks_per_ns());
+    output_printf("Translation found, %s\n", found ? "yes" : "no");
+    output_printf("Translation per pair at histogram buffer NS, %.2f\n", 2 * tlb_cost_ns(&res, histogram_bytes));
+    tlb_print(&res);
+
+    clock_service_stop();
+    output_shutdown();
+    return found ? 0 : 1;
+}
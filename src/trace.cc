@@ -0,0 +1,375 @@
+#include "trace.hh"
+#include "config.hh"
+#include "output.hh"
+#include "placement.hh"
+#include "shared.hh"
+#include "timer.hh"
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char trace_magic[8] = TRACE_MAGIC;
+
+// Room for the soft block limit plus the samples of one more pair.
+#define TRACE_BUFFER_BYTES (2 * TRACE_BLOCK_BYTES)
+// Longest encoded record: three 10-byte varints
+#define TRACE_RECORD_MAX (30)
+#define TRACE_BLOCK_HEADER (12)
+
+static inline uint64_t zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline void put_varint(struct trace_buffer *b, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    b->data[b->bytes++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  b->data[b->bytes++] = (uint8_t)v;
+}
+
+static inline int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v)
+{
+  uint64_t x = 0;
+  for (unsigned shift = 0; shift < 64 && *p < end; shift += 7)
+  {
+    uint8_t byte = *(*p)++;
+    x |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *v = x;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+void trace_writer_init(struct trace_writer *w, uint64_t base)
+{
+  w->base = base;
+  w->meta.clear();
+  w->open = 0;
+  w->epochs = w->pairs = w->samples = {NULL, 0, 0};
+  w->pairs_last_id = w->pairs_last_offset = 0;
+  w->samples_last_id = w->samples_last_latency = 0;
+  w->samples_last_epoch = 0;
+  w->epochs_recorded = -1;
+  w->total_pairs = w->total_samples = w->total_bytes = 0;
+}
+
+void trace_meta(struct trace_writer *w, const char *key, const char *fmt, ...)
+{
+  char value[OUTPUT_LINE_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(value, sizeof(value), fmt, ap);
+  va_end(ap);
+  w->meta += key;
+  w->meta += '=';
+  w->meta += value;
+  w->meta += '\n';
+}
+
+int trace_writer_open(struct trace_writer *w, const char *path)
+{
+  trace_meta(w, "version", "%d", TRACE_VERSION);
+  trace_meta(w, "timer", "%s", timer_backend());
+  trace_meta(w, "ticks_per_ns", "%.6f", timestamp_ticks_per_ns());
+  trace_meta(w, "placement", "%s", placement_policy_name((enum placement_policy)config.placement_policy));
+  trace_meta(w, "measure_cpu", "%d", placement_measure_cpu());
+  trace_meta(w, "counter_cpu", "%d", placement_counter_cpu());
+  trace_meta(w, "realtime", "%d", placement_realtime());
+#ifdef MEASURE_SIM
+  trace_meta(w, "buffer", "simulated");
+#else
+  trace_meta(w, "buffer", "%s", allocated_backing);
+#endif
+  trace_meta(w, "page_size", "%llu", (unsigned long long)allocated_page_size);
+  trace_meta(w, "prewarm", "%llu", (unsigned long long)config.prewarm);
+  trace_meta(w, "buffer_mb", "%llu", (unsigned long long)config.buffer_mb);
+  trace_meta(w, "row_size", "%llu", (unsigned long long)config.row_size);
+  trace_meta(w, "conflict_latency", "%llu", (unsigned long long)config.conflict_latency);
+  trace_meta(w, "adaptive_min_samples", "%d", ADAPTIVE_MIN_SAMPLES);
+  trace_meta(w, "adaptive_max_samples", "%d", ADAPTIVE_MAX_SAMPLES);
+  trace_meta(w, "adaptive_sign_margin", "%d", ADAPTIVE_SIGN_MARGIN);
+  trace_meta(w, "guard_max_retries", "%d", GUARD_MAX_RETRIES);
+  trace_meta(w, "clock_recal_sec", "%d", CLOCK_RECAL_SEC);
+  trace_meta(w, "pair_seed", "%llu", (unsigned long long)config.pair_seed);
+
+  if (output_open_sink(OUT_TRACE, path))
+    return -1;
+  w->epochs.data = (uint8_t *)malloc(TRACE_BUFFER_BYTES);
+  w->pairs.data = (uint8_t *)malloc(TRACE_BUFFER_BYTES);
+  w->samples.data = (uint8_t *)malloc(TRACE_BUFFER_BYTES);
+  if (!w->epochs.data || !w->pairs.data || !w->samples.data)
+  {
+    perror("malloc");
+    exit(1);
+  }
+
+  uint8_t header[16];
+  memcpy(header, trace_magic, sizeof(trace_magic));
+  put_u32(header + 8, TRACE_VERSION);
+  put_u32(header + 12, (uint32_t)w->meta.size());
+  output_write(OUT_TRACE, (const char *)header, sizeof(header));
+  output_write(OUT_TRACE, w->meta.data(), w->meta.size());
+  w->total_bytes = sizeof(header) + w->meta.size();
+  w->open = 1;
+  return 0;
+}
+
+static void emit_block(struct trace_writer *w, enum trace_block_type type, struct trace_buffer *b)
+{
+  if (!b->records)
+    return;
+  uint8_t header[TRACE_BLOCK_HEADER];
+  put_u32(header, type);
+  put_u32(header + 4, b->records);
+  put_u32(header + 8, (uint32_t)b->bytes);
+  output_write(OUT_TRACE, (const char *)header, sizeof(header));
+  output_write(OUT_TRACE, (const char *)b->data, b->bytes);
+  w->total_bytes += sizeof(header) + b->bytes;
+  b->bytes = 0;
+  b->records = 0;
+}
+
+// Epochs and pairs first, so every sample's references precede it.
+static void flush_blocks(struct trace_writer *w)
+{
+  emit_block(w, TRACE_BLOCK_EPOCHS, &w->epochs);
+  emit_block(w, TRACE_BLOCK_PAIRS, &w->pairs);
+  emit_block(w, TRACE_BLOCK_SAMPLES, &w->samples);
+  w->pairs_last_id = 0;
+  w->pairs_last_offset = 0;
+  w->samples_last_id = 0;
+  w->samples_last_latency = 0;
+  w->samples_last_epoch = 0;
+}
+
+void trace_pair(struct trace_writer *w, uint32_t pair_id, uint64_t addr_A, uint64_t addr_B)
+{
+  if (!w->open)
+    return;
+  if (w->samples.bytes >= TRACE_BLOCK_BYTES || w->pairs.bytes + TRACE_RECORD_MAX > TRACE_BUFFER_BYTES)
+    flush_blocks(w);
+
+  uint64_t off_A = addr_A - w->base;
+  uint64_t off_B = addr_B - w->base;
+  put_varint(&w->pairs, zigzag((int64_t)pair_id - (int64_t)w->pairs_last_id));
+  put_varint(&w->pairs, zigzag((int64_t)(off_A - w->pairs_last_offset)));
+  put_varint(&w->pairs, zigzag((int64_t)(off_B - off_A)));
+  w->pairs.records++;
+  w->pairs_last_id = pair_id;
+  w->pairs_last_offset = off_A;
+  w->total_pairs++;
+}
+
+void trace_sample(struct trace_writer *w, uint32_t pair_id, uint64_t latency, uint32_t epoch)
+{
+  if (!w->open)
+    return;
+  if (w->samples.bytes + TRACE_RECORD_MAX > TRACE_BUFFER_BYTES ||
+      w->epochs.bytes + 2 * TRACE_RECORD_MAX > TRACE_BUFFER_BYTES)
+    flush_blocks(w);
+
+  // First sample of a new epoch: record its rate for the replay.
+  while (w->epochs_recorded < (int64_t)epoch && w->epochs.bytes + TRACE_RECORD_MAX <= TRACE_BUFFER_BYTES)
+  {
+    uint32_t e = (uint32_t)++w->epochs_recorded;
+    double rate = clock_calibration_of(e).ticks_per_ns;
+    if (rate <= 0)
+      rate = timestamp_ticks_per_ns();
+    put_varint(&w->epochs, e);
+    memcpy(w->epochs.data + w->epochs.bytes, &rate, sizeof(rate));
+    w->epochs.bytes += sizeof(rate);
+    w->epochs.records++;
+  }
+
+  put_varint(&w->samples, zigzag((int64_t)pair_id - (int64_t)w->samples_last_id));
+  put_varint(&w->samples, zigzag((int64_t)(latency - w->samples_last_latency)));
+  put_varint(&w->samples, zigzag((int64_t)epoch - (int64_t)w->samples_last_epoch));
+  w->samples.records++;
+  w->samples_last_id = pair_id;
+  w->samples_last_latency = latency;
+  w->samples_last_epoch = epoch;
+  w->total_samples++;
+}
+
+void trace_writer_close(struct trace_writer *w)
+{
+  if (w->open)
+  {
+    flush_blocks(w);
+    output_flush();
+    output_log("[+] trace: %llu pairs, %llu samples, %llu bytes (%.2f bytes/sample)\n",
+               (unsigned long long)w->total_pairs, (unsigned long long)w->total_samples,
+               (unsigned long long)w->total_bytes,
+               w->total_samples ? (double)w->total_bytes / w->total_samples : 0.0);
+  }
+  free(w->epochs.data);
+  free(w->pairs.data);
+  free(w->samples.data);
+  w->epochs.data = w->pairs.data = w->samples.data = NULL;
+  w->open = 0;
+}
+
+int trace_reader_open(struct trace_reader *r, const char *path)
+{
+  memset(r, 0, sizeof(*r));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    perror("open");
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < 16)
+  {
+    output_log("[-] trace: %s is too short\n", path);
+    close(fd);
+    return -1;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    perror("mmap");
+    return -1;
+  }
+  r->map = (const uint8_t *)map;
+  r->size = st.st_size;
+
+  r->version = get_u32(r->map + 8);
+  r->meta_bytes = get_u32(r->map + 12);
+  if (memcmp(r->map, trace_magic, sizeof(trace_magic)) || r->version != TRACE_VERSION ||
+      16 + r->meta_bytes > r->size)
+  {
+    output_log("[-] trace: %s is not a version %d trace\n", path, TRACE_VERSION);
+    trace_reader_close(r);
+    return -1;
+  }
+  r->meta = (const char *)r->map + 16;
+  // Whole file is read front to back.
+  madvise((void *)r->map, r->size, MADV_SEQUENTIAL);
+  trace_rewind(r);
+  return 0;
+}
+
+void trace_reader_close(struct trace_reader *r)
+{
+  if (r->map)
+    munmap((void *)r->map, r->size);
+  r->map = NULL;
+}
+
+std::string trace_meta_get(const struct trace_reader *r, const char *key, const char *def)
+{
+  size_t key_len = strlen(key);
+  const char *p = r->meta;
+  const char *end = r->meta + r->meta_bytes;
+  while (p < end)
+  {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (!eol)
+      eol = end;
+    if ((size_t)(eol - p) > key_len && !memcmp(p, key, key_len) && p[key_len] == '=')
+      return std::string(p + key_len + 1, eol);
+    p = eol + 1;
+  }
+  return def;
+}
+
+void trace_rewind(struct trace_reader *r)
+{
+  r->next_block = 16 + r->meta_bytes;
+  r->records_left = 0;
+  r->truncated = 0;
+}
+
+int trace_next(struct trace_reader *r, struct trace_record *rec)
+{
+  while (r->records_left == 0)
+  {
+    if (r->next_block + TRACE_BLOCK_HEADER > r->size)
+    {
+      r->truncated = r->next_block != r->size;
+      return 0;
+    }
+    const uint8_t *h = r->map + r->next_block;
+    uint32_t bytes = get_u32(h + 8);
+    if (r->next_block + TRACE_BLOCK_HEADER + bytes > r->size)
+    {
+      r->truncated = 1;
+      return 0;
+    }
+    r->type = (enum trace_block_type)get_u32(h);
+    r->records_left = get_u32(h + 4);
+    r->p = h + TRACE_BLOCK_HEADER;
+    r->end = r->p + bytes;
+    r->next_block += TRACE_BLOCK_HEADER + bytes;
+    if (r->type < TRACE_BLOCK_EPOCHS || r->type > TRACE_BLOCK_SAMPLES)
+      r->records_left = 0;
+    r->pair_id = 0;
+    r->offset = 0;
+    r->latency = 0;
+    r->epoch = 0;
+  }
+
+  uint64_t a, b, c;
+  rec->type = r->type;
+  switch (r->type)
+  {
+  case TRACE_BLOCK_EPOCHS:
+    if (get_varint(&r->p, r->end, &a) || r->end - r->p < (ptrdiff_t)sizeof(double))
+      return -1;
+    rec->epoch = (uint32_t)a;
+    memcpy(&rec->ticks_per_ns, r->p, sizeof(double));
+    r->p += sizeof(double);
+    break;
+  case TRACE_BLOCK_PAIRS:
+    if (get_varint(&r->p, r->end, &a) || get_varint(&r->p, r->end, &b) || get_varint(&r->p, r->end, &c))
+      return -1;
+    r->pair_id += (uint32_t)unzigzag(a);
+    r->offset += (uint64_t)unzigzag(b);
+    rec->pair_id = r->pair_id;
+    rec->offset_A = r->offset;
+    rec->offset_B = r->offset + (uint64_t)unzigzag(c);
+    break;
+  case TRACE_BLOCK_SAMPLES:
+    if (get_varint(&r->p, r->end, &a) || get_varint(&r->p, r->end, &b) || get_varint(&r->p, r->end, &c))
+      return -1;
+    r->pair_id += (uint32_t)unzigzag(a);
+    r->latency += (uint64_t)unzigzag(b);
+    r->epoch += (uint32_t)unzigzag(c);
+    rec->pair_id = r->pair_id;
+    rec->latency = r->latency;
+    rec->epoch = r->epoch;
+    break;
+  }
+  r->records_left--;
+  return 1;
+}
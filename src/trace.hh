@@ -0,0 +1,148 @@
+#ifndef TRACE_GUARD
+#define TRACE_GUARD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "params.hh"
+
+// Raw-sample trace format.
+//
+// Every latency sample of a sweep, so a new analysis can be tried on an old
+// run without going back to the device. Layout (little-endian):
+//
+//   header   "DRAMTRC\0", u32 version, u32 meta_bytes
+//   meta     meta_bytes of "key=value\n" lines: timer backend, placement,
+//            buffer backing, the params.hh values the run was built with
+//   blocks   u32 type, u32 records, u32 payload_bytes, then the payload
+//
+// Payloads are LEB128 varints; signed deltas are zigzag-encoded, and every
+// delta restarts at zero in each block so blocks decode independently.
+//   TRACE_BLOCK_EPOCHS   epoch, ticks_per_ns as the 8 raw bytes of a double
+//   TRACE_BLOCK_PAIRS    delta pair id, delta offset A, offset B - offset A
+//   TRACE_BLOCK_SAMPLES  delta pair id, delta latency, delta epoch
+// Offsets are from the buffer base, latencies raw timer units of their
+// epoch. The writer emits epochs and pairs before the samples that use them,
+// and a run cut short leaves at most a truncated last block, which the
+// reader stops at.
+
+#define TRACE_MAGIC "DRAMTRC"
+#define TRACE_VERSION (1)
+
+enum trace_block_type
+{
+  TRACE_BLOCK_EPOCHS = 1,
+  TRACE_BLOCK_PAIRS = 2,
+  TRACE_BLOCK_SAMPLES = 3,
+};
+
+struct trace_record
+{
+  enum trace_block_type type;
+  uint32_t pair_id;
+  uint64_t offset_A;   // Pairs
+  uint64_t offset_B;
+  uint64_t latency;    // Samples
+  uint32_t epoch;      // Samples and epochs
+  double ticks_per_ns; // Epochs
+};
+
+struct trace_buffer
+{
+  uint8_t *data;
+  size_t bytes;
+  uint32_t records;
+};
+
+// Streaming writer. Encoded blocks go to OUT_TRACE of the output layer, so
+// the write(2) calls happen on the writer thread, never between samples.
+struct trace_writer
+{
+  uint64_t base;
+  std::string meta;
+  int open;
+
+  struct trace_buffer epochs;
+  struct trace_buffer pairs;
+  struct trace_buffer samples;
+  // Delta bases, reset with every block
+  uint32_t pairs_last_id;
+  uint64_t pairs_last_offset;
+  uint32_t samples_last_id;
+  uint64_t samples_last_latency;
+  uint32_t samples_last_epoch;
+  int64_t epochs_recorded; // Highest epoch whose rate is in the trace, -1 for none
+
+  uint64_t total_pairs;
+  uint64_t total_samples;
+  uint64_t total_bytes;
+};
+
+// Resets w for a buffer starting at base. Metadata may be added until open.
+void trace_writer_init(struct trace_writer *w, uint64_t base);
+void trace_meta(struct trace_writer *w, const char *key, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/*
+ * trace_writer_open
+ *
+ * Adds the run metadata every trace carries (timer, placement, buffer,
+ * params) and writes the header to path through OUT_TRACE. output_init must
+ * have been called.
+ *
+ * Returns: 0 on success, -1 if path could not be opened
+ */
+int trace_writer_open(struct trace_writer *w, const char *path);
+
+// Declares a pair. Full blocks are only cut here, between pairs.
+void trace_pair(struct trace_writer *w, uint32_t pair_id, uint64_t addr_A, uint64_t addr_B);
+
+// One raw sample of a declared pair, in timer units of epoch.
+void trace_sample(struct trace_writer *w, uint32_t pair_id, uint64_t latency, uint32_t epoch);
+
+// Writes the last blocks, waits for them to reach the file and frees w.
+void trace_writer_close(struct trace_writer *w);
+
+// Memory-mapped reader.
+struct trace_reader
+{
+  const uint8_t *map;
+  size_t size;
+  uint32_t version;
+  const char *meta;
+  size_t meta_bytes;
+
+  size_t next_block; // File offset of the next block header
+  enum trace_block_type type;
+  uint32_t records_left;
+  const uint8_t *p;
+  const uint8_t *end;
+  uint32_t pair_id;
+  uint64_t offset;
+  uint64_t latency;
+  uint32_t epoch;
+  int truncated; // Stopped at a block running past the end of the file
+};
+
+// Returns: 0 on success, -1 if the file cannot be mapped or is not a trace
+int trace_reader_open(struct trace_reader *r, const char *path);
+void trace_reader_close(struct trace_reader *r);
+
+// Value of a metadata key, or def if the trace does not have it.
+std::string trace_meta_get(const struct trace_reader *r, const char *key, const char *def);
+
+// Back to the first block.
+void trace_rewind(struct trace_reader *r);
+
+/*
+ * trace_next
+ *
+ * Decodes the next record in file order.
+ *
+ * Outputs: rec - The record
+ * Returns: 1 for a record, 0 at the end of the trace, -1 on a corrupt block.
+ *          Blocks of unknown type are skipped.
+ */
+int trace_next(struct trace_reader *r, struct trace_record *rec);
+
+#endif
@@ -36,15 +36,27 @@
 //   asm volatile("lfence");
 // }
 
+// Host builds: on x86-64 the arm_v8_* helpers below map onto the nearest
+// x86 instructions (mfence/lfence, clflush, rdtsc) so the same sources build
+// and run natively for the simulator and timer benchmarks.
+
 static inline void arm_v8_memory_barrier(void)
 {
+#if defined(__aarch64__)
   asm volatile("DSB SY");
   asm volatile("ISB");
+#elif defined(__x86_64__)
+  asm volatile("mfence\n\tlfence" ::: "memory");
+#endif
 }
 
 static inline void arm_v8_dsb_barrier(void)
 {
+#if defined(__aarch64__)
   asm volatile("DSB SY");
+#elif defined(__x86_64__)
+  asm volatile("mfence" ::: "memory");
+#endif
 }
 
 static inline int power(int base, unsigned int exp)
@@ -91,6 +103,7 @@ static inline void arm_v8_cache_flush(uint64_t addr)
   //  asm volatile ("IC IVAU, %0" :: "r"(addr));
   //  The above should not work.
 
+#if defined(__aarch64__)
   asm volatile("DC CIVAC, %0" ::"r"(addr));
   // asm volatile ("DC CVAC, %0" :: "r"(addr));
   asm volatile ("IC IVAU, %0" :: "r"(addr));
@@ -98,6 +111,9 @@ static inline void arm_v8_cache_flush(uint64_t addr)
   // Some combination of memory barriers needed.
   asm volatile("DSB SY");
   asm volatile("ISB");
+#elif defined(__x86_64__)
+  asm volatile("clflush (%0)\n\tmfence" ::"r"(addr) : "memory");
+#endif
 }
 
 
@@ -106,7 +122,11 @@ static inline void arm_v8_cache_flush(uint64_t addr)
  * Using STR VAL, [ADDR] to store a value into an address.
 */
 static inline void store_value(int* addr, int value) {
+#if defined(__aarch64__)
     asm volatile ("str %1, [%0]" :: "r" (addr), "r" (value) );
+#else
+    *(volatile int *)addr = value;
+#endif
 }
 
 /**
@@ -124,7 +144,14 @@ static inline uint64_t rdtsc(void)
    * bits wide and it is attributed with the flag 'cap_user_time_short'
    * is true.
    */
+#if defined(__aarch64__)
   asm volatile("mrs %0, cntvct_el0" : "=r"(val));
+#elif defined(__x86_64__)
+  // x86 host: the invariant TSC instead of the generic timer
+  uint32_t low, high;
+  asm volatile("rdtsc" : "=a"(low), "=d"(high));
+  val = ((uint64_t)high << 32) | low;
+#endif
 
   return val;
 }
@@ -0,0 +1,231 @@
+#include "workers.hh"
+#include "output.hh"
+#include "placement.hh"
+#include "shared.hh"
+#include "timer.hh"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory counters need lock-free atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory counters need lock-free atomics");
+
+struct worker_shared *workers_create(int num_workers)
+{
+  if (num_workers < 1 || num_workers > WORKERS_MAX)
+  {
+    output_log("[-] workers: %d workers, must be 1 to %d\n", num_workers, WORKERS_MAX);
+    return NULL;
+  }
+  void *mem = mmap(NULL, sizeof(struct worker_shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+  if (mem == MAP_FAILED)
+  {
+    perror("mmap");
+    return NULL;
+  }
+  // Anonymous memory is zeroed, which is a valid state for every atomic here.
+  struct worker_shared *sh = (struct worker_shared *)mem;
+  sh->num_workers = num_workers;
+  for (int w = 0; w < num_workers; w++)
+  {
+    sh->slot[w].status = -1;
+    sh->slot[w].measure_cpu = -1;
+    sh->slot[w].counter_cpu = -1;
+  }
+  return sh;
+}
+
+void workers_destroy(struct worker_shared *sh)
+{
+  munmap(sh, sizeof(struct worker_shared));
+}
+
+// Exit status of a reaped worker, -1 unless it exited normally.
+static int exit_status(int status)
+{
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int workers_run(struct worker_shared *sh, worker_fn fn, void *arg)
+{
+  int n = sh->num_workers;
+  pid_t pid[WORKERS_MAX];
+  int reaped[WORKERS_MAX] = {0};
+  int launched = 0;
+  int abort_run = 0;
+
+  sh->ready.store(0);
+  sh->go.store(0);
+  output_flush();
+  for (int w = 0; w < n; w++)
+  {
+    pid[w] = fork();
+    if (pid[w] == 0)
+    {
+      int rc = fn(w, sh, arg);
+      output_shutdown();
+      _exit(rc & 0xff);
+    }
+    if (pid[w] < 0)
+    {
+      perror("fork");
+      abort_run = 1;
+      break;
+    }
+    sh->slot[w].pid = pid[w];
+    launched++;
+  }
+
+  // Start barrier: release everyone at once, or nobody.
+  uint64_t deadline = monotonic_ns() + (uint64_t)WORKERS_BARRIER_SEC * 1000000000ULL;
+  while (!abort_run && sh->ready.load(std::memory_order_acquire) < (uint32_t)n)
+  {
+    for (int w = 0; w < launched; w++)
+    {
+      int status;
+      if (!reaped[w] && waitpid(pid[w], &status, WNOHANG) == pid[w])
+      {
+        reaped[w] = 1;
+        sh->slot[w].status = exit_status(status);
+        output_log("[-] workers: worker %d exited before the start barrier\n", w);
+        abort_run = 1;
+      }
+    }
+    if (monotonic_ns() > deadline)
+    {
+      output_log("[-] workers: only %u of %d workers reached the start barrier\n", sh->ready.load(), n);
+      abort_run = 1;
+    }
+    usleep(1000);
+  }
+  if (!abort_run)
+  {
+    // Every worker has reported its rate by now; merge in their mean.
+    double rate_sum = 0;
+    for (int w = 0; w < n; w++)
+      rate_sum += sh->slot[w].ticks_per_ns;
+    sh->ticks_per_ns = rate_sum / n;
+    sh->start_ns = monotonic_ns();
+    output_log("[+] workers: %d workers released\n", n);
+  }
+  sh->go.store(abort_run ? 2 : 1, std::memory_order_release);
+
+  int failed = n - launched;
+  for (int w = 0; w < launched; w++)
+  {
+    int status;
+    if (!reaped[w])
+    {
+      pid_t got;
+      while ((got = waitpid(pid[w], &status, 0)) < 0 && errno == EINTR)
+        ;
+      if (got == pid[w])
+        sh->slot[w].status = exit_status(status);
+      else
+      {
+        output_log("[-] workers: could not reap worker %d: %s\n", w, strerror(errno));
+        sh->slot[w].status = -1;
+      }
+    }
+    failed += sh->slot[w].status != 0;
+  }
+  return failed;
+}
+
+int worker_barrier(struct worker_shared *sh, int worker)
+{
+  struct worker_slot *slot = &sh->slot[worker];
+  slot->pid = getpid();
+  slot->measure_cpu = placement_measure_cpu();
+  slot->counter_cpu = placement_counter_cpu();
+  // The simulator has no clock service: its tick rate instead.
+  slot->ticks_per_ns = clock_calibration_of(0).ticks_per_ns;
+  if (slot->ticks_per_ns <= 0)
+    slot->ticks_per_ns = timestamp_ticks_per_ns();
+
+  sh->ready.fetch_add(1, std::memory_order_acq_rel);
+  uint32_t go;
+  while ((go = sh->go.load(std::memory_order_acquire)) == 0)
+    ;
+  return go == 1 ? 0 : -1;
+}
+
+void worker_count(struct worker_shared *sh, int worker, struct worker_local *l, const struct pair_result *res)
+{
+  double own = sh->slot[worker].ticks_per_ns;
+  double scale = own > 0 && sh->ticks_per_ns > 0 ? sh->ticks_per_ns / own : 1.0;
+  l->histogram[sweep_bucket((uint64_t)(res->median * scale + 0.5))]++;
+  l->pairs++;
+  l->samples += res->num_samples;
+  l->ambiguous += res->decision == PAIR_AMBIGUOUS;
+  l->conflicts += res->decision == PAIR_CONFLICT;
+  if (l->pairs >= WORKERS_MERGE_PAIRS)
+    worker_merge(sh, worker, l);
+}
+
+void worker_merge(struct worker_shared *sh, int worker, struct worker_local *l)
+{
+  struct worker_slot *slot = &sh->slot[worker];
+  for (int b = 0; b < WORKER_BUCKETS; b++)
+  {
+    if (!l->histogram[b])
+      continue;
+    sh->histogram[b].fetch_add(l->histogram[b], std::memory_order_relaxed);
+    slot->histogram[b] += l->histogram[b];
+  }
+  sh->pairs.fetch_add(l->pairs, std::memory_order_relaxed);
+  sh->samples.fetch_add(l->samples, std::memory_order_relaxed);
+  sh->conflicts.fetch_add(l->conflicts, std::memory_order_relaxed);
+  sh->merges.fetch_add(1, std::memory_order_relaxed);
+
+  slot->pairs += l->pairs;
+  slot->samples += l->samples;
+  slot->ambiguous += l->ambiguous;
+  slot->conflicts += l->conflicts;
+  slot->correct += l->correct;
+  slot->seconds = (monotonic_ns() - sh->start_ns) / 1e9;
+  memset(l, 0, sizeof(*l));
+}
+
+// Bucket holding the median pair of a histogram.
+static int median_bucket(const uint64_t *hist, uint64_t total)
+{
+  uint64_t seen = 0;
+  for (int b = 0; b < WORKER_BUCKETS; b++)
+  {
+    seen += hist[b];
+    if (2 * seen >= total && total)
+      return b;
+  }
+  return -1;
+}
+
+void workers_print(const struct worker_shared *sh)
+{
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("Workers\n");
+  output_printf("Worker,PID,Measure-CPU,Counter-CPU,Ticks-Per-NS,Status,Pairs,Samples,Ambiguous,Conflict-Fraction,"
+                "Median-Bucket,Rejected,Seconds,Pairs-Per-Sec\n");
+  for (int w = 0; w < sh->num_workers; w++)
+  {
+    const struct worker_slot *s = &sh->slot[w];
+    int median = median_bucket(s->histogram, s->pairs);
+    output_printf("%d,%d,%d,%d,%.4f,%d,%llu,%llu,%llu,%.4f,[%d-%d),%llu,%.2f,%.0f\n", w, (int)s->pid,
+                  s->measure_cpu, s->counter_cpu, s->ticks_per_ns, s->status, (unsigned long long)s->pairs, (unsigned long long)s->samples,
+                  (unsigned long long)s->ambiguous, s->pairs ? (double)s->conflicts / s->pairs : 0.0, median * 10,
+                  median * 10 + 10, (unsigned long long)s->rejected, s->seconds,
+                  s->seconds > 0 ? s->pairs / s->seconds : 0.0);
+  }
+
+  output_printf("TABLESTART,TABLESTART\n");
+  output_printf("UNIT,TICKS\n");
+  output_printf("TIMING-METHOD,%s\n", timer_backend());
+  output_printf("Timing-Unit,Number-of-Address-Pairs\n");
+  for (int i = 0; i < WORKER_BUCKETS - 1; i++)
+    output_printf("[%d-%d),%15llu\n", i * 10, i * 10 + 10, (unsigned long long)sh->histogram[i].load());
+  output_printf("[%d),%15llu \n", (WORKER_BUCKETS - 1) * 10, (unsigned long long)sh->histogram[WORKER_BUCKETS - 1].load());
+}
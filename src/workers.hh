@@ -0,0 +1,128 @@
+#ifndef WORKERS_GUARD
+#define WORKERS_GUARD
+
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "params.hh"
+#include "sweep.hh"
+
+// Multi-process measurement.
+//
+// Worker processes instead of threads: each has its own address space,
+// allocator, buffer and (with TIMING_PTHREAD) counter thread, so workers
+// cannot disturb each other through anything but the hardware. The launcher
+// maps a shared region, forks the workers and releases them together from a
+// start barrier once all have finished their setup. Workers count into a
+// local histogram and merge it into the shared one with atomic adds every
+// WORKERS_MERGE_PAIRS pairs; each also keeps its own totals in its slot for
+// per-worker (A/B) comparison. The parent aggregates and reports.
+//
+// Each worker's counter thread ticks at its own rate (a P core and an E core
+// differ), so every worker reports its epoch 0 rate at the barrier and its
+// medians are rescaled to the mean of those rates before they are bucketed:
+// the merged histogram is in ticks of worker_shared::ticks_per_ns.
+//
+// The region lives in MAP_SHARED memory, so its atomics must be lock-free.
+
+// Same buckets as histogram: SWEEP_BUCKET_WIDTH timer units wide, the last
+// one open.
+#define WORKER_BUCKETS (SWEEP_BUCKETS)
+
+// Totals of one worker. Written only by that worker.
+struct worker_slot
+{
+  pid_t pid;
+  int measure_cpu;
+  int counter_cpu;
+  int status; // Exit status, -1 if the worker was killed or never ran
+  double ticks_per_ns; // Epoch 0 rate of the worker's clock
+  uint64_t pairs;
+  uint64_t samples;
+  uint64_t ambiguous;
+  uint64_t conflicts;
+  uint64_t correct;  // Checked against ground truth, where a worker has it
+  uint64_t rejected; // Samples the guard retried
+  double seconds;    // From the barrier to the worker's last merge
+  uint64_t histogram[WORKER_BUCKETS];
+};
+
+struct worker_shared
+{
+  int num_workers;
+  std::atomic<uint32_t> ready; // Workers waiting at the barrier
+  std::atomic<uint32_t> go;    // 1: start, 2: abort
+  uint64_t start_ns;
+  double ticks_per_ns;         // Rate the shared histogram is in, set at release
+
+  // Merged over all workers
+  std::atomic<uint64_t> histogram[WORKER_BUCKETS];
+  std::atomic<uint64_t> pairs;
+  std::atomic<uint64_t> samples;
+  std::atomic<uint64_t> conflicts;
+  std::atomic<uint64_t> merges;
+
+  struct worker_slot slot[WORKERS_MAX];
+};
+
+// What a worker counts between merges.
+struct worker_local
+{
+  uint64_t histogram[WORKER_BUCKETS];
+  uint64_t pairs;
+  uint64_t samples;
+  uint64_t ambiguous;
+  uint64_t conflicts;
+  uint64_t correct;
+};
+
+/*
+ * Worker body, run in the child after fork(). It does its setup, calls
+ * worker_barrier, measures, merges, and returns its exit status.
+ */
+typedef int (*worker_fn)(int worker, struct worker_shared *sh, void *arg);
+
+// Shared region for num_workers workers, or NULL.
+struct worker_shared *workers_create(int num_workers);
+void workers_destroy(struct worker_shared *sh);
+
+/*
+ * workers_run
+ *
+ * Forks sh->num_workers workers running fn, releases the start barrier once
+ * all are waiting at it (or aborts it if one dies first or
+ * WORKERS_BARRIER_SEC pass), and waits for every worker to exit. The caller
+ * should not have started threads other than the output writer: a forked
+ * child keeps only the forking thread.
+ *
+ * Returns: Number of workers that did not exit with status 0
+ */
+int workers_run(struct worker_shared *sh, worker_fn fn, void *arg);
+
+/*
+ * worker_barrier
+ *
+ * Called by a worker once its setup is done. Spins until the launcher
+ * releases every worker at once.
+ *
+ * Returns: 0 to start measuring, -1 if the launcher aborted the run
+ */
+int worker_barrier(struct worker_shared *sh, int worker);
+
+/*
+ * worker_count
+ *
+ * Counts one measured pair into l, its median rescaled from the worker's
+ * clock to sh->ticks_per_ns, and merges l once it holds
+ * WORKERS_MERGE_PAIRS pairs.
+ */
+void worker_count(struct worker_shared *sh, int worker, struct worker_local *l, const struct pair_result *res);
+
+// Adds l into the shared totals and worker's slot, then clears it.
+void worker_merge(struct worker_shared *sh, int worker, struct worker_local *l);
+
+// Per-worker table, then the merged histogram, in histogram's format.
+void workers_print(const struct worker_shared *sh);
+
+#endif
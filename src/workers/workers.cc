@@ -0,0 +1,78 @@
+#include "../shared.hh"
+#include "../config.hh"
+#include "../util.hh"
+#include "../params.hh"
+#include "../output.hh"
+#include "../guard.hh"
+#include "../timer.hh"
+#include "../sweep.hh"
+#include "../workers.hh"
+
+// The histogram sweep in config.workers processes at once, each on its own CPUs
+// with its own buffer and counter thread, merged through shared memory.
+
+static int sweep_worker(int worker, struct worker_shared *sh, void *arg) {
+    int n = sh->num_workers;
+    timing_init_worker(worker, n);
+    uint64_t buffer_size_bytes = config.workers_buffer_mb * (1024*1024);
+    allocated_mem = allocate_pages(buffer_size_bytes);
+
+    uint64_t num_rows = buffer_size_bytes / config.row_size;
+    uint64_t max_pairs = config.pair_budget_pairs ? (config.pair_budget_pairs + n - 1) / n : num_rows - 1;
+    guard_init(&default_guard, config.prewarm ? measure_bank_latency_prewarm : measure_bank_latency);
+    struct latency_sweep sweep;
+    latency_sweep_init(&sweep, allocated_mem, buffer_size_bytes, config.pair_seed + worker, max_pairs,
+                       config.conflict_latency, config.sample_budget ? (config.sample_budget + n - 1) / n : 0);
+
+    struct worker_local local;
+    memset(&local, 0, sizeof(local));
+    if (worker_barrier(sh, worker)) {
+        clock_service_stop();
+        return 1;
+    }
+    // The pair sampler's time budget starts at the barrier, like everyone's.
+    sweep.pairs.start_sec = monotonic_ns() / 1e9;
+
+    struct pair_result res;
+    while (latency_sweep_next(&sweep, &res))
+        worker_count(sh, worker, &local, &res);
+    worker_merge(sh, worker, &local);
+    sh->slot[worker].rejected = latency_sweep_rejected(&sweep, NULL);
+    clock_service_stop();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    output_init(NULL);
+    int rc = config_init(&argc, argv);
+    if (rc)
+        return rc < 0 ? 2 : 0;
+    struct worker_shared *sh = workers_create((int) config.workers);
+    if (!sh)
+        return 1;
+
+    // Forks before any timer or placement thread exists; each worker
+    // starts its own.
+    int failed = workers_run(sh, sweep_worker, NULL);
+
+    output_printf("HEADER,HEADER\n");
+    output_printf("Workers, %d\n", sh->num_workers);
+    output_printf("Buffer per worker MB, %llu\n", (unsigned long long) config.workers_buffer_mb);
+    output_printf("Pair mode, %s\n", pair_mode_name((enum pair_mode) config.pair_mode));
+    output_printf("Pair seed, %llu (+ worker)\n", (unsigned long long) config.pair_seed);
+    output_printf("Row order, %s\n", order_mode_name((enum order_mode) config.order));
+    output_printf("Pairs measured, %llu\n", (unsigned long long) sh->pairs.load());
+    output_printf("Total samples, %llu\n", (unsigned long long) sh->samples.load());
+    output_printf("Conflict fraction, %.4f\n", sh->pairs ? (double) sh->conflicts / sh->pairs : 0.0);
+    output_printf("Merges, %llu\n", (unsigned long long) sh->merges.load());
+    output_printf("Timer, %s\n", timer_backend());
+    // The merged table is in ticks of the workers' mean rate, see workers.hh.
+    output_printf("Epoch 0 ticks per ns, %.4f\n", sh->ticks_per_ns);
+    output_printf("Failed workers, %d\n", failed);
+    config_print();
+    workers_print(sh);
+
+    workers_destroy(sh);
+    output_shutdown();
+    return failed ? 1 : 0;
+}